@@ -0,0 +1,156 @@
+/*
+ Arena allocator
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#ifndef MP_ARENA_H_
+#define MP_ARENA_H_
+
+#include <cstddef>
+
+#include "mp/format.h"
+
+namespace mp {
+
+// A memory arena that allocates objects from large chunks by bumping a
+// pointer. Objects cannot be freed individually: all of them are freed at
+// once when the arena is destroyed or released, in time proportional to
+// the number of chunks.
+class Arena {
+ private:
+  // A chunk header. The usable memory follows the header padded to
+  // CACHE_LINE_SIZE.
+  struct Chunk {
+    Chunk *next;
+    std::size_t offset;  // Offset from the pointer returned by operator new.
+  };
+
+  Chunk *chunks_;
+  char *ptr_;  // Pointer to the free memory in the current chunk.
+  char *end_;  // Pointer to the end of the current chunk.
+  std::size_t chunk_size_;
+  std::size_t num_chunks_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(Arena);
+
+  // Allocates a new chunk and returns size bytes from it.
+  void *AllocateChunk(std::size_t size);
+
+ public:
+  enum {
+    // Alignment of allocated objects. Expressions contain doubles and
+    // pointers, so there is no need for larger alignment.
+    ALIGNMENT =
+        sizeof(double) > sizeof(void*) ? sizeof(double) : sizeof(void*),
+
+    // Chunks are aligned to a cache line.
+    CACHE_LINE_SIZE = 64,
+
+    DEFAULT_CHUNK_SIZE = 64 * 1024
+  };
+
+  explicit Arena(std::size_t chunk_size = DEFAULT_CHUNK_SIZE)
+    : chunks_(0), ptr_(0), end_(0), chunk_size_(chunk_size), num_chunks_(0) {}
+
+  ~Arena() { Release(); }
+
+  // Allocates size bytes of memory aligned to ALIGNMENT.
+  void *Allocate(std::size_t size) {
+    size = (size + ALIGNMENT - 1) & ~static_cast<std::size_t>(ALIGNMENT - 1);
+    if (static_cast<std::size_t>(end_ - ptr_) < size)
+      return AllocateChunk(size);
+    void *result = ptr_;
+    ptr_ += size;
+    return result;
+  }
+
+  // Frees all memory allocated in the arena.
+  void Release();
+
+  // Returns the number of chunks.
+  std::size_t num_chunks() const { return num_chunks_; }
+};
+
+// An allocator that allocates memory in an arena. Deallocation is a no-op;
+// the memory is freed when the arena is destroyed.
+template <typename T = char>
+class ArenaAllocator {
+ private:
+  Arena *arena_;
+
+  template <typename U>
+  friend class ArenaAllocator;
+
+ public:
+  typedef T value_type;
+  typedef T *pointer;
+  typedef const T *const_pointer;
+  typedef T &reference;
+  typedef const T &const_reference;
+  typedef std::size_t size_type;
+  typedef std::ptrdiff_t difference_type;
+
+  template <typename U>
+  struct rebind {
+    typedef ArenaAllocator<U> other;
+  };
+
+  explicit ArenaAllocator(Arena *arena) : arena_(arena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena_) {}
+
+  Arena *arena() const { return arena_; }
+
+  T *allocate(std::size_t n) {
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T *, std::size_t) {}
+
+  std::size_t max_size() const {
+    return static_cast<std::size_t>(-1) / sizeof(T);
+  }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U> &other) const {
+    return arena_ == other.arena_;
+  }
+
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U> &other) const {
+    return arena_ != other.arena_;
+  }
+};
+
+namespace internal {
+// Checks if Alloc frees all memory at once in which case there is no need
+// to keep track of allocated objects.
+template <typename Alloc>
+struct HasBulkDeallocation {
+  enum { value = false };
+};
+
+template <typename T>
+struct HasBulkDeallocation< ArenaAllocator<T> > {
+  enum { value = true };
+};
+}  // namespace internal
+}  // namespace mp
+
+#endif  // MP_ARENA_H_
@@ -0,0 +1,248 @@
+/*
+ Reverse-mode automatic differentiation of expression tapes
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#ifndef MP_EXPR_AD_H_
+#define MP_EXPR_AD_H_
+
+#include <vector>
+
+#include "mp/expr-tape.h"
+
+namespace mp {
+
+// Computes derivatives of expression tape outputs in reverse mode.
+//
+// The tape is split into segments: one for each output and one for each
+// shared instruction, i.e. an instruction such as a common expression
+// whose value is used more than once. A segment consists of instructions
+// that are reachable from its root without passing through another
+// shared instruction. The gradient of a shared instruction is computed
+// once per point and then combined into gradients of all segments that
+// use it, so its subexpression is differentiated only once.
+//
+// Only arguments with nonzero derivatives are followed, so variables
+// that only occur in conditions, counts or logical expressions are not
+// included in the Jacobian structure.
+class ReverseAD {
+ private:
+  ExprTape &tape_;
+
+  // A segment of the tape. Elements of each segment are stored
+  // consecutively and the element ranges are given by the start fields
+  // of this and the next segment.
+  struct Segment {
+    int root;
+    // Start of instructions in cone_ in decreasing order of indices.
+    int cone_start;
+    // Start of shared segments used by this segment in refs_.
+    int ref_start;
+    // Start of variable indices in pattern_.
+    int pattern_start;
+  };
+
+  // Output segments followed by shared segments.
+  std::vector<Segment> segments_;
+  std::vector<int> cone_;
+  std::vector<int> refs_;
+
+  // Variable indices of segment gradients. Rows of the Jacobian come
+  // first so that the first num_jac_nonzeros() elements form its
+  // structure in CSR format.
+  std::vector<int> pattern_;
+  std::vector<int> jac_row_starts_;
+
+  // Segment indices of shared instructions or -1.
+  std::vector<int> shared_;
+
+  // Gradients of shared segments at the current point indexed by
+  // positions in pattern_ and the evaluation numbers they correspond to.
+  std::vector<double> shared_grads_;
+  std::vector<unsigned> shared_stamps_;
+  unsigned stamp_;
+
+  // Adjoints of instructions and a dense gradient accumulator that are
+  // kept zero between uses.
+  std::vector<double> adjoints_;
+  std::vector<double> grad_;
+
+  // The last point, output values at it and a gradient row used by
+  // Gradient.
+  std::vector<double> x_;
+  std::vector<double> results_;
+  std::vector<double> row_;
+
+  // Collects instructions and shared segments of a segment.
+  void BuildCone(int segment, std::vector<int> &marks);
+
+  // Appends variable indices of a segment's gradient to pattern.
+  void AddPattern(int segment, std::vector<int> &pattern,
+                  std::vector<int> &marks) const;
+
+  // Evaluates the tape at x unless x is the same as the last point.
+  void NextPoint(const double *x, double *results);
+
+  // Computes gradients of shared segments used by a segment at the
+  // current point unless they are already known.
+  void ComputeSharedGrads(int segment);
+
+  // Differentiates a segment at the current point and writes its gradient
+  // to grad in the order of the segment pattern.
+  void Differentiate(int segment, double *grad);
+
+  // Propagates the adjoint of an instruction to its arguments.
+  void Propagate(const ExprTape::Instruction &instr, int index, double adj);
+
+ public:
+  // Creates an object computing derivatives of tape outputs. The tape
+  // should not be modified while this object is in use. Values computed
+  // by the tape are reused for consecutive calls at the same point, so
+  // the tape should not be evaluated elsewhere between such calls.
+  explicit ReverseAD(ExprTape &tape);
+
+  // Returns the number of nonzeros in the Jacobian of tape outputs.
+  int num_jac_nonzeros() const { return jac_row_starts_.back(); }
+
+  // Returns the start of the row of the Jacobian corresponding to
+  // an output. jac_row_start(tape.num_outputs()) == num_jac_nonzeros().
+  int jac_row_start(int output) const { return jac_row_starts_[output]; }
+
+  // Returns the variable index of a Jacobian element.
+  int jac_var_index(int pos) const { return pattern_[pos]; }
+
+  // Returns the Jacobian structure in CSR format.
+  const int *jac_row_starts() const { return jac_row_starts_.data(); }
+  const int *jac_var_indices() const { return pattern_.data(); }
+
+  // Computes the Jacobian of tape outputs at x and writes its
+  // num_jac_nonzeros() elements to jac. If results is not null, writes
+  // values of outputs to it.
+  //
+  // Each row lists the variables of the linear part of the output
+  // in their original order followed by the remaining variables in
+  // increasing order. For problems read from .nl files, where linear
+  // parts include all variables of constraints, rows of the Jacobian
+  // therefore have the same layout as the linear parts.
+  void Jacobian(const double *x, double *jac, double *results = 0);
+
+  // Computes the gradient of an output at x and writes tape.num_vars()
+  // values to grad. Returns the value of the output.
+  double Gradient(int output, const double *x, double *grad);
+};
+
+// Computes the Hessian of the Lagrangian sum(w[i] * f[i](x)), where f[i]
+// are tape outputs, in forward-over-reverse mode.
+//
+// The sparsity structure is determined once on construction from the
+// nonlinear operations of the tape, so that only variable pairs that
+// occur together in the same nonlinear operation are included. Variable
+// sets of shared instructions such as common expressions are computed
+// once. The columns of the structure are then colored so that columns
+// of the same color have no nonzeros in common rows, which allows
+// computing all Hessian elements with one Hessian-vector product per
+// color.
+//
+// Partial derivatives of instructions and first-order adjoints are
+// computed once per point and multipliers and reused by all
+// Hessian-vector products at that point.
+class LagrangianHessian {
+ private:
+  ExprTape &tape_;
+
+  // Instructions that can affect derivatives of outputs in increasing
+  // order.
+  std::vector<int> active_;
+
+  // The upper triangle of the Hessian structure in CSC format.
+  std::vector<int> col_starts_;
+  std::vector<int> row_indices_;
+
+  // Columns grouped by color.
+  std::vector<int> color_starts_;
+  std::vector<int> color_cols_;
+
+  // Partial derivatives of an instruction with respect to its first
+  // (d1, d11) and second (d2, d22) argument, or the selected argument
+  // of expr::IF, expr::MIN and expr::MAX.
+  struct Partials {
+    double d1, d2, d11, d12, d22;
+    int selected;
+  };
+  std::vector<Partials> partials_;
+
+  // First-order adjoints at the current point.
+  std::vector<double> adjoints_;
+
+  // Directional derivatives of instruction values and adjoints.
+  std::vector<double> tangents_;
+  std::vector<double> tangent_adjoints_;
+
+  // The current point and multipliers.
+  std::vector<double> x_;
+  std::vector<double> w_;
+  std::vector<double> results_;
+  bool prepared_;
+
+  // Computes partial derivatives and adjoints at (x, w) unless they are
+  // the same as the last ones.
+  void Prepare(const double *x, const double *w);
+
+  // Computes the Hessian-vector product at the current point.
+  void Multiply(const double *v, double *hv);
+
+ public:
+  // Creates an object computing the Hessian of the Lagrangian of tape
+  // outputs. The tape should not be modified while this object is
+  // in use.
+  explicit LagrangianHessian(ExprTape &tape);
+
+  // Returns the number of nonzeros in the upper triangle of the Hessian.
+  int num_hes_nonzeros() const { return col_starts_.back(); }
+
+  // Returns the start of a column of the upper triangle of the Hessian.
+  // hes_col_start(tape.num_vars()) == num_hes_nonzeros().
+  int hes_col_start(int col) const { return col_starts_[col]; }
+
+  // Returns the row index of a Hessian element. Row indices are sorted
+  // within columns and don't exceed column indices.
+  int hes_row_index(int pos) const { return row_indices_[pos]; }
+
+  // Returns the number of Hessian-vector products used to compute
+  // the Hessian.
+  int num_colors() const {
+    return static_cast<int>(color_starts_.size()) - 1;
+  }
+
+  // Computes the upper triangle of the Hessian of the Lagrangian with
+  // multipliers w at x and writes its num_hes_nonzeros() elements
+  // to hes. w should contain tape.num_outputs() values.
+  void Compute(const double *x, const double *w, double *hes);
+
+  // Computes the product of the Hessian of the Lagrangian with
+  // multipliers w at x and a vector v and writes tape.num_vars()
+  // values to hv.
+  void MultiplyVector(const double *x, const double *w,
+                      const double *v, double *hv) {
+    Prepare(x, w);
+    Multiply(v, hv);
+  }
+};
+}  // namespace mp
+
+#endif  // MP_EXPR_AD_H_
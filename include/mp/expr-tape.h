@@ -0,0 +1,368 @@
+/*
+ Expression tape
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#ifndef MP_EXPR_TAPE_H_
+#define MP_EXPR_TAPE_H_
+
+#include <vector>
+
+#include "mp/expr-visitor.h"
+
+namespace mp {
+
+// An expression tape: a flat sequence of instructions computing values
+// of expressions. Each instruction stores its result in a slot with the
+// same index as the instruction and refers to its arguments by their
+// indices which are always smaller than its own index. Common
+// subexpressions such as common expressions (defined variables) are
+// computed once and shared by all instructions that refer to them.
+class ExprTape {
+ public:
+  enum {
+    // The number of points evaluated together by EvaluateBatch.
+    // Each instruction processes all lanes in a simple loop that
+    // compilers turn into SIMD code.
+    NUM_LANES = 8
+  };
+
+  // Opcodes specific to the tape. Other instructions use expression
+  // kinds as opcodes.
+  enum {
+    // A linear expression sum(coefs[i] * x[var_indices[i]]) with terms
+    // starting at position arg1 and arg2 terms.
+    LINEAR = expr::LAST_EXPR + 1
+  };
+
+  // An instruction.
+  // Operands depend on the opcode:
+  //   expr::NUMBER, expr::BOOL: value
+  //   expr::VARIABLE: arg0 - variable index
+  //   unary, expr::NOT: arg0 - argument
+  //   binary, relational, binary logical and logical count expressions:
+  //     arg0 - lhs, arg1 - rhs
+  //   expr::IF, expr::IMPLICATION: arg0 - condition, arg1 - then,
+  //     arg2 - else
+  //   expr::PLTERM: arg0 - argument, arg1 - start of slopes and breakpoints
+  //     in data(), arg2 - number of breakpoints
+  //   iterated and pairwise expressions: arg1 - start of arguments in
+  //     args(), arg2 - number of arguments
+  //   LINEAR: arg1 - start of terms, arg2 - number of terms
+  struct Instruction {
+    int opcode;
+    int arg0;
+    int arg1;
+    int arg2;
+    double value;
+  };
+
+ private:
+  std::vector<Instruction> code_;
+  std::vector<int> args_;
+  std::vector<double> data_;
+  std::vector<int> var_indices_;
+  std::vector<double> coefs_;
+  std::vector<int> outputs_;
+  int num_vars_;
+
+  // Instruction results, NUM_LANES values per instruction in batch mode.
+  std::vector<double> values_;
+
+  // The number of points evaluated by the last run.
+  int num_points_;
+
+  template <int NUM_POINTS>
+  void Run(const double *const *points);
+
+ public:
+  ExprTape() : num_vars_(0), num_points_(0) {}
+
+  int num_instructions() const { return static_cast<int>(code_.size()); }
+
+  const Instruction &instruction(int index) const {
+    MP_ASSERT(0 <= index && index < num_instructions(), "invalid index");
+    return code_[index];
+  }
+
+  // Returns the argument of an iterated expression at the specified
+  // position.
+  int arg(int pos) const { return args_[pos]; }
+
+  // Returns the slope or breakpoint of a piecewise-linear term at the
+  // specified position.
+  double data(int pos) const { return data_[pos]; }
+
+  // Returns the variable index and coefficient of a linear term at the
+  // specified position.
+  int var_index(int pos) const { return var_indices_[pos]; }
+  double coef(int pos) const { return coefs_[pos]; }
+
+  // Returns the number of variables referenced by the tape, i.e. the
+  // maximum variable index plus one.
+  int num_vars() const { return num_vars_; }
+
+  // Adds an instruction and returns its index.
+  int Add(int opcode, int arg0 = -1, int arg1 = -1, int arg2 = -1) {
+    MP_ASSERT(arg0 < num_instructions() && arg1 < num_instructions() &&
+              arg2 < num_instructions(), "invalid argument");
+    Instruction instr = {opcode, arg0, arg1, arg2, 0};
+    code_.push_back(instr);
+    return num_instructions() - 1;
+  }
+
+  // Adds a numeric or logical constant.
+  int AddConstant(double value, int opcode = expr::NUMBER) {
+    Instruction instr = {opcode, -1, -1, -1, value};
+    code_.push_back(instr);
+    return num_instructions() - 1;
+  }
+
+  int AddVariable(int var_index) {
+    MP_ASSERT(var_index >= 0, "invalid index");
+    if (var_index >= num_vars_)
+      num_vars_ = var_index + 1;
+    Instruction instr = {expr::VARIABLE, var_index, -1, -1, 0};
+    code_.push_back(instr);
+    return num_instructions() - 1;
+  }
+
+  // Adds an instruction with a variable number of arguments.
+  int AddIterated(int opcode, const std::vector<int> &args) {
+    Instruction instr = {opcode, -1, static_cast<int>(args_.size()),
+                         static_cast<int>(args.size()), 0};
+    args_.insert(args_.end(), args.begin(), args.end());
+    code_.push_back(instr);
+    return num_instructions() - 1;
+  }
+
+  // Adds a piecewise-linear term. data contains slopes interleaved with
+  // breakpoints, i.e. s[0], b[0], s[1], ..., b[n - 1], s[n].
+  int AddPLTerm(int arg, const std::vector<double> &data) {
+    Instruction instr = {expr::PLTERM, arg, static_cast<int>(data_.size()),
+                         static_cast<int>(data.size() / 2), 0};
+    data_.insert(data_.end(), data.begin(), data.end());
+    code_.push_back(instr);
+    return num_instructions() - 1;
+  }
+
+  // Adds a linear expression.
+  template <typename LinearExpr>
+  int AddLinear(const LinearExpr &linear) {
+    Instruction instr = {LINEAR, -1, static_cast<int>(coefs_.size()),
+                         linear.num_terms(), 0};
+    for (typename LinearExpr::iterator
+         i = linear.begin(), end = linear.end(); i != end; ++i) {
+      int var_index = i->var_index();
+      if (var_index >= num_vars_)
+        num_vars_ = var_index + 1;
+      var_indices_.push_back(var_index);
+      coefs_.push_back(i->coef());
+    }
+    code_.push_back(instr);
+    return num_instructions() - 1;
+  }
+
+  int num_outputs() const { return static_cast<int>(outputs_.size()); }
+
+  // Returns the index of the instruction computing the specified output.
+  int output(int index) const { return outputs_[index]; }
+
+  // Marks the result of an instruction as an output and returns
+  // the output index.
+  int AddOutput(int instr_index) {
+    MP_ASSERT(0 <= instr_index && instr_index < num_instructions(),
+              "invalid index");
+    outputs_.push_back(instr_index);
+    return num_outputs() - 1;
+  }
+
+  // Evaluates outputs at a single point x which should contain values of
+  // at least num_vars() variables. Writes num_outputs() values to results.
+  void Evaluate(const double *x, double *results);
+
+  // Returns the value computed by an instruction at the last point
+  // passed to Evaluate or the first point of the last batch passed to
+  // EvaluateBatch.
+  double value(int instr_index) const {
+    MP_ASSERT(num_points_ != 0, "tape is not evaluated");
+    return values_[instr_index * num_points_];
+  }
+
+  // Evaluates outputs at num_points points stored consecutively in points
+  // with point_size values each. Writes values of outputs at point i to
+  // results[i * num_outputs()], ..., results[(i + 1) * num_outputs() - 1].
+  void EvaluateBatch(const double *points, int num_points, int point_size,
+                     double *results);
+};
+
+// Compiles expressions of an optimization problem into an expression tape.
+// Common expressions are compiled once when they are first referenced.
+template <typename Problem>
+class ExprCompiler : public ExprVisitor<ExprCompiler<Problem>, int> {
+ private:
+  const Problem &problem_;
+  ExprTape &tape_;
+
+  // Instruction indices of compiled common expressions or -1.
+  std::vector<int> common_exprs_;
+
+  template <typename ExprType>
+  int CompileIterated(int opcode, ExprType e) {
+    std::vector<int> args;
+    args.reserve(e.num_args());
+    for (typename ExprType::iterator
+         i = e.begin(), end = e.end(); i != end; ++i) {
+      args.push_back(this->Visit(*i));
+    }
+    return tape_.AddIterated(opcode, args);
+  }
+
+  template <typename ExprType>
+  int CompileIf(ExprType e) {
+    int condition = this->Visit(e.condition());
+    int then_expr = this->Visit(e.then_expr());
+    return tape_.Add(e.kind(), condition, then_expr,
+                     this->Visit(e.else_expr()));
+  }
+
+ public:
+  ExprCompiler(const Problem &p, ExprTape &tape)
+    : problem_(p), tape_(tape), common_exprs_(p.num_common_exprs(), -1) {}
+
+  // Compiles an expression with linear and nonlinear parts and returns
+  // the index of the instruction computing its value.
+  template <typename LinearExpr>
+  int Compile(const LinearExpr &linear, NumericExpr nonlinear) {
+    int result = linear.num_terms() != 0 ? tape_.AddLinear(linear) : -1;
+    if (nonlinear) {
+      int nl = this->Visit(nonlinear);
+      result = result >= 0 ? tape_.Add(expr::ADD, result, nl) : nl;
+    }
+    return result >= 0 ? result : tape_.AddConstant(0);
+  }
+
+  // Compiles an objective expression.
+  int CompileObj(int obj_index) {
+    typename Problem::Objective obj = problem_.obj(obj_index);
+    return Compile(obj.linear_expr(), obj.nonlinear_expr());
+  }
+
+  // Compiles the body of an algebraic constraint.
+  int CompileAlgebraicCon(int con_index) {
+    typename Problem::AlgebraicCon con = problem_.algebraic_con(con_index);
+    return Compile(con.linear_expr(), con.nonlinear_expr());
+  }
+
+  // Compiles a logical constraint.
+  int CompileLogicalCon(int con_index) {
+    return this->Visit(problem_.logical_con(con_index).expr());
+  }
+
+  int VisitNumericConstant(NumericConstant c) {
+    return tape_.AddConstant(c.value());
+  }
+
+  int VisitVariable(Reference v) {
+    return tape_.AddVariable(v.index());
+  }
+
+  int VisitCommonExpr(Reference e) {
+    int index = e.index();
+    if (common_exprs_[index] < 0) {
+      typename Problem::CommonExpr expr = problem_.common_expr(index);
+      common_exprs_[index] = Compile(expr.linear_expr(), expr.nonlinear_expr());
+    }
+    return common_exprs_[index];
+  }
+
+  int VisitUnary(UnaryExpr e) {
+    return tape_.Add(e.kind(), this->Visit(e.arg()));
+  }
+
+  int VisitBinary(BinaryExpr e) {
+    int lhs = this->Visit(e.lhs());
+    return tape_.Add(e.kind(), lhs, this->Visit(e.rhs()));
+  }
+
+  int VisitIf(IfExpr e) { return CompileIf(e); }
+
+  int VisitPLTerm(PLTerm e) {
+    std::vector<double> data;
+    data.reserve(e.num_breakpoints() + e.num_slopes());
+    for (int i = 0, n = e.num_breakpoints(); i < n; ++i) {
+      data.push_back(e.slope(i));
+      data.push_back(e.breakpoint(i));
+    }
+    data.push_back(e.slope(e.num_slopes() - 1));
+    return tape_.AddPLTerm(this->Visit(e.arg()), data);
+  }
+
+  int VisitVarArg(IteratedExpr e) { return CompileIterated(e.kind(), e); }
+  int VisitSum(IteratedExpr e) { return CompileIterated(e.kind(), e); }
+  int VisitNumberOf(IteratedExpr e) { return CompileIterated(e.kind(), e); }
+  int VisitCount(CountExpr e) { return CompileIterated(e.kind(), e); }
+
+  int VisitLogicalConstant(LogicalConstant c) {
+    return tape_.AddConstant(c.value(), expr::BOOL);
+  }
+
+  int VisitNot(NotExpr e) {
+    return tape_.Add(e.kind(), this->Visit(e.arg()));
+  }
+
+  int VisitBinaryLogical(BinaryLogicalExpr e) {
+    int lhs = this->Visit(e.lhs());
+    return tape_.Add(e.kind(), lhs, this->Visit(e.rhs()));
+  }
+
+  int VisitRelational(RelationalExpr e) {
+    int lhs = this->Visit(e.lhs());
+    return tape_.Add(e.kind(), lhs, this->Visit(e.rhs()));
+  }
+
+  int VisitLogicalCount(LogicalCountExpr e) {
+    int lhs = this->Visit(e.lhs());
+    return tape_.Add(e.kind(), lhs, VisitCount(e.rhs()));
+  }
+
+  int VisitImplication(ImplicationExpr e) { return CompileIf(e); }
+
+  int VisitIteratedLogical(IteratedLogicalExpr e) {
+    return CompileIterated(e.kind(), e);
+  }
+
+  int VisitAllDiff(PairwiseExpr e) { return CompileIterated(e.kind(), e); }
+  int VisitNotAllDiff(PairwiseExpr e) { return CompileIterated(e.kind(), e); }
+};
+
+// Compiles all objectives, algebraic constraint bodies and logical
+// constraints of a problem into a tape adding outputs in this order.
+template <typename Problem>
+void CompileProblem(const Problem &p, ExprTape &tape) {
+  ExprCompiler<Problem> compiler(p, tape);
+  for (int i = 0, n = p.num_objs(); i < n; ++i)
+    tape.AddOutput(compiler.CompileObj(i));
+  for (int i = 0, n = p.num_algebraic_cons(); i < n; ++i)
+    tape.AddOutput(compiler.CompileAlgebraicCon(i));
+  for (int i = 0, n = p.num_logical_cons(); i < n; ++i)
+    tape.AddOutput(compiler.CompileLogicalCon(i));
+}
+}  // namespace mp
+
+#endif  // MP_EXPR_TAPE_H_
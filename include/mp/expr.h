@@ -31,6 +31,7 @@
 # include <functional>
 #endif
 
+#include "mp/arena.h"
 #include "mp/common.h"
 #include "mp/error.h"
 #include "mp/format.h"
@@ -47,6 +48,8 @@ template <typename Alloc>
 class BasicExprFactory;
 
 namespace internal {
+class ExprTable;
+
 // Casts an expression to type ExprType which must be a valid expression type.
 // If assertions are enabled, it generates an assertion failure when e is
 // not convertible to ExprType. Otherwise no runtime check is performed.
@@ -145,6 +148,7 @@ class BasicExpr : private internal::ExprBase {
 
   template <typename Alloc>
   friend class BasicExprFactory;
+  friend class internal::ExprTable;
 
  protected:
   typedef ExprBase::Impl Impl;
@@ -196,6 +200,7 @@ inline ExprType Cast(Expr e) {
   const Impl *impl() const { \
     return static_cast<const Impl*>(ExprType::impl()); \
   } \
+  friend class internal::ExprTable; \
   template <typename Alloc> \
   friend class BasicExprFactory
 
@@ -641,6 +646,54 @@ struct ExprTypes {
 };
 }  // namespace internal
 
+namespace internal {
+// A hash table of expressions used for hash-consing. Expressions are
+// compared shallowly, by kind, value and argument pointers, which is
+// sufficient because arguments of expressions in the table are unique
+// themselves.
+class ExprTable {
+ private:
+  typedef Expr::Impl Impl;
+
+  // Open addressing with linear probing. Null pointers denote empty slots.
+  std::vector<const Impl*> slots_;
+  std::size_t size_;
+
+  struct Fields;
+
+  static void GetFields(const Impl *impl, Fields &fields);
+
+  static std::size_t Hash(const Fields &fields);
+  static bool Equal(const Fields &lhs, const Fields &rhs);
+
+  void Grow();
+
+ public:
+  ExprTable() : size_(0) {}
+
+  // Returns true if expressions of the specified kind can be stored in
+  // the table. Piecewise-linear terms, calls and strings are not shared.
+  static bool IsSupported(expr::Kind kind) {
+    return kind != expr::PLTERM && kind != expr::CALL &&
+        kind != expr::STRING;
+  }
+
+  // Returns the number of expressions in the table.
+  std::size_t size() const { return size_; }
+
+  void Clear() {
+    std::vector<const Impl*>().swap(slots_);
+    size_ = 0;
+  }
+
+  // Returns an expression equal to impl or null if there is none.
+  const Impl *Find(const Impl *impl) const;
+
+  // Inserts an expression that is not equal to any in the table.
+  void Insert(const Impl *impl);
+};
+}  // namespace internal
+
 // An expression factory.
 // Alloc: a memory allocator.
 // Allocator requirements:
@@ -655,16 +708,31 @@ class BasicExprFactory : private Alloc {
   std::vector<const Expr::Impl*> exprs_;
   std::vector<const Function::Impl*> funcs_;
 
+  // The number of leading functions in funcs_ that are owned by another
+  // factory (see ShareFunctions).
+  std::size_t num_shared_funcs_;
+
+  // Unique expressions if hash-consing is enabled.
+  internal::ExprTable expr_table_;
+  bool hash_consing_;
+
   FMT_DISALLOW_COPY_AND_ASSIGN(BasicExprFactory);
 
   // Allocates memory for an object of type ExprType::Impl.
   // extra_bytes: extra bytes to allocate at the end (can be negative).
   template <typename ExprType>
   typename ExprType::Impl *Allocate(expr::Kind kind, int extra_bytes = 0) {
+    typedef typename ExprType::Impl Impl;
+    if (internal::HasBulkDeallocation<Alloc>::value) {
+      // No need to keep track of expressions that are freed all at once.
+      Impl *impl = reinterpret_cast<Impl*>(
+            this->allocate(sizeof(Impl) + extra_bytes));
+      impl->kind_ = kind;
+      return impl;
+    }
     // Call push_back first to make sure that the impl pointer doesn't leak
     // if push_back throws an exception.
     exprs_.push_back(0);
-    typedef typename ExprType::Impl Impl;
     // The following cannot overflow.
     Impl *impl = reinterpret_cast<Impl*>(
           this->allocate(sizeof(Impl) + extra_bytes));
@@ -674,42 +742,79 @@ class BasicExprFactory : private Alloc {
   }
 
   template <typename T>
-  void Deallocate(const std::vector<T> &data);
+  void Deallocate(const std::vector<T> &data, std::size_t first = 0);
+
+  // Frees an expression that has just been allocated and not returned
+  // to the caller.
+  void Free(const Expr::Impl *impl) {
+    if (internal::HasBulkDeallocation<Alloc>::value)
+      return;
+    // The expression is normally close to the end since only its
+    // arguments have been allocated after it.
+    for (std::size_t i = exprs_.size(); i-- > 0; ) {
+      if (exprs_[i] == impl) {
+        exprs_.erase(exprs_.begin() + i);
+        break;
+      }
+    }
+    this->deallocate(const_cast<char*>(reinterpret_cast<const char*>(impl)),
+                     0);
+  }
+
+  // Makes an expression with the same kind and data as key. If
+  // hash-consing is enabled, returns an existing equal expression if
+  // there is one.
+  template <typename ExprType>
+  ExprType MakeExpr(const typename ExprType::Impl &key) {
+    if (hash_consing_) {
+      if (const Expr::Impl *impl = expr_table_.Find(&key))
+        return Expr::Create<ExprType>(impl);
+    }
+    typename ExprType::Impl *impl = Allocate<ExprType>(key.kind_);
+    *impl = key;
+    if (hash_consing_)
+      expr_table_.Insert(impl);
+    return Expr::Create<ExprType>(impl);
+  }
 
   // Makes a reference expression.
   Reference MakeReference(expr::Kind kind, int index) {
-    typename Reference::Impl *impl = Allocate<Reference>(kind);
-    impl->index = index;
-    return Expr::Create<Reference>(impl);
+    typename Reference::Impl key;
+    key.kind_ = kind;
+    key.index = index;
+    return MakeExpr<Reference>(key);
   }
 
   template <typename ExprType, typename Arg>
   ExprType MakeUnary(expr::Kind kind, Arg arg) {
     MP_ASSERT(arg != 0, "invalid argument");
-    typename ExprType::Impl *impl = Allocate<ExprType>(kind);
-    impl->arg = arg.impl_;
-    return Expr::Create<ExprType>(impl);
+    typename ExprType::Impl key;
+    key.kind_ = kind;
+    key.arg = arg.impl_;
+    return MakeExpr<ExprType>(key);
   }
 
   template <typename ExprType, typename LHS, typename RHS>
   ExprType MakeBinary(expr::Kind kind, LHS lhs, RHS rhs) {
     MP_ASSERT(internal::Is<ExprType>(kind), "invalid expression kind");
     MP_ASSERT(lhs != 0 && rhs != 0, "invalid argument");
-    typename ExprType::Impl *impl = Allocate<ExprType>(kind);
-    impl->lhs = lhs.impl_;
-    impl->rhs = rhs.impl_;
-    return Expr::Create<ExprType>(impl);
+    typename ExprType::Impl key;
+    key.kind_ = kind;
+    key.lhs = lhs.impl_;
+    key.rhs = rhs.impl_;
+    return MakeExpr<ExprType>(key);
   }
 
   template <typename ExprType, typename Arg>
   ExprType MakeIf(LogicalExpr condition, Arg then_expr, Arg else_expr) {
     // else_expr can be null.
     MP_ASSERT(condition != 0 && then_expr != 0, "invalid argument");
-    typename ExprType::Impl *impl = Allocate<ExprType>(ExprType::KIND);
-    impl->condition = condition.impl_;
-    impl->then_expr = then_expr.impl_;
-    impl->else_expr = else_expr.impl_;
-    return Expr::Create<ExprType>(impl);
+    typename ExprType::Impl key;
+    key.kind_ = ExprType::KIND;
+    key.condition = condition.impl_;
+    key.then_expr = then_expr.impl_;
+    key.else_expr = else_expr.impl_;
+    return MakeExpr<ExprType>(key);
   }
 
   // A variable argument expression builder.
@@ -748,6 +853,13 @@ class BasicExprFactory : private Alloc {
     typename ExprType::Impl *impl = builder.impl_;
     // Check that all arguments provided.
     MP_ASSERT(builder.arg_index_ == impl->num_args, "too few arguments");
+    if (hash_consing_ && internal::ExprTable::IsSupported(impl->kind())) {
+      if (const Expr::Impl *existing = expr_table_.Find(impl)) {
+        Free(impl);
+        return Expr::Create<ExprType>(existing);
+      }
+      expr_table_.Insert(impl);
+    }
     return Expr::Create<ExprType>(impl);
   }
 
@@ -764,12 +876,44 @@ class BasicExprFactory : private Alloc {
   Function CreateFunction(const Function::Impl *&impl, fmt::StringRef name,
                           int num_args, func::Type type);
 
+ protected:
+  // Makes functions of another factory available in this one. The functions
+  // remain owned by the other factory which should outlive this one.
+  void ShareFunctions(const BasicExprFactory &other) {
+    MP_ASSERT(funcs_.empty(), "functions already added");
+    funcs_ = other.funcs_;
+    num_shared_funcs_ = funcs_.size();
+  }
+
  public:
-  explicit BasicExprFactory(Alloc alloc = Alloc()) : Alloc(alloc) {}
+  explicit BasicExprFactory(Alloc alloc = Alloc())
+    : Alloc(alloc), num_shared_funcs_(0), hash_consing_(false) {}
 
   virtual ~BasicExprFactory() {
+    if (internal::HasBulkDeallocation<Alloc>::value)
+      return;
     Deallocate(exprs_);
-    Deallocate(funcs_);
+    Deallocate(funcs_, num_shared_funcs_);
+  }
+
+  // Returns true if hash-consing is enabled.
+  bool hash_consing() const { return hash_consing_; }
+
+  // Enables or disables hash-consing. When enabled, structurally equal
+  // expressions made by the factory share the same implementation, so
+  // duplicate subexpressions take no extra memory and can be recognized
+  // by identity. Piecewise-linear terms, calls and strings are never
+  // shared and expressions made while hash-consing was disabled are not
+  // reused.
+  void set_hash_consing(bool enable) {
+    hash_consing_ = enable;
+    if (!enable)
+      expr_table_.Clear();
+  }
+
+  // Returns the number of unique expressions made with hash-consing.
+  int num_unique_exprs() const {
+    return static_cast<int>(expr_table_.size());
   }
 
   // Returns the number of functions.
@@ -811,9 +955,10 @@ class BasicExprFactory : private Alloc {
 
   // Makes a numeric constant.
   NumericConstant MakeNumericConstant(double value) {
-    NumericConstant::Impl *impl = Allocate<NumericConstant>(expr::NUMBER);
-    impl->value = value;
-    return Expr::Create<NumericConstant>(impl);
+    NumericConstant::Impl key;
+    key.kind_ = expr::NUMBER;
+    key.value = value;
+    return MakeExpr<NumericConstant>(key);
   }
 
   // Makes a variable reference.
@@ -977,9 +1122,10 @@ class BasicExprFactory : private Alloc {
 
   // Makes a logical constant.
   LogicalConstant MakeLogicalConstant(bool value) {
-    LogicalConstant::Impl *impl = Allocate<LogicalConstant>(expr::BOOL);
-    impl->value = value;
-    return Expr::Create<LogicalConstant>(impl);
+    LogicalConstant::Impl key;
+    key.kind_ = expr::BOOL;
+    key.value = value;
+    return MakeExpr<LogicalConstant>(key);
   }
 
   // Makes a logical NOT expression.
@@ -1058,9 +1204,10 @@ class BasicExprFactory : private Alloc {
 
 template <typename Alloc>
 template <typename T>
-void BasicExprFactory<Alloc>::Deallocate(const std::vector<T> &data) {
+void BasicExprFactory<Alloc>::Deallocate(
+    const std::vector<T> &data, std::size_t first) {
   for (typename std::vector<T>::const_iterator
-       i = data.begin(), end = data.end(); i != end; ++i) {
+       i = data.begin() + first, end = data.end(); i != end; ++i) {
     this->deallocate(const_cast<char*>(reinterpret_cast<const char*>(*i)), 0);
   }
 }
@@ -1084,6 +1231,34 @@ Function BasicExprFactory<Alloc>::CreateFunction(
 
 typedef BasicExprFactory< std::allocator<char> > ExprFactory;
 
+namespace internal {
+// Holds an arena. This class is used as a base to make sure that the arena
+// is constructed before and destroyed after the expression factory.
+class ArenaHolder {
+ protected:
+  Arena expr_arena_;
+
+  explicit ArenaHolder(std::size_t chunk_size) : expr_arena_(chunk_size) {}
+};
+}  // namespace internal
+
+// An expression factory that allocates expressions in an arena. Individual
+// expressions are not tracked and all of them are freed at once when the
+// factory is destroyed.
+class ArenaExprFactory :
+    private internal::ArenaHolder,
+    public BasicExprFactory< mp::ArenaAllocator<char> > {
+ public:
+  explicit ArenaExprFactory(
+      std::size_t chunk_size = Arena::DEFAULT_CHUNK_SIZE)
+    : internal::ArenaHolder(chunk_size),
+      BasicExprFactory< mp::ArenaAllocator<char> >(
+        mp::ArenaAllocator<char>(&expr_arena_)) {}
+
+  // Returns the arena used to allocate expressions.
+  const Arena &arena() const { return expr_arena_; }
+};
+
 void format(fmt::BasicFormatter<char> &f, const char *&, NumericExpr e);
 
 template <typename Expr>
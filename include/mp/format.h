@@ -837,6 +837,21 @@ struct IntTraits {
 
 FMT_API void report_unknown_type(char code, const char *type);
 
+// The maximum size of the output of format_shortest.
+enum { MAX_SHORTEST_SIZE = 25 };
+
+// Writes a decimal representation of a finite nonnegative double into
+// buffer using the notation of %g and returns the number of characters
+// written. The representation has up to 17 significant digits and is
+// generated with the Grisu2 algorithm. It round-trips exactly and is
+// usually, but not always, the shortest one.
+FMT_API std::size_t format_shortest(char *buffer, double value);
+
+// Returns true if values of type T can be formatted with format_shortest.
+template <typename T>
+inline bool is_double(T) { return false; }
+inline bool is_double(double) { return true; }
+
 // Static data is placed in this class template to allow header-only
 // configuration.
 template <typename T = void>
@@ -2397,7 +2412,11 @@ class BasicWriter {
   template <typename T, typename Spec>
   void write_int(T value, Spec spec);
 
-  // Formats a floating-point number (double or long double).
+  // Formats a floating-point number (double or long double). If neither
+  // the type nor the precision nor the '#' flag is specified, a double is
+  // written with up to 17 significant digits in a representation that
+  // round-trips exactly and is usually the shortest. Otherwise the number
+  // is formatted as with printf and the default type is 'g'.
   template <typename T>
   void write_double(T value, const FormatSpec &spec);
 
@@ -2534,6 +2553,13 @@ class BasicWriter {
     return *this << IntFormatSpec<ULongLong>(value);
   }
 
+  /**
+    \rst
+    Formats *value* using a representation that round-trips exactly and
+    is usually the shortest, e.g. ``0.1`` or ``0.30000000000000004``, and
+    writes it to the stream.
+    \endrst
+   */
   BasicWriter &operator<<(double value) {
     write_double(value, FormatSpec());
     return *this;
@@ -2884,6 +2910,21 @@ void BasicWriter<Char>::write_double(T value, const FormatSpec &spec) {
     return;
   }
 
+  if (!spec.type() && spec.precision() < 0 && !spec.flag(HASH_FLAG) &&
+      internal::is_double(value)) {
+    // Write a representation that round-trips exactly and is usually
+    // the shortest if neither the type nor the precision is specified.
+    double d = static_cast<double>(value);
+    if (d == 0 && 1 / d < 0)
+      sign = '-';  // isnegative may not detect negative zero.
+    char digits[internal::MAX_SHORTEST_SIZE];
+    unsigned n = static_cast<unsigned>(
+          internal::format_shortest(digits, d));
+    CharPtr p = prepare_int_buffer(n, spec, &sign, sign ? 1 : 0);
+    std::uninitialized_copy(digits, digits + n, p - (n - 1));
+    return;
+  }
+
   std::size_t offset = buffer_.size();
   unsigned width = spec.width();
   if (sign) {
@@ -3159,6 +3200,11 @@ FMT_API void print_colored(Color c, CStringRef format, ArgList args);
   \rst
   Formats arguments and returns the result as a string.
 
+  A ``double`` argument without a type or precision such as in ``{}`` or
+  ``{:8}`` is formatted with a representation that round-trips exactly
+  and is usually the shortest. It has up to 17 significant digits unlike
+  the 6 digits of the ``'g'`` type.
+
   **Example**::
 
     std::string message = format("The answer is {}", 42);
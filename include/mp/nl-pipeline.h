@@ -0,0 +1,1039 @@
+/*
+ Streaming NL handler pipeline
+
+ A pipeline is a chain of NL handlers each of which receives notifications
+ from an NL reader or the previous stage and passes them, possibly
+ filtered or transformed, to the next stage:
+
+   mp::NullNLHandler<int> sink;
+   mp::NLStatsCollector< mp::NullNLHandler<int> > stats(sink);
+   mp::ReadNLFile(filename, stats);
+
+ Stages don't store problem components between notifications so a
+ problem can be processed without constructing it in memory.
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#ifndef MP_NL_PIPELINE_H_
+#define MP_NL_PIPELINE_H_
+
+#include <cstdio>
+#include <vector>
+
+#include "mp/nl-reader.h"
+#include "mp/nl-writer.h"
+
+namespace mp {
+
+/**
+  \rst
+  An NL handler that forwards all notifications to another handler.
+
+  `~mp::NLForwarder` is a base class for pipeline stages. A stage redefines
+  methods for the constructs it filters or transforms and passes them on
+  by calling the same methods of `~mp::NLForwarder::handler()`. Expression
+  and argument handler types are the ones of the next handler.
+  \endrst
+ */
+template <typename Handler>
+class NLForwarder {
+ private:
+  Handler &handler_;
+
+ public:
+  /** Constructs a stage that forwards notifications to *h*. */
+  explicit NLForwarder(Handler &h) : handler_(h) {}
+
+  /** Returns the next handler in the pipeline. */
+  Handler &handler() const { return handler_; }
+
+  typedef typename Handler::Expr Expr;
+  typedef typename Handler::NumericExpr NumericExpr;
+  typedef typename Handler::LogicalExpr LogicalExpr;
+  typedef typename Handler::CountExpr CountExpr;
+  typedef typename Handler::Reference Reference;
+
+  typedef typename Handler::LinearExprHandler LinearExprHandler;
+  typedef typename Handler::LinearObjHandler LinearObjHandler;
+  typedef typename Handler::LinearConHandler LinearConHandler;
+  typedef typename Handler::ColumnSizeHandler ColumnSizeHandler;
+  typedef typename Handler::IntSuffixHandler IntSuffixHandler;
+  typedef typename Handler::DblSuffixHandler DblSuffixHandler;
+  typedef typename Handler::PLTermHandler PLTermHandler;
+  typedef typename Handler::NumericArgHandler NumericArgHandler;
+  typedef typename Handler::VarArgHandler VarArgHandler;
+  typedef typename Handler::CallArgHandler CallArgHandler;
+  typedef typename Handler::NumberOfArgHandler NumberOfArgHandler;
+  typedef typename Handler::CountArgHandler CountArgHandler;
+  typedef typename Handler::LogicalArgHandler LogicalArgHandler;
+  typedef typename Handler::PairwiseArgHandler PairwiseArgHandler;
+  typedef typename Handler::SymbolicArgHandler SymbolicArgHandler;
+
+  void OnHeader(const NLHeader &h) { handler_.OnHeader(h); }
+
+  bool NeedObj(int obj_index) const { return handler_.NeedObj(obj_index); }
+
+  void OnObj(int index, obj::Type type, NumericExpr expr) {
+    handler_.OnObj(index, type, expr);
+  }
+
+  void OnAlgebraicCon(int index, NumericExpr expr) {
+    handler_.OnAlgebraicCon(index, expr);
+  }
+
+  void OnLogicalCon(int index, LogicalExpr expr) {
+    handler_.OnLogicalCon(index, expr);
+  }
+
+  LinearExprHandler BeginCommonExpr(int index, int num_linear_terms) {
+    return handler_.BeginCommonExpr(index, num_linear_terms);
+  }
+
+  void EndCommonExpr(int index, NumericExpr expr, int position) {
+    handler_.EndCommonExpr(index, expr, position);
+  }
+
+  void OnComplementarity(int con_index, int var_index, ComplInfo info) {
+    handler_.OnComplementarity(con_index, var_index, info);
+  }
+
+  LinearObjHandler OnLinearObjExpr(int obj_index, int num_linear_terms) {
+    return handler_.OnLinearObjExpr(obj_index, num_linear_terms);
+  }
+
+  LinearConHandler OnLinearConExpr(int con_index, int num_linear_terms) {
+    return handler_.OnLinearConExpr(con_index, num_linear_terms);
+  }
+
+  void OnVarBounds(int index, double lb, double ub) {
+    handler_.OnVarBounds(index, lb, ub);
+  }
+
+  void OnConBounds(int index, double lb, double ub) {
+    handler_.OnConBounds(index, lb, ub);
+  }
+
+  void OnInitialValue(int var_index, double value) {
+    handler_.OnInitialValue(var_index, value);
+  }
+
+  void OnInitialDualValue(int con_index, double value) {
+    handler_.OnInitialDualValue(con_index, value);
+  }
+
+  ColumnSizeHandler OnColumnSizes() { return handler_.OnColumnSizes(); }
+
+  void OnFunction(int index, fmt::StringRef name,
+                  int num_args, func::Type type) {
+    handler_.OnFunction(index, name, num_args, type);
+  }
+
+  IntSuffixHandler OnIntSuffix(fmt::StringRef name, suf::Kind kind,
+                               int num_values) {
+    return handler_.OnIntSuffix(name, kind, num_values);
+  }
+
+  DblSuffixHandler OnDblSuffix(fmt::StringRef name, suf::Kind kind,
+                               int num_values) {
+    return handler_.OnDblSuffix(name, kind, num_values);
+  }
+
+  NumericExpr OnNumber(double value) { return handler_.OnNumber(value); }
+
+  Reference OnVariableRef(int var_index) {
+    return handler_.OnVariableRef(var_index);
+  }
+
+  Reference OnCommonExprRef(int expr_index) {
+    return handler_.OnCommonExprRef(expr_index);
+  }
+
+  NumericExpr OnUnary(expr::Kind kind, NumericExpr arg) {
+    return handler_.OnUnary(kind, arg);
+  }
+
+  NumericExpr OnBinary(expr::Kind kind, NumericExpr lhs, NumericExpr rhs) {
+    return handler_.OnBinary(kind, lhs, rhs);
+  }
+
+  NumericExpr OnIf(LogicalExpr condition,
+                   NumericExpr then_expr, NumericExpr else_expr) {
+    return handler_.OnIf(condition, then_expr, else_expr);
+  }
+
+  PLTermHandler BeginPLTerm(int num_breakpoints) {
+    return handler_.BeginPLTerm(num_breakpoints);
+  }
+
+  NumericExpr EndPLTerm(PLTermHandler handler, Reference arg) {
+    return handler_.EndPLTerm(handler, arg);
+  }
+
+  CallArgHandler BeginCall(int func_index, int num_args) {
+    return handler_.BeginCall(func_index, num_args);
+  }
+
+  NumericExpr EndCall(CallArgHandler handler) {
+    return handler_.EndCall(handler);
+  }
+
+  VarArgHandler BeginVarArg(expr::Kind kind, int num_args) {
+    return handler_.BeginVarArg(kind, num_args);
+  }
+
+  NumericExpr EndVarArg(VarArgHandler handler) {
+    return handler_.EndVarArg(handler);
+  }
+
+  NumericArgHandler BeginSum(int num_args) {
+    return handler_.BeginSum(num_args);
+  }
+
+  NumericExpr EndSum(NumericArgHandler handler) {
+    return handler_.EndSum(handler);
+  }
+
+  CountArgHandler BeginCount(int num_args) {
+    return handler_.BeginCount(num_args);
+  }
+
+  CountExpr EndCount(CountArgHandler handler) {
+    return handler_.EndCount(handler);
+  }
+
+  NumberOfArgHandler BeginNumberOf(int num_args, NumericExpr arg0) {
+    return handler_.BeginNumberOf(num_args, arg0);
+  }
+
+  NumericExpr EndNumberOf(NumberOfArgHandler handler) {
+    return handler_.EndNumberOf(handler);
+  }
+
+  SymbolicArgHandler BeginSymbolicNumberOf(int num_args, Expr arg0) {
+    return handler_.BeginSymbolicNumberOf(num_args, arg0);
+  }
+
+  NumericExpr EndSymbolicNumberOf(SymbolicArgHandler handler) {
+    return handler_.EndSymbolicNumberOf(handler);
+  }
+
+  LogicalExpr OnBool(bool value) { return handler_.OnBool(value); }
+
+  LogicalExpr OnNot(LogicalExpr arg) { return handler_.OnNot(arg); }
+
+  LogicalExpr OnBinaryLogical(
+      expr::Kind kind, LogicalExpr lhs, LogicalExpr rhs) {
+    return handler_.OnBinaryLogical(kind, lhs, rhs);
+  }
+
+  LogicalExpr OnRelational(expr::Kind kind, NumericExpr lhs, NumericExpr rhs) {
+    return handler_.OnRelational(kind, lhs, rhs);
+  }
+
+  LogicalExpr OnLogicalCount(expr::Kind kind, NumericExpr lhs, CountExpr rhs) {
+    return handler_.OnLogicalCount(kind, lhs, rhs);
+  }
+
+  LogicalExpr OnImplication(
+      LogicalExpr condition, LogicalExpr then_expr, LogicalExpr else_expr) {
+    return handler_.OnImplication(condition, then_expr, else_expr);
+  }
+
+  LogicalArgHandler BeginIteratedLogical(expr::Kind kind, int num_args) {
+    return handler_.BeginIteratedLogical(kind, num_args);
+  }
+
+  LogicalExpr EndIteratedLogical(LogicalArgHandler handler) {
+    return handler_.EndIteratedLogical(handler);
+  }
+
+  PairwiseArgHandler BeginPairwise(expr::Kind kind, int num_args) {
+    return handler_.BeginPairwise(kind, num_args);
+  }
+
+  LogicalExpr EndPairwise(PairwiseArgHandler handler) {
+    return handler_.EndPairwise(handler);
+  }
+
+  Expr OnString(fmt::StringRef value) { return handler_.OnString(value); }
+
+  Expr OnSymbolicIf(LogicalExpr condition, Expr then_expr, Expr else_expr) {
+    return handler_.OnSymbolicIf(condition, then_expr, else_expr);
+  }
+
+  void EndInput() { handler_.EndInput(); }
+};
+
+/** Problem statistics collected by `mp::NLStatsCollector`. */
+struct NLStats {
+  /** The number of objectives. */
+  int num_objs;
+
+  /** The number of objectives with nonlinear parts. */
+  int num_nl_objs;
+
+  /** The number of algebraic constraints. */
+  int num_algebraic_cons;
+
+  /** The number of algebraic constraints with nonlinear parts. */
+  int num_nl_cons;
+
+  /** The number of logical constraints. */
+  int num_logical_cons;
+
+  /** The number of common expressions. */
+  int num_common_exprs;
+
+  /** The number of linear terms in objectives. */
+  int num_obj_nonzeros;
+
+  /** The number of linear terms in algebraic constraints. */
+  int num_con_nonzeros;
+
+  /** The number of fixed variables. */
+  int num_fixed_vars;
+
+  /** The number of variables without finite bounds. */
+  int num_free_vars;
+
+  /** The number of equality constraints. */
+  int num_eqns;
+
+  /** The number of complementarity conditions. */
+  int num_compl_conds;
+
+  /** The largest number of nodes in a single expression. */
+  int max_expr_size;
+
+  /** The numbers of expression nodes indexed by kind. */
+  int num_exprs[expr::LAST_EXPR + 1];
+
+  NLStats()
+    : num_objs(0), num_nl_objs(0), num_algebraic_cons(0), num_nl_cons(0),
+      num_logical_cons(0), num_common_exprs(0), num_obj_nonzeros(0),
+      num_con_nonzeros(0), num_fixed_vars(0), num_free_vars(0), num_eqns(0),
+      num_compl_conds(0), max_expr_size(0) {
+    std::fill(num_exprs, num_exprs + expr::LAST_EXPR + 1, 0);
+  }
+};
+
+/**
+  \rst
+  A pipeline stage that collects problem statistics and forwards all
+  notifications to the next handler. Use `mp::NullNLHandler` as the next
+  handler to only compute the statistics.
+  \endrst
+ */
+template <typename Handler>
+class NLStatsCollector : public NLForwarder<Handler> {
+ private:
+  NLStats stats_;
+
+  // The number of nodes in the expression being read.
+  int expr_size_;
+
+  typedef NLForwarder<Handler> Base;
+
+  void AddNode(expr::Kind kind) {
+    ++stats_.num_exprs[kind];
+    ++expr_size_;
+  }
+
+  // Finishes an expression returning true if it is nonempty.
+  bool EndExpr() {
+    int size = expr_size_;
+    expr_size_ = 0;
+    if (size > stats_.max_expr_size)
+      stats_.max_expr_size = size;
+    return size != 0;
+  }
+
+  static bool IsInf(double value) {
+    return value == std::numeric_limits<double>::infinity();
+  }
+
+ public:
+  typedef typename Base::Expr Expr;
+  typedef typename Base::NumericExpr NumericExpr;
+  typedef typename Base::LogicalExpr LogicalExpr;
+  typedef typename Base::CountExpr CountExpr;
+  typedef typename Base::Reference Reference;
+
+  explicit NLStatsCollector(Handler &h) : Base(h), expr_size_(0) {}
+
+  /** Returns the statistics collected so far. */
+  const NLStats &stats() const { return stats_; }
+
+  void OnObj(int index, obj::Type type, NumericExpr expr) {
+    ++stats_.num_objs;
+    if (EndExpr())
+      ++stats_.num_nl_objs;
+    this->handler().OnObj(index, type, expr);
+  }
+
+  void OnAlgebraicCon(int index, NumericExpr expr) {
+    ++stats_.num_algebraic_cons;
+    if (EndExpr())
+      ++stats_.num_nl_cons;
+    this->handler().OnAlgebraicCon(index, expr);
+  }
+
+  void OnLogicalCon(int index, LogicalExpr expr) {
+    ++stats_.num_logical_cons;
+    EndExpr();
+    this->handler().OnLogicalCon(index, expr);
+  }
+
+  void EndCommonExpr(int index, NumericExpr expr, int position) {
+    ++stats_.num_common_exprs;
+    EndExpr();
+    this->handler().EndCommonExpr(index, expr, position);
+  }
+
+  void OnComplementarity(int con_index, int var_index, ComplInfo info) {
+    ++stats_.num_compl_conds;
+    this->handler().OnComplementarity(con_index, var_index, info);
+  }
+
+  typename Base::LinearObjHandler OnLinearObjExpr(
+      int obj_index, int num_linear_terms) {
+    stats_.num_obj_nonzeros += num_linear_terms;
+    return this->handler().OnLinearObjExpr(obj_index, num_linear_terms);
+  }
+
+  typename Base::LinearConHandler OnLinearConExpr(
+      int con_index, int num_linear_terms) {
+    stats_.num_con_nonzeros += num_linear_terms;
+    return this->handler().OnLinearConExpr(con_index, num_linear_terms);
+  }
+
+  void OnVarBounds(int index, double lb, double ub) {
+    if (lb == ub)
+      ++stats_.num_fixed_vars;
+    else if (IsInf(-lb) && IsInf(ub))
+      ++stats_.num_free_vars;
+    this->handler().OnVarBounds(index, lb, ub);
+  }
+
+  void OnConBounds(int index, double lb, double ub) {
+    if (lb == ub)
+      ++stats_.num_eqns;
+    this->handler().OnConBounds(index, lb, ub);
+  }
+
+  NumericExpr OnNumber(double value) {
+    AddNode(expr::NUMBER);
+    return this->handler().OnNumber(value);
+  }
+
+  Reference OnVariableRef(int var_index) {
+    AddNode(expr::VARIABLE);
+    return this->handler().OnVariableRef(var_index);
+  }
+
+  Reference OnCommonExprRef(int expr_index) {
+    AddNode(expr::COMMON_EXPR);
+    return this->handler().OnCommonExprRef(expr_index);
+  }
+
+  NumericExpr OnUnary(expr::Kind kind, NumericExpr arg) {
+    AddNode(kind);
+    return this->handler().OnUnary(kind, arg);
+  }
+
+  NumericExpr OnBinary(expr::Kind kind, NumericExpr lhs, NumericExpr rhs) {
+    AddNode(kind);
+    return this->handler().OnBinary(kind, lhs, rhs);
+  }
+
+  NumericExpr OnIf(LogicalExpr condition,
+                   NumericExpr then_expr, NumericExpr else_expr) {
+    AddNode(expr::IF);
+    return this->handler().OnIf(condition, then_expr, else_expr);
+  }
+
+  typename Base::PLTermHandler BeginPLTerm(int num_breakpoints) {
+    AddNode(expr::PLTERM);
+    return this->handler().BeginPLTerm(num_breakpoints);
+  }
+
+  typename Base::CallArgHandler BeginCall(int func_index, int num_args) {
+    AddNode(expr::CALL);
+    return this->handler().BeginCall(func_index, num_args);
+  }
+
+  typename Base::VarArgHandler BeginVarArg(expr::Kind kind, int num_args) {
+    AddNode(kind);
+    return this->handler().BeginVarArg(kind, num_args);
+  }
+
+  typename Base::NumericArgHandler BeginSum(int num_args) {
+    AddNode(expr::SUM);
+    return this->handler().BeginSum(num_args);
+  }
+
+  typename Base::CountArgHandler BeginCount(int num_args) {
+    AddNode(expr::COUNT);
+    return this->handler().BeginCount(num_args);
+  }
+
+  typename Base::NumberOfArgHandler BeginNumberOf(
+      int num_args, NumericExpr arg0) {
+    AddNode(expr::NUMBEROF);
+    return this->handler().BeginNumberOf(num_args, arg0);
+  }
+
+  typename Base::SymbolicArgHandler BeginSymbolicNumberOf(
+      int num_args, Expr arg0) {
+    AddNode(expr::NUMBEROF_SYM);
+    return this->handler().BeginSymbolicNumberOf(num_args, arg0);
+  }
+
+  LogicalExpr OnBool(bool value) {
+    AddNode(expr::BOOL);
+    return this->handler().OnBool(value);
+  }
+
+  LogicalExpr OnNot(LogicalExpr arg) {
+    AddNode(expr::NOT);
+    return this->handler().OnNot(arg);
+  }
+
+  LogicalExpr OnBinaryLogical(
+      expr::Kind kind, LogicalExpr lhs, LogicalExpr rhs) {
+    AddNode(kind);
+    return this->handler().OnBinaryLogical(kind, lhs, rhs);
+  }
+
+  LogicalExpr OnRelational(expr::Kind kind, NumericExpr lhs, NumericExpr rhs) {
+    AddNode(kind);
+    return this->handler().OnRelational(kind, lhs, rhs);
+  }
+
+  LogicalExpr OnLogicalCount(expr::Kind kind, NumericExpr lhs, CountExpr rhs) {
+    AddNode(kind);
+    return this->handler().OnLogicalCount(kind, lhs, rhs);
+  }
+
+  LogicalExpr OnImplication(
+      LogicalExpr condition, LogicalExpr then_expr, LogicalExpr else_expr) {
+    AddNode(expr::IMPLICATION);
+    return this->handler().OnImplication(condition, then_expr, else_expr);
+  }
+
+  typename Base::LogicalArgHandler BeginIteratedLogical(
+      expr::Kind kind, int num_args) {
+    AddNode(kind);
+    return this->handler().BeginIteratedLogical(kind, num_args);
+  }
+
+  typename Base::PairwiseArgHandler BeginPairwise(
+      expr::Kind kind, int num_args) {
+    AddNode(kind);
+    return this->handler().BeginPairwise(kind, num_args);
+  }
+
+  Expr OnString(fmt::StringRef value) {
+    AddNode(expr::STRING);
+    return this->handler().OnString(value);
+  }
+
+  Expr OnSymbolicIf(LogicalExpr condition, Expr then_expr, Expr else_expr) {
+    AddNode(expr::IFSYM);
+    return this->handler().OnSymbolicIf(condition, then_expr, else_expr);
+  }
+};
+
+/**
+  \rst
+  An NL handler that writes the problem it receives to a file in the text
+  .nl format. It is normally the last stage of a pipeline that rewrites
+  a transformed problem.
+
+  Output is written to the file in blocks as soon as a block is filled,
+  so the memory used doesn't depend on the problem size with two
+  exceptions: nodes of an
+  expression are kept until the expression is complete because operators
+  precede their arguments in the .nl format, and initial values are kept
+  until the end of the ``x`` or ``d`` segment because the segment starts
+  with the number of values. Notifications should arrive in the order
+  in which `mp::NLReader` produces them.
+  \endrst
+ */
+class NLStreamWriter {
+ private:
+  std::FILE *file_;
+  int num_vars_;
+
+  // Output that has not been written to the file yet.
+  fmt::MemoryWriter out_;
+
+  // Initial values of the x or d segment that has not been written yet.
+  fmt::MemoryWriter pending_;
+  char pending_type_;
+  int num_pending_;
+
+  // Linear part of the common expression being read.
+  fmt::MemoryWriter linear_;
+  int num_linear_terms_;
+
+  // An expression node. Its text in the .nl format is the header
+  // text_[text_start:text_end] followed by the texts of its arguments
+  // args_[arg_start:arg_start + num_args].
+  struct Node {
+    int text_start;
+    int text_end;
+    int arg_start;
+    int num_args;
+  };
+
+  // Nodes of the expression being read. Node 0 is reserved so that a
+  // default-constructed expression denotes the omitted zero constant.
+  std::vector<Node> nodes_;
+  std::vector<int> args_;
+  fmt::MemoryWriter text_;
+
+  // Arguments of iterated expressions that are being read.
+  std::vector<int> arg_stack_;
+
+  enum { BUFFER_SIZE = 1 << 16 };
+
+  typedef internal::NLFormatter<internal::TextNLEncoder> Formatter;
+
+  // Returns a formatter that writes to w.
+  static Formatter Format(fmt::Writer &w) { return Formatter(w); }
+
+  // Writes the output buffer to the file.
+  void Flush();
+
+  // Writes the output buffer to the file if it is full. The buffer only
+  // contains complete records, so this can be called after any record.
+  void FlushIfFull() {
+    if (out_.size() >= BUFFER_SIZE)
+      Flush();
+  }
+
+  void FlushPending();
+
+  // Finishes the previous segment.
+  void BeginSegment() {
+    if (num_pending_ != 0)
+      FlushPending();
+    FlushIfFull();
+  }
+
+  void WriteBounds(double lb, double ub) {
+    Format(out_).WriteBounds(lb, ub);
+    FlushIfFull();
+  }
+
+  void AddPending(char type, int index, double value);
+
+  // Starts a node whose header text follows.
+  int BeginNode() {
+    Node node = {static_cast<int>(text_.size()), 0,
+                 static_cast<int>(args_.size()), 0};
+    nodes_.push_back(node);
+    return static_cast<int>(nodes_.size()) - 1;
+  }
+
+  // Ends a node header.
+  void EndHeader(int node) {
+    nodes_[node].text_end = static_cast<int>(text_.size());
+  }
+
+  // Appends a constant to a node header.
+  void AddConstant(int node, double value) {
+    Format(text_).WriteConstant(value);
+    EndHeader(node);
+  }
+
+  int MakeNode(int opcode, int num_args, const int *args);
+
+  int MakeNode(expr::Kind kind, int arg) {
+    return MakeNode(expr::nl_opcode(kind), 1, &arg);
+  }
+
+  int MakeNode(expr::Kind kind, int arg1, int arg2) {
+    int args[] = {arg1, arg2};
+    return MakeNode(expr::nl_opcode(kind), 2, args);
+  }
+
+  int MakeNode(expr::Kind kind, int arg1, int arg2, int arg3) {
+    int args[] = {arg1, arg2, arg3};
+    return MakeNode(expr::nl_opcode(kind), 3, args);
+  }
+
+  // Writes an expression to out_ and clears expression nodes.
+  void WriteExpr(int expr);
+  void DoWriteExpr(int node);
+
+ public:
+  typedef int Expr;
+  typedef int NumericExpr;
+  typedef int LogicalExpr;
+  typedef int CountExpr;
+  typedef int Reference;
+
+  /** Constructs a writer that writes to the specified file. */
+  explicit NLStreamWriter(std::FILE *file);
+
+  void OnHeader(const NLHeader &h);
+
+  bool NeedObj(int) const { return true; }
+
+  void OnObj(int index, obj::Type type, int expr) {
+    BeginSegment();
+    Format(out_).WriteSegmentHeader('O', index, type == obj::MAX ? 1 : 0);
+    WriteExpr(expr);
+  }
+
+  void OnAlgebraicCon(int index, int expr) {
+    BeginSegment();
+    Format(out_).WriteSegmentHeader('C', index);
+    WriteExpr(expr);
+  }
+
+  void OnLogicalCon(int index, int expr) {
+    BeginSegment();
+    Format(out_).WriteSegmentHeader('L', index);
+    WriteExpr(expr);
+  }
+
+  /** Receives notifications of linear terms. */
+  class LinearExprHandler {
+   private:
+    NLStreamWriter *writer_;
+    fmt::Writer *out_;
+
+   public:
+    LinearExprHandler(NLStreamWriter &w, fmt::Writer &out)
+      : writer_(&w), out_(&out) {}
+
+    void AddTerm(int var_index, double coef) {
+      Format(*out_).WriteIndexedValue(var_index, coef);
+      writer_->FlushIfFull();
+    }
+  };
+  typedef LinearExprHandler LinearObjHandler;
+  typedef LinearExprHandler LinearConHandler;
+
+  LinearExprHandler BeginCommonExpr(int, int num_linear_terms) {
+    linear_.clear();
+    num_linear_terms_ = num_linear_terms;
+    return LinearExprHandler(*this, linear_);
+  }
+
+  void EndCommonExpr(int index, int expr, int position);
+
+  void OnComplementarity(int con_index, int var_index, ComplInfo info);
+
+  LinearObjHandler OnLinearObjExpr(int obj_index, int num_linear_terms) {
+    BeginSegment();
+    Format(out_).WriteSegmentHeader('G', obj_index, num_linear_terms);
+    return LinearObjHandler(*this, out_);
+  }
+
+  LinearConHandler OnLinearConExpr(int con_index, int num_linear_terms) {
+    BeginSegment();
+    Format(out_).WriteSegmentHeader('J', con_index, num_linear_terms);
+    return LinearConHandler(*this, out_);
+  }
+
+  void OnVarBounds(int index, double lb, double ub) {
+    if (index == 0) {
+      BeginSegment();
+      Format(out_).WriteSegmentHeader('b');
+    }
+    WriteBounds(lb, ub);
+  }
+
+  void OnConBounds(int index, double lb, double ub) {
+    if (index == 0) {
+      BeginSegment();
+      Format(out_).WriteSegmentHeader('r');
+    }
+    WriteBounds(lb, ub);
+  }
+
+  void OnInitialValue(int var_index, double value) {
+    AddPending('x', var_index, value);
+  }
+
+  void OnInitialDualValue(int con_index, double value) {
+    AddPending('d', con_index, value);
+  }
+
+  /** Receives notifications of Jacobian column sizes. */
+  class ColumnSizeHandler {
+   private:
+    NLStreamWriter *writer_;
+    int offset_;
+
+   public:
+    explicit ColumnSizeHandler(NLStreamWriter &w) : writer_(&w), offset_(0) {}
+
+    void Add(int size) {
+      offset_ += size;
+      Format(writer_->out_).WriteCount(offset_);
+      writer_->FlushIfFull();
+    }
+  };
+
+  ColumnSizeHandler OnColumnSizes() {
+    BeginSegment();
+    Format(out_).WriteSegmentHeader('k', num_vars_ - 1);
+    return ColumnSizeHandler(*this);
+  }
+
+  void OnFunction(int index, fmt::StringRef name,
+                  int num_args, func::Type type) {
+    BeginSegment();
+    Format(out_).WriteFuncHeader(index, type, num_args, name);
+  }
+
+  /** Receives notifications of suffix values. */
+  template <typename T>
+  class SuffixHandler {
+   private:
+    NLStreamWriter *writer_;
+
+   public:
+    explicit SuffixHandler(NLStreamWriter &w) : writer_(&w) {}
+
+    void SetValue(int index, T value) {
+      Format(writer_->out_).WriteIndexedValue(index, value);
+      writer_->FlushIfFull();
+    }
+  };
+  typedef SuffixHandler<int> IntSuffixHandler;
+  typedef SuffixHandler<double> DblSuffixHandler;
+
+  IntSuffixHandler OnIntSuffix(fmt::StringRef name, suf::Kind kind,
+                               int num_values) {
+    BeginSegment();
+    Format(out_).WriteSuffixHeader(kind, num_values, name);
+    return IntSuffixHandler(*this);
+  }
+
+  DblSuffixHandler OnDblSuffix(fmt::StringRef name, suf::Kind kind,
+                               int num_values) {
+    BeginSegment();
+    Format(out_).WriteSuffixHeader(kind | suf::FLOAT, num_values, name);
+    return DblSuffixHandler(*this);
+  }
+
+  int OnNumber(double value) {
+    int node = BeginNode();
+    AddConstant(node, value);
+    return node;
+  }
+
+  int OnVariableRef(int var_index) {
+    int node = BeginNode();
+    Format(text_).WriteReference(var_index);
+    EndHeader(node);
+    return node;
+  }
+
+  int OnCommonExprRef(int expr_index) {
+    return OnVariableRef(num_vars_ + expr_index);
+  }
+
+  int OnUnary(expr::Kind kind, int arg) { return MakeNode(kind, arg); }
+
+  int OnBinary(expr::Kind kind, int lhs, int rhs) {
+    return MakeNode(kind, lhs, rhs);
+  }
+
+  int OnIf(int condition, int then_expr, int else_expr) {
+    return MakeNode(expr::IF, condition, then_expr, else_expr);
+  }
+
+  /** Receives notifications of slopes and breakpoints. */
+  class PLTermHandler {
+   private:
+    NLStreamWriter *writer_;
+    int node_;
+
+    friend class NLStreamWriter;
+
+   public:
+    PLTermHandler(NLStreamWriter &w, int node) : writer_(&w), node_(node) {}
+
+    void AddSlope(double slope) { writer_->AddConstant(node_, slope); }
+    void AddBreakpoint(double breakpoint) {
+      writer_->AddConstant(node_, breakpoint);
+    }
+  };
+
+  PLTermHandler BeginPLTerm(int num_breakpoints) {
+    int node = BeginNode();
+    Formatter f = Format(text_);
+    f.WriteOpCode(expr::PLTERM);
+    f.WriteCount(num_breakpoints + 1);
+    EndHeader(node);
+    return PLTermHandler(*this, node);
+  }
+
+  int EndPLTerm(PLTermHandler handler, int arg) {
+    int node = handler.node_;
+    nodes_[node].arg_start = static_cast<int>(args_.size());
+    nodes_[node].num_args = 1;
+    args_.push_back(arg);
+    return node;
+  }
+
+  /** Receives notifications of arguments of iterated expressions. */
+  class ArgHandler {
+   private:
+    NLStreamWriter *writer_;
+    int node_;
+    int stack_start_;
+
+    friend class NLStreamWriter;
+
+   public:
+    ArgHandler(NLStreamWriter &w, int node)
+      : writer_(&w), node_(node),
+        stack_start_(static_cast<int>(w.arg_stack_.size())) {}
+
+    void AddArg(int arg) { writer_->arg_stack_.push_back(arg); }
+  };
+
+  typedef ArgHandler NumericArgHandler;
+  typedef ArgHandler VarArgHandler;
+  typedef ArgHandler CallArgHandler;
+  typedef ArgHandler NumberOfArgHandler;
+  typedef ArgHandler CountArgHandler;
+  typedef ArgHandler LogicalArgHandler;
+  typedef ArgHandler PairwiseArgHandler;
+  typedef ArgHandler SymbolicArgHandler;
+
+  ArgHandler BeginIterated(expr::Kind kind, int num_args) {
+    int node = BeginNode();
+    Formatter f = Format(text_);
+    f.WriteOpCode(kind);
+    f.WriteCount(num_args);
+    EndHeader(node);
+    return ArgHandler(*this, node);
+  }
+
+  int EndIterated(ArgHandler handler);
+
+  CallArgHandler BeginCall(int func_index, int num_args) {
+    int node = BeginNode();
+    Format(text_).WriteCall(func_index, num_args);
+    EndHeader(node);
+    return ArgHandler(*this, node);
+  }
+
+  int EndCall(CallArgHandler handler) { return EndIterated(handler); }
+
+  VarArgHandler BeginVarArg(expr::Kind kind, int num_args) {
+    return BeginIterated(kind, num_args);
+  }
+
+  int EndVarArg(VarArgHandler handler) { return EndIterated(handler); }
+
+  NumericArgHandler BeginSum(int num_args) {
+    return BeginIterated(expr::SUM, num_args);
+  }
+
+  int EndSum(NumericArgHandler handler) { return EndIterated(handler); }
+
+  CountArgHandler BeginCount(int num_args) {
+    return BeginIterated(expr::COUNT, num_args);
+  }
+
+  int EndCount(CountArgHandler handler) { return EndIterated(handler); }
+
+  NumberOfArgHandler BeginNumberOf(int num_args, int arg0) {
+    ArgHandler handler = BeginIterated(expr::NUMBEROF, num_args);
+    handler.AddArg(arg0);
+    return handler;
+  }
+
+  int EndNumberOf(NumberOfArgHandler handler) { return EndIterated(handler); }
+
+  SymbolicArgHandler BeginSymbolicNumberOf(int num_args, int arg0) {
+    ArgHandler handler = BeginIterated(expr::NUMBEROF_SYM, num_args);
+    handler.AddArg(arg0);
+    return handler;
+  }
+
+  int EndSymbolicNumberOf(SymbolicArgHandler handler) {
+    return EndIterated(handler);
+  }
+
+  int OnBool(bool value) {
+    int node = BeginNode();
+    Format(text_).WriteConstant(value ? 1 : 0);
+    EndHeader(node);
+    return node;
+  }
+
+  int OnNot(int arg) { return MakeNode(expr::NOT, arg); }
+
+  int OnBinaryLogical(expr::Kind kind, int lhs, int rhs) {
+    return MakeNode(kind, lhs, rhs);
+  }
+
+  int OnRelational(expr::Kind kind, int lhs, int rhs) {
+    return MakeNode(kind, lhs, rhs);
+  }
+
+  int OnLogicalCount(expr::Kind kind, int lhs, int rhs) {
+    return MakeNode(kind, lhs, rhs);
+  }
+
+  int OnImplication(int condition, int then_expr, int else_expr) {
+    return MakeNode(expr::IMPLICATION, condition, then_expr, else_expr);
+  }
+
+  LogicalArgHandler BeginIteratedLogical(expr::Kind kind, int num_args) {
+    return BeginIterated(kind, num_args);
+  }
+
+  int EndIteratedLogical(LogicalArgHandler handler) {
+    return EndIterated(handler);
+  }
+
+  PairwiseArgHandler BeginPairwise(expr::Kind kind, int num_args) {
+    return BeginIterated(kind, num_args);
+  }
+
+  int EndPairwise(PairwiseArgHandler handler) { return EndIterated(handler); }
+
+  int OnString(fmt::StringRef value) {
+    int node = BeginNode();
+    Format(text_).WriteString(value);
+    EndHeader(node);
+    return node;
+  }
+
+  int OnSymbolicIf(int condition, int then_expr, int else_expr) {
+    return MakeNode(expr::IFSYM, condition, then_expr, else_expr);
+  }
+
+  /** Writes the remaining output to the file. */
+  void EndInput();
+};
+}  // namespace mp
+
+#endif  // MP_NL_PIPELINE_H_
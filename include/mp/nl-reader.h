@@ -47,9 +47,13 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cfloat>
 #include <cstdlib>
+#include <cstring>
 #include <limits>
+#include <stdint.h>
 #include <string>
+#include <vector>
 
 namespace mp {
 
@@ -350,8 +354,17 @@ class NLHandler {
   }
 
   /**
+    \rst
     A class (struct) that receives notifications of terms in the linear part
     of a common expression.
+
+    This and other linear expression handlers may also define a method
+    ``void AddTerms(int num_terms, int *&indices, double *&coefs)`` that
+    adds *num_terms* terms and returns pointers to arrays of their variable
+    indices and coefficients. If it is defined, terms from binary input are
+    decoded straight into these arrays instead of being passed to
+    ``AddTerm`` one at a time.
+    \endrst
    */
   struct LinearExprHandler {
     /** Receives notification of a term in the linear expression. */
@@ -1042,6 +1055,83 @@ struct Locale {
 };
 #endif
 
+// Parses a decimal floating-point number such as "-1.25e3" that can be
+// converted to double with a single rounding and advances str past it.
+// Returns false without consuming input if the number is not of this form,
+// e.g. has more than 19 significant digits or a large exponent, or is an
+// infinity or a hexadecimal float. Such numbers should be parsed with strtod.
+inline bool ParseDecimalDouble(const char *&str, double &value) {
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+  // Powers of 10 that are exactly representable as double.
+  static const double POWERS_OF_10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  enum { MAX_EXP = 22, MAX_DIGITS = 19 };
+  const char *p = str;
+  bool negative = *p == '-';
+  if (negative || *p == '+')
+    ++p;
+  const char *digits_start = p;
+  while (*p == '0')
+    ++p;
+  fmt::ULongLong mantissa = 0;
+  int num_digits = 0, exp = 0;
+  for (; *p >= '0' && *p <= '9'; ++p, ++num_digits)
+    mantissa = mantissa * 10 + (*p - '0');
+  bool has_digits = p != digits_start;
+  if (*p == '.') {
+    const char *fraction_start = ++p;
+    if (num_digits == 0) {
+      for (; *p == '0'; ++p)
+        --exp;
+    }
+    for (; *p >= '0' && *p <= '9'; ++p, ++num_digits, --exp)
+      mantissa = mantissa * 10 + (*p - '0');
+    has_digits = has_digits || p != fraction_start;
+  }
+  if (!has_digits || num_digits > MAX_DIGITS)
+    return false;
+  if (*p == 'e' || *p == 'E') {
+    ++p;
+    bool negative_exp = *p == '-';
+    if (negative_exp || *p == '+')
+      ++p;
+    if (*p < '0' || *p > '9')
+      return false;
+    int abs_exp = 0;
+    for (; *p >= '0' && *p <= '9'; ++p) {
+      if (abs_exp > 1000)
+        return false;
+      abs_exp = abs_exp * 10 + (*p - '0');
+    }
+    exp += negative_exp ? -abs_exp : abs_exp;
+  }
+  switch (*p) {
+  case ' ': case '\t': case '\n': case '\r': case '\0':
+    break;
+  default:
+    return false;
+  }
+  // Both the mantissa and the power of 10 are exact, so the result is
+  // correctly rounded.
+  fmt::ULongLong max_mantissa = static_cast<fmt::ULongLong>(1) << 53;
+  if (mantissa > max_mantissa || exp < -MAX_EXP || exp > MAX_EXP)
+    return false;
+  double result = static_cast<double>(mantissa);
+  if (exp < 0)
+    result /= POWERS_OF_10[-exp];
+  else
+    result *= POWERS_OF_10[exp];
+  value = negative ? -result : result;
+  str = p;
+  return true;
+#else
+  Unused(str, value);
+  return false;
+#endif
+}
+
 template <typename Locale = Locale>
 class TextReader : public ReaderBase {
  private:
@@ -1066,13 +1156,19 @@ class TextReader : public ReaderBase {
       return false;
     typedef typename MakeUnsigned<Int>::Type UInt;
     UInt result = 0;
+    // The first digits10 digits cannot overflow UInt, so accumulate them
+    // without checking.
+    int num_safe_digits = std::numeric_limits<UInt>::digits10;
     do {
-      UInt new_result = result * 10 + (c - '0');
-      if (new_result < result)
-        ReportError("number is too big");
-      result = new_result;
+      result = result * 10 + (c - '0');
       c = *++ptr_;
-    } while (c >= '0' && c <= '9');
+    } while (c >= '0' && c <= '9' && --num_safe_digits != 0);
+    for (; c >= '0' && c <= '9'; c = *++ptr_) {
+      unsigned digit = c - '0';
+      if (result > (std::numeric_limits<UInt>::max() - digit) / 10)
+        ReportError("number is too big");
+      result = result * 10 + digit;
+    }
     UInt max = std::numeric_limits<Int>::max();
     if (result > max)
       ReportError("number is too big");
@@ -1129,9 +1225,14 @@ class TextReader : public ReaderBase {
       const char *loc, fmt::CStringRef format_str,
       const fmt::ArgList &args = fmt::ArgList());
 
+  // Skips whitespace other than newline. This is equivalent to checking
+  // std::isspace in the "C" locale but doesn't depend on the current locale.
   void SkipSpace() {
-    while (std::isspace(*ptr_) && *ptr_ != '\n')
-      ++ptr_;
+    for (;; ++ptr_) {
+      char c = *ptr_;
+      if (c != ' ' && c != '\t' && c != '\r' && c != '\v' && c != '\f')
+        break;
+    }
     token_ = ptr_;
   }
 
@@ -1140,6 +1241,15 @@ class TextReader : public ReaderBase {
 
   Locale &locale() { return locale_; }
 
+  // Returns the current line number starting from 1.
+  int line() const { return line_; }
+
+  // Moves to the beginning of the line with the specified number.
+  void SeekLine(const char *line_start, int line) {
+    token_ = ptr_ = line_start_ = line_start;
+    line_ = line;
+  }
+
   void ReportError(fmt::CStringRef format_str, const fmt::ArgList &args) {
     DoReportError(token_, format_str, args);
   }
@@ -1171,7 +1281,7 @@ class TextReader : public ReaderBase {
     SkipSpace();
     const char *start = ptr_;
     double value = 0;
-    if (*ptr_ != '\n')
+    if (*ptr_ != '\n' && !ParseDecimalDouble(ptr_, value))
       value = locale_.strtod(ptr_);
     if (ptr_ == start)
       ReportError("expected double");
@@ -1202,17 +1312,52 @@ class EndiannessConverter {
     std::reverse(data, data + size);
   }
 
+  // Swaps bytes with shifts which compilers turn into a single instruction
+  // such as bswap.
+  static uint32_t SwapBytes(uint32_t n) {
+    return (n >> 24) | ((n >> 8) & 0xff00u) | ((n << 8) & 0xff0000u) |
+        (n << 24);
+  }
+
+  static uint64_t SwapBytes(uint64_t n) {
+    uint64_t low = SwapBytes(static_cast<uint32_t>(n));
+    return (low << 32) | SwapBytes(static_cast<uint32_t>(n >> 32));
+  }
+
+  template <typename UInt, typename T>
+  static T SwapBytes(T value) {
+    UInt n = 0;
+    std::memcpy(&n, &value, sizeof(T));
+    n = SwapBytes(n);
+    std::memcpy(&value, &n, sizeof(T));
+    return value;
+  }
+
  public:
   template <typename T>
   T Convert(T value) {
     Convert(reinterpret_cast<char*>(&value), sizeof(T));
     return value;
   }
+
+  int Convert(int value) {
+    return sizeof(int) == sizeof(uint32_t) ?
+          SwapBytes<uint32_t>(value) : Convert<int>(value);
+  }
+
+  double Convert(double value) {
+    return sizeof(double) == sizeof(uint64_t) ?
+          SwapBytes<uint64_t>(value) : Convert<double>(value);
+  }
 };
 
 class BinaryReaderBase : public ReaderBase {
+ private:
+  std::size_t base_offset_;  // Offset of the data start in the input.
+
  protected:
-  explicit BinaryReaderBase(const ReaderBase &base) : ReaderBase(base) {}
+  explicit BinaryReaderBase(const ReaderBase &base)
+    : ReaderBase(base), base_offset_(0) {}
 
   // Reads length chars.
   const char *Read(int length) {
@@ -1229,6 +1374,24 @@ class BinaryReaderBase : public ReaderBase {
   void ReportError(fmt::CStringRef format_str, const fmt::ArgList &args);
   FMT_VARIADIC(void, ReportError, fmt::CStringRef)
 
+  // Sets the offset of the data start in the input which is added to
+  // offsets in error messages. This is used when the input is read in parts.
+  void set_base_offset(std::size_t offset) { base_offset_ = offset; }
+
+  // Reads num_records records of record_size bytes each checking the input
+  // size once and returns a pointer to the first record.
+  const char *ReadRecords(int num_records, std::size_t record_size) {
+    token_ = ptr_;
+    if (static_cast<std::size_t>(end_ - ptr_) / record_size <
+        static_cast<std::size_t>(num_records)) {
+      token_ = end_;
+      ReportError("unexpected end of file");
+    }
+    const char *start = ptr_;
+    ptr_ += num_records * record_size;
+    return start;
+  }
+
   void ReadTillEndOfLine() {
     // Do nothing.
   }
@@ -1266,6 +1429,25 @@ class BinaryReader : private InputConverter, public BinaryReaderBase {
 
   // Reads a function or suffix name.
   fmt::StringRef ReadName() { return ReadString(); }
+
+  // Decodes a value of type T at data obtained with ReadRecords.
+  template <typename T>
+  T Decode(const char *data) {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return this->Convert(value);
+  }
+
+  // Decodes num_records records of an int and a double at data obtained
+  // with ReadRecords into separate arrays.
+  void DecodeRecords(const char *data, int num_records,
+                     int *ints, double *doubles) {
+    const std::size_t RECORD_SIZE = sizeof(int) + sizeof(double);
+    for (int i = 0; i < num_records; ++i, data += RECORD_SIZE) {
+      ints[i] = Decode<int>(data);
+      doubles[i] = Decode<double>(data + sizeof(int));
+    }
+  }
 };
 
 // An NLHandler that forwards notification of variable bounds to another
@@ -1288,6 +1470,26 @@ struct NullLinearExprHandler {
   void AddTerm(int, double) {}
 };
 
+template <bool B>
+struct BoolConstant {};
+
+// Checks if a linear expression handler T can add terms in bulk, i.e. has
+// a method void AddTerms(int num_terms, int *&indices, double *&coefs)
+// that adds num_terms terms and returns pointers to their variable indices
+// and coefficients for the caller to fill in.
+template <typename T>
+class HasAddTerms {
+ private:
+  template <typename U, void (U::*)(int, int *&, double *&)>
+  struct Check {};
+
+  template <typename U>
+  static fmt::internal::Yes &test(Check<U, &U::AddTerms> *);
+  template <typename U> static fmt::internal::No &test(...);
+ public:
+  enum {value = sizeof(test<T>(0)) == sizeof(fmt::internal::Yes)};
+};
+
 // An NL reader.
 // Handler: a class implementing the NLHandler concept that receives
 //          notifications of NL constructs
@@ -1489,6 +1691,95 @@ class NLReader {
   template <typename LinearHandler>
   void ReadLinearExpr(int num_terms, LinearHandler linear_expr);
 
+  // Passes linear terms read as index-value pairs to a linear handler.
+  template <typename LinearHandler>
+  struct LinearTermAdder {
+    LinearHandler &handler;
+    explicit LinearTermAdder(LinearHandler &h) : handler(h) {}
+    void operator()(int var_index, double coef) {
+      handler.AddTerm(var_index, coef);
+    }
+  };
+
+  // Passes initial values read as index-value pairs to a value handler.
+  template <typename ValueHandler>
+  struct InitialValueSetter {
+    ValueHandler &handler;
+    explicit InitialValueSetter(ValueHandler &h) : handler(h) {}
+    void operator()(int index, double value) {
+      handler.SetInitialValue(index, value);
+    }
+  };
+
+  // Reads num_pairs pairs of an index in the range [0, ub) and a value,
+  // one per line, and passes them to pair_handler.
+  template <typename R, typename PairHandler>
+  void ReadIndexedValues(R &, int num_pairs, unsigned ub,
+                         PairHandler pair_handler) {
+    for (int i = 0; i < num_pairs; ++i) {
+      int index = ReadUInt(ub);
+      double value = reader_.ReadDouble();
+      reader_.ReadTillEndOfLine();
+      pair_handler(index, value);
+    }
+  }
+
+  // Reads num_pairs records of an index in the range [0, ub) and a value
+  // from binary input checking the input size and the indices. Returns
+  // a pointer to the first record.
+  template <typename Converter>
+  const char *ReadIndexedRecords(BinaryReader<Converter> &reader,
+                                 int num_pairs, unsigned ub) {
+    const std::size_t PAIR_SIZE = sizeof(int) + sizeof(double);
+    const char *start = reader.ReadRecords(num_pairs, PAIR_SIZE);
+    const char *data = start;
+    for (int i = 0; i < num_pairs; ++i, data += PAIR_SIZE) {
+      int index = reader.template Decode<int>(data);
+      if (static_cast<unsigned>(index) >= ub) {
+        reader.set_ptr(data);
+        if (index < 0)
+          reader.ReportError("expected unsigned integer");
+        reader.ReportError("integer {} out of bounds", index);
+      }
+    }
+    return start;
+  }
+
+  // Decodes index-value pairs from binary input in bulk.
+  template <typename Converter, typename PairHandler>
+  void ReadIndexedValues(BinaryReader<Converter> &reader, int num_pairs,
+                         unsigned ub, PairHandler pair_handler) {
+    const std::size_t PAIR_SIZE = sizeof(int) + sizeof(double);
+    const char *data = ReadIndexedRecords(reader, num_pairs, ub);
+    for (int i = 0; i < num_pairs; ++i, data += PAIR_SIZE) {
+      pair_handler(reader.template Decode<int>(data),
+                   reader.template Decode<double>(data + sizeof(int)));
+    }
+  }
+
+  // Reads linear terms passing them to the handler one at a time.
+  template <typename R, typename LinearHandler, bool ADD_TERMS>
+  void ReadLinearTerms(R &reader, int num_terms, LinearHandler &linear_expr,
+                       BoolConstant<ADD_TERMS>) {
+    ReadIndexedValues(reader, num_terms, header_.num_vars,
+                      LinearTermAdder<LinearHandler>(linear_expr));
+  }
+
+  // Decodes linear terms from binary input straight into the arrays
+  // provided by a handler that can add terms in bulk. The terms are
+  // checked before they are added, so invalid input doesn't reach
+  // the handler.
+  template <typename Converter, typename LinearHandler>
+  void ReadLinearTerms(BinaryReader<Converter> &reader, int num_terms,
+                       LinearHandler &linear_expr, BoolConstant<true>) {
+    const char *data =
+        ReadIndexedRecords(reader, num_terms, header_.num_vars);
+    int *indices = 0;
+    double *coefs = 0;
+    linear_expr.AddTerms(num_terms, indices, coefs);
+    reader.DecodeRecords(data, num_terms, indices, coefs);
+  }
+
   // Reads column sizes, numbers of nonzeros in the first num_var − 1
   // columns of the Jacobian sparsity matrix.
   template <bool CUMULATIVE>
@@ -1522,7 +1813,13 @@ class NLReader {
  public:
   NLReader(Reader &reader, const NLHeader &header, Handler &handler, int flags)
     : reader_(reader), header_(header), handler_(handler), flags_(flags),
-      num_vars_and_exprs_(0) {}
+      // TextReader::ReadHeader checks that this doesn't overflow.
+      num_vars_and_exprs_(header.num_vars +
+                          header.num_common_exprs_in_both +
+                          header.num_common_exprs_in_cons +
+                          header.num_common_exprs_in_objs +
+                          header.num_common_exprs_in_single_cons +
+                          header.num_common_exprs_in_single_objs) {}
 
   // Algebraic constraint handler.
   struct AlgebraicConHandler : ItemHandler<CON> {
@@ -1549,6 +1846,10 @@ class NLReader {
   template <typename BoundHandler>
   void ReadBounds();
 
+  // Reads a segment of type c such as 'C' or 'J'. The segment type
+  // character should be already consumed by the reader.
+  void ReadSegment(char c);
+
   // bound_reader: a reader after variable bounds section input
   void Read(Reader *bound_reader);
 
@@ -1786,14 +2087,10 @@ template <typename Reader, typename Handler>
 template <typename LinearHandler>
 void NLReader<Reader, Handler>::ReadLinearExpr(
     int num_terms, LinearHandler linear_expr) {
-  for (int i = 0; i < num_terms; ++i) {
-    // Variable index should be less than num_vars because common
-    // expressions are not allowed in a linear expression.
-    int var_index = ReadUInt(header_.num_vars);
-    double coef = reader_.ReadDouble();
-    reader_.ReadTillEndOfLine();
-    linear_expr.AddTerm(var_index, coef);
-  }
+  // Variable index should be less than num_vars because common
+  // expressions are not allowed in a linear expression.
+  ReadLinearTerms(reader_, num_terms, linear_expr,
+                  BoolConstant<HasAddTerms<LinearHandler>::value>());
 }
 
 template <typename Reader, typename Handler>
@@ -1885,11 +2182,8 @@ void NLReader<Reader, Handler>::ReadInitialValues() {
   if (num_values > vh.num_items())
     reader_.ReportError("too many initial values");
   reader_.ReadTillEndOfLine();
-  for (int i = 0; i < num_values; ++i) {
-    int index = ReadUInt(vh.num_items());
-    vh.SetInitialValue(index, reader_.ReadDouble());
-    reader_.ReadTillEndOfLine();
-  }
+  ReadIndexedValues(reader_, num_values, vh.num_items(),
+                    InitialValueSetter<ValueHandler>(vh));
 }
 
 template <typename Reader, typename Handler>
@@ -1912,102 +2206,128 @@ void NLReader<Reader, Handler>::ReadSuffix(int info) {
 }
 
 template <typename Reader, typename Handler>
-void NLReader<Reader, Handler>::Read(Reader *bound_reader) {
-  bool read_bounds = bound_reader == 0;
-  // TextReader::ReadHeader checks that this doesn't overflow.
-  num_vars_and_exprs_ = header_.num_vars +
-      header_.num_common_exprs_in_both +
-      header_.num_common_exprs_in_cons +
-      header_.num_common_exprs_in_objs +
-      header_.num_common_exprs_in_single_cons +
-      header_.num_common_exprs_in_single_objs;
-  for (;;) {
-    char c = reader_.ReadChar();
-    switch (c) {
-    case 'C': {
-      // Nonlinear part of an algebraic constraint body.
-      int index = ReadUInt(header_.num_algebraic_cons);
-      reader_.ReadTillEndOfLine();
-      handler_.OnAlgebraicCon(index, ReadNumericExpr(true));
-      break;
-    }
-    case 'L': {
-      // Logical constraint expression.
-      int index = ReadUInt(header_.num_logical_cons);
-      reader_.ReadTillEndOfLine();
-      handler_.OnLogicalCon(index, ReadLogicalExpr());
-      break;
-    }
-    case 'O': {
-      // Objective type and nonlinear part of an objective expression.
-      int index = ReadUInt(header_.num_objs);
-      int obj_type = reader_.ReadUInt();
-      reader_.ReadTillEndOfLine();
-      handler_.OnObj(index, obj_type != 0 ? obj::MAX : obj::MIN,
-                     ReadNumericExpr(true));
-      break;
-    }
-    case 'V': {
-      // Defined variable definition (must precede V, C, L, O segments
-      // where used).
-      int expr_index = ReadUInt(header_.num_vars, num_vars_and_exprs_);
-      expr_index -= header_.num_vars;
-      int num_linear_terms = reader_.ReadUInt();
-      int position = reader_.ReadUInt();
-      reader_.ReadTillEndOfLine();
-      typename Handler::LinearExprHandler
-          expr_handler(handler_.BeginCommonExpr(expr_index, num_linear_terms));
-      if (num_linear_terms != 0)
-        ReadLinearExpr(num_linear_terms, expr_handler);
-      handler_.EndCommonExpr(expr_index, ReadNumericExpr(), position);
-      break;
-    }
-    case 'F': {
-      // Imported function description.
-      int index = ReadUInt(header_.num_funcs);
-      int type = reader_.ReadUInt();
-      if (type != func::NUMERIC && type != func::SYMBOLIC)
-        reader_.ReportError("invalid function type");
-      int num_args = reader_.template ReadInt<int>();
-      fmt::StringRef name = reader_.ReadName();
-      reader_.ReadTillEndOfLine();
-      handler_.OnFunction(index, name, num_args, static_cast<func::Type>(type));
+void NLReader<Reader, Handler>::ReadSegment(char c) {
+  switch (c) {
+  case 'C': {
+    // Nonlinear part of an algebraic constraint body.
+    int index = ReadUInt(header_.num_algebraic_cons);
+    reader_.ReadTillEndOfLine();
+    handler_.OnAlgebraicCon(index, ReadNumericExpr(true));
+    break;
+  }
+  case 'L': {
+    // Logical constraint expression.
+    int index = ReadUInt(header_.num_logical_cons);
+    reader_.ReadTillEndOfLine();
+    handler_.OnLogicalCon(index, ReadLogicalExpr());
+    break;
+  }
+  case 'O': {
+    // Objective type and nonlinear part of an objective expression.
+    int index = ReadUInt(header_.num_objs);
+    int obj_type = reader_.ReadUInt();
+    reader_.ReadTillEndOfLine();
+    handler_.OnObj(index, obj_type != 0 ? obj::MAX : obj::MIN,
+                   ReadNumericExpr(true));
+    break;
+  }
+  case 'V': {
+    // Defined variable definition (must precede V, C, L, O segments
+    // where used).
+    int expr_index = ReadUInt(header_.num_vars, num_vars_and_exprs_);
+    expr_index -= header_.num_vars;
+    int num_linear_terms = reader_.ReadUInt();
+    int position = reader_.ReadUInt();
+    reader_.ReadTillEndOfLine();
+    typename Handler::LinearExprHandler
+        expr_handler(handler_.BeginCommonExpr(expr_index, num_linear_terms));
+    if (num_linear_terms != 0)
+      ReadLinearExpr(num_linear_terms, expr_handler);
+    handler_.EndCommonExpr(expr_index, ReadNumericExpr(), position);
+    break;
+  }
+  case 'F': {
+    // Imported function description.
+    int index = ReadUInt(header_.num_funcs);
+    int type = reader_.ReadUInt();
+    if (type != func::NUMERIC && type != func::SYMBOLIC)
+      reader_.ReportError("invalid function type");
+    int num_args = reader_.template ReadInt<int>();
+    fmt::StringRef name = reader_.ReadName();
+    reader_.ReadTillEndOfLine();
+    handler_.OnFunction(index, name, num_args, static_cast<func::Type>(type));
+    break;
+  }
+  case 'G':
+    // Linear part of an objective expression & gradient sparsity.
+    ReadLinearExpr<ObjHandler>();
+    break;
+  case 'J':
+    // Jacobian sparsity & linear terms in constraints.
+    ReadLinearExpr<AlgebraicConHandler>();
+    break;
+  case 'S': {
+    // Suffix values.
+    int info = reader_.ReadUInt();
+    if (info > (internal::SUFFIX_KIND_MASK | suf::FLOAT))
+      reader_.ReportError("invalid suffix kind");
+    switch (info & internal::SUFFIX_KIND_MASK) {
+    case suf::VAR:
+      ReadSuffix<VarHandler>(info);
       break;
-    }
-    case 'G':
-      // Linear part of an objective expression & gradient sparsity.
-      ReadLinearExpr<ObjHandler>();
+    case suf::CON:
+      ReadSuffix<ConHandler>(info);
       break;
-    case 'J':
-      // Jacobian sparsity & linear terms in constraints.
-      ReadLinearExpr<AlgebraicConHandler>();
+    case suf::OBJ:
+      ReadSuffix<ObjHandler>(info);
       break;
-    case 'S': {
-      // Suffix values.
-      int info = reader_.ReadUInt();
-      if (info > (internal::SUFFIX_KIND_MASK | suf::FLOAT))
-        reader_.ReportError("invalid suffix kind");
-      switch (info & internal::SUFFIX_KIND_MASK) {
-      case suf::VAR:
-        ReadSuffix<VarHandler>(info);
-        break;
-      case suf::CON:
-        ReadSuffix<ConHandler>(info);
-        break;
-      case suf::OBJ:
-        ReadSuffix<ObjHandler>(info);
-        break;
-      case suf::PROBLEM:
-        ReadSuffix<ProblemHandler>(info);
-        break;
-      }
+    case suf::PROBLEM:
+      ReadSuffix<ProblemHandler>(info);
       break;
     }
+    break;
+  }
+  case 'b':
+    // Bounds on variables.
+    ReadBounds<VarHandler>();
+    break;
+  case 'r':
+    // Bounds on algebraic constraint bodies ("ranges").
+    ReadBounds<AlgebraicConHandler>();
+    break;
+  case 'K':
+    // Jacobian sparsity & linear constraint term matrix column sizes
+    // (must precede all J segments).
+    ReadColumnSizes<false>();
+    break;
+  case 'k':
+    // Jacobian sparsity & linear constraint term matrix cumulative column
+    // sizes (must precede all J segments).
+    ReadColumnSizes<true>();
+    break;
+  case 'x':
+    // Primal initial guess.
+    ReadInitialValues<VarHandler>();
+    break;
+  case 'd':
+    // Dual initial guess.
+    ReadInitialValues<AlgebraicConHandler>();
+    break;
+  default:
+    reader_.ReportError("invalid segment type");
+  }
+}
+
+template <typename Reader, typename Handler>
+void NLReader<Reader, Handler>::Read(Reader *bound_reader) {
+  bool read_bounds = bound_reader == 0;
+  for (;;) {
+    char c = reader_.ReadChar();
+    switch (c) {
     case 'b':
       // Bounds on variables.
       if (read_bounds) {
         ReadBounds<VarHandler>();
-        reader_.ptr();
         if ((flags_ & READ_BOUNDS_FIRST) != 0)
           return;
         read_bounds = false;
@@ -2018,28 +2338,6 @@ void NLReader<Reader, Handler>::Read(Reader *bound_reader) {
       reader_ = *bound_reader;
       bound_reader = 0;
       break;
-    case 'r':
-      // Bounds on algebraic constraint bodies ("ranges").
-      ReadBounds<AlgebraicConHandler>();
-      break;
-    case 'K':
-      // Jacobian sparsity & linear constraint term matrix column sizes
-      // (must precede all J segments).
-      ReadColumnSizes<false>();
-      break;
-    case 'k':
-      // Jacobian sparsity & linear constraint term matrix cumulative column
-      // sizes (must precede all J segments).
-      ReadColumnSizes<true>();
-      break;
-    case 'x':
-      // Primal initial guess.
-      ReadInitialValues<VarHandler>();
-      break;
-    case 'd':
-      // Dual initial guess.
-      ReadInitialValues<AlgebraicConHandler>();
-      break;
     case '\0':
       if (reader_.IsEOF()) {
         if (read_bounds)
@@ -2048,7 +2346,7 @@ void NLReader<Reader, Handler>::Read(Reader *bound_reader) {
       }
       // Fall through.
     default:
-      reader_.ReportError("invalid segment type");
+      ReadSegment(c);
     }
   }
 }
@@ -2071,6 +2369,179 @@ void NLReader<Reader, Handler>::Read() {
   handler_.EndInput();
 }
 
+// A source of input such as a pipe.
+class InputSource {
+ public:
+  virtual ~InputSource() {}
+
+  // Reads at most size bytes into buffer and returns the number of bytes
+  // read or 0 at the end of input.
+  virtual std::size_t Read(char *buffer, std::size_t size) = 0;
+
+  // Returns a descriptor that can be polled for input or -1 if there is
+  // none. Waiting for input on a descriptor can be interrupted when the
+  // reader is destroyed before the end of input.
+  virtual int descriptor() const { return -1; }
+};
+
+// An input source that reads from a file.
+template <typename File>
+class FileSource : public InputSource {
+ private:
+  File &file_;
+
+ public:
+  explicit FileSource(File &file) : file_(file) {}
+
+  std::size_t Read(char *buffer, std::size_t size) {
+    return file_.read(buffer, size);
+  }
+
+  int descriptor() const { return file_.descriptor(); }
+};
+
+// .nl input read from a source in blocks and split into chunks of complete
+// segments, so that it can be parsed without keeping the whole input in
+// memory. With MP_USE_THREAD the next block is read on a background thread
+// while the current chunk is being parsed.
+class SegmentStream {
+ private:
+  class Impl;
+  Impl *impl_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(SegmentStream);
+
+ public:
+  enum {
+    DEFAULT_CHUNK_SIZE = 1 << 20,
+    DEFAULT_BLOCK_SIZE = 1 << 16
+  };
+
+  // A chunk of input consisting of complete segments.
+  struct Chunk {
+    NLStringRef data;    // Null-terminated chunk data.
+    int line;            // The line number of the chunk start.
+    std::size_t offset;  // The offset of the chunk start in the input.
+
+    Chunk(NLStringRef d, int l, std::size_t o) : data(d), line(l), offset(o) {}
+  };
+
+  // chunk_size: the approximate size of a chunk in bytes
+  // block_size: the size of a block read from the source in bytes
+  SegmentStream(InputSource &source, fmt::CStringRef name,
+                std::size_t chunk_size = DEFAULT_CHUNK_SIZE,
+                std::size_t block_size = DEFAULT_BLOCK_SIZE);
+
+  // Waits for a read in progress to complete.
+  ~SegmentStream();
+
+  // Reads the header. Should be called before ReadChunk.
+  void ReadHeader(NLHeader &header);
+
+  // Reads the next chunk of input. The 'b' segment always forms a separate
+  // chunk. Returns a chunk with empty data at the end of input. The data is
+  // valid until the next call.
+  Chunk ReadChunk();
+};
+
+// Reads segments from a stream passing them to a handler in the input
+// order except for the bounds in the READ_BOUNDS_FIRST mode.
+template <typename InputConverter, typename Handler>
+class StreamSegmentReader {
+ private:
+  SegmentStream &stream_;
+  std::string name_;
+  const NLHeader &header_;
+  Handler &handler_;
+  int flags_;
+  bool read_bounds_;
+  bool at_end_;
+
+  struct PendingChunk {
+    std::string data;
+    int line;
+    std::size_t offset;
+  };
+
+  // Reads segments of a chunk.
+  template <typename Reader, typename ChunkHandler>
+  void ReadSegments(Reader &reader, ChunkHandler &handler) {
+    NLReader<Reader, ChunkHandler> nl_reader(reader, header_, handler, flags_);
+    for (;;) {
+      char c = reader.ReadChar();
+      if (c == '\0' && reader.IsEOF()) {
+        if (at_end_ && !read_bounds_)
+          reader.ReportError("segment 'b' missing");
+        return;
+      }
+      if (c == 'b') {
+        if (read_bounds_)
+          reader.ReportError("duplicate 'b' segment");
+        read_bounds_ = true;
+      }
+      nl_reader.ReadSegment(c);
+    }
+  }
+
+  template <typename ChunkHandler>
+  void Read(const SegmentStream::Chunk &chunk, ChunkHandler &handler) {
+    TextReader<> reader(chunk.data, name_);
+    reader.SeekLine(chunk.data.c_str(), chunk.line);
+    if (header_.format == NLHeader::TEXT) {
+      ReadSegments(reader, handler);
+      return;
+    }
+    BinaryReader<InputConverter> bin_reader(reader);
+    bin_reader.set_base_offset(chunk.offset);
+    ReadSegments(bin_reader, handler);
+  }
+
+ public:
+  StreamSegmentReader(SegmentStream &stream, fmt::CStringRef name,
+                      const NLHeader &header, Handler &handler, int flags)
+    : stream_(stream), name_(name.c_str()), header_(header),
+      handler_(handler), flags_(flags), read_bounds_(false), at_end_(false) {}
+
+  void Read() {
+    // Chunks preceding the bounds in the READ_BOUNDS_FIRST mode.
+    std::vector<PendingChunk> pending;
+    bool bounds_first = (flags_ & READ_BOUNDS_FIRST) != 0;
+    for (;;) {
+      SegmentStream::Chunk chunk = stream_.ReadChunk();
+      at_end_ = chunk.data.size() == 0;
+      if (bounds_first && !read_bounds_ && !at_end_ &&
+          *chunk.data.c_str() != 'b') {
+        // Parse the chunk without passing anything but bounds to the handler
+        // to report errors in the same order as NLReader does.
+        VarBoundHandler<Handler> bound_handler(handler_);
+        Read(chunk, bound_handler);
+        PendingChunk pc = {
+          std::string(chunk.data.c_str(), chunk.data.size()),
+          chunk.line, chunk.offset
+        };
+        pending.push_back(pc);
+        continue;
+      }
+      Read(chunk, handler_);
+      for (std::size_t i = 0, n = pending.size(); i != n; ++i) {
+        const PendingChunk &pc = pending[i];
+        Read(SegmentStream::Chunk(pc.data, pc.line, pc.offset), handler_);
+      }
+      pending.clear();
+      if (at_end_)
+        break;
+    }
+    handler_.EndInput();
+  }
+};
+
+// Reads .nl input from a source such as a pipe (see mp::ReadNLStream).
+template <typename Handler>
+void ReadNLStream(
+    InputSource &source, Handler &handler, fmt::CStringRef name, int flags,
+    std::size_t chunk_size = SegmentStream::DEFAULT_CHUNK_SIZE,
+    std::size_t block_size = SegmentStream::DEFAULT_BLOCK_SIZE);
+
 // An .nl file reader.
 template <typename File = fmt::File>
 class NLFileReader {
@@ -2078,6 +2549,8 @@ class NLFileReader {
   File file_;
   std::size_t size_;
   std::size_t rounded_size_;  // Size rounded up to a multiple of page size.
+  int map_hints_;
+  MappedFileStats stats_;
 
   void Open(fmt::CStringRef filename);
 
@@ -2085,25 +2558,41 @@ class NLFileReader {
   void Read(fmt::internal::MemoryBuffer<char, 1> &array);
 
  public:
-  NLFileReader() : size_(0), rounded_size_(0) {}
+  NLFileReader()
+    : size_(0), rounded_size_(0), map_hints_(map_hint::SEQUENTIAL) {}
 
   const File &file() { return file_; }
 
+  // Sets the map_hint flags used when memory-mapping the file.
+  void set_map_hints(int hints) { map_hints_ = hints; }
+
+  // Returns the statistics of the last memory-mapped read.
+  const MappedFileStats &stats() const { return stats_; }
+
   // Opens and reads the file.
   template <typename Handler>
   void Read(fmt::CStringRef filename, Handler &handler, int flags) {
     Open(filename);
-    if (size_ == rounded_size_) {
-      // Don't use mmap, because the file size is a multiple of the page size
+    if (size_ == rounded_size_ &&
+        (size_ == 0 || (flags & READ_PARALLEL) == 0)) {
+      // The file is empty, which is also the case for pipes and devices
+      // that cannot be mapped, or its size is a multiple of the page size
       // and therefore the mmap'ed buffer won't be null-terminated.
+      // Read it as a stream to avoid copying the whole file.
+      FileSource<File> source(file_);
+      return ReadNLStream(source, handler, filename, flags);
+    }
+    if (size_ == rounded_size_) {
+      // Parallel reading needs the whole input in memory.
       fmt::internal::MemoryBuffer<char, 1> array;
       Read(array);
       return ReadNLString(
             NLStringRef(&array[0], size_), handler, filename, flags);
     }
-    MemoryMappedFile<File> mapped_file(file_, rounded_size_);
+    MemoryMappedFile<File> mapped_file(file_, rounded_size_, map_hints_);
     ReadNLString(
           NLStringRef(mapped_file.start(), size_), handler, filename, flags);
+    stats_ = mapped_file.stats();
   }
 };
 
@@ -2115,6 +2604,85 @@ void ReadBinary(TextReader<> &reader, const NLHeader &header,
         bin_reader, header, handler, flags).Read();
 }
 
+// Text .nl input split into segments that are converted into the binary
+// format on worker threads (see mp::READ_PARALLEL). Consecutive segments
+// are grouped into chunks which are the units of work.
+class TextSegmentConverter {
+ private:
+  class Impl;
+  Impl *impl_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(TextSegmentConverter);
+
+ public:
+  enum { DEFAULT_CHUNK_SIZE = 1 << 20 };
+
+  // Splits the input data following the header into segments and starts
+  // converting them. reader should be positioned after the header.
+  // chunk_size: the approximate size of a chunk in bytes of text input
+  // num_threads: the number of worker threads, 0 means use the number of
+  //              hardware threads
+  TextSegmentConverter(NLStringRef data, const TextReader<> &reader,
+                       const NLHeader &header,
+                       std::size_t chunk_size = DEFAULT_CHUNK_SIZE,
+                       int num_threads = 0);
+
+  // Waits for the worker threads to finish.
+  ~TextSegmentConverter();
+
+  // Returns true if the input has been split into segments. The input is
+  // not split if it is malformed and should be read sequentially to
+  // report an error.
+  bool split() const;
+
+  // Returns the number of chunks.
+  int num_chunks() const;
+
+  // Returns the index of the chunk containing variable bounds. The 'b'
+  // segment always forms a separate chunk.
+  int bounds_chunk() const;
+
+  // Waits until the chunk with the specified index is converted and returns
+  // its data in the binary format. Throws an exception if the chunk cannot
+  // be converted.
+  NLStringRef GetChunk(int index);
+};
+
+// Reads segments of binary input passing them to the handler.
+template <typename Handler>
+void ReadBinarySegments(NLStringRef data, fmt::CStringRef name,
+                        const NLHeader &header, Handler &handler) {
+  TextReader<> base(data, name);
+  BinaryReader<> reader(base);
+  NLReader<BinaryReader<>, Handler> nl_reader(reader, header, handler, 0);
+  while (char c = reader.ReadChar())
+    nl_reader.ReadSegment(c);
+}
+
+// Reads text input converting segments into the binary format in parallel
+// and passing them to the handler in the input order.
+template <typename Handler>
+void ReadTextInParallel(
+    NLStringRef data, fmt::CStringRef name, TextReader<> &reader,
+    const NLHeader &header, Handler &handler, int flags,
+    std::size_t chunk_size = TextSegmentConverter::DEFAULT_CHUNK_SIZE) {
+  TextSegmentConverter converter(data, reader, header, chunk_size);
+  if (!converter.split()) {
+    NLReader<TextReader<>, Handler>(reader, header, handler, flags).Read();
+    return;
+  }
+  int bounds_chunk = -1;
+  if ((flags & READ_BOUNDS_FIRST) != 0) {
+    bounds_chunk = converter.bounds_chunk();
+    ReadBinarySegments(converter.GetChunk(bounds_chunk), name, header, handler);
+  }
+  for (int i = 0, n = converter.num_chunks(); i < n; ++i) {
+    if (i != bounds_chunk)
+      ReadBinarySegments(converter.GetChunk(i), name, header, handler);
+  }
+  handler.EndInput();
+}
+
 template <typename NameHandler>
 void ReadNames(fmt::CStringRef filename, fmt::StringRef data,
                NameHandler &handler) {
@@ -2490,6 +3058,11 @@ void ReadNLString(NLStringRef str, Handler &handler,
   adapter.OnHeader(header);
   switch (header.format) {
   case NLHeader::TEXT:
+    if ((flags & READ_PARALLEL) != 0) {
+      internal::ReadTextInParallel<typename Adapter::Type>(
+            str, name, reader, header, adapter, flags);
+      break;
+    }
     internal::NLReader<internal::TextReader<>, typename Adapter::Type>(
           reader, header, adapter, flags).Read();
     break;
@@ -2508,10 +3081,41 @@ void ReadNLString(NLStringRef str, Handler &handler,
   }
 }
 
+namespace internal {
+template <typename Handler>
+void ReadNLStream(InputSource &source, Handler &handler, fmt::CStringRef name,
+                  int flags, std::size_t chunk_size, std::size_t block_size) {
+  typedef NLAdapter<Handler, HasBuilder<Handler>::value> Adapter;
+  typedef typename Adapter::Type AdapterType;
+  typename Adapter::RefType adapter(handler);
+  SegmentStream stream(source, name, chunk_size, block_size);
+  NLHeader header = NLHeader();
+  stream.ReadHeader(header);
+  adapter.OnHeader(header);
+  arith::Kind arith_kind = arith::GetKind();
+  if (header.format == NLHeader::TEXT || arith_kind == header.arith_kind) {
+    StreamSegmentReader<IdentityConverter, AdapterType>(
+          stream, name, header, adapter, flags).Read();
+    return;
+  }
+  if (!IsIEEE(arith_kind) || !IsIEEE(header.arith_kind))
+    throw ReadError(name, 0, 0, "unsupported floating-point arithmetic");
+  StreamSegmentReader<EndiannessConverter, AdapterType>(
+        stream, name, header, adapter, flags).Read();
+}
+}  // namespace internal
+
 template <typename Handler>
 inline void ReadNLFile(fmt::CStringRef filename, Handler &handler, int flags) {
   internal::NLFileReader<>().Read(filename, handler, flags);
 }
+
+template <typename Handler>
+inline void ReadNLStream(fmt::File &file, Handler &handler,
+                         fmt::CStringRef name, int flags) {
+  internal::FileSource<fmt::File> source(file);
+  internal::ReadNLStream(source, handler, name, flags);
+}
 }  // namespace mp
 
 #endif  // MP_NL_READER_H_
@@ -0,0 +1,1069 @@
+/*
+ .nl writer
+
+ Writes an optimization problem in the text or binary .nl format:
+
+   mp::WriteNLFile("test.nl", problem, mp::NLHeader::BINARY);
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#ifndef MP_NL_WRITER_H_
+#define MP_NL_WRITER_H_
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+#include "mp/error.h"
+#include "mp/expr-visitor.h"
+#include "mp/nl-reader.h"
+#include "mp/problem.h"
+
+namespace mp {
+namespace internal {
+
+// Encodes .nl constructs in the text format. Tokens are written without
+// separators; Space and EndLine add them where the format requires.
+class TextNLEncoder {
+ private:
+  fmt::Writer &w_;
+
+ public:
+  explicit TextNLEncoder(fmt::Writer &w) : w_(w) {}
+
+  void Code(char c) { w_ << c; }
+  void Int(int value) { w_ << value; }
+  void Double(double value) { w_ << value; }
+  void Space() { w_ << ' '; }
+  void EndLine() { w_ << '\n'; }
+
+  // Writes a string literal.
+  void String(fmt::StringRef s) {
+    w_ << s.size() << ':' << s;
+  }
+
+  // Writes a function or suffix name.
+  void Name(fmt::StringRef name) { w_ << name; }
+};
+
+// Encodes .nl constructs in the binary format using the native
+// representation of numbers.
+class BinaryNLEncoder {
+ private:
+  fmt::Buffer<char> &buffer_;
+
+  template <typename T>
+  void Append(T value) {
+    const char *data = reinterpret_cast<const char*>(&value);
+    buffer_.append(data, data + sizeof(T));
+  }
+
+ public:
+  explicit BinaryNLEncoder(fmt::Writer &w) : buffer_(w.buffer()) {}
+
+  void Code(char c) { buffer_.push_back(c); }
+  void Int(int value) { Append(value); }
+  void Double(double value) { Append(value); }
+  void Space() {}
+  void EndLine() {}
+
+  void String(fmt::StringRef s) {
+    Int(static_cast<int>(s.size()));
+    buffer_.append(s.data(), s.data() + s.size());
+  }
+
+  void Name(fmt::StringRef name) { String(name); }
+};
+
+// Writes records of the .nl format using Encoder. Both NLWriter and
+// NLStreamWriter produce their output with this class.
+template <typename Encoder>
+class NLFormatter {
+ private:
+  Encoder enc_;
+
+ public:
+  explicit NLFormatter(fmt::Writer &w) : enc_(w) {}
+
+  void WriteOpCode(int opcode) {
+    enc_.Code('o');
+    enc_.Int(opcode);
+    enc_.EndLine();
+  }
+
+  void WriteOpCode(expr::Kind kind) { WriteOpCode(expr::nl_opcode(kind)); }
+
+  void WriteConstant(double value) {
+    enc_.Code('n');
+    enc_.Double(value);
+    enc_.EndLine();
+  }
+
+  // Writes a reference to a variable or a common expression.
+  void WriteReference(int index) {
+    enc_.Code('v');
+    enc_.Int(index);
+    enc_.EndLine();
+  }
+
+  // Writes a count such as the number of arguments of an iterated
+  // expression or a cumulative Jacobian column size.
+  void WriteCount(int count) {
+    enc_.Int(count);
+    enc_.EndLine();
+  }
+
+  void WriteString(fmt::StringRef s) {
+    enc_.Code('h');
+    enc_.String(s);
+    enc_.EndLine();
+  }
+
+  void WriteCall(int func_index, int num_args) {
+    enc_.Code('f');
+    enc_.Int(func_index);
+    enc_.Space();
+    enc_.Int(num_args);
+    enc_.EndLine();
+  }
+
+  void WriteIndexedValue(int index, int value) {
+    enc_.Int(index);
+    enc_.Space();
+    enc_.Int(value);
+    enc_.EndLine();
+  }
+
+  void WriteIndexedValue(int index, double value) {
+    enc_.Int(index);
+    enc_.Space();
+    enc_.Double(value);
+    enc_.EndLine();
+  }
+
+  void WriteBounds(double lb, double ub);
+
+  // Writes a complementarity condition in the r segment.
+  void WriteComplementarity(int flags, int var_index) {
+    enc_.Code('5');
+    enc_.Space();
+    enc_.Int(flags);
+    enc_.Space();
+    enc_.Int(var_index + 1);
+    enc_.EndLine();
+  }
+
+  // Writes a segment header without arguments such as r or b.
+  void WriteSegmentHeader(char code) {
+    enc_.Code(code);
+    enc_.EndLine();
+  }
+
+  // Writes a segment header with one argument such as C, L, x, d or k.
+  void WriteSegmentHeader(char code, int arg) {
+    enc_.Code(code);
+    enc_.Int(arg);
+    enc_.EndLine();
+  }
+
+  // Writes a segment header with two arguments such as O, J or G.
+  void WriteSegmentHeader(char code, int arg1, int arg2) {
+    enc_.Code(code);
+    enc_.Int(arg1);
+    enc_.Space();
+    enc_.Int(arg2);
+    enc_.EndLine();
+  }
+
+  void WriteCommonExprHeader(int index, int num_linear_terms, int position) {
+    enc_.Code('V');
+    enc_.Int(index);
+    enc_.Space();
+    enc_.Int(num_linear_terms);
+    enc_.Space();
+    enc_.Int(position);
+    enc_.EndLine();
+  }
+
+  void WriteFuncHeader(int index, int type, int num_args,
+                       fmt::StringRef name) {
+    enc_.Code('F');
+    enc_.Int(index);
+    enc_.Space();
+    enc_.Int(type);
+    enc_.Space();
+    enc_.Int(num_args);
+    enc_.Space();
+    enc_.Name(name);
+    enc_.EndLine();
+  }
+
+  void WriteSuffixHeader(int kind, int num_values, fmt::StringRef name) {
+    enc_.Code('S');
+    enc_.Int(kind);
+    enc_.Space();
+    enc_.Int(num_values);
+    enc_.Space();
+    enc_.Name(name);
+    enc_.EndLine();
+  }
+};
+
+template <typename Encoder>
+void NLFormatter<Encoder>::WriteBounds(double lb, double ub) {
+  double infinity = std::numeric_limits<double>::infinity();
+  if (lb == ub) {
+    enc_.Code('4');
+    enc_.Space();
+    enc_.Double(lb);
+  } else if (lb == -infinity) {
+    if (ub == infinity) {
+      enc_.Code('3');
+    } else {
+      enc_.Code('1');
+      enc_.Space();
+      enc_.Double(ub);
+    }
+  } else if (ub == infinity) {
+    enc_.Code('2');
+    enc_.Space();
+    enc_.Double(lb);
+  } else {
+    enc_.Code('0');
+    enc_.Space();
+    enc_.Double(lb);
+    enc_.Space();
+    enc_.Double(ub);
+  }
+  enc_.EndLine();
+}
+
+// Writes segments of a problem using Encoder.
+template <typename Problem, typename Encoder>
+class NLSegmentWriter :
+    public ExprVisitor<NLSegmentWriter<Problem, Encoder>, void> {
+ private:
+  const Problem &problem_;
+  const std::vector<Function> &funcs_;
+  NLFormatter<Encoder> out_;
+
+  typedef ExprVisitor<NLSegmentWriter<Problem, Encoder>, void> Base;
+
+  template <typename ExprType>
+  void WriteIf(ExprType e) {
+    out_.WriteOpCode(e.kind());
+    Visit(e.condition());
+    Visit(e.then_expr());
+    Visit(e.else_expr());
+  }
+
+  template <typename ExprType>
+  void WriteIterated(ExprType e) {
+    out_.WriteOpCode(e.kind());
+    out_.WriteCount(e.num_args());
+    for (typename ExprType::iterator
+         i = e.begin(), end = e.end(); i != end; ++i) {
+      Visit(*i);
+    }
+  }
+
+  // Writes a numeric expression omitting the linear part.
+  void WriteExpr(NumericExpr e) {
+    if (e)
+      Visit(e);
+    else
+      out_.WriteConstant(0);
+  }
+
+  template <typename LinearExpr>
+  void WriteLinearExpr(char code, int index, const LinearExpr &expr);
+
+  // Writes nonzero values of a suffix with indices less than num_items.
+  template <typename T>
+  class SuffixValueWriter {
+   private:
+    NLFormatter<Encoder> &out_;
+    int num_items_;
+
+   public:
+    SuffixValueWriter(NLFormatter<Encoder> &out, int num_items)
+      : out_(out), num_items_(num_items) {}
+
+    void Visit(int index, T value) {
+      if (index < num_items_)
+        out_.WriteIndexedValue(index, value);
+    }
+  };
+
+  // Counts nonzero values of a suffix with indices less than num_items.
+  class SuffixValueCounter {
+   private:
+    int num_items_;
+    int count_;
+
+   public:
+    explicit SuffixValueCounter(int num_items)
+      : num_items_(num_items), count_(0) {}
+
+    int count() const { return count_; }
+
+    template <typename T>
+    void Visit(int index, T) {
+      if (index < num_items_)
+        ++count_;
+    }
+  };
+
+  template <typename T>
+  void WriteSuffixValues(Suffix s, int num_items) {
+    SuffixValueWriter<T> writer(out_, num_items);
+    Cast< BasicSuffix<T> >(s).VisitValues(writer);
+  }
+
+  int GetNumItems(suf::Kind kind) const;
+
+ public:
+  NLSegmentWriter(const Problem &p, const std::vector<Function> &funcs,
+                  fmt::Writer &w)
+    : problem_(p), funcs_(funcs), out_(w) {}
+
+  using Base::Visit;
+
+  // Writes function descriptions (F segments).
+  void WriteFuncs(int start, int end);
+
+  // Writes suffixes of the specified kind (S segments).
+  void WriteSuffixes(suf::Kind kind);
+
+  // Writes common expressions (V segments).
+  void WriteCommonExprs(int start, int end);
+
+  // Writes nonlinear parts of algebraic constraints (C segments).
+  void WriteAlgebraicCons(int start, int end);
+
+  // Writes logical constraints (L segments).
+  void WriteLogicalCons(int start, int end);
+
+  // Writes nonlinear parts of objectives (O segments).
+  void WriteObjs(int start, int end);
+
+  // Writes nonzero initial values of variables (x segment) or dual
+  // values of algebraic constraints (d segment). The segment header with
+  // num_values is written if start is 0.
+  void WriteInitialValues(char code, int num_values, int start, int end);
+
+  // Writes constraint bounds (r segment).
+  void WriteConBounds(int start, int end);
+
+  // Writes variable bounds (b segment).
+  void WriteVarBounds(int start, int end);
+
+  // Writes cumulative Jacobian column sizes (k segment).
+  void WriteColumnSizes();
+
+  // Writes linear parts of algebraic constraints (J segments).
+  void WriteLinearCons(int start, int end);
+
+  // Writes linear parts of objectives (G segments).
+  void WriteLinearObjs(int start, int end);
+
+  void VisitNumericConstant(NumericConstant c) {
+    out_.WriteConstant(c.value());
+  }
+
+  void VisitVariable(Reference v) { out_.WriteReference(v.index()); }
+
+  void VisitCommonExpr(Reference e) {
+    out_.WriteReference(problem_.num_vars() + e.index());
+  }
+
+  void VisitUnary(UnaryExpr e) {
+    out_.WriteOpCode(e.kind());
+    Visit(e.arg());
+  }
+
+  void VisitBinary(BinaryExpr e) {
+    out_.WriteOpCode(e.kind());
+    Visit(e.lhs());
+    Visit(e.rhs());
+  }
+
+  void VisitIf(IfExpr e) { WriteIf(e); }
+
+  void VisitPLTerm(PLTerm e) {
+    out_.WriteOpCode(expr::PLTERM);
+    out_.WriteCount(e.num_slopes());
+    for (int i = 0, n = e.num_breakpoints(); i < n; ++i) {
+      out_.WriteConstant(e.slope(i));
+      out_.WriteConstant(e.breakpoint(i));
+    }
+    out_.WriteConstant(e.slope(e.num_slopes() - 1));
+    Visit(e.arg());
+  }
+
+  void VisitCall(CallExpr e);
+
+  void VisitVarArg(IteratedExpr e) { WriteIterated(e); }
+  void VisitSum(IteratedExpr e) { WriteIterated(e); }
+  void VisitNumberOf(IteratedExpr e) { WriteIterated(e); }
+  void VisitNumberOfSym(SymbolicNumberOfExpr e) { WriteIterated(e); }
+  void VisitCount(CountExpr e) { WriteIterated(e); }
+
+  void VisitLogicalConstant(LogicalConstant c) {
+    out_.WriteConstant(c.value() ? 1 : 0);
+  }
+
+  void VisitNot(NotExpr e) {
+    out_.WriteOpCode(expr::NOT);
+    Visit(e.arg());
+  }
+
+  void VisitBinaryLogical(BinaryLogicalExpr e) {
+    out_.WriteOpCode(e.kind());
+    Visit(e.lhs());
+    Visit(e.rhs());
+  }
+
+  void VisitRelational(RelationalExpr e) {
+    out_.WriteOpCode(e.kind());
+    Visit(e.lhs());
+    Visit(e.rhs());
+  }
+
+  void VisitLogicalCount(LogicalCountExpr e) {
+    out_.WriteOpCode(e.kind());
+    Visit(e.lhs());
+    VisitCount(e.rhs());
+  }
+
+  void VisitImplication(ImplicationExpr e) { WriteIf(e); }
+
+  void VisitIteratedLogical(IteratedLogicalExpr e) { WriteIterated(e); }
+
+  void VisitAllDiff(PairwiseExpr e) { WriteIterated(e); }
+  void VisitNotAllDiff(PairwiseExpr e) { WriteIterated(e); }
+
+  void VisitStringLiteral(StringLiteral e) { out_.WriteString(e.value()); }
+
+  void VisitSymbolicIf(SymbolicIfExpr e) { WriteIf(e); }
+};
+
+template <typename Problem, typename Encoder>
+template <typename LinearExpr>
+void NLSegmentWriter<Problem, Encoder>::WriteLinearExpr(
+    char code, int index, const LinearExpr &expr) {
+  int num_terms = expr.num_terms();
+  if (num_terms == 0)
+    return;
+  out_.WriteSegmentHeader(code, index, num_terms);
+  for (typename LinearExpr::iterator
+       i = expr.begin(), end = expr.end(); i != end; ++i) {
+    out_.WriteIndexedValue(i->var_index(), i->coef());
+  }
+}
+
+template <typename Problem, typename Encoder>
+int NLSegmentWriter<Problem, Encoder>::GetNumItems(suf::Kind kind) const {
+  switch (kind) {
+  case suf::VAR:
+    return problem_.num_vars();
+  case suf::CON:
+    return problem_.num_algebraic_cons();
+  case suf::OBJ:
+    return problem_.num_objs();
+  default:
+    return 1;
+  }
+}
+
+template <typename Problem, typename Encoder>
+void NLSegmentWriter<Problem, Encoder>::WriteFuncs(int start, int end) {
+  for (int i = start; i < end; ++i) {
+    Function f = funcs_[i];
+    if (!f)
+      continue;
+    out_.WriteFuncHeader(i, f.type(), f.num_args(), f.name());
+  }
+}
+
+template <typename Problem, typename Encoder>
+void NLSegmentWriter<Problem, Encoder>::WriteSuffixes(suf::Kind kind) {
+  int num_items = GetNumItems(kind);
+  const typename Problem::SuffixSet &suffixes = problem_.suffixes(kind);
+  for (typename Problem::SuffixSet::iterator
+       i = suffixes.begin(), end = suffixes.end(); i != end; ++i) {
+    // Suffix::num_values() is the capacity, so count the values to write.
+    Suffix s = *i;
+    SuffixValueCounter counter(num_items);
+    s.VisitValues(counter);
+    if (counter.count() == 0)
+      continue;
+    out_.WriteSuffixHeader(s.kind() & (internal::SUFFIX_KIND_MASK | suf::FLOAT),
+                           counter.count(), s.name());
+    if ((s.kind() & suf::FLOAT) != 0)
+      WriteSuffixValues<double>(s, num_items);
+    else
+      WriteSuffixValues<int>(s, num_items);
+  }
+}
+
+template <typename Problem, typename Encoder>
+void NLSegmentWriter<Problem, Encoder>::WriteCommonExprs(int start, int end) {
+  int num_vars = problem_.num_vars();
+  for (int i = start; i < end; ++i) {
+    typename Problem::CommonExpr e = problem_.common_expr(i);
+    const LinearExpr &linear = e.linear_expr();
+    out_.WriteCommonExprHeader(num_vars + i, linear.num_terms(), 0);
+    for (LinearExpr::iterator
+         j = linear.begin(), term_end = linear.end(); j != term_end; ++j) {
+      out_.WriteIndexedValue(j->var_index(), j->coef());
+    }
+    WriteExpr(e.nonlinear_expr());
+  }
+}
+
+template <typename Problem, typename Encoder>
+void NLSegmentWriter<Problem, Encoder>::WriteAlgebraicCons(
+    int start, int end) {
+  for (int i = start; i < end; ++i) {
+    out_.WriteSegmentHeader('C', i);
+    WriteExpr(problem_.algebraic_con(i).nonlinear_expr());
+  }
+}
+
+template <typename Problem, typename Encoder>
+void NLSegmentWriter<Problem, Encoder>::WriteLogicalCons(int start, int end) {
+  for (int i = start; i < end; ++i) {
+    out_.WriteSegmentHeader('L', i);
+    LogicalExpr e = problem_.logical_con(i).expr();
+    if (e)
+      Visit(e);
+    else
+      out_.WriteConstant(0);
+  }
+}
+
+template <typename Problem, typename Encoder>
+void NLSegmentWriter<Problem, Encoder>::WriteObjs(int start, int end) {
+  for (int i = start; i < end; ++i) {
+    typename Problem::Objective obj = problem_.obj(i);
+    out_.WriteSegmentHeader('O', i, obj.type() == obj::MAX ? 1 : 0);
+    WriteExpr(obj.nonlinear_expr());
+  }
+}
+
+template <typename Problem, typename Encoder>
+void NLSegmentWriter<Problem, Encoder>::WriteInitialValues(
+    char code, int num_values, int start, int end) {
+  if (start == 0)
+    out_.WriteSegmentHeader(code, num_values);
+  for (int i = start; i < end; ++i) {
+    double value = code == 'x' ?
+          problem_.var(i).value() : problem_.algebraic_con(i).dual();
+    if (value != 0)
+      out_.WriteIndexedValue(i, value);
+  }
+}
+
+template <typename Problem, typename Encoder>
+void NLSegmentWriter<Problem, Encoder>::WriteConBounds(int start, int end) {
+  if (start == 0)
+    out_.WriteSegmentHeader('r');
+  for (int i = start; i < end; ++i) {
+    typename Problem::AlgebraicCon con = problem_.algebraic_con(i);
+    out_.WriteBounds(con.lb(), con.ub());
+  }
+}
+
+template <typename Problem, typename Encoder>
+void NLSegmentWriter<Problem, Encoder>::WriteVarBounds(int start, int end) {
+  if (start == 0)
+    out_.WriteSegmentHeader('b');
+  for (int i = start; i < end; ++i) {
+    typename Problem::Variable var = problem_.var(i);
+    out_.WriteBounds(var.lb(), var.ub());
+  }
+}
+
+template <typename Problem, typename Encoder>
+void NLSegmentWriter<Problem, Encoder>::WriteColumnSizes() {
+  int num_vars = problem_.num_vars();
+  std::vector<int> offsets(num_vars + 1);
+  for (int i = 0, n = problem_.num_algebraic_cons(); i < n; ++i) {
+    LinearExpr expr = problem_.algebraic_con(i).linear_expr();
+    for (LinearExpr::iterator j = expr.begin(), end = expr.end();
+         j != end; ++j) {
+      ++offsets[j->var_index() + 1];
+    }
+  }
+  out_.WriteSegmentHeader('k', num_vars - 1);
+  for (int i = 1; i < num_vars; ++i) {
+    offsets[i] += offsets[i - 1];
+    out_.WriteCount(offsets[i]);
+  }
+}
+
+template <typename Problem, typename Encoder>
+void NLSegmentWriter<Problem, Encoder>::WriteLinearCons(int start, int end) {
+  for (int i = start; i < end; ++i)
+    WriteLinearExpr('J', i, problem_.algebraic_con(i).linear_expr());
+}
+
+template <typename Problem, typename Encoder>
+void NLSegmentWriter<Problem, Encoder>::WriteLinearObjs(int start, int end) {
+  for (int i = start; i < end; ++i)
+    WriteLinearExpr('G', i, problem_.obj(i).linear_expr());
+}
+
+template <typename Problem, typename Encoder>
+void NLSegmentWriter<Problem, Encoder>::VisitCall(CallExpr e) {
+  Function f = e.function();
+  int index = 0, num_funcs = static_cast<int>(funcs_.size());
+  // Problems normally have few functions, so a linear search is fine.
+  while (index < num_funcs && funcs_[index] != f)
+    ++index;
+  MP_ASSERT(index < num_funcs, "unknown function");
+  out_.WriteCall(index, e.num_args());
+  for (CallExpr::iterator i = e.begin(), end = e.end(); i != end; ++i)
+    Visit(*i);
+}
+
+// Finds variables that appear in nonlinear parts of constraints and
+// objectives. Variables of a common expression are attributed to every
+// constraint and objective that references the expression.
+template <typename Problem>
+class NLVarCollector : public ExprVisitor<NLVarCollector<Problem>, void> {
+ private:
+  const Problem &problem_;
+
+  // Combinations of IN_CONS and IN_OBJS for variables and common
+  // expressions.
+  std::vector<int> var_flags_;
+  std::vector<int> expr_flags_;
+
+  // The flag of the expression being visited.
+  int flag_;
+
+  typedef ExprVisitor<NLVarCollector<Problem>, void> Base;
+
+  template <typename ExprType>
+  void VisitIfArgs(ExprType e) {
+    Visit(e.condition());
+    Visit(e.then_expr());
+    Visit(e.else_expr());
+  }
+
+  template <typename ExprType>
+  void VisitArgs(ExprType e) {
+    for (typename ExprType::iterator
+         i = e.begin(), end = e.end(); i != end; ++i) {
+      Visit(*i);
+    }
+  }
+
+ public:
+  enum { IN_CONS = 1, IN_OBJS = 2 };
+
+  explicit NLVarCollector(const Problem &p);
+
+  // Returns a combination of IN_CONS and IN_OBJS for a variable.
+  int flags(int var_index) const { return var_flags_[var_index]; }
+
+  using Base::Visit;
+
+  void VisitNumericConstant(NumericConstant) {}
+  void VisitVariable(Reference v) { var_flags_[v.index()] |= flag_; }
+  void VisitCommonExpr(Reference e);
+  void VisitUnary(UnaryExpr e) { Visit(e.arg()); }
+
+  void VisitBinary(BinaryExpr e) {
+    Visit(e.lhs());
+    Visit(e.rhs());
+  }
+
+  void VisitIf(IfExpr e) { VisitIfArgs(e); }
+  void VisitPLTerm(PLTerm e) { Visit(e.arg()); }
+  void VisitCall(CallExpr e) { VisitArgs(e); }
+  void VisitVarArg(IteratedExpr e) { VisitArgs(e); }
+  void VisitSum(IteratedExpr e) { VisitArgs(e); }
+  void VisitNumberOf(IteratedExpr e) { VisitArgs(e); }
+  void VisitNumberOfSym(SymbolicNumberOfExpr e) { VisitArgs(e); }
+  void VisitCount(CountExpr e) { VisitArgs(e); }
+  void VisitLogicalConstant(LogicalConstant) {}
+  void VisitNot(NotExpr e) { Visit(e.arg()); }
+
+  void VisitBinaryLogical(BinaryLogicalExpr e) {
+    Visit(e.lhs());
+    Visit(e.rhs());
+  }
+
+  void VisitRelational(RelationalExpr e) {
+    Visit(e.lhs());
+    Visit(e.rhs());
+  }
+
+  void VisitLogicalCount(LogicalCountExpr e) {
+    Visit(e.lhs());
+    VisitCount(e.rhs());
+  }
+
+  void VisitImplication(ImplicationExpr e) { VisitIfArgs(e); }
+  void VisitIteratedLogical(IteratedLogicalExpr e) { VisitArgs(e); }
+  void VisitAllDiff(PairwiseExpr e) { VisitArgs(e); }
+  void VisitNotAllDiff(PairwiseExpr e) { VisitArgs(e); }
+  void VisitStringLiteral(StringLiteral) {}
+  void VisitSymbolicIf(SymbolicIfExpr e) { VisitIfArgs(e); }
+};
+
+template <typename Problem>
+NLVarCollector<Problem>::NLVarCollector(const Problem &p)
+  : problem_(p), var_flags_(p.num_vars()),
+    expr_flags_(p.num_common_exprs()), flag_(IN_CONS) {
+  for (int i = 0, n = p.num_algebraic_cons(); i < n; ++i) {
+    NumericExpr e = p.algebraic_con(i).nonlinear_expr();
+    if (e)
+      Visit(e);
+  }
+  for (int i = 0, n = p.num_logical_cons(); i < n; ++i) {
+    LogicalExpr e = p.logical_con(i).expr();
+    if (e)
+      Visit(e);
+  }
+  flag_ = IN_OBJS;
+  for (int i = 0, n = p.num_objs(); i < n; ++i) {
+    NumericExpr e = p.obj(i).nonlinear_expr();
+    if (e)
+      Visit(e);
+  }
+}
+
+template <typename Problem>
+void NLVarCollector<Problem>::VisitCommonExpr(Reference e) {
+  int index = e.index();
+  if ((expr_flags_[index] & flag_) != 0)
+    return;
+  expr_flags_[index] |= flag_;
+  typename Problem::CommonExpr common_expr = problem_.common_expr(index);
+  const LinearExpr &linear = common_expr.linear_expr();
+  for (LinearExpr::iterator i = linear.begin(), end = linear.end();
+       i != end; ++i) {
+    var_flags_[i->var_index()] |= flag_;
+  }
+  NumericExpr nonlinear = common_expr.nonlinear_expr();
+  if (nonlinear)
+    Visit(nonlinear);
+}
+
+// A base class of NLWriter that formats chunks of output in parallel
+// and writes them to a file.
+class NLWriterBase {
+ protected:
+  // Output segment groups in the order in which they are written.
+  enum SegmentType {
+    FUNCS, SUFFIXES, COMMON_EXPRS, ALGEBRAIC_CONS, LOGICAL_CONS, OBJS,
+    DUAL_VALUES, INITIAL_VALUES, CON_BOUNDS, VAR_BOUNDS, COLUMN_SIZES,
+    LINEAR_CONS, LINEAR_OBJS
+  };
+
+  // A chunk of output containing items [start, end) of a segment group.
+  struct Chunk {
+    SegmentType type;
+    int start;
+    int end;
+
+    // Position of the formatted chunk in a buffer.
+    int buffer;
+    std::size_t offset;
+    std::size_t size;
+  };
+
+ private:
+  int num_threads_;
+  std::vector<Chunk> chunks_;
+
+  // Minimum number of items in a chunk.
+  enum { MIN_CHUNK_SIZE = 1024 };
+
+  class Formatter;
+
+ protected:
+  explicit NLWriterBase(int num_threads) : num_threads_(num_threads) {}
+  virtual ~NLWriterBase() {}
+
+  // Adds a chunk containing items [start, end) of a segment group.
+  void AddChunk(SegmentType type, int start, int end) {
+    Chunk chunk = {type, start, end, 0, 0, 0};
+    chunks_.push_back(chunk);
+  }
+
+  // Splits items [0, num_items) of a segment group into chunks.
+  void AddChunks(SegmentType type, int num_items);
+
+  // Formats a chunk.
+  virtual void Format(const Chunk &chunk, fmt::Writer &w) = 0;
+
+  // Formats all chunks and writes them after the header with a single
+  // vectored write if possible.
+  void Write(fmt::CStringRef filename, const NLHeader &header);
+};
+}  // namespace internal
+
+/**
+  \rst
+  An .nl writer. It writes a problem in the text or binary .nl format
+  that `mp::NLReader` accepts.
+
+  Segments are formatted in parallel into per-thread buffers which are then
+  written to the file with a single vectored write. Complementarity
+  conditions are not supported. Variables are written in the problem
+  order, so they should already be in the order that the .nl format
+  requires: variables that appear nonlinearly in both constraints and
+  objectives, just in constraints, just in objectives, and then linear
+  variables, with integer variables following continuous ones in each
+  group. The constructor throws `mp::Error` otherwise.
+  \endrst
+ */
+template <typename Problem>
+class NLWriter : private internal::NLWriterBase {
+ private:
+  const Problem &problem_;
+  NLHeader header_;
+  std::vector<Function> funcs_;
+
+  // Sets the numbers of nonlinear and integer variables in the header
+  // checking that variables are in the .nl order.
+  void SetVarCounts();
+
+  template <typename Encoder>
+  void DoFormat(const Chunk &chunk, fmt::Writer &w);
+
+  void Format(const Chunk &chunk, fmt::Writer &w) {
+    if (header_.format == NLHeader::BINARY)
+      DoFormat<internal::BinaryNLEncoder>(chunk, w);
+    else
+      DoFormat<internal::TextNLEncoder>(chunk, w);
+  }
+
+ public:
+  /**
+    \rst
+    Constructs a writer for the problem *p*. *num_threads* is the number of
+    threads used for formatting; if it is not positive, the number of
+    hardware threads is used.
+    \endrst
+   */
+  explicit NLWriter(const Problem &p, int num_threads = 0);
+
+  /** Returns the header of the output. */
+  const NLHeader &header() const { return header_; }
+
+  /** Writes the problem to a file in the specified format. */
+  void Write(fmt::CStringRef filename,
+             NLHeader::Format format = NLHeader::TEXT);
+};
+
+template <typename Problem>
+NLWriter<Problem>::NLWriter(const Problem &p, int num_threads)
+  : internal::NLWriterBase(num_threads), problem_(p) {
+  if (p.HasComplementarity())
+    throw MakeUnsupportedError("complementarity conditions");
+  NLHeader &h = header_;
+  h.num_vars = p.num_vars();
+  h.num_algebraic_cons = p.num_algebraic_cons();
+  h.num_objs = p.num_objs();
+  h.num_logical_cons = p.num_logical_cons();
+  h.num_common_exprs_in_both = p.num_common_exprs();
+  h.num_funcs = p.num_functions();
+  SetVarCounts();
+  double infinity = std::numeric_limits<double>::infinity();
+  for (int i = 0; i < h.num_algebraic_cons; ++i) {
+    typename Problem::AlgebraicCon con = p.algebraic_con(i);
+    if (con.lb() == con.ub())
+      ++h.num_eqns;
+    else if (con.lb() != -infinity && con.ub() != infinity)
+      ++h.num_ranges;
+    if (con.nonlinear_expr())
+      ++h.num_nl_cons;
+    h.num_con_nonzeros += con.linear_expr().num_terms();
+  }
+  for (int i = 0; i < h.num_objs; ++i) {
+    typename Problem::Objective obj = p.obj(i);
+    if (obj.nonlinear_expr())
+      ++h.num_nl_objs;
+    h.num_obj_nonzeros += obj.linear_expr().num_terms();
+  }
+  funcs_.reserve(h.num_funcs);
+  for (int i = 0; i < h.num_funcs; ++i)
+    funcs_.push_back(p.function(i));
+
+  AddChunks(FUNCS, h.num_funcs);
+  for (int i = 0; i < internal::NUM_SUFFIX_KINDS; ++i)
+    AddChunk(SUFFIXES, i, i + 1);
+  AddChunks(COMMON_EXPRS, p.num_common_exprs());
+  AddChunks(ALGEBRAIC_CONS, h.num_algebraic_cons);
+  AddChunks(LOGICAL_CONS, h.num_logical_cons);
+  AddChunks(OBJS, h.num_objs);
+  AddChunks(DUAL_VALUES, h.num_algebraic_cons);
+  AddChunks(INITIAL_VALUES, h.num_vars);
+  AddChunks(CON_BOUNDS, h.num_algebraic_cons);
+  // The b segment is required even if there are no variables.
+  if (h.num_vars != 0)
+    AddChunks(VAR_BOUNDS, h.num_vars);
+  else
+    AddChunk(VAR_BOUNDS, 0, 0);
+  if (h.num_algebraic_cons != 0 && h.num_vars != 0)
+    AddChunk(COLUMN_SIZES, 0, 0);
+  AddChunks(LINEAR_CONS, h.num_algebraic_cons);
+  AddChunks(LINEAR_OBJS, h.num_objs);
+}
+
+template <typename Problem>
+void NLWriter<Problem>::SetVarCounts() {
+  typedef internal::NLVarCollector<Problem> Collector;
+  Collector collector(problem_);
+  // Variable categories in the .nl order: nonlinear in both constraints
+  // and objectives, nonlinear just in constraints, nonlinear just in
+  // objectives and linear. Continuous variables precede integer ones in
+  // each category.
+  enum { BOTH, CONS, OBJS, LINEAR, NUM_CATEGORIES };
+  int counts[NUM_CATEGORIES][2] = {};
+  int prev_rank = 0;
+  for (int i = 0, n = problem_.num_vars(); i < n; ++i) {
+    int category = LINEAR;
+    switch (collector.flags(i)) {
+    case Collector::IN_CONS | Collector::IN_OBJS:
+      category = BOTH;
+      break;
+    case Collector::IN_CONS:
+      category = CONS;
+      break;
+    case Collector::IN_OBJS:
+      category = OBJS;
+      break;
+    }
+    int integer = problem_.var(i).type() == var::INTEGER ? 1 : 0;
+    int rank = category * 2 + integer;
+    if (rank < prev_rank) {
+      if (prev_rank / 2 == category)
+        throw Error("integer variables must follow continuous variables");
+      throw Error("variable {} is out of order: nonlinear variables must "
+                  "precede linear ones and be ordered by where they appear "
+                  "nonlinearly", i);
+    }
+    prev_rank = rank;
+    ++counts[category][integer];
+  }
+  NLHeader &h = header_;
+  h.num_nl_vars_in_both = counts[BOTH][0] + counts[BOTH][1];
+  h.num_nl_vars_in_cons =
+      h.num_nl_vars_in_both + counts[CONS][0] + counts[CONS][1];
+  // The first num_nl_vars_in_objs variables are treated as nonlinear in
+  // objectives, so variables nonlinear just in objectives follow all
+  // variables nonlinear in constraints.
+  int num_obj_only_vars = counts[OBJS][0] + counts[OBJS][1];
+  h.num_nl_vars_in_objs = num_obj_only_vars != 0 ?
+        h.num_nl_vars_in_cons + num_obj_only_vars : h.num_nl_vars_in_both;
+  h.num_nl_integer_vars_in_both = counts[BOTH][1];
+  h.num_nl_integer_vars_in_cons = counts[CONS][1];
+  h.num_nl_integer_vars_in_objs = counts[OBJS][1];
+  h.num_linear_integer_vars = counts[LINEAR][1];
+}
+
+template <typename Problem>
+template <typename Encoder>
+void NLWriter<Problem>::DoFormat(const Chunk &chunk, fmt::Writer &w) {
+  internal::NLSegmentWriter<Problem, Encoder> writer(problem_, funcs_, w);
+  int start = chunk.start, end = chunk.end;
+  switch (chunk.type) {
+  case FUNCS:
+    writer.WriteFuncs(start, end);
+    break;
+  case SUFFIXES:
+    writer.WriteSuffixes(static_cast<suf::Kind>(start));
+    break;
+  case COMMON_EXPRS:
+    writer.WriteCommonExprs(start, end);
+    break;
+  case ALGEBRAIC_CONS:
+    writer.WriteAlgebraicCons(start, end);
+    break;
+  case LOGICAL_CONS:
+    writer.WriteLogicalCons(start, end);
+    break;
+  case OBJS:
+    writer.WriteObjs(start, end);
+    break;
+  case DUAL_VALUES: case INITIAL_VALUES: {
+    // Count the values to write because the segment starts with the count.
+    int num_values = 0;
+    if (start == 0) {
+      bool dual = chunk.type == DUAL_VALUES;
+      int n = dual ? problem_.num_algebraic_cons() : problem_.num_vars();
+      for (int i = 0; i < n; ++i) {
+        double value = dual ?
+              problem_.algebraic_con(i).dual() : problem_.var(i).value();
+        if (value != 0)
+          ++num_values;
+      }
+      if (num_values == 0)
+        break;
+    }
+    writer.WriteInitialValues(chunk.type == DUAL_VALUES ? 'd' : 'x',
+                              num_values, start, end);
+    break;
+  }
+  case CON_BOUNDS:
+    writer.WriteConBounds(start, end);
+    break;
+  case VAR_BOUNDS:
+    writer.WriteVarBounds(start, end);
+    break;
+  case COLUMN_SIZES:
+    writer.WriteColumnSizes();
+    break;
+  case LINEAR_CONS:
+    writer.WriteLinearCons(start, end);
+    break;
+  case LINEAR_OBJS:
+    writer.WriteLinearObjs(start, end);
+    break;
+  }
+}
+
+template <typename Problem>
+void NLWriter<Problem>::Write(fmt::CStringRef filename,
+                              NLHeader::Format format) {
+  header_.format = format;
+  header_.arith_kind =
+      format == NLHeader::BINARY ? arith::GetKind() : arith::UNKNOWN;
+  internal::NLWriterBase::Write(filename, header_);
+}
+
+/**
+  \rst
+  Writes an optimization problem to a file in the specified .nl format.
+  \endrst
+ */
+template <typename Problem>
+inline void WriteNLFile(fmt::CStringRef filename, const Problem &p,
+                        NLHeader::Format format = NLHeader::TEXT) {
+  NLWriter<Problem>(p).Write(filename, format);
+}
+}  // namespace mp
+
+#endif  // MP_NL_WRITER_H_
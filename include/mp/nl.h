@@ -25,6 +25,7 @@
 
 #include "mp/error.h"   // MP_ASSERT
 #include "mp/format.h"  // fmt::CStringRef
+#include "mp/posix.h"   // fmt::File
 
 #include <cstring>  // std::strlen, std::size_t
 #include <string>   // std::string
@@ -68,7 +69,13 @@ class NLStringRef {
 // Flags for ReadNLFile and ReadNLString.
 enum {
   /** Read variable bounds before anything else. */
-  READ_BOUNDS_FIRST = 1
+  READ_BOUNDS_FIRST = 1,
+
+  /**
+    Parse segments of a text input on multiple threads. The handler is
+    still called from the calling thread in the input order.
+   */
+  READ_PARALLEL = 2
 };
 
 /**
@@ -86,7 +93,8 @@ enum {
   *flags* can be either 0, which is the default, to read all constructs in
   the order they appear in the input, or `mp::READ_BOUNDS_FIRST` to read
   variable bounds after the NL header and before other constructs such as
-  nonlinear expressions.
+  nonlinear expressions. `mp::READ_PARALLEL` can be combined with the above
+  to parse a text input on multiple threads.
   \endrst
  */
 template <typename Handler>
@@ -107,7 +115,8 @@ void ReadNLString(NLStringRef str, Handler &handler,
   *flags* can be either 0, which is the default, to read all constructs in
   the order they appear in the input, or `mp::READ_BOUNDS_FIRST` to read
   variable bounds after the NL header and before other constructs such as
-  nonlinear expressions.
+  nonlinear expressions. `mp::READ_PARALLEL` can be combined with the above
+  to parse a text input on multiple threads.
 
   **Example**::
 
@@ -127,6 +136,32 @@ void ReadNLString(NLStringRef str, Handler &handler,
  */
 template <typename Handler>
 void ReadNLFile(fmt::CStringRef filename, Handler &handler, int flags = 0);
+
+/**
+  \rst
+  Reads an optimization problem in the NL format from *file* which can be
+  a pipe or standard input and sends notifications of the problem components
+  to the *handler* object as `mp::ReadNLFile` does.
+
+  The input is read in blocks, on a background thread if threads are
+  enabled, and parsed in chunks of complete segments as soon as they arrive.
+  Memory usage is proportional to the size of the largest segment rather
+  than to the size of the input, and reading overlaps with producing the
+  input on the other end of a pipe. The *name* argument is used as the name
+  of the input when reporting errors. `mp::READ_PARALLEL` is ignored and
+  `mp::READ_BOUNDS_FIRST` keeps the input preceding the variable bounds
+  in memory until the bounds are read.
+
+  **Example**::
+
+    fmt::File in = fmt::File::dup(0);  // Standard input.
+    mp::Problem p;
+    mp::ReadNLStream(in, p);
+  \endrst
+ */
+template <typename Handler>
+void ReadNLStream(fmt::File &file, Handler &handler,
+                  fmt::CStringRef name = "(stdin)", int flags = 0);
 }  // namespace mp
 
 #endif  // MP_NL_
@@ -26,6 +26,8 @@
 #include "mp/error.h"
 #include "mp/posix.h"
 
+#include <functional>
+
 namespace mp {
 
 // This class provides a subset of boost filesystem's path API.
@@ -77,27 +79,86 @@ class path {
 // Throws Error on error.
 path GetExecutablePath();
 
+namespace internal {
+// Calls task(i) for each i in [0, num_tasks), every call on its own thread
+// except task(0) which is called on the current thread. Returns when all
+// started threads have been joined, even if a task or a thread creation
+// throws, and then rethrows the exception of the task with the smallest
+// index. Calls the tasks sequentially if threads are not supported.
+void RunInParallel(int num_tasks, const std::function<void (int)> &task);
+}
+
+// Hints about how a memory-mapped file will be accessed. The hints can be
+// combined with bitwise OR and are ignored where not supported.
+namespace map_hint {
+enum {
+  // Pages are accessed sequentially so they can be read ahead aggressively.
+  SEQUENTIAL = 1,
+  // Read the whole file into memory when mapping it.
+  POPULATE   = 2,
+  // Back the mapping with transparent huge pages.
+  HUGE_PAGES = 4,
+  // Touch the file sequentially from the start on a background thread,
+  // starting read-ahead one window ahead of the thread. The thread
+  // doesn't track the position of the reader.
+  PREFETCH   = 8
+};
+}
+
+// Statistics of a memory-mapped file.
+struct MappedFileStats {
+  // The numbers of minor and major page faults in the process since
+  // the file has been mapped.
+  long num_minor_faults;
+  long num_major_faults;
+
+  // Time in seconds spent mapping the file including populating it.
+  double map_time;
+
+  // Time in seconds spent on the prefetch thread.
+  double prefetch_time;
+
+  MappedFileStats()
+    : num_minor_faults(0), num_major_faults(0), map_time(0), prefetch_time(0) {}
+};
+
 namespace internal {
 class MemoryMappedFileBase {
  private:
   char *start_;
   std::size_t size_;
+  double map_time_;
+  long minor_faults_;  // Minor page faults at the time of mapping.
+  long major_faults_;  // Major page faults at the time of mapping.
+
+  class Prefetcher;
+  Prefetcher *prefetcher_;
 
   FMT_DISALLOW_COPY_AND_ASSIGN(MemoryMappedFileBase);
 
  protected:
-  MemoryMappedFileBase() : start_(), size_(0) {}
+  MemoryMappedFileBase()
+    : start_(), size_(0), map_time_(0), minor_faults_(0), major_faults_(0),
+      prefetcher_(0) {}
   ~MemoryMappedFileBase() {
     if (start_)
       unmap();
   }
 
-  void map(int fd, std::size_t size);
+  // Maps size bytes of the file with the descriptor fd. hints is
+  // a combination of map_hint flags.
+  void map(int fd, std::size_t size, int hints = 0);
   void unmap();
 
  public:
+  // The size of the window the prefetch thread reads ahead of itself.
+  enum { PREFETCH_WINDOW_SIZE = 4 << 20 };
+
   const char *start() const { return start_; }
   std::size_t size() const { return size_; }
+
+  // Returns the statistics of the current mapping.
+  MappedFileStats stats() const;
 };
 
 // Converts file size to mmap size.
@@ -117,18 +178,18 @@ template <typename File = fmt::File>
 class MemoryMappedFile : public internal::MemoryMappedFileBase {
  public:
   MemoryMappedFile() {}
-  MemoryMappedFile(const File &file, std::size_t size) {
-    internal::MemoryMappedFileBase::map(file.descriptor(), size);
+  MemoryMappedFile(const File &file, std::size_t size, int hints = 0) {
+    internal::MemoryMappedFileBase::map(file.descriptor(), size, hints);
   }
 
-  void map(const File &file, std::size_t size) {
+  void map(const File &file, std::size_t size, int hints = 0) {
     if (start())
       unmap();
-    internal::MemoryMappedFileBase::map(file.descriptor(), size);
+    internal::MemoryMappedFileBase::map(file.descriptor(), size, hints);
   }
 
-  void map(const File &file, fmt::CStringRef filename) {
-    map(file, internal::ConvertFileToMmapSize(file.size(), filename));
+  void map(const File &file, fmt::CStringRef filename, int hints = 0) {
+    map(file, internal::ConvertFileToMmapSize(file.size(), filename), hints);
   }
 };
 
@@ -23,6 +23,7 @@
 #ifndef MP_PROBLEM_BUILDER_H_
 #define MP_PROBLEM_BUILDER_H_
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <memory>
@@ -415,6 +416,23 @@ class ProblemBuilder : public SuffixManager {
   }
 };
 
+class SPAdapter;
+
+namespace internal {
+// Transposes a compressed sparse matrix given by *starts*, *indices* and
+// *values* with *major_size* major vectors into *t_starts*, *t_indices* and
+// *t_values* with *minor_size* major vectors. The output arrays must be
+// preallocated. Elements of each transposed vector are ordered by their
+// major index in the original matrix, so the result doesn't depend on
+// *num_threads*. If *num_threads* is zero or negative, the number of
+// hardware threads is used. This function is instantiated for double values.
+template <typename T>
+void Transpose(int major_size, int minor_size,
+               const int *starts, const int *indices, const T *values,
+               int *t_starts, int *t_indices, T *t_values,
+               int num_threads = 0);
+}
+
 // An optimization problem with a column-wise constraint matrix.
 class ColProblem : public Problem {
  private:
@@ -423,11 +441,21 @@ class ColProblem : public Problem {
   std::vector<int> row_indices_;
   std::vector<double> coefs_;
 
+  // Optional row-wise constraint matrix.
+  bool build_rows_;
+  std::vector<int> row_starts_;
+  std::vector<int> col_indices_;
+  std::vector<double> row_coefs_;
+
   friend class ColProblemBuilder;
 
+  // SPAdapter fills preallocated blocks of the matrix of a deterministic
+  // equivalent on multiple threads.
+  friend class SPAdapter;
+
  public:
-  ColProblem() {}
-  explicit ColProblem(const Solver &) {}
+  ColProblem() : build_rows_(false) {}
+  explicit ColProblem(const Solver &) : build_rows_(false) {}
 
   int col_start(int col_index) const { return col_starts_[col_index]; }
   int row_index(int elt_index) const { return row_indices_[elt_index]; }
@@ -437,19 +465,54 @@ class ColProblem : public Problem {
   const int *row_indices() const { return row_indices_.data(); }
   const double *values() const { return coefs_.data(); }
 
+  // Requests the row-wise constraint matrix to be built together with
+  // the column-wise one when the problem is read.
+  void set_build_rows(bool build_rows) { build_rows_ = build_rows; }
+
+  // Returns true if the row-wise constraint matrix has been built.
+  bool has_rows() const { return !row_starts_.empty(); }
+
+  int row_start(int row_index) const { return row_starts_[row_index]; }
+  int col_index(int elt_index) const { return col_indices_[elt_index]; }
+  double row_value(int elt_index) const { return row_coefs_[elt_index]; }
+
+  const int *row_starts() const { return row_starts_.data(); }
+  const int *col_indices() const { return col_indices_.data(); }
+  const double *row_values() const { return row_coefs_.data(); }
+
   // Returns the built problem. This is used for compatibility with the problem
   // builder API.
   ColProblem &problem() { return *this; }
 };
 
 // An NL handler that builds a problem with a column-wise constraint matrix.
+// If requested with ColProblem::set_build_rows, the row-wise matrix is filled
+// in the same pass over the J segments: column starts come from the 'k'
+// segment and row starts from the sizes of J segments which normally appear
+// in the order of constraints. Out-of-order segments are handled by
+// transposing the column-wise matrix at the end of input.
 class ColProblemBuilder : public internal::NLProblemBuilder<ColProblem> {
  private:
   typedef internal::NLProblemBuilder<ColProblem> Base;
 
+  // The number of rows with known starts.
+  int num_rows_;
+  bool rows_in_order_;
+
+  // Builds the row-wise matrix by transposing the column-wise one.
+  void TransposeColumns() {
+    ColProblem &p = builder();
+    internal::Transpose(static_cast<int>(p.col_starts_.size()) - 1,
+                        static_cast<int>(p.row_starts_.size()) - 1,
+                        p.col_starts_.data(), p.row_indices_.data(),
+                        p.coefs_.data(), p.row_starts_.data(),
+                        p.col_indices_.data(), p.row_coefs_.data());
+  }
+
  public:
   explicit ColProblemBuilder(ColProblem &p)
-    : internal::NLProblemBuilder<ColProblem>(p) {}
+    : internal::NLProblemBuilder<ColProblem>(p),
+      num_rows_(0), rows_in_order_(true) {}
 
   void OnHeader(const NLHeader &h) {
     Base::OnHeader(h);
@@ -458,6 +521,11 @@ class ColProblemBuilder : public internal::NLProblemBuilder<ColProblem> {
     problem.col_starts_.resize(2);
     problem.row_indices_.resize(h.num_con_nonzeros);
     problem.coefs_.resize(h.num_con_nonzeros);
+    if (problem.build_rows_) {
+      problem.row_starts_.assign(h.num_algebraic_cons + 1, 0);
+      problem.col_indices_.resize(h.num_con_nonzeros);
+      problem.row_coefs_.resize(h.num_con_nonzeros);
+    }
   }
 
   class ColumnSizeHandler {
@@ -483,25 +551,59 @@ class ColProblemBuilder : public internal::NLProblemBuilder<ColProblem> {
    private:
     ColProblem *problem_;
     int con_index_;
+    int row_elt_index_;  // Index of the next row element or -1 if none.
 
     friend class ColProblemBuilder;
 
-    LinearConHandler(ColProblem &p, int con_index)
-      : problem_(&p), con_index_(con_index) {}
+    LinearConHandler(ColProblem &p, int con_index, int row_elt_index)
+      : problem_(&p), con_index_(con_index), row_elt_index_(row_elt_index) {}
 
    public:
     void AddTerm(int var_index, double coef) {
       int index = problem_->col_starts_[var_index + 1]++;
       problem_->row_indices_[index] = con_index_;
       problem_->coefs_[index] = coef;
+      if (row_elt_index_ >= 0) {
+        problem_->col_indices_[row_elt_index_] = var_index;
+        problem_->row_coefs_[row_elt_index_++] = coef;
+      }
     }
   };
 
-  LinearConHandler OnLinearConExpr(int con_index, int) {
+  LinearConHandler OnLinearConExpr(int con_index, int num_terms) {
     // Pass zero as the number of linear terms as we store constraints
     // column-wise rather than row-wise.
     Base::OnLinearConExpr(con_index, 0);
-    return LinearConHandler(builder(), con_index);
+    ColProblem &problem = builder();
+    if (!problem.has_rows() || !rows_in_order_)
+      return LinearConHandler(problem, con_index, -1);
+    if (con_index < num_rows_) {
+      rows_in_order_ = false;
+      return LinearConHandler(problem, con_index, -1);
+    }
+    // Rows between the last one and con_index are empty.
+    std::vector<int> &starts = problem.row_starts_;
+    for (int i = num_rows_ + 1; i <= con_index; ++i)
+      starts[i] = starts[num_rows_];
+    starts[con_index + 1] = starts[con_index] + num_terms;
+    num_rows_ = con_index + 1;
+    return LinearConHandler(problem, con_index, starts[con_index]);
+  }
+
+  void EndInput() {
+    Base::EndInput();
+    ColProblem &problem = builder();
+    if (!problem.has_rows())
+      return;
+    if (!rows_in_order_) {
+      TransposeColumns();
+      return;
+    }
+    std::vector<int> &starts = problem.row_starts_;
+    for (int i = num_rows_ + 1, n = static_cast<int>(starts.size());
+         i < n; ++i) {
+      starts[i] = starts[num_rows_];
+    }
   }
 };
 }  // namespace mp
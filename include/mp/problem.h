@@ -23,7 +23,10 @@
 #ifndef MP_PROBLEM_H_
 #define MP_PROBLEM_H_
 
+#include <algorithm>
 #include <cstddef>  // for std::size_t
+#include <cstring>
+#include <iterator>
 #include <limits>
 #include <vector>
 
@@ -38,8 +41,14 @@
 
 namespace mp {
 
+// A linear expression.
+// Variable indices and coefficients are stored in separate arrays which
+// either belong to the expression or refer to a part of a larger block
+// such as the compressed sparse row (CSR) storage of linear constraints
+// in BasicProblem. In the latter case the expression is a view that
+// becomes owning when it is modified.
 class LinearExpr {
- private:
+ public:
   class Term {
    private:
     int var_index_;
@@ -53,26 +62,336 @@ class LinearExpr {
     int var_index() const { return var_index_; }
     double coef() const { return coef_; }
   };
-  std::vector<Term> terms_;
+
+ private:
+  int *indices_;
+  double *coefs_;
+  int num_terms_;
+
+  // Capacity of the owned arrays or -1 if the expression is a view.
+  int capacity_;
+
+  template <typename Alloc>
+  friend class BasicProblem;
+
+  // Constructs a view of terms stored elsewhere.
+  LinearExpr(const int *indices, const double *coefs, int num_terms)
+    : indices_(const_cast<int*>(indices)), coefs_(const_cast<double*>(coefs)),
+      num_terms_(num_terms), capacity_(-1) {}
+
+  // Returns a view of the terms of this expression.
+  LinearExpr view() const {
+    return LinearExpr(indices_, coefs_, num_terms_);
+  }
+
+  // Reallocates arrays to hold capacity terms making the expression owning.
+  void Reallocate(int capacity);
 
  public:
-  int num_terms() const { return static_cast<int>(terms_.size()); }
-  int capacity() const { return static_cast<int>(terms_.capacity()); }
+  LinearExpr() : indices_(), coefs_(), num_terms_(0), capacity_(0) {}
+
+  LinearExpr(const LinearExpr &other)
+    : indices_(), coefs_(), num_terms_(0), capacity_(0) {
+    *this = other;
+  }
+
+#if FMT_USE_RVALUE_REFERENCES
+  LinearExpr(LinearExpr &&other) FMT_NOEXCEPT
+    : indices_(other.indices_), coefs_(other.coefs_),
+      num_terms_(other.num_terms_), capacity_(other.capacity_) {
+    other.indices_ = 0;
+    other.coefs_ = 0;
+    other.num_terms_ = other.capacity_ = 0;
+  }
+
+  LinearExpr &operator=(LinearExpr &&other) FMT_NOEXCEPT {
+    swap(other);
+    return *this;
+  }
+#endif
+
+  ~LinearExpr() {
+    if (capacity_ > 0)
+      operator delete(coefs_);
+  }
+
+  LinearExpr &operator=(const LinearExpr &other);
+
+  void swap(LinearExpr &other) {
+    std::swap(indices_, other.indices_);
+    std::swap(coefs_, other.coefs_);
+    std::swap(num_terms_, other.num_terms_);
+    std::swap(capacity_, other.capacity_);
+  }
 
-  typedef std::vector<Term>::const_iterator iterator;
+  int num_terms() const { return num_terms_; }
+  int capacity() const { return capacity_ >= 0 ? capacity_ : num_terms_; }
 
-  iterator begin() const { return terms_.begin(); }
-  iterator end() const { return terms_.end(); }
+  class iterator : public std::iterator<std::forward_iterator_tag, Term> {
+   private:
+    const int *index_;
+    const double *coef_;
+    mutable Term term_;
+
+    friend class LinearExpr;
+
+    iterator(const int *index, const double *coef)
+      : index_(index), coef_(coef), term_(0, 0) {}
+
+   public:
+    iterator() : index_(), coef_(), term_(0, 0) {}
+
+    const Term *operator->() const {
+      term_ = Term(*index_, *coef_);
+      return &term_;
+    }
+
+    Term operator*() const { return Term(*index_, *coef_); }
+
+    iterator &operator++() {
+      ++index_;
+      ++coef_;
+      return *this;
+    }
+
+    iterator operator++(int ) {
+      iterator it(*this);
+      ++*this;
+      return it;
+    }
+
+    bool operator==(iterator other) const { return index_ == other.index_; }
+    bool operator!=(iterator other) const { return index_ != other.index_; }
+  };
+
+  iterator begin() const { return iterator(indices_, coefs_); }
+  iterator end() const {
+    return iterator(indices_ + num_terms_, coefs_ + num_terms_);
+  }
 
   void AddTerm(int var_index, double coef) {
-    terms_.push_back(Term(var_index, coef));
+    // A view has negative capacity so it is always reallocated here.
+    if (num_terms_ >= capacity_)
+      Reallocate(num_terms_ != 0 ? 2 * num_terms_ : 1);
+    indices_[num_terms_] = var_index;
+    coefs_[num_terms_] = coef;
+    ++num_terms_;
   }
 
   void Reserve(int num_terms) {
-    terms_.reserve(num_terms);
+    if (num_terms > capacity_)
+      Reallocate(num_terms > num_terms_ ? num_terms : num_terms_);
+  }
+
+  // Adds num_terms terms with unspecified variable indices and coefficients
+  // and returns pointers to them in indices and coefs for the caller to
+  // fill in. The pointers are valid until the expression is modified.
+  void AddTerms(int num_terms, int *&indices, double *&coefs) {
+    int new_size = num_terms_ + num_terms;
+    if (new_size > capacity_)
+      Reallocate(new_size);
+    indices = indices_ + num_terms_;
+    coefs = coefs_ + num_terms_;
+    num_terms_ = new_size;
+  }
+
+  // Returns the position of the term with the specified variable index or
+  // -1 if there is no such term.
+  int FindTerm(int var_index) const {
+    for (int i = 0; i < num_terms_; ++i) {
+      if (indices_[i] == var_index)
+        return i;
+    }
+    return -1;
   }
+
+  // Sets the coefficient of a variable adding a term if the variable
+  // doesn't appear in the expression.
+  void SetCoef(int var_index, double coef) {
+    int position = FindTerm(var_index);
+    if (position < 0) {
+      AddTerm(var_index, coef);
+      return;
+    }
+    if (capacity_ < 0)
+      Reallocate(num_terms_);  // Make a view owning before modifying it.
+    coefs_[position] = coef;
+  }
+};
+
+inline void LinearExpr::Reallocate(int capacity) {
+  MP_ASSERT(capacity >= num_terms_, "invalid capacity");
+  if (capacity == 0) {
+    *this = LinearExpr();
+    return;
+  }
+  // Store coefficients first to keep them aligned.
+  double *coefs = static_cast<double*>(
+        operator new(capacity * (sizeof(double) + sizeof(int))));
+  int *indices = reinterpret_cast<int*>(coefs + capacity);
+  if (num_terms_ != 0) {
+    std::memcpy(coefs, coefs_, num_terms_ * sizeof(double));
+    std::memcpy(indices, indices_, num_terms_ * sizeof(int));
+  }
+  if (capacity_ > 0)
+    operator delete(coefs_);
+  indices_ = indices;
+  coefs_ = coefs;
+  capacity_ = capacity;
+}
+
+inline LinearExpr &LinearExpr::operator=(const LinearExpr &other) {
+  if (this == &other)
+    return *this;
+  num_terms_ = 0;
+  if (capacity_ < other.num_terms_)
+    Reallocate(other.num_terms_);
+  if (other.num_terms_ != 0) {
+    std::memcpy(coefs_, other.coefs_, other.num_terms_ * sizeof(double));
+    std::memcpy(indices_, other.indices_, other.num_terms_ * sizeof(int));
+  }
+  num_terms_ = other.num_terms_;
+  return *this;
+}
+
+// A sparse matrix in compressed sparse column (CSC) format.
+class CSCMatrix {
+ private:
+  std::vector<int> col_starts_;
+  std::vector<int> row_indices_;
+  std::vector<double> values_;
+
+  template <typename Alloc>
+  friend class BasicProblem;
+
+ public:
+  int num_cols() const {
+    return col_starts_.empty() ? 0 : static_cast<int>(col_starts_.size() - 1);
+  }
+  int num_elements() const { return static_cast<int>(values_.size()); }
+
+  int col_start(int col_index) const { return col_starts_[col_index]; }
+  int row_index(int elt_index) const { return row_indices_[elt_index]; }
+  double value(int elt_index) const { return values_[elt_index]; }
+
+  const int *col_starts() const { return col_starts_.data(); }
+  const int *row_indices() const { return row_indices_.data(); }
+  const double *values() const { return values_.data(); }
+};
+
+/** A change to a problem recorded in the change journal. */
+struct ProblemChange {
+  /** Kind of a change. */
+  enum Kind {
+    /** A lower bound on the variable *index*. */
+    VAR_LB,
+    /** An upper bound on the variable *index*. */
+    VAR_UB,
+    /** A lower bound on the algebraic constraint *index*. */
+    CON_LB,
+    /** An upper bound on the algebraic constraint *index*. */
+    CON_UB,
+    /** A coefficient of *var_index* in the linear part of objective *index*. */
+    OBJ_COEF,
+    /**
+      A coefficient of *var_index* in the linear part of algebraic
+      constraint *index*.
+     */
+    CON_COEF
+  };
+
+  Kind kind;
+  int index;
+  int var_index;  // Variable index for coefficient changes, -1 otherwise.
+  double value;
 };
 
+/**
+  \rst
+  A set of changes to bounds and linear coefficients that defines
+  a variant (scenario) of a problem. Only the changes are stored so many
+  overlays of the same base problem take little memory.
+
+  `mp::ProblemOverlay` provides the handler interface of
+  `mp::BasicProblem::ReplayChanges` so changes recorded in a change journal
+  can be collected in an overlay::
+
+    mp::ProblemOverlay overlay;
+    problem.ReplayChanges(overlay);
+  \endrst
+ */
+class ProblemOverlay {
+ private:
+  std::vector<ProblemChange> changes_;
+
+  void Add(ProblemChange::Kind kind, int index, double value,
+           int var_index = -1) {
+    MP_ASSERT(index >= 0 && var_index >= -1, "invalid index");
+    ProblemChange change = {kind, index, var_index, value};
+    changes_.push_back(change);
+  }
+
+ public:
+  void SetVarLB(int var_index, double lb) {
+    Add(ProblemChange::VAR_LB, var_index, lb);
+  }
+  void SetVarUB(int var_index, double ub) {
+    Add(ProblemChange::VAR_UB, var_index, ub);
+  }
+  void SetConLB(int con_index, double lb) {
+    Add(ProblemChange::CON_LB, con_index, lb);
+  }
+  void SetConUB(int con_index, double ub) {
+    Add(ProblemChange::CON_UB, con_index, ub);
+  }
+  void SetObjCoef(int obj_index, int var_index, double coef) {
+    Add(ProblemChange::OBJ_COEF, obj_index, coef, var_index);
+  }
+  void SetConCoef(int con_index, int var_index, double coef) {
+    Add(ProblemChange::CON_COEF, con_index, coef, var_index);
+  }
+
+  /** Returns the number of changes. */
+  int num_changes() const { return static_cast<int>(changes_.size()); }
+
+  /** Returns the change at the specified index. */
+  const ProblemChange &change(int index) const {
+    internal::CheckIndex(index, num_changes());
+    return changes_[index];
+  }
+
+  /** Applies the changes to a problem in the order they were added. */
+  template <typename Problem>
+  void Apply(Problem &p) const;
+};
+
+template <typename Problem>
+void ProblemOverlay::Apply(Problem &p) const {
+  for (std::size_t i = 0, n = changes_.size(); i != n; ++i) {
+    const ProblemChange &c = changes_[i];
+    switch (c.kind) {
+    case ProblemChange::VAR_LB:
+      p.var(c.index).set_lb(c.value);
+      break;
+    case ProblemChange::VAR_UB:
+      p.var(c.index).set_ub(c.value);
+      break;
+    case ProblemChange::CON_LB:
+      p.algebraic_con(c.index).set_lb(c.value);
+      break;
+    case ProblemChange::CON_UB:
+      p.algebraic_con(c.index).set_ub(c.value);
+      break;
+    case ProblemChange::OBJ_COEF:
+      p.obj(c.index).set_coef(c.var_index, c.value);
+      break;
+    case ProblemChange::CON_COEF:
+      p.algebraic_con(c.index).set_coef(c.var_index, c.value);
+      break;
+    }
+  }
+}
+
 class Solver;
 
 /** An optimization problem. */
@@ -87,14 +406,76 @@ class BasicProblem : public ExprFactory, public SuffixManager {
   typedef mp::Reference Reference;
   typedef internal::ExprTypes ExprTypes;
 
+  /** Storage of linear parts of algebraic constraints. */
+  enum LinearConStorage {
+    /** Each constraint owns a separate linear expression. */
+    LINEAR_CON_EXPRS,
+    /**
+      Linear parts of all constraints are stored in a single block in
+      compressed sparse row (CSR) format. This avoids an allocation per
+      constraint and reduces memory usage for problems with many constraints.
+     */
+    LINEAR_CON_CSR
+  };
+
  private:
-  // A variable.
-  struct Var {
+  // Lower and upper bounds on a variable or an algebraic constraint.
+  struct Bounds {
     double lb;
     double ub;
-    Var(double lb, double ub) : lb(lb), ub(ub) {}
+    Bounds(double lb, double ub) : lb(lb), ub(ub) {}
+  };
+
+  // An array of bounds that refers to the array of a base problem until
+  // it is modified, so that overlays (see ShareFrom) only copy bounds when
+  // they change.
+  class BoundsArray {
+   private:
+    std::vector<Bounds> data_;
+    const std::vector<Bounds> *shared_;  // Shared bounds or null if owned.
+
+    const std::vector<Bounds> &get() const {
+      return shared_ ? *shared_ : data_;
+    }
+
+    // Copies shared bounds into this array.
+    std::vector<Bounds> &own() {
+      if (shared_) {
+        data_.reserve(shared_->capacity());
+        data_ = *shared_;
+        shared_ = 0;
+      }
+      return data_;
+    }
+
+   public:
+    BoundsArray() : shared_(0) {}
+
+    // Makes this array refer to the bounds of another one.
+    void Share(const BoundsArray &other) {
+      data_.clear();
+      shared_ = &other.get();
+    }
+
+    bool empty() const { return get().empty(); }
+    std::size_t size() const { return get().size(); }
+    std::size_t capacity() const { return get().capacity(); }
+
+    const Bounds &operator[](std::size_t index) const {
+      return get()[index];
+    }
+
+    // Returns a mutable reference to the bounds at the specified index
+    // copying shared bounds first.
+    Bounds &mut(std::size_t index) { return own()[index]; }
+
+    void reserve(std::size_t size) { own().reserve(size); }
+    void push_back(Bounds b) { own().push_back(b); }
+    void resize(std::size_t size, Bounds b) { own().resize(size, b); }
   };
-  std::vector<Var> vars_;
+
+  // Variable bounds.
+  BoundsArray vars_;
 
   // Packed variable type information.
   // is_var_int_[i] specifies whether variable i is integer.
@@ -117,13 +498,29 @@ class BasicProblem : public ExprFactory, public SuffixManager {
     // Nonlinear parts are stored in nonlinear_cons_ to avoid overhead
     // for linear problems.
     LinearExpr linear_expr;
-    double lb;
-    double ub;
-    AlgebraicConInfo() : lb(0), ub(0) {}
-    AlgebraicConInfo(double lb, double ub) : lb(lb), ub(ub) {}
   };
   std::vector<AlgebraicConInfo> algebraic_cons_;
 
+  // Algebraic constraint bounds.
+  BoundsArray con_bounds_;
+
+  LinearConStorage linear_con_storage_;
+
+  // Linear parts of algebraic constraints in CSR format with explicit row
+  // sizes used instead of AlgebraicConInfo::linear_expr if
+  // linear_con_storage_ is LINEAR_CON_CSR. Terms of constraint i occupy
+  // positions from linear_con_starts_[i] to
+  // linear_con_starts_[i] + linear_con_sizes_[i] (exclusive) in
+  // linear_con_indices_ and linear_con_coefs_. Constraints normally occupy
+  // consecutive parts of the block, but a constraint modified after
+  // other constraints is moved to the end leaving its old terms unused
+  // until the block is compacted.
+  std::vector<int> linear_con_starts_;
+  std::vector<int> linear_con_sizes_;
+  std::vector<int> linear_con_indices_;
+  std::vector<double> linear_con_coefs_;
+  std::size_t num_unused_linear_con_terms_;
+
   // Information about complementarity conditions.
   // compl_vars_[i] > 0 means constraint i complements variable
   // compl_vars_[i] - 1. The array can be empty if there are no
@@ -149,6 +546,18 @@ class BasicProblem : public ExprFactory, public SuffixManager {
   // Initial values for dual variables.
   std::vector<double> initial_dual_values_;
 
+  // Change journal which is only filled if record_changes_ is true.
+  bool record_changes_;
+  std::vector<ProblemChange> changes_;
+
+  void RecordChange(ProblemChange::Kind kind, int index, double value,
+                    int var_index = -1) {
+    if (!record_changes_)
+      return;
+    ProblemChange change = {kind, index, var_index, value};
+    changes_.push_back(change);
+  }
+
   void SetNonlinearObjExpr(int obj_index, NumericExpr expr) {
     internal::CheckIndex(obj_index, linear_objs_.size());
     if (nonlinear_objs_.size() <= static_cast<std::size_t>(obj_index))
@@ -163,6 +572,64 @@ class BasicProblem : public ExprFactory, public SuffixManager {
     nonlinear_cons_[con_index] = expr;
   }
 
+  // Returns the linear part of an algebraic constraint expression.
+  LinearExpr GetLinearConExpr(int con_index) const {
+    if (linear_con_storage_ == LINEAR_CON_EXPRS)
+      return algebraic_cons_[con_index].linear_expr.view();
+    int start = linear_con_starts_[con_index];
+    return LinearExpr(linear_con_indices_.data() + start,
+                      linear_con_coefs_.data() + start,
+                      linear_con_sizes_[con_index]);
+  }
+
+  // Moves the CSR linear part of an algebraic constraint to the end of
+  // the block so that new terms can be appended to it. Compacts the block
+  // instead if more than half of it would be unused.
+  void MoveLinearConToEnd(int con_index);
+
+  // Adds a term to the CSR linear part of an algebraic constraint.
+  void AddLinearConTerm(int con_index, int var_index, double coef) {
+    std::size_t end = static_cast<std::size_t>(
+          linear_con_starts_[con_index] + linear_con_sizes_[con_index]);
+    if (end != linear_con_indices_.size())
+      MoveLinearConToEnd(con_index);
+    linear_con_indices_.push_back(var_index);
+    linear_con_coefs_.push_back(coef);
+    ++linear_con_sizes_[con_index];
+  }
+
+  // Adds num_terms terms to the CSR linear part of an algebraic constraint
+  // and returns pointers to them (see LinearExpr::AddTerms).
+  void AddLinearConTerms(int con_index, int num_terms,
+                         int *&indices, double *&coefs) {
+    std::size_t end = static_cast<std::size_t>(
+          linear_con_starts_[con_index] + linear_con_sizes_[con_index]);
+    if (end != linear_con_indices_.size())
+      MoveLinearConToEnd(con_index);
+    std::size_t size = linear_con_indices_.size();
+    linear_con_indices_.resize(size + num_terms);
+    linear_con_coefs_.resize(size + num_terms);
+    indices = linear_con_indices_.data() + size;
+    coefs = linear_con_coefs_.data() + size;
+    linear_con_sizes_[con_index] += num_terms;
+  }
+
+  // Sets a coefficient in the linear part of an algebraic constraint.
+  void SetLinearConCoef(int con_index, int var_index, double coef) {
+    MP_ASSERT(0 <= var_index && var_index < num_vars(), "invalid index");
+    if (linear_con_storage_ == LINEAR_CON_EXPRS) {
+      algebraic_cons_[con_index].linear_expr.SetCoef(var_index, coef);
+    } else {
+      // Modify an existing term in place to avoid moving the constraint.
+      int position = GetLinearConExpr(con_index).FindTerm(var_index);
+      if (position >= 0)
+        linear_con_coefs_[linear_con_starts_[con_index] + position] = coef;
+      else
+        AddLinearConTerm(con_index, var_index, coef);
+    }
+    RecordChange(ProblemChange::CON_COEF, con_index, coef, var_index);
+  }
+
   // Sets the initial value for a variable.
   void SetInitialValue(int var_index, double value) {
     if (initial_values_.size() <= static_cast<unsigned>(var_index)) {
@@ -331,12 +798,12 @@ class BasicProblem : public ExprFactory, public SuffixManager {
    public:
     // Returns the lower bound on the constraint.
     double lb() const {
-      return this->problem_->algebraic_cons_[this->index_].lb;
+      return this->problem_->con_bounds_[this->index_].lb;
     }
 
     // Returns the upper bound on the constraint.
     double ub() const {
-      return this->problem_->algebraic_cons_[this->index_].ub;
+      return this->problem_->con_bounds_[this->index_].ub;
     }
 
     // Returns the dual value.
@@ -347,8 +814,10 @@ class BasicProblem : public ExprFactory, public SuffixManager {
     }
 
     // Returns the linear part of a constraint expression.
-    const LinearExpr &linear_expr() const {
-      return this->problem_->algebraic_cons_[this->index_].linear_expr;
+    // The returned expression refers to the problem storage and is
+    // invalidated when linear parts of constraints are modified.
+    LinearExpr linear_expr() const {
+      return this->problem_->GetLinearConExpr(this->index_);
     }
 
     // Returns the nonlinear part of a constraint expression.
@@ -373,9 +842,13 @@ class BasicProblem : public ExprFactory, public SuffixManager {
 
  public:
   /** Constructs an empty optimization problem. */
-  BasicProblem() {}
+  BasicProblem()
+    : linear_con_storage_(LINEAR_CON_EXPRS), num_unused_linear_con_terms_(0),
+      record_changes_(false) {}
 
-  explicit BasicProblem(const Solver &) {}
+  explicit BasicProblem(const Solver &)
+    : linear_con_storage_(LINEAR_CON_EXPRS), num_unused_linear_con_terms_(0),
+      record_changes_(false) {}
 
   /** Returns the number of variables. */
   int num_vars() const { return static_cast<int>(vars_.size()); }
@@ -420,10 +893,12 @@ class BasicProblem : public ExprFactory, public SuffixManager {
     }
 
     void set_lb(double lb) const {
-      this->problem_->vars_[this->index_].lb = lb;
+      this->problem_->vars_.mut(this->index_).lb = lb;
+      this->problem_->RecordChange(ProblemChange::VAR_LB, this->index_, lb);
     }
     void set_ub(double ub) const {
-      this->problem_->vars_[this->index_].ub = ub;
+      this->problem_->vars_.mut(this->index_).ub = ub;
+      this->problem_->RecordChange(ProblemChange::VAR_UB, this->index_, ub);
     }
 
     // Sets the initial value.
@@ -525,7 +1000,7 @@ class BasicProblem : public ExprFactory, public SuffixManager {
   Variable AddVar(double lb, double ub, var::Type type = var::CONTINUOUS) {
     std::size_t index = vars_.size();
     MP_ASSERT(index < MP_MAX_PROBLEM_ITEMS, "too many variables");
-    vars_.push_back(Var(lb, ub));
+    vars_.push_back(Bounds(lb, ub));
     is_var_int_.push_back(type != var::CONTINUOUS);
     return Variable(this, static_cast<int>(index));
   }
@@ -533,7 +1008,7 @@ class BasicProblem : public ExprFactory, public SuffixManager {
   void AddVars(int num_vars, var::Type type) {
     MP_ASSERT(num_vars >= 0, "invalid size");
     std::size_t new_size = val(SafeInt<int>(vars_.size()) + num_vars);
-    vars_.resize(new_size, Var(0, 0));
+    vars_.resize(new_size, Bounds(0, 0));
     is_var_int_.resize(new_size, type != var::CONTINUOUS);
   }
 
@@ -547,6 +1022,11 @@ class BasicProblem : public ExprFactory, public SuffixManager {
     void AddTerm(int var_index, double coef) {
       expr_->AddTerm(var_index, coef);
     }
+
+    // Adds terms in bulk (see LinearExpr::AddTerms).
+    void AddTerms(int num_terms, int *&indices, double *&coefs) {
+      expr_->AddTerms(num_terms, indices, coefs);
+    }
   };
 
   typedef LinearExprBuilder LinearObjBuilder;
@@ -583,6 +1063,15 @@ class BasicProblem : public ExprFactory, public SuffixManager {
       return LinearObjBuilder(&expr);
     }
 
+    // Sets the coefficient of a variable in the linear part of
+    // the objective expression adding a term if necessary.
+    void set_coef(int var_index, double coef) const {
+      BasicProblem *p = this->problem_;
+      MP_ASSERT(0 <= var_index && var_index < p->num_vars(), "invalid index");
+      linear_expr().SetCoef(var_index, coef);
+      p->RecordChange(ProblemChange::OBJ_COEF, this->index_, coef, var_index);
+    }
+
     // Sets the nonlinear part of the objective expression.
     void set_nonlinear_expr(NumericExpr expr) const {
       this->problem_->SetNonlinearObjExpr(this->index_, expr);
@@ -630,7 +1119,34 @@ class BasicProblem : public ExprFactory, public SuffixManager {
     is_obj_max_.resize(num_objs);
   }
 
-  typedef LinearExprBuilder LinearConBuilder;
+  // A builder of the linear part of an algebraic constraint.
+  class LinearConBuilder {
+   private:
+    BasicProblem *problem_;
+    LinearExpr *expr_;  // null if linear parts are stored in CSR format
+    int con_index_;
+
+    friend class BasicProblem;
+
+    LinearConBuilder(BasicProblem *p, LinearExpr *expr, int con_index)
+      : problem_(p), expr_(expr), con_index_(con_index) {}
+
+   public:
+    void AddTerm(int var_index, double coef) {
+      if (expr_)
+        expr_->AddTerm(var_index, coef);
+      else
+        problem_->AddLinearConTerm(con_index_, var_index, coef);
+    }
+
+    // Adds terms in bulk (see LinearExpr::AddTerms).
+    void AddTerms(int num_terms, int *&indices, double *&coefs) {
+      if (expr_)
+        expr_->AddTerms(num_terms, indices, coefs);
+      else
+        problem_->AddLinearConTerms(con_index_, num_terms, indices, coefs);
+    }
+  };
 
   // An algebraic constraint.
   typedef BasicAlgebraicCon<ProblemItem> AlgebraicCon;
@@ -650,12 +1166,20 @@ class BasicProblem : public ExprFactory, public SuffixManager {
 
     // Sets the lower bound on the constraint.
     void set_lb(double lb) const {
-      this->problem_->algebraic_cons_[this->index_].lb = lb;
+      this->problem_->con_bounds_.mut(this->index_).lb = lb;
+      this->problem_->RecordChange(ProblemChange::CON_LB, this->index_, lb);
     }
 
     // Sets the upper bound on the constraint.
     void set_ub(double ub) const {
-      this->problem_->algebraic_cons_[this->index_].ub = ub;
+      this->problem_->con_bounds_.mut(this->index_).ub = ub;
+      this->problem_->RecordChange(ProblemChange::CON_UB, this->index_, ub);
+    }
+
+    // Sets the coefficient of a variable in the linear part of
+    // the constraint expression adding a term if necessary.
+    void set_coef(int var_index, double coef) const {
+      this->problem_->SetLinearConCoef(this->index_, var_index, coef);
     }
 
     // Sets the initial dual value.
@@ -664,15 +1188,21 @@ class BasicProblem : public ExprFactory, public SuffixManager {
     }
 
     // Returns the linear part of the constraint expression.
-    LinearExpr &linear_expr() const {
-      return this->problem_->algebraic_cons_[this->index_].linear_expr;
+    // The returned expression is const because linear parts stored in
+    // CSR format can't be modified through it. Use set_coef or
+    // set_linear_expr to modify the linear part.
+    const LinearExpr linear_expr() const {
+      return this->problem_->GetLinearConExpr(this->index_);
     }
 
     // Sets the linear part of the objective expression.
     LinearConBuilder set_linear_expr(int num_linear_terms) const {
-      LinearExpr &expr = linear_expr();
+      BasicProblem *p = this->problem_;
+      if (p->linear_con_storage_ == LINEAR_CON_CSR)
+        return LinearConBuilder(p, 0, this->index_);
+      LinearExpr &expr = p->algebraic_cons_[this->index_].linear_expr;
       expr.Reserve(num_linear_terms);
-      return LinearConBuilder(&expr);
+      return LinearConBuilder(p, &expr, this->index_);
     }
 
     // Sets the nonlinear part of the constraint expression.
@@ -716,14 +1246,44 @@ class BasicProblem : public ExprFactory, public SuffixManager {
     std::size_t num_cons = algebraic_cons_.size();
     MP_ASSERT(num_cons < MP_MAX_PROBLEM_ITEMS,
               "too many algebraic constraints");
-    algebraic_cons_.push_back(AlgebraicConInfo(lb, ub));
+    algebraic_cons_.push_back(AlgebraicConInfo());
+    con_bounds_.push_back(Bounds(lb, ub));
+    if (linear_con_storage_ == LINEAR_CON_CSR) {
+      linear_con_starts_.push_back(
+            static_cast<int>(linear_con_indices_.size()));
+      linear_con_sizes_.push_back(0);
+    }
     return MutAlgebraicCon(this, static_cast<int>(num_cons));
   }
 
   void AddAlgebraicCons(int num_cons) {
     algebraic_cons_.resize(num_cons);
+    con_bounds_.resize(num_cons, Bounds(0, 0));
+    if (linear_con_storage_ == LINEAR_CON_CSR) {
+      linear_con_starts_.resize(
+            num_cons, static_cast<int>(linear_con_indices_.size()));
+      linear_con_sizes_.resize(num_cons);
+    }
   }
 
+  /** Returns the storage of linear parts of algebraic constraints. */
+  LinearConStorage linear_con_storage() const { return linear_con_storage_; }
+
+  /**
+    Sets the storage of linear parts of algebraic constraints converting
+    existing linear parts if necessary. Setting the storage before adding
+    constraints avoids the conversion.
+   */
+  void set_linear_con_storage(LinearConStorage storage);
+
+  /**
+    Gets the constraint matrix, i.e. the linear parts of algebraic
+    constraints, in compressed sparse column format. The matrix has
+    num_vars() columns and terms in each column are ordered by constraint
+    index.
+   */
+  void GetConMatrix(CSCMatrix &matrix) const;
+
   // A logical constraint.
   template <typename Item>
   class BasicLogicalCon : private Item {
@@ -921,6 +1481,91 @@ class BasicProblem : public ExprFactory, public SuffixManager {
   // Sets problem information and reserves memory for problem elements.
   void SetInfo(const ProblemInfo &info);
 
+  /**
+    \rst
+    Makes this problem a copy-on-write copy of *base*. Expression trees
+    and functions are shared with *base*. Bounds and linear parts of
+    objectives, algebraic constraints and common expressions refer to its
+    storage until they are modified. Variable and objective types,
+    complementarity conditions and initial values are copied.
+    Suffixes are neither shared nor copied, so after the call this problem
+    has no suffixes; add them to it if the solver needs them.
+    This problem must be empty and *base* must not be modified or destroyed
+    while this problem is in use.
+    \endrst
+   */
+  void ShareFrom(const BasicProblem &base);
+
+  /**
+    Enables or disables recording of changes in the change journal.
+    Changes of variable and constraint bounds with set_lb and set_ub and
+    of linear coefficients with set_coef are recorded. Structural
+    changes such as adding variables or constraints and changes made via
+    references to linear expressions are not recorded.
+   */
+  void set_record_changes(bool record) { record_changes_ = record; }
+
+  /** Returns true if changes are recorded in the change journal. */
+  bool record_changes() const { return record_changes_; }
+
+  /** Returns the number of changes in the change journal. */
+  int num_changes() const { return static_cast<int>(changes_.size()); }
+
+  /** Returns the change at the specified index in the change journal. */
+  const ProblemChange &change(int index) const {
+    internal::CheckIndex(index, num_changes());
+    return changes_[index];
+  }
+
+  /** Removes all changes from the change journal. */
+  void ClearChanges() { changes_.clear(); }
+
+  /**
+    \rst
+    Replays changes from the change journal starting from the one at
+    position *start* by calling the following methods of *handler*::
+
+      void SetVarLB(int var_index, double lb);
+      void SetVarUB(int var_index, double ub);
+      void SetConLB(int con_index, double lb);
+      void SetConUB(int con_index, double ub);
+      void SetObjCoef(int obj_index, int var_index, double coef);
+      void SetConCoef(int con_index, int var_index, double coef);
+
+    This allows updating a solver that has already loaded the problem
+    without converting the whole problem again. Several consumers can
+    replay the same journal by passing the number of changes they have
+    already seen as *start*.
+    \endrst
+   */
+  template <typename Handler>
+  void ReplayChanges(Handler &handler, int start = 0) const {
+    MP_ASSERT(0 <= start && start <= num_changes(), "invalid index");
+    for (std::size_t i = start, n = changes_.size(); i != n; ++i) {
+      const ProblemChange &c = changes_[i];
+      switch (c.kind) {
+      case ProblemChange::VAR_LB:
+        handler.SetVarLB(c.index, c.value);
+        break;
+      case ProblemChange::VAR_UB:
+        handler.SetVarUB(c.index, c.value);
+        break;
+      case ProblemChange::CON_LB:
+        handler.SetConLB(c.index, c.value);
+        break;
+      case ProblemChange::CON_UB:
+        handler.SetConUB(c.index, c.value);
+        break;
+      case ProblemChange::OBJ_COEF:
+        handler.SetObjCoef(c.index, c.var_index, c.value);
+        break;
+      case ProblemChange::CON_COEF:
+        handler.SetConCoef(c.index, c.var_index, c.value);
+        break;
+      }
+    }
+  }
+
   typedef BasicProblem Builder;
 
   // Returns the built problem. This is used for compatibility with the problem
@@ -35,9 +35,108 @@
 
 namespace mp {
 
+namespace sol {
+/** .sol file format. */
+enum Format {
+  /** Text format. */
+  TEXT,
+
+  /** Binary format with numbers in the native representation. */
+  BINARY
+};
+}
+
 namespace internal {
 
-void WriteMessage(fmt::BufferedFile &file, const char *message);
+// Buffered .sol file output with fast formatting of numbers.
+// Output is accumulated in a large buffer and written to the file in
+// blocks bypassing format string parsing and per-value stdio calls.
+class SolOutput {
+ private:
+  fmt::BufferedFile file_;
+  char *buffer_;
+  char *ptr_;
+  char *end_;
+
+  enum {
+    BUFFER_SIZE = 1 << 18,
+    // The maximum size of a formatted number including a separator.
+    MAX_NUMBER_SIZE = 32
+  };
+
+  // Writes the buffer contents to the file.
+  void Flush();
+
+  // Makes sure that there is space for size more characters in the buffer.
+  void Reserve(std::size_t size) {
+    if (static_cast<std::size_t>(end_ - ptr_) < size)
+      Flush();
+  }
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(SolOutput);
+
+ public:
+  explicit SolOutput(fmt::CStringRef filename);
+  ~SolOutput();
+
+  void Write(fmt::StringRef s);
+
+  void Write(char c) {
+    Reserve(1);
+    *ptr_++ = c;
+  }
+
+  void Write(long value) {
+    Reserve(MAX_NUMBER_SIZE);
+    ptr_ = FormatInt(ptr_, value);
+  }
+  void Write(int value) { Write(static_cast<long>(value)); }
+
+  // Writes a representation of value that round-trips exactly;
+  // usually the shortest.
+  void Write(double value) {
+    Reserve(MAX_NUMBER_SIZE);
+    ptr_ = FormatDouble(ptr_, value);
+  }
+
+  // Writes the native representation of a value.
+  template <typename T>
+  void WriteBinary(T value) {
+    Reserve(sizeof(T));
+    std::memcpy(ptr_, &value, sizeof(T));
+    ptr_ += sizeof(T);
+  }
+
+  // Writes the size of a record in the binary format. The size precedes
+  // and follows the record data as in Fortran unformatted files.
+  void WriteRecordSize(std::size_t size) {
+    WriteBinary(static_cast<int>(size));
+  }
+
+  // Writes a record in the binary format.
+  void WriteRecord(const void *data, std::size_t size) {
+    WriteRecordSize(size);
+    Write(fmt::StringRef(static_cast<const char*>(data), size));
+    WriteRecordSize(size);
+  }
+
+  // Writes a solver message replacing empty lines which would terminate
+  // the message with lines containing a single space. In the binary
+  // format each line is a record and an empty record ends the message.
+  void WriteMessage(const char *message, sol::Format format = sol::TEXT);
+
+  // Writes the remaining output and closes the file.
+  void Close();
+
+  // Formats an integer into buffer and returns a pointer past the end
+  // of the output.
+  static char *FormatInt(char *buffer, fmt::LongLong value);
+
+  // Formats a representation of a double that round-trips exactly
+  // (usually the shortest) into buffer and returns a pointer past the end
+  // of the output. buffer should have space for at least 25 characters.
+  static char *FormatDouble(char *buffer, double value);
+};
 
 // Suffix value visitor that counts values.
 class SuffixValueCounter {
@@ -56,17 +155,38 @@ class SuffixValueCounter {
 // Suffix value visitor that writes values to a file.
 class SuffixValueWriter {
  private:
-  fmt::BufferedFile &file_;
+  SolOutput &out_;
 
  public:
-  explicit SuffixValueWriter(fmt::BufferedFile &file) : file_(file) {}
+  explicit SuffixValueWriter(SolOutput &out) : out_(out) {}
 
   template <typename T>
-  void Visit(int index, T value) { file_.print("{} {}\n", index, value); }
+  void Visit(int index, T value) {
+    out_.Write(index);
+    out_.Write(' ');
+    out_.Write(value);
+    out_.Write('\n');
+  }
 };
 
-template <typename SuffixMap>
-void WriteSuffixes(fmt::BufferedFile &file, const SuffixMap *suffixes) {
+// Suffix value visitor that writes values to a file in the binary format.
+class BinarySuffixValueWriter {
+ private:
+  SolOutput &out_;
+
+ public:
+  explicit BinarySuffixValueWriter(SolOutput &out) : out_(out) {}
+
+  template <typename T>
+  void Visit(int index, T value) {
+    out_.WriteBinary(index);
+    out_.WriteBinary(value);
+  }
+};
+
+template <typename Solution, typename SuffixMap>
+void WriteSuffixes(SolOutput &out, const Solution &sol,
+                   const SuffixMap *suffixes, sol::Format format) {
   if (!suffixes)
     return;
   for (typename SuffixMap::iterator
@@ -79,40 +199,168 @@ void WriteSuffixes(fmt::BufferedFile &file, const SuffixMap *suffixes) {
     if (num_values == 0)
       continue;
     const char *name = i->name();
+    const char *table = sol.suffix_table(name);
+    std::size_t table_size = table ? std::strlen(table) : 0;
     int mask = internal::SUFFIX_KIND_MASK | suf::FLOAT | suf::IODECL;
-    file.print("suffix {} {} {} {} {}\n{}\n",
-               i->kind() & mask, num_values, std::strlen(name) + 1, 0, 0, name);
-    // TODO: write table
-    SuffixValueWriter writer(file);
+    int kind = i->kind() & mask;
+    int name_size = static_cast<int>(std::strlen(name));
+    if (format == sol::BINARY) {
+      // The header contains the same numbers as in the text format.
+      int header[] = {
+        kind, num_values, name_size + 1,
+        table_size != 0 ? static_cast<int>(table_size) + 1 : 0, 0
+      };
+      out.WriteRecord(header, sizeof(header));
+      out.WriteRecord(name, name_size);
+      if (table_size != 0)
+        out.WriteRecord(table, table_size);
+      std::size_t value_size =
+          (kind & suf::FLOAT) != 0 ? sizeof(double) : sizeof(int);
+      std::size_t size = num_values * (sizeof(int) + value_size);
+      out.WriteRecordSize(size);
+      BinarySuffixValueWriter writer(out);
+      i->VisitValues(writer);
+      out.WriteRecordSize(size);
+      continue;
+    }
+    // The header has the form:
+    //   suffix <kind> <num_values> <name size> <table size> 0
+    // where sizes include the terminating newlines.
+    out.Write(fmt::StringRef("suffix "));
+    out.Write(kind);
+    out.Write(' ');
+    out.Write(num_values);
+    out.Write(' ');
+    out.Write(name_size + 1);
+    out.Write(' ');
+    out.Write(static_cast<long>(table_size != 0 ? table_size + 1 : 0));
+    out.Write(fmt::StringRef(" 0\n"));
+    out.Write(name);
+    out.Write('\n');
+    if (table_size != 0) {
+      out.Write(fmt::StringRef(table, table_size));
+      out.Write('\n');
+    }
+    SuffixValueWriter writer(out);
     i->VisitValues(writer);
   }
 }
-}  // namespace internal
 
-// Writes a solution to a .sol file.
+// Writes a solution in the text format.
+template <typename Solution>
+void WriteTextSol(SolOutput &out, const Solution &sol) {
+  out.WriteMessage(sol.message());
+  // Write options. The number of options is written even if it is 0
+  // because the counts of values that follow are read after the options.
+  out.Write(fmt::StringRef("Options\n"));
+  int num_options = sol.num_options();
+  out.Write(num_options);
+  out.Write('\n');
+  for (int i = 0; i < num_options; ++i) {
+    out.Write(sol.option(i));
+    out.Write('\n');
+  }
+  int num_values = sol.num_values(), num_dual_values = sol.num_dual_values();
+  for (int i = 0; i < 2; ++i) {
+    out.Write(num_dual_values);
+    out.Write('\n');
+  }
+  for (int i = 0; i < 2; ++i) {
+    out.Write(num_values);
+    out.Write('\n');
+  }
+  // Dual values precede primal values as in the counts above.
+  for (int i = 0; i < num_dual_values; ++i) {
+    out.Write(sol.dual_value(i));
+    out.Write('\n');
+  }
+  for (int i = 0; i < num_values; ++i) {
+    out.Write(sol.value(i));
+    out.Write('\n');
+  }
+  out.Write(fmt::StringRef("objno 0 "));
+  out.Write(sol.status());
+  out.Write('\n');
+}
+
+// Writes a solution in the binary format.
 template <typename Solution>
-void WriteSolFile(fmt::CStringRef filename, const Solution &sol) {
-  fmt::BufferedFile file(filename, "w");
-  internal::WriteMessage(file, sol.message());
-  // Write options.
-  file.print("Options\n");
-  if (int num_options = sol.num_options()) {
-    file.print("{}\n", num_options);
-    for (int i = 0; i < num_options; ++i)
-      file.print("{}\n", sol.option(i));
-  }
-  // TODO: check precision
+void WriteBinarySol(SolOutput &out, const Solution &sol) {
+  out.WriteRecord("binary", 6);
+  out.WriteMessage(sol.message(), sol::BINARY);
+  out.WriteRecord("Options", 7);
+  int num_options = sol.num_options();
   int num_values = sol.num_values(), num_dual_values = sol.num_dual_values();
-  file.print("{0}\n{0}\n{1}\n{1}\n", num_dual_values, num_values);
-  for (int i = 0; i < num_values; ++i)
-    file.print("{}\n", sol.value(i));
-  for (int i = 0, n = num_dual_values; i < n; ++i)
-    file.print("{}\n", sol.dual_value(i));
-  file.print("objno 0 {}\n", sol.status());
+  std::size_t size = (num_options + 5) * sizeof(int);
+  out.WriteRecordSize(size);
+  out.WriteBinary(num_options);
+  for (int i = 0; i < num_options; ++i)
+    out.WriteBinary(sol.option(i));
+  out.WriteBinary(num_dual_values);
+  out.WriteBinary(num_dual_values);
+  out.WriteBinary(num_values);
+  out.WriteBinary(num_values);
+  out.WriteRecordSize(size);
+  if (num_dual_values != 0) {
+    size = num_dual_values * sizeof(double);
+    out.WriteRecordSize(size);
+    for (int i = 0; i < num_dual_values; ++i)
+      out.WriteBinary(sol.dual_value(i));
+    out.WriteRecordSize(size);
+  }
+  if (num_values != 0) {
+    size = num_values * sizeof(double);
+    out.WriteRecordSize(size);
+    for (int i = 0; i < num_values; ++i)
+      out.WriteBinary(sol.value(i));
+    out.WriteRecordSize(size);
+  }
+  int objno[] = {0, sol.status()};
+  out.WriteRecord(objno, sizeof(objno));
+}
+}  // namespace internal
+
+/**
+  \rst
+  Writes a solution to a .sol file in the specified format. The *sol*
+  object should provide the interface of `mp::SolutionAdapter`.
+
+  In the text format values are written with a representation that
+  round-trips exactly and is usually the shortest.
+
+  The binary format is the one produced by ASL's ``write_sol`` for
+  binary .nl input. Each record is written as in Fortran unformatted
+  files: its size in bytes as an ``int``, the data and the size again.
+  Numbers are written in the native representation. The records are
+
+  * ``binary``;
+  * one record per line of the solver message followed by an empty
+    record;
+  * ``Options``;
+  * ``int`` values: the number of options, the options, the number of
+    dual values (twice) and the number of primal values (twice);
+  * dual values as ``double`` if there are any;
+  * primal values as ``double`` if there are any;
+  * ``int`` values: the objective number (0) and the solve status;
+  * for each output suffix with nonzero values: ``int`` values of the
+    header as in the text format (kind, number of values, name size,
+    table size and 0), the name, the table if there is one, and the
+    values as pairs of an ``int`` index and an ``int`` or ``double``
+    value.
+  \endrst
+ */
+template <typename Solution>
+void WriteSolFile(fmt::CStringRef filename, const Solution &sol,
+                  sol::Format format = sol::TEXT) {
+  internal::SolOutput out(filename);
+  if (format == sol::BINARY)
+    internal::WriteBinarySol(out, sol);
+  else
+    internal::WriteTextSol(out, sol);
   suf::Kind kinds[] = {suf::VAR, suf::CON, suf::OBJ, suf::PROBLEM};
   for (std::size_t i = 0, n = sizeof(kinds) / sizeof(*kinds); i < n; ++i)
-    internal::WriteSuffixes(file, sol.suffixes(kinds[i]));
-  // TODO: test
+    internal::WriteSuffixes(out, sol, sol.suffixes(kinds[i]), format);
+  out.Close();
 }
 }  // namepace mp
 
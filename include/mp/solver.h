@@ -33,6 +33,7 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #if MP_USE_ATOMIC
@@ -46,6 +47,8 @@
 #include "mp/nl-reader.h"
 #include "mp/option.h"
 #include "mp/os.h"
+#include "mp/posix.h"
+#include "mp/problem.h"
 #include "mp/problem-builder.h"
 #include "mp/sol.h"
 #include "mp/suffix.h"
@@ -208,6 +211,147 @@ class Interrupter {
   virtual void SetHandler(InterruptHandler handler, void *data) = 0;
 };
 
+namespace internal {
+
+#if MP_USE_ATOMIC
+using std::atomic;
+#else
+// Dummy "atomic" for compatibility with legacy compilers.
+template <typename T>
+class atomic {
+ private:
+  T value_;
+
+ public:
+  atomic(T value = T()) : value_(value) {}
+  operator T() const { return value_; }
+};
+#endif
+}  // namespace internal
+
+namespace internal {
+class TokenWatchdog;
+}
+
+/**
+  \rst
+  A cooperative cancellation token for one solution process.
+
+  A token is cancelled explicitly with `~mp::CancellationToken::Cancel`,
+  when its parent token is cancelled, when its deadline passes or, if
+  enabled with `~mp::CancellationToken::CancelOnSigInt`, when SIGINT is
+  received while an `mp::internal::SignalHandler` is active. Composing
+  tokens this way allows cancelling one of several solves running in the
+  same process or all of them at once.
+
+  A token implements `mp::Interrupter` so it reaches solver backends
+  through the interrupter hooks: install it with ``Solver::set_interrupter``
+  and the backend's calls of ``interrupter()->Stop()`` poll the token while
+  the handler registered with ``interrupter()->SetHandler`` is called on
+  cancellation. Polling is lock-free; a mutex is only taken to register
+  handlers and child tokens and to cancel. While a token with a handler
+  has a deadline, a parent or a signal to watch, a watchdog thread polls it
+  every few milliseconds and calls the handler once the token is cancelled,
+  so backends that only react to the handler are interrupted as well.
+  Without thread support such tokens are only cancelled when polled.
+
+  **Example**::
+
+    mp::CancellationToken all;
+    all.set_time_limit(60);
+    mp::CancellationToken token(&all);
+    solver.set_interrupter(&token);
+    // Call token.Cancel() from another thread to stop this solve or
+    // all.Cancel() to stop every solve using a child of all.
+  \endrst
+ */
+class CancellationToken : public Interrupter {
+ private:
+  // The following members can be read without locking the mutex.
+  internal::atomic<int> cancelled_;
+  // Nonzero if Stop should check the parent, the deadline or signals.
+  internal::atomic<int> check_;
+  CancellationToken *parent_;
+  // Deadline in steady_clock ticks or NO_DEADLINE.
+  internal::atomic<steady_clock::rep> deadline_;
+  // Signal count at the time CancelOnSigInt was called or -1.
+  internal::atomic<long> signal_count_;
+
+  static const steady_clock::rep NO_DEADLINE;
+
+  // The following members are guarded by a mutex.
+  InterruptHandler handler_;
+  void *handler_data_;
+  std::vector<CancellationToken*> children_;
+
+  friend class internal::TokenWatchdog;
+
+  // Interrupt handlers with their data.
+  typedef std::vector< std::pair<InterruptHandler, void*> > HandlerList;
+
+  // Returns true if the parent token is cancelled or the deadline has
+  // passed or a signal has been received.
+  bool IsStopRequested() const;
+
+  // Cancels the token and its children with the mutex locked adding
+  // their handlers to the list. The handlers should be called after
+  // the mutex is unlocked.
+  void DoCancel(HandlerList &handlers);
+
+  // Calls interrupt handlers with the mutex unlocked.
+  static void CallHandlers(const HandlerList &handlers);
+
+  // Hands the token to the watchdog if it has a handler and something
+  // to check, with the mutex locked.
+  void UpdateWatch();
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(CancellationToken);
+
+ public:
+  /**
+    Constructs a token that is cancelled when *parent*, if not null, is
+    cancelled. The parent must outlive the token.
+   */
+  explicit CancellationToken(CancellationToken *parent = 0);
+
+  ~CancellationToken();
+
+  /**
+    Sets the time after which the token is cancelled. Can be called
+    while the token is being polled.
+   */
+  void set_deadline(steady_clock::time_point deadline);
+
+  /**
+    Sets the deadline to *seconds* from now. A limit too large to be
+    represented by `mp::steady_clock` means no deadline.
+   */
+  void set_time_limit(double seconds);
+
+  /** Makes the token cancelled when SIGINT is received from now on. */
+  void CancelOnSigInt();
+
+  /**
+    Cancels the token and its children calling their interrupt handlers.
+    Can be called from any thread but not from a signal handler.
+   */
+  void Cancel();
+
+  /** Returns true if the token is cancelled. */
+  bool Stop() const {
+    return cancelled_ != 0 || (check_ && IsStopRequested());
+  }
+
+  /**
+    Sets a handler called on cancellation. If the token is already
+    cancelled, the handler is called immediately. The handler is called
+    without holding the lock that guards tokens, so it can cancel tokens
+    and set handlers. It may still be called shortly after being replaced
+    if cancellation is in progress on another thread.
+   */
+  void SetHandler(InterruptHandler handler, void *data);
+};
+
 // A solver option.
 class SolverOption {
  private:
@@ -404,6 +548,7 @@ class Solver : private ErrorHandler,
 
   bool timing_;
   bool multiobj_;
+  int flags_;
 
   bool has_errors_;
   OutputHandler *output_handler_;
@@ -560,7 +705,11 @@ class Solver : private ErrorHandler,
     MULTIPLE_SOL = 1,
 
     // Multiple objectives support.
-    MULTIPLE_OBJ = 2
+    MULTIPLE_OBJ = 2,
+
+    // Different solver objects can be used concurrently on separate
+    // threads. Makes SolverApp run jobs on multiple workers in server mode.
+    REENTRANT = 4
   };
 
  protected:
@@ -768,6 +917,9 @@ class Solver : private ErrorHandler,
   // Returns true if multiobjective optimization is enabled.
   bool multiobj() const { return multiobj_; }
 
+  // Returns the solver flags passed to the constructor.
+  int flags() const { return flags_; }
+
   // Returns the error handler.
   ErrorHandler *error_handler() { return error_handler_; }
 
@@ -941,13 +1093,16 @@ class SolutionAdapter {
   mp::ArrayRef<int> options_;
   mp::ArrayRef<double> values_;
   mp::ArrayRef<double> dual_values_;
+  const Solver::SuffixList *suffix_infos_;
 
  public:
   SolutionAdapter(int status, ProblemBuilder *pb, const char *message,
                   mp::ArrayRef<int> options, mp::ArrayRef<double> values,
-                  mp::ArrayRef<double> dual_values)
+                  mp::ArrayRef<double> dual_values,
+                  const Solver::SuffixList *suffix_infos = 0)
     : status_(status), builder_(pb), message_(message), options_(options),
-      values_(values), dual_values_(dual_values) {}
+      values_(values), dual_values_(dual_values),
+      suffix_infos_(suffix_infos) {}
 
   int status() const { return status_; }
 
@@ -965,6 +1120,19 @@ class SolutionAdapter {
   const typename ProblemBuilder::SuffixSet *suffixes(suf::Kind kind) const {
     return builder_ ? &builder_->suffixes(kind) : 0;
   }
+
+  // Returns the value table of a suffix declared by the solver or null
+  // if there is no such table.
+  const char *suffix_table(const char *name) const {
+    if (!suffix_infos_)
+      return 0;
+    for (Solver::SuffixList::const_iterator i = suffix_infos_->begin(),
+         end = suffix_infos_->end(); i != end; ++i) {
+      if (std::strcmp(i->name(), name) == 0)
+        return i->table();
+    }
+    return 0;
+  }
 };
 
 class NullSolutionHandler : public SolutionHandler {
@@ -1055,7 +1223,8 @@ void SolutionWriter<Solver, Writer>::HandleSolution(
         status, &builder_, message.c_str(), options_,
         MakeArrayRef(values, values ? builder_.num_vars() : 0),
         MakeArrayRef(dual_values,
-                     dual_values ? builder_.num_algebraic_cons() : 0));
+                     dual_values ? builder_.num_algebraic_cons() : 0),
+        &solver_.suffixes());
   this->Write(stub_ + ".sol", sol);
 }
 
@@ -1071,6 +1240,7 @@ class SolverAppOptionParser {
   OptionList options_;
 
   bool echo_solver_options_;
+  bool server_mode_;
 
   // Prints usage information and stops processing options.
   bool ShowUsage();
@@ -1088,6 +1258,11 @@ class SolverAppOptionParser {
     return true;
   }
 
+  bool EnableServerMode() {
+    server_mode_ = true;
+    return true;
+  }
+
   // Stops processing options.
   bool EndOptions() { return false; }
 
@@ -1099,24 +1274,15 @@ class SolverAppOptionParser {
   // Retruns true if assignments of solver options should be echoed.
   bool echo_solver_options() const { return echo_solver_options_; }
 
-  // Parses command-line options.
-  const char *Parse(char **&argv);
-};
+  // Returns true if the server mode is requested with -b.
+  bool server_mode() const { return server_mode_; }
 
-#if MP_USE_ATOMIC
-using std::atomic;
-#else
-// Dummy "atomic" for compatibility with legacy compilers.
-template <typename T>
-class atomic {
- private:
-  T value_;
-
- public:
-  atomic(T value = T()) : value_(value) {}
-  operator T() const { return value_; }
+  // Parses command-line options and returns the stub. In server mode
+  // returns the socket path given with socket=<path> instead or an empty
+  // string to read jobs from standard input. The socket argument is removed
+  // and other arguments are left to be parsed as solver options.
+  const char *Parse(char **&argv);
 };
-#endif
 
 #ifdef _WIN32
 // Signal repeater used to pass signals across processes on Windows.
@@ -1145,11 +1311,20 @@ class SignalHandler : public Interrupter {
   Solver &solver_;
   std::string message_;
   static volatile std::sig_atomic_t stop_;
+  static volatile std::sig_atomic_t signal_count_;
 
   static atomic<const char*> signal_message_ptr_;
   static atomic<unsigned> signal_message_size_;
-  static atomic<InterruptHandler> handler_;
-  static atomic<void*> data_;
+
+  // An interrupt handler with its data. Handlers are published with
+  // a single atomic pointer so that the signal handler never sees
+  // a handler with the data of another.
+  struct HandlerInfo {
+    InterruptHandler handler;
+    void *data;
+  };
+  static HandlerInfo handlers_[2];
+  static atomic<const HandlerInfo*> handler_;
 
   static void HandleSigInt(int sig);
 
@@ -1160,11 +1335,12 @@ class SignalHandler : public Interrupter {
 
   ~SignalHandler();
 
-  //static bool stop() { return stop_ != 0; }
-
   // Returns true if the execution should be stopped due to SIGINT.
   bool Stop() const { return stop_ != 0; }
 
+  // Returns the number of SIGINT signals received so far.
+  static long signal_count() { return signal_count_; }
+
   void SetHandler(InterruptHandler handler, void *data);
 };
 
@@ -1308,6 +1484,9 @@ class SolverApp : private Reader {
   };
   AppOutputHandler output_handler_;
 
+  // Runs the application in server mode.
+  int RunServer(const char *socket_path, char **argv, int nl_reader_flags);
+
  public:
   SolverApp() : option_parser_(solver_) {
     solver_.set_output_handler(&output_handler_);
@@ -1338,6 +1517,8 @@ int SolverApp<Solver, Reader>::Run(char **argv, int nl_reader_flags) {
   // Parse command-line arguments.
   const char *filename = option_parser_.Parse(argv);
   if (!filename) return 0;
+  if (option_parser_.server_mode())
+    return RunServer(filename, argv, nl_reader_flags);
 
   unsigned banner_size = 0;
   if (solver_.ampl_flag()) {
@@ -1384,6 +1565,438 @@ int SolverApp<Solver, Reader>::Run(char **argv, int nl_reader_flags) {
   return 0;
 }
 
+namespace internal {
+
+// Saved values of solver options that can be restored later.
+class OptionSnapshot {
+ private:
+  struct Value {
+    SolverOption *option;
+    std::string value;
+  };
+  std::vector<Value> values_;
+
+ public:
+  // Saves values of all options of a solver except flags and options
+  // that cannot be formatted.
+  void Save(Solver &s);
+
+  // Restores saved option values that have changed.
+  void Restore();
+};
+
+// The part of SolverServer that doesn't depend on the solver type.
+// It reads jobs, distributes them among workers and reports results.
+class SolverServerBase {
+ public:
+  // A job: solve the problem from a stub with the specified options.
+  struct Job {
+    int id;
+    std::string stub;
+    std::string options;
+    steady_clock::time_point start;
+  };
+
+ private:
+  int num_workers_;
+  int num_jobs_;
+
+  class Dispatcher;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(SolverServerBase);
+
+ protected:
+  // Constructs the object with the specified number of workers or
+  // the number of hardware threads if num_workers <= 0.
+  explicit SolverServerBase(int num_workers);
+
+  virtual ~SolverServerBase() {}
+
+  // Runs a job on the worker with the specified index writing solver output
+  // to the output writer. Throws an exception if the job fails.
+  virtual void RunJob(int worker, const Job &job, fmt::Writer &output) = 0;
+
+ public:
+  // Returns the number of workers.
+  int num_workers() const { return num_workers_; }
+
+  // Reads jobs from in and writes job reports to out until the end of input
+  // or a "quit" line. Returns true if stopped by "quit". Reports to a client
+  // that has disconnected are dropped; other write errors stop serving
+  // after running jobs complete and are rethrown.
+  bool Serve(fmt::File &in, fmt::File &out);
+
+  // Listens for connections on a Unix domain socket with the specified path
+  // and serves jobs from them one connection at a time until a "quit" line
+  // is received. A socket left at the path is replaced, but any other file
+  // there is an error. Reports to clients that have disconnected are
+  // dropped.
+  void Listen(fmt::CStringRef socket_path);
+};
+}  // namespace internal
+
+/**
+  \rst
+  A batch solve server that runs a stream of jobs keeping solver objects and
+  their option tables between jobs. Each job is a line of the form::
+
+    <stub> [<option assignments>...]
+
+  Option assignments are applied on top of the options set with
+  `~mp::SolverServer::SetOptions` which are restored after each job.
+  Jobs are run on a pool of workers each with its own solver, so more than
+  one worker should only be used for reentrant solvers. For each job the
+  server writes the solver output with lines prefixed by ``#`` followed
+  by a report line::
+
+    <job id> <ok|error> <latency in seconds> <stub>[: <error message>]
+
+  The latency is measured from the time the job has been read and includes
+  waiting in the queue. A job writes a ``.sol`` file like a solver invoked
+  with ``-AMPL`` does.
+  \endrst
+ */
+template <typename Solver, typename Reader = internal::NLFileReader<> >
+class SolverServer : public internal::SolverServerBase {
+ private:
+  class Worker : public OutputHandler, public ErrorHandler {
+   public:
+    Solver solver;
+    Reader reader;
+    internal::OptionSnapshot options;
+    fmt::Writer *output;  // Output of the current job.
+
+    Worker() : output(0) {
+      solver.set_output_handler(this);
+      solver.set_error_handler(this);
+      options.Save(solver);
+    }
+    virtual ~Worker() {}
+
+    void HandleOutput(fmt::CStringRef s) {
+      if (output)
+        *output << s.c_str();
+      else
+        std::fputs(s.c_str(), stdout);
+    }
+
+    void HandleError(fmt::CStringRef message) {
+      if (output)
+        *output << message.c_str() << '\n';
+      else
+        std::fprintf(stderr, "%s\n", message.c_str());
+    }
+  };
+
+  std::vector<Worker*> workers_;
+  int nl_reader_flags_;
+
+ protected:
+  void RunJob(int worker, const Job &job, fmt::Writer &output);
+
+ public:
+  explicit SolverServer(int num_workers = 1, int nl_reader_flags = 0)
+    : internal::SolverServerBase(num_workers),
+      nl_reader_flags_(nl_reader_flags) {
+    workers_.reserve(this->num_workers());
+    for (int i = 0, n = this->num_workers(); i < n; ++i)
+      workers_.push_back(new Worker());
+  }
+
+  ~SolverServer() {
+    for (std::size_t i = 0, n = workers_.size(); i != n; ++i)
+      delete workers_[i];
+  }
+
+  // Returns the solver of the worker with the specified index.
+  Solver &solver(int worker = 0) { return workers_[worker]->solver; }
+
+  // Parses default solver options for all jobs and returns true if there
+  // were no errors. Only the options of the first worker are echoed.
+  bool SetOptions(char **argv, unsigned flags = 0) {
+    bool ok = true;
+    for (std::size_t i = 0, n = workers_.size(); i != n; ++i) {
+      Worker &w = *workers_[i];
+      if (!w.solver.ParseOptions(
+            argv, i == 0 ? flags : flags | Solver::NO_OPTION_ECHO)) {
+        ok = false;
+      }
+      w.options.Save(w.solver);
+    }
+    return ok;
+  }
+};
+
+template <typename Solver, typename Reader>
+void SolverServer<Solver, Reader>::RunJob(
+    int worker, const Job &job, fmt::Writer &output) {
+  Worker &w = *workers_[worker];
+  w.output = &output;
+  w.options.Restore();
+  Solver &solver = w.solver;
+
+  // Add .nl extension if necessary.
+  std::string nl_filename = job.stub, filename_no_ext = nl_filename;
+  const char *ext = std::strrchr(job.stub.c_str(), '.');
+  if (!ext || std::strcmp(ext, ".nl") != 0)
+    nl_filename += ".nl";
+  else
+    filename_no_ext.resize(filename_no_ext.size() - 3);
+  internal::SetBasename(solver, &filename_no_ext);
+
+  // Parse job options.
+  std::vector<char> options(job.options.begin(), job.options.end());
+  options.push_back('\0');
+  char *argv[] = {&options[0], 0};
+  if (!solver.ParseOptions(argv, Solver::NO_OPTION_ECHO))
+    throw Error("invalid solver options");
+  solver.set_wantsol(solver.wantsol() | Solver::WRITE_SOL_FILE);
+
+  // Read and solve the problem.
+  steady_clock::time_point start = steady_clock::now();
+  typename Solver::ProblemBuilder builder(solver);
+  internal::SolverNLHandler<Solver> handler(builder, solver);
+  w.reader.Read(nl_filename, handler, nl_reader_flags_);
+  double read_time = GetTimeAndReset(start);
+  if (solver.timing())
+    solver.Print("Input time = {:.6f}s\n", read_time);
+  ArrayRef<int> ampl_options(handler.options(), handler.num_options());
+  internal::AppSolutionHandler<Solver> sol_handler(
+        filename_no_ext, solver, builder, ampl_options, 0);
+  solver.Solve(builder.problem(), sol_handler);
+}
+
+template <typename Solver, typename Reader>
+int SolverApp<Solver, Reader>::RunServer(
+    const char *socket_path, char **argv, int nl_reader_flags) {
+  // Use one worker per hardware thread if the solver is reentrant.
+  int num_workers = (solver_.flags() & Solver::REENTRANT) != 0 ? 0 : 1;
+  SolverServer<Solver, Reader> server(num_workers, nl_reader_flags);
+  unsigned flags =
+      option_parser_.echo_solver_options() ? 0 : Solver::NO_OPTION_ECHO;
+  if (!server.SetOptions(argv, flags))
+    return 1;
+  if (*socket_path) {
+    server.Listen(socket_path);
+  } else {
+    fmt::File in = fmt::File::dup(0), out = fmt::File::dup(1);
+    server.Serve(in, out);
+  }
+  return 0;
+}
+
+namespace internal {
+
+// The part of ScenarioDriver that doesn't depend on the solver type.
+class ScenarioDriverBase {
+ private:
+  int num_workers_;
+
+  class Runner;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(ScenarioDriverBase);
+
+ protected:
+  // Constructs the object with the specified number of workers or
+  // the number of hardware threads if num_workers <= 0.
+  explicit ScenarioDriverBase(int num_workers);
+
+  virtual ~ScenarioDriverBase() {}
+
+  // Solves a scenario on the worker with the specified index.
+  virtual void SolveScenario(int worker, int scenario) = 0;
+
+  // Solves scenarios distributing them among workers.
+  void Run(int num_scenarios);
+
+  // Reduces the number of workers, e.g. for solvers that are not
+  // reentrant.
+  void LimitNumWorkers(int max_num_workers) {
+    num_workers_ = std::min(num_workers_, std::max(max_num_workers, 1));
+  }
+
+ public:
+  // Returns the number of workers.
+  int num_workers() const { return num_workers_; }
+};
+}  // namespace internal
+
+/**
+  \rst
+  A driver that solves many variants (scenarios) of one base problem
+  concurrently. Each scenario is a `mp::ProblemOverlay` and only its changes
+  are stored. When a scenario is solved, a copy-on-write copy of the base
+  problem is made with `mp::BasicProblem::ShareFrom` and the changes are
+  applied to it, so expression trees and unmodified linear parts are
+  shared with the base problem. Suffixes of the base problem are not
+  passed to the scenarios. Scenarios are dispatched to a pool of workers
+  each with its own solver. Solvers without the `mp::Solver::REENTRANT`
+  flag always use a single worker. The solution of each scenario is
+  written to a ``.sol`` file with the scenario stub. Each scenario is
+  solved with its own `mp::CancellationToken` installed as the solver
+  interrupter so scenarios can be cancelled individually with `Cancel`
+  or all at once with ``token().Cancel()``.
+
+  **Example**::
+
+    mp::ScenarioDriver<MySolver> driver(problem, 4);
+    for (int i = 0; i < 10; ++i) {
+      mp::ProblemOverlay overlay;
+      overlay.SetConUB(0, i);
+      driver.AddScenario(fmt::format("scenario{}", i), overlay);
+    }
+    driver.Solve();
+    for (int i = 0; i < 10; ++i)
+      fmt::print("{}\n", driver.result(i).obj_value);
+  \endrst
+ */
+template <typename Solver>
+class ScenarioDriver : public internal::ScenarioDriverBase {
+ public:
+  typedef typename Solver::ProblemBuilder Problem;
+
+  /** The result of solving a scenario. */
+  struct Result {
+    /** Solution status, `mp::sol::UNKNOWN` if not solved. */
+    int status;
+    /** Objective value of the final solution. */
+    double obj_value;
+    /** Solver message or an error message if solving failed. */
+    std::string message;
+
+    Result() : status(sol::UNKNOWN), obj_value(0) {}
+  };
+
+ private:
+  const Problem &base_;
+  std::vector<Solver*> solvers_;
+
+  struct Scenario {
+    std::string stub;
+    ProblemOverlay overlay;
+  };
+  std::vector<Scenario> scenarios_;
+  std::vector<Result> results_;
+  CancellationToken token_;
+  // Scenario tokens which are children of token_.
+  std::vector<CancellationToken*> tokens_;
+
+  // Stores the final solution in a result and writes it to a .sol file.
+  class ResultWriter : public SolutionWriter<Solver> {
+   private:
+    Result &result_;
+
+   public:
+    ResultWriter(fmt::StringRef stub, Solver &s, Problem &p, Result &r)
+      : SolutionWriter<Solver>(stub, s, p), result_(r) {}
+
+    void HandleSolution(int status, fmt::CStringRef message,
+                        const double *values, const double *dual_values,
+                        double obj_value) {
+      result_.status = status;
+      result_.obj_value = obj_value;
+      result_.message = message.c_str();
+      SolutionWriter<Solver>::HandleSolution(
+            status, message, values, dual_values, obj_value);
+    }
+  };
+
+ protected:
+  void SolveScenario(int worker, int scenario);
+
+ public:
+  /**
+    Constructs the driver for a base problem which must not be modified
+    or destroyed while the driver is in use.
+   */
+  explicit ScenarioDriver(const Problem &base, int num_workers = 1)
+    : internal::ScenarioDriverBase(num_workers), base_(base) {
+    solvers_.reserve(this->num_workers());
+    solvers_.push_back(new Solver());
+    // Solve scenarios of a non-reentrant solver one at a time.
+    if ((solvers_[0]->flags() & Solver::REENTRANT) == 0)
+      this->LimitNumWorkers(1);
+    for (int i = 1, n = this->num_workers(); i < n; ++i)
+      solvers_.push_back(new Solver());
+  }
+
+  ~ScenarioDriver() {
+    for (std::size_t i = 0, n = solvers_.size(); i != n; ++i)
+      delete solvers_[i];
+    for (std::size_t i = 0, n = tokens_.size(); i != n; ++i)
+      delete tokens_[i];
+  }
+
+  /** Returns the solver of the worker with the specified index. */
+  Solver &solver(int worker = 0) { return *solvers_[worker]; }
+
+  /** Returns the number of scenarios. */
+  int num_scenarios() const { return static_cast<int>(scenarios_.size()); }
+
+  /**
+    Adds a scenario with the stub used for the name of its ``.sol`` file.
+   */
+  void AddScenario(fmt::StringRef stub, const ProblemOverlay &overlay) {
+    Scenario scenario = {stub.to_string(), overlay};
+    scenarios_.push_back(scenario);
+    tokens_.push_back(0);
+    tokens_.back() = new CancellationToken(&token_);
+  }
+
+  /**
+    Returns the token that cancels all scenarios. It can be used to set
+    a deadline or to cancel on SIGINT.
+   */
+  CancellationToken &token() { return token_; }
+
+  /**
+    Cancels a scenario. Can be called from any thread while `Solve` is
+    running. A scenario that is cancelled before it is started is not
+    solved and gets the `mp::sol::INTERRUPTED` status.
+   */
+  void Cancel(int scenario) {
+    internal::CheckIndex(scenario, tokens_.size());
+    tokens_[scenario]->Cancel();
+  }
+
+  /** Solves all scenarios. */
+  void Solve() {
+    results_.assign(scenarios_.size(), Result());
+    Run(num_scenarios());
+  }
+
+  /** Returns the result of solving the scenario with the specified index. */
+  const Result &result(int scenario) const {
+    internal::CheckIndex(scenario, results_.size());
+    return results_[scenario];
+  }
+};
+
+template <typename Solver>
+void ScenarioDriver<Solver>::SolveScenario(int worker, int scenario) {
+  const Scenario &s = scenarios_[scenario];
+  Result &result = results_[scenario];
+  CancellationToken &token = *tokens_[scenario];
+  if (token.Stop()) {
+    result.status = sol::INTERRUPTED;
+    result.message = "interrupted";
+    return;
+  }
+  Solver &solver = *solvers_[worker];
+  solver.set_interrupter(&token);
+  try {
+    Problem problem;
+    problem.ShareFrom(base_);
+    s.overlay.Apply(problem);
+    ResultWriter writer(s.stub, solver, problem, result);
+    solver.Solve(problem, writer);
+  } catch (const std::exception &e) {
+    result.status = sol::FAILURE;
+    result.message = e.what();
+  }
+  solver.set_interrupter(0);
+}
+
 #ifdef MP_USE_UNIQUE_PTR
 typedef std::unique_ptr<Solver> SolverPtr;
 #else
@@ -23,32 +23,162 @@
 #include "smpswriter/smpswriter.h"
 #include "sp.h"
 #include "mp/expr-visitor.h"
-
-#include <cstdio>  // std::fopen
-#include <limits>  // std::numeric_limits
+#include "mp/os.h"
+
+#include <algorithm>   // std::min
+#include <cmath>       // std::fabs
+#include <cstdio>      // std::fopen
+#include <cstring>     // std::memcpy
+#include <functional>  // std::bind
+#include <limits>      // std::numeric_limits
 #include <string>
 #include <vector>
 
+#ifdef MP_USE_THREAD
+# include <thread>
+#endif
+
 using mp::SPAdapter;
 
 namespace {
 
+// A growable memory buffer for SMPS records. Text is copied as is and
+// numbers are converted directly with the Grisu2 round-trip algorithm,
+// so no format strings are parsed when writing large files.
+class OutputBuffer {
+ private:
+  std::vector<char> data_;
+  std::size_t size_;
+
+  enum { INITIAL_CAPACITY = 1 << 16 };
+
+  // Makes room for n more characters and returns a pointer to them.
+  char *Reserve(std::size_t n) {
+    std::size_t new_size = size_ + n;
+    if (new_size > data_.size())
+      data_.resize(std::max(new_size, 2 * data_.size()));
+    return &data_[size_];
+  }
+
+ public:
+  OutputBuffer() : data_(INITIAL_CAPACITY), size_(0) {}
+
+  const char *data() const { return &data_[0]; }
+  std::size_t size() const { return size_; }
+
+  void clear() { size_ = 0; }
+
+  void Write(const char *s, std::size_t n) {
+    std::memcpy(Reserve(n), s, n);
+    size_ += n;
+  }
+
+  void Write(fmt::StringRef s) { Write(s.data(), s.size()); }
+
+  void Write(char c) {
+    *Reserve(1) = c;
+    ++size_;
+  }
+
+  // Writes value left-aligned in a field of the specified width.
+  void Write(unsigned value, std::size_t width = 0) {
+    fmt::FormatInt f(value);
+    Write(f.data(), f.size());
+    Pad(f.size(), width);
+  }
+
+  // Writes value the same way as fmt::format("{:<width}", value).
+  void Write(double value, std::size_t width = 0);
+
+  // Writes spaces to fill a field of the specified width if its first
+  // size characters have been written.
+  void Pad(std::size_t size, std::size_t width) {
+    if (size >= width)
+      return;
+    std::size_t n = width - size;
+    std::fill_n(Reserve(n), n, ' ');
+    size_ += n;
+  }
+};
+
+void OutputBuffer::Write(double value, std::size_t width) {
+  std::size_t start = size_;
+  if (std::fabs(value) <= std::numeric_limits<double>::max()) {
+    char *p = Reserve(fmt::internal::MAX_SHORTEST_SIZE + 1);
+    if (value < 0 || (value == 0 && 1 / value < 0)) {
+      *p++ = '-';
+      ++size_;
+      value = -value;
+    }
+    size_ += fmt::internal::format_shortest(p, value);
+  } else {
+    // Infinities and NaNs are rare, so use the formatting functions.
+    fmt::MemoryWriter w;
+    w << value;
+    Write(w.data(), w.size());
+  }
+  Pad(size_ - start, width);
+}
+
 class FileWriter {
  private:
   FILE *f_;
+  std::string filename_;
   FMT_DISALLOW_COPY_AND_ASSIGN(FileWriter);
 
  public:
-  FileWriter(fmt::CStringRef filename) : f_(std::fopen(filename.c_str(), "w")) {
+  FileWriter(fmt::CStringRef filename)
+    : f_(std::fopen(filename.c_str(), "w")), filename_(filename.c_str()) {
     if (!f_)
       throw fmt::SystemError(errno, "cannot open file '{}'", filename);
   }
   ~FileWriter() { std::fclose(f_); }
 
-  void Write(fmt::CStringRef format, const fmt::ArgList &args) {
-    fmt::print(f_, format, args);
+  void Write(const OutputBuffer &buffer) {
+    std::size_t size = buffer.size();
+    if (std::fwrite(buffer.data(), 1, size, f_) != size)
+      throw fmt::SystemError(errno, "cannot write to file '{}'", filename_);
   }
-  FMT_VARIADIC(void, Write, fmt::CStringRef)
+};
+
+// Names of columns or rows such as "C1" left-aligned in fixed-width fields
+// of the form "C{:<7}". The names are formatted once and copied into
+// the output for every record that refers to them.
+class NameTable {
+ private:
+  std::vector<char> chars_;
+  std::vector<int> starts_;
+
+  enum { WIDTH = 8 };
+
+ public:
+  NameTable(char prefix, int num_names);
+
+  fmt::StringRef operator[](int index) const {
+    return fmt::StringRef(&chars_[starts_[index]],
+                          starts_[index + 1] - starts_[index]);
+  }
+};
+
+NameTable::NameTable(char prefix, int num_names) : starts_(num_names + 1) {
+  chars_.reserve(static_cast<std::size_t>(num_names) * WIDTH);
+  for (int i = 0; i < num_names; ++i) {
+    fmt::FormatInt f(i + 1);
+    chars_.push_back(prefix);
+    chars_.insert(chars_.end(), f.data(), f.data() + f.size());
+    if (f.size() + 1 < WIDTH)
+      chars_.resize(chars_.size() + WIDTH - 1 - f.size(), ' ');
+    starts_[i + 1] = static_cast<int>(chars_.size());
+  }
+}
+
+// Column and row names of the core problem.
+struct Names {
+  NameTable cols;
+  NameTable rows;
+
+  explicit Names(const SPAdapter &sp)
+    : cols('C', sp.num_vars()), rows('R', sp.num_cons()) {}
 };
 
 char GetConRHSAndType(double lb, double ub, double &rhs) {
@@ -66,17 +196,21 @@ char GetConRHSAndType(double lb, double ub, double &rhs) {
 }
 
 void WriteTimeFile(fmt::CStringRef filename, const SPAdapter &sp) {
-  FileWriter writer(filename);
-  writer.Write(
+  OutputBuffer buffer;
+  buffer.Write(
     "TIME          PROBLEM\n"
     "PERIODS\n"
     "    C1        OBJ                      T1\n");
   if (sp.num_stages() > 1) {
     auto stage0 = sp.stage(0);
-    writer.Write("    C{:<7}  R{:<7}                 T2\n",
-                 stage0.num_vars() + 1, stage0.num_cons() + 1);
+    buffer.Write("    C");
+    buffer.Write(static_cast<unsigned>(stage0.num_vars() + 1), 7);
+    buffer.Write("  R");
+    buffer.Write(static_cast<unsigned>(stage0.num_cons() + 1), 7);
+    buffer.Write("                 T2\n");
   }
-  writer.Write("ENDATA\n");
+  buffer.Write("ENDATA\n");
+  FileWriter(filename).Write(buffer);
 }
 
 class RHSHandler {
@@ -90,26 +224,40 @@ class RHSHandler {
   void OnRHS(int con_index, double offset) { rhs_[con_index] += offset; }
 };
 
+// Writes a constraint matrix element or a right-hand side record.
+inline void WriteRecord(OutputBuffer &buffer, fmt::StringRef col_name,
+                        fmt::StringRef row_name, double value) {
+  buffer.Write("    ");
+  buffer.Write(col_name);
+  buffer.Write("  ");
+  buffer.Write(row_name);
+  buffer.Write("  ");
+  buffer.Write(value);
+  buffer.Write('\n');
+}
+
 class ScenarioWriter {
  private:
-  FileWriter &writer_;
+  OutputBuffer &buffer_;
+  const Names &names_;
 
  public:
-  explicit ScenarioWriter(FileWriter &w) : writer_(w) {}
+  ScenarioWriter(OutputBuffer &buffer, const Names &names)
+    : buffer_(buffer), names_(names) {}
 
   void OnTerm(int con_index, int var_index, double coef) {
-    writer_.Write("    C{:<7}  R{:<7}  {}\n",
-                  var_index + 1, con_index + 1, coef);
+    WriteRecord(buffer_, names_.cols[var_index], names_.rows[con_index], coef);
   }
 
   void OnRHS(int con_index, double offset) {
-    writer_.Write("    RHS1      R{:<7}  {}\n", con_index + 1, offset);
+    WriteRecord(buffer_, "RHS1    ", names_.rows[con_index], offset);
   }
 };
 
-void WriteCoreFile(fmt::CStringRef filename, const SPAdapter &sp) {
-  FileWriter writer(filename);
-  writer.Write(
+void WriteCoreFile(fmt::CStringRef filename, const SPAdapter &sp,
+                   const Names &names) {
+  OutputBuffer buffer;
+  buffer.Write(
     "NAME          PROBLEM\n"
     "ROWS\n"
     " N  OBJ\n");
@@ -117,13 +265,16 @@ void WriteCoreFile(fmt::CStringRef filename, const SPAdapter &sp) {
   std::vector<double> core_rhs(num_core_cons);
   for (int i = 0; i < num_core_cons; ++i) {
     auto con = sp.con(i);
-    writer.Write(" {}  R{}\n",
-                 GetConRHSAndType(con.lb(), con.ub(), core_rhs[i]), i + 1);
+    buffer.Write(' ');
+    buffer.Write(GetConRHSAndType(con.lb(), con.ub(), core_rhs[i]));
+    buffer.Write("  R");
+    buffer.Write(static_cast<unsigned>(i + 1));
+    buffer.Write('\n');
   }
 
   int int_var_index = 0;
   bool integer_block = false;
-  writer.Write("COLUMNS\n");
+  buffer.Write("COLUMNS\n");
   int num_core_vars = sp.num_vars();
   auto obj = sp.obj(0).linear_expr();
   auto obj_term = obj.begin(), obj_end = obj.end();
@@ -131,98 +282,177 @@ void WriteCoreFile(fmt::CStringRef filename, const SPAdapter &sp) {
     auto var = sp.var(i);
     if (var.type() == mp::var::CONTINUOUS) {
       if (integer_block) {
-        writer.Write("    INT{:<5}    'MARKER'      'INTEND'\n", int_var_index);
+        buffer.Write("    INT");
+        buffer.Write(static_cast<unsigned>(int_var_index), 5);
+        buffer.Write("    'MARKER'      'INTEND'\n");
         integer_block = false;
       }
     } else if (!integer_block) {
-      writer.Write("    INT{:<5}    'MARKER'      'INTORG'\n", ++int_var_index);
+      buffer.Write("    INT");
+      buffer.Write(static_cast<unsigned>(++int_var_index), 5);
+      buffer.Write("    'MARKER'      'INTORG'\n");
       integer_block = true;
     }
 
-    if (i == obj_term->var_index()) {
-      writer.Write("    C{:<7}  OBJ       {}\n", i + 1, obj_term->coef());
-      if (obj_term != obj_end)
-        ++obj_term;
+    fmt::StringRef col_name = names.cols[i];
+    if (obj_term != obj_end && i == obj_term->var_index()) {
+      WriteRecord(buffer, col_name, "OBJ     ", obj_term->coef());
+      ++obj_term;
     }
     auto column = sp.column(i);
     for (auto term = column.begin(), end = column.end(); term != end; ++term) {
       // TODO: merge with the first scenario
-      writer.Write("    C{:<7}  R{:<7}  {}\n",
-                   i + 1, term->con_index() + 1, term->coef());
+      WriteRecord(buffer, col_name, names.rows[term->con_index()],
+                  term->coef());
     }
   }
-  if (integer_block)
-    writer.Write("    INT{:<5}    'MARKER'      'INTEND'\n", int_var_index);
+  if (integer_block) {
+    buffer.Write("    INT");
+    buffer.Write(static_cast<unsigned>(int_var_index), 5);
+    buffer.Write("    'MARKER'      'INTEND'\n");
+  }
 
   RHSHandler handler(core_rhs);
   sp.GetScenario(0, handler);
 
-  writer.Write("RHS\n");
+  buffer.Write("RHS\n");
   for (int i = 0; i < num_core_cons; ++i) {
     if (auto rhs = core_rhs[i])
-      writer.Write("    RHS1      R{:<7}  {}\n", i + 1, rhs);
+      WriteRecord(buffer, "RHS1    ", names.rows[i], rhs);
   }
 
-  class BoundsWriter {
-   private:
-    FileWriter &writer;
-    bool has_bounds_;
-
-   public:
-    explicit BoundsWriter(FileWriter &w) : writer(w), has_bounds_(false) {}
-
-    FileWriter &get() {
-      if (!has_bounds_) {
-        writer.Write("BOUNDS\n");
-        has_bounds_ = true;
-      }
-      return writer;
-    }
-  } bw(writer);
-
+  bool has_bounds = false;
   double inf = std::numeric_limits<double>::infinity();
   for (int i = 0; i < num_core_vars; ++i) {
     auto var = sp.var(i);
     double lb = var.lb(), ub = var.ub();
-    if (lb != 0)
-      bw.get().Write(" LO BOUND1      C{:<7}  {}\n", i + 1, lb);
-    if (ub < inf)
-      bw.get().Write(" UP BOUND1      C{:<7}  {}\n", i + 1, ub);
+    if (lb == 0 && ub >= inf)
+      continue;
+    if (!has_bounds) {
+      buffer.Write("BOUNDS\n");
+      has_bounds = true;
+    }
+    if (lb != 0) {
+      buffer.Write(" LO BOUND1      ");
+      buffer.Write(names.cols[i]);
+      buffer.Write("  ");
+      buffer.Write(lb);
+      buffer.Write('\n');
+    }
+    if (ub < inf) {
+      buffer.Write(" UP BOUND1      ");
+      buffer.Write(names.cols[i]);
+      buffer.Write("  ");
+      buffer.Write(ub);
+      buffer.Write('\n');
+    }
   }
-  writer.Write("ENDATA\n");
+  buffer.Write("ENDATA\n");
+  FileWriter(filename).Write(buffer);
 }
 
-void WriteDiscreteScenarios(FileWriter &writer, const SPAdapter &sp) {
-  assert(sp.num_rvs() == 1);
-  const auto &rv = sp.rv(0);
-  writer.Write("SCENARIOS     DISCRETE\n");
-  writer.Write(" SC SCEN1     'ROOT'    {:<12}   T1\n", rv.probability(0));
-  for (size_t s = 1, num_scen = rv.num_realizations(); s < num_scen; ++s) {
-    writer.Write(" SC SCEN{:<4}  SCEN1     {:<12}   T2\n",
-                 s + 1, rv.probability(s));
-    ScenarioWriter sw(writer);
-    sp.GetScenario(s, sw);
+// Writes scenarios to the .sto file. Scenarios are split into blocks of
+// BLOCK_SIZE and each round writes up to num_threads blocks in parallel,
+// one buffer per block. The buffers are then written to the file in order,
+// so the output doesn't depend on the number of threads and the memory
+// is bounded by the size of a round.
+class DiscreteScenarioWriter {
+ private:
+  const SPAdapter &sp_;
+  const Names &names_;
+  int num_scenarios_;
+  int round_start_;  // The first scenario of the current round.
+  std::vector<OutputBuffer> buffers_;
+
+  enum { BLOCK_SIZE = 256 };
+
+  void WriteBlock(int block);
+
+ public:
+  DiscreteScenarioWriter(const SPAdapter &sp, const Names &names)
+    : sp_(sp), names_(names), num_scenarios_(sp.rv(0).num_realizations()),
+      round_start_(0) {}
+
+  void Write(FileWriter &writer, int num_threads);
+};
+
+void DiscreteScenarioWriter::WriteBlock(int block) {
+  OutputBuffer &buffer = buffers_[block];
+  buffer.clear();
+  const auto &rv = sp_.rv(0);
+  ScenarioWriter sw(buffer, names_);
+  int start = round_start_ + block * BLOCK_SIZE;
+  for (int s = start, end = std::min(start + BLOCK_SIZE, num_scenarios_);
+       s < end; ++s) {
+    buffer.Write(" SC SCEN");
+    buffer.Write(static_cast<unsigned>(s + 1), 4);
+    buffer.Write("  SCEN1     ");
+    buffer.Write(rv.probability(s), 12);
+    buffer.Write("   T2\n");
+    sp_.GetScenario(s, sw);
+  }
+}
+
+void DiscreteScenarioWriter::Write(FileWriter &writer, int num_threads) {
+  // The first scenario is the root written with the core problem.
+  int num_blocks = (num_scenarios_ - 1 + BLOCK_SIZE - 1) / BLOCK_SIZE;
+#ifdef MP_USE_THREAD
+  if (num_threads <= 0)
+    num_threads = static_cast<int>(std::thread::hardware_concurrency());
+#else
+  num_threads = 1;
+#endif
+  int max_blocks_per_round = std::max(std::min(num_threads, num_blocks), 1);
+  buffers_.resize(max_blocks_per_round);
+  for (round_start_ = 1; round_start_ < num_scenarios_;
+       round_start_ += max_blocks_per_round * BLOCK_SIZE) {
+    int num_round_blocks = std::min(
+          max_blocks_per_round,
+          (num_scenarios_ - round_start_ + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    mp::internal::RunInParallel(
+          num_round_blocks, std::bind(&DiscreteScenarioWriter::WriteBlock,
+                                      this, std::placeholders::_1));
+    for (int i = 0; i < num_round_blocks; ++i)
+      writer.Write(buffers_[i]);
   }
 }
 
-void WriteStochFile(fmt::CStringRef filename, const SPAdapter &sp) {
+void WriteDiscreteScenarios(FileWriter &writer, const SPAdapter &sp,
+                            const Names &names, int num_threads) {
+  assert(sp.num_rvs() == 1);
+  OutputBuffer buffer;
+  buffer.Write("SCENARIOS     DISCRETE\n");
+  buffer.Write(" SC SCEN1     'ROOT'    ");
+  buffer.Write(sp.rv(0).probability(0), 12);
+  buffer.Write("   T1\n");
+  writer.Write(buffer);
+  DiscreteScenarioWriter(sp, names).Write(writer, num_threads);
+}
+
+void WriteStochFile(fmt::CStringRef filename, const SPAdapter &sp,
+                    const Names &names, int num_threads) {
   FileWriter writer(filename);
-  writer.Write("STOCH         PROBLEM\n");
+  OutputBuffer buffer;
+  buffer.Write("STOCH         PROBLEM\n");
+  writer.Write(buffer);
   if (sp.num_stages() > 1) {
     int num_rvs = sp.num_rvs();
     if (num_rvs == 1)
-      WriteDiscreteScenarios(writer, sp);
+      WriteDiscreteScenarios(writer, sp, names, num_threads);
     else
       throw mp::Error("unsupported RV");
   }
-  writer.Write("ENDATA\n");
+  buffer.clear();
+  buffer.Write("ENDATA\n");
+  writer.Write(buffer);
 }
 }  // namespace
 
 namespace mp {
 
 SMPSWriter::SMPSWriter()
-  : SolverImpl<ColProblem>("smpswriter", "SMPSWriter", 20160620) {
+  : SolverImpl<ColProblem>("smpswriter", "SMPSWriter", 20160620),
+    num_threads_(0) {
   AddSuffix("stage", 0, suf::VAR);
 }
 
@@ -232,9 +462,10 @@ void SMPSWriter::Solve(ColProblem &p, SolutionHandler &) {
   std::string::size_type ext_pos = smps_basename.rfind('.');
   if (ext_pos != std::string::npos)
     smps_basename.resize(ext_pos);
+  Names names(sp);
   WriteTimeFile(smps_basename + ".tim", sp);
-  WriteCoreFile(smps_basename + ".cor", sp);
-  WriteStochFile(smps_basename + ".sto", sp);
+  WriteCoreFile(smps_basename + ".cor", sp, names);
+  WriteStochFile(smps_basename + ".sto", sp, names, num_threads_);
 }
 
 SolverPtr create_smpswriter(const char *) {
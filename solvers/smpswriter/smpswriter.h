@@ -30,6 +30,7 @@ namespace mp {
 class SMPSWriter : public SolverImpl<ColProblem> {
  private:
   std::string basename_;
+  int num_threads_;
 
  public:
   SMPSWriter();
@@ -40,6 +41,11 @@ class SMPSWriter : public SolverImpl<ColProblem> {
     basename_ = basename.to_string();
   }
 
+  // Sets the number of threads used to write scenarios. If num_threads
+  // is 0, the number of hardware threads is used. The output doesn't
+  // depend on the number of threads.
+  void set_num_threads(int num_threads) { num_threads_ = num_threads; }
+
   void Solve(ColProblem &p, SolutionHandler &sh);
 };
 }
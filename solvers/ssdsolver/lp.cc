@@ -0,0 +1,264 @@
+/*
+ LP backends for the SSD cutting-plane method.
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include "ssdsolver/lp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace {
+
+// A bound used instead of an infinite one for nonbasic variables.
+const double ARTIFICIAL_BOUND = 1e7;
+
+// Primal feasibility tolerance.
+const double FEASIBILITY_TOL = 1e-9;
+
+// Dual feasibility tolerance used in the ratio test.
+const double OPTIMALITY_TOL = 1e-9;
+
+// The minimum absolute value of a pivot element.
+const double PIVOT_TOL = 1e-9;
+
+const double INF = std::numeric_limits<double>::infinity();
+}  // namespace
+
+int mp::DualSimplex::AddVar(double lb, double ub, double cost) {
+  Var var = {lb, ub, cost, 0, FREE};
+  vars_.push_back(var);
+  for (std::size_t i = 0, n = tableau_.size(); i != n; ++i)
+    tableau_[i].push_back(0);
+  reduced_costs_.push_back(cost);
+  return static_cast<int>(vars_.size() - 1);
+}
+
+void mp::DualSimplex::MakeNonbasic(int var_index) {
+  Var &var = vars_[var_index];
+  double d = reduced_costs_[var_index];
+  if (d > 0 || (d == 0 && var.lb == -INF && var.ub != INF)) {
+    var.status = AT_UB;
+    var.value = var.ub != INF ? var.ub : ARTIFICIAL_BOUND;
+  } else if (d < 0 || var.lb != -INF) {
+    var.status = AT_LB;
+    var.value = var.lb != -INF ? var.lb : -ARTIFICIAL_BOUND;
+  } else {
+    var.status = FREE;
+    var.value = 0;
+  }
+}
+
+void mp::DualSimplex::ComputeBasicValues() {
+  for (std::size_t i = 0, n = tableau_.size(); i != n; ++i) {
+    const double *row = &tableau_[i][0];
+    double value = 0;
+    for (std::size_t j = 0, num_vars = vars_.size(); j != num_vars; ++j) {
+      if (row[j] != 0 && vars_[j].status != BASIC)
+        value -= row[j] * vars_[j].value;
+    }
+    vars_[head_[i]].value = value;
+  }
+}
+
+void mp::DualSimplex::Pivot(int row, int var_index) {
+  std::size_t num_vars = vars_.size();
+  std::vector<double> &pivot_row = tableau_[row];
+  double scale = 1 / pivot_row[var_index];
+  for (std::size_t j = 0; j != num_vars; ++j)
+    pivot_row[j] *= scale;
+  pivot_row[var_index] = 1;
+  for (std::size_t i = 0, n = tableau_.size(); i != n; ++i) {
+    if (i == static_cast<std::size_t>(row))
+      continue;
+    std::vector<double> &r = tableau_[i];
+    double factor = r[var_index];
+    if (factor == 0)
+      continue;
+    for (std::size_t j = 0; j != num_vars; ++j)
+      r[j] -= factor * pivot_row[j];
+    r[var_index] = 0;
+  }
+  double factor = reduced_costs_[var_index];
+  for (std::size_t j = 0; j != num_vars; ++j)
+    reduced_costs_[j] -= factor * pivot_row[j];
+  reduced_costs_[var_index] = 0;
+  head_[row] = var_index;
+  vars_[var_index].status = BASIC;
+}
+
+void mp::DualSimplex::Load(const Problem &p) {
+  if (p.num_objs() > 1 || p.has_nonlinear_cons() ||
+      p.num_logical_cons() != 0 || p.num_common_exprs() != 0 ||
+      (p.num_objs() != 0 && p.obj(0).nonlinear_expr())) {
+    throw Error("DualSimplex: only linear problems are supported");
+  }
+  vars_.clear();
+  tableau_.clear();
+  head_.clear();
+  reduced_costs_.clear();
+  num_iterations_ = 0;
+  num_structural_vars_ = p.num_vars();
+  for (int j = 0; j < num_structural_vars_; ++j)
+    AddVar(p.var(j).lb(), p.var(j).ub(), 0);
+  if (p.num_objs() != 0) {
+    Problem::Objective obj = p.obj(0);
+    double sign = obj.type() == obj::MIN ? -1 : 1;
+    const LinearExpr &linear = obj.linear_expr();
+    for (LinearExpr::iterator i = linear.begin(), e = linear.end(); i != e; ++i)
+      vars_[i->var_index()].cost = reduced_costs_[i->var_index()] =
+          sign * i->coef();
+  }
+  for (int j = 0; j < num_structural_vars_; ++j)
+    MakeNonbasic(j);
+  std::vector<int> indices;
+  std::vector<double> coefs;
+  for (int i = 0, n = p.num_algebraic_cons(); i < n; ++i) {
+    Problem::AlgebraicCon con = p.algebraic_con(i);
+    const LinearExpr &linear = con.linear_expr();
+    indices.clear();
+    coefs.clear();
+    for (LinearExpr::iterator
+         j = linear.begin(), e = linear.end(); j != e; ++j) {
+      indices.push_back(j->var_index());
+      coefs.push_back(j->coef());
+    }
+    AddRow(con.lb(), con.ub(), linear.num_terms(),
+           indices.empty() ? 0 : &indices[0], coefs.empty() ? 0 : &coefs[0]);
+  }
+}
+
+void mp::DualSimplex::AddRow(double lb, double ub, int num_terms,
+                             const int *vars, const double *coefs) {
+  // The row variable r = sum(coefs[k] * x[vars[k]]) is basic in the new
+  // tableau row r - sum(coefs[k] * x[vars[k]]) = 0 after basic variables
+  // are eliminated from it.
+  int var_index = AddVar(lb, ub, 0);
+  vars_[var_index].status = BASIC;
+  std::size_t num_vars = vars_.size();
+  std::vector<double> row(num_vars);
+  row[var_index] = 1;
+  for (int k = 0; k < num_terms; ++k) {
+    MP_ASSERT(0 <= vars[k] && vars[k] < num_structural_vars_,
+              "invalid index");
+    row[vars[k]] -= coefs[k];
+  }
+  for (std::size_t i = 0, n = tableau_.size(); i != n; ++i) {
+    double factor = row[head_[i]];
+    if (factor == 0)
+      continue;
+    const double *r = &tableau_[i][0];
+    for (std::size_t j = 0; j != num_vars; ++j)
+      row[j] -= factor * r[j];
+    row[head_[i]] = 0;
+  }
+  double value = 0;
+  for (std::size_t j = 0; j != num_vars; ++j) {
+    if (row[j] != 0 && vars_[j].status != BASIC)
+      value -= row[j] * vars_[j].value;
+  }
+  vars_[var_index].value = value;
+  tableau_.push_back(row);
+  head_.push_back(var_index);
+}
+
+int mp::DualSimplex::Optimize() {
+  int num_rows = static_cast<int>(tableau_.size());
+  int num_vars = static_cast<int>(vars_.size());
+  int max_iterations = num_iterations_ + 50 * (num_rows + num_vars) + 1000;
+  for (;;) {
+    // Choose the leaving variable with the largest infeasibility.
+    int row = -1;
+    double max_infeasibility = FEASIBILITY_TOL;
+    for (int i = 0; i < num_rows; ++i) {
+      const Var &var = vars_[head_[i]];
+      double infeasibility = std::max(var.lb - var.value, var.value - var.ub);
+      if (infeasibility > max_infeasibility) {
+        max_infeasibility = infeasibility;
+        row = i;
+      }
+    }
+    if (row < 0)
+      break;
+    if (num_iterations_ == max_iterations)
+      return sol::LIMIT;
+    ++num_iterations_;
+
+    // The leaving variable is increased to its lower bound if it is below
+    // it and decreased to its upper bound otherwise. Changing a nonbasic
+    // variable x[j] by delta changes the leaving one by -alpha[j] * delta.
+    const Var &leaving = vars_[head_[row]];
+    bool increase = leaving.value < leaving.lb;
+    const double *alpha = &tableau_[row][0];
+
+    // Ratio test with Harris tolerances: find the maximum step in the dual
+    // with relaxed dual feasibility and then choose the largest pivot
+    // among the candidates within this step.
+    double max_step = INF;
+    for (int j = 0; j < num_vars; ++j) {
+      VarStatus status = vars_[j].status;
+      if (status == BASIC || vars_[j].lb == vars_[j].ub)
+        continue;
+      double a = increase ? -alpha[j] : alpha[j];
+      if (status == AT_LB ? a <= PIVOT_TOL :
+          status == AT_UB ? a >= -PIVOT_TOL : std::fabs(a) <= PIVOT_TOL)
+        continue;
+      double step = (std::fabs(reduced_costs_[j]) + OPTIMALITY_TOL) /
+          std::fabs(a);
+      if (step < max_step)
+        max_step = step;
+    }
+    int entering = -1;
+    double max_pivot = 0;
+    for (int j = 0; j < num_vars; ++j) {
+      VarStatus status = vars_[j].status;
+      if (status == BASIC || vars_[j].lb == vars_[j].ub)
+        continue;
+      double a = increase ? -alpha[j] : alpha[j];
+      if (status == AT_LB ? a <= PIVOT_TOL :
+          status == AT_UB ? a >= -PIVOT_TOL : std::fabs(a) <= PIVOT_TOL)
+        continue;
+      if (std::fabs(reduced_costs_[j]) / std::fabs(a) <= max_step &&
+          std::fabs(a) > max_pivot) {
+        max_pivot = std::fabs(a);
+        entering = j;
+      }
+    }
+    if (entering < 0)
+      return sol::INFEASIBLE;
+
+    Var &var = vars_[head_[row]];
+    var.status = increase ? AT_LB : AT_UB;
+    var.value = increase ? var.lb : var.ub;
+    Pivot(row, entering);
+    ComputeBasicValues();
+  }
+
+  // The problem is unbounded if a nonbasic variable is at an artificial
+  // bound.
+  for (int j = 0; j < num_vars; ++j) {
+    const Var &var = vars_[j];
+    if ((var.status == AT_LB && var.lb == -INF) ||
+        (var.status == AT_UB && var.ub == INF)) {
+      return sol::UNBOUNDED;
+    }
+  }
+  return sol::SOLVED;
+}
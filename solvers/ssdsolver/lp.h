@@ -0,0 +1,140 @@
+/*
+ LP backends for the SSD cutting-plane method.
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#ifndef MP_SOLVERS_LP_H_
+#define MP_SOLVERS_LP_H_
+
+#include <memory>
+#include <vector>
+
+#include "mp/problem.h"
+
+namespace mp {
+
+// An LP solver that keeps the problem and the basis between solves so that
+// rows can be added and the problem reoptimized starting from the previous
+// basis instead of being converted and solved from scratch.
+class LPBackend {
+ public:
+  virtual ~LPBackend() {}
+
+  // Loads a linear problem with at most one objective.
+  virtual void Load(const Problem &p) = 0;
+
+  // Adds a row lb <= sum(coefs[i] * x[vars[i]]) <= ub.
+  virtual void AddRow(double lb, double ub, int num_terms,
+                      const int *vars, const double *coefs) = 0;
+
+  // Optimizes the problem starting from the last basis and returns
+  // the solution status, one of the sol::Status values.
+  virtual int Optimize() = 0;
+
+  // Returns the value of a variable in the last solution.
+  virtual double value(int var_index) const = 0;
+};
+
+#ifdef MP_USE_UNIQUE_PTR
+typedef std::unique_ptr<LPBackend> LPBackendPtr;
+#else
+typedef std::auto_ptr<LPBackend> LPBackendPtr;
+#endif
+
+// A bounded dual simplex method on a dense tableau.
+//
+// This is a lightweight backend for small problems and for testing when
+// no other LP solver is available. The basis remains dual feasible when
+// a row is added so the problem is reoptimized with a few pivots. Adding
+// a row eliminates the basic variables from it against the dense tableau,
+// which takes O(rows * vars) time regardless of the number of its terms.
+// Infinite bounds of nonbasic variables required for dual feasibility are
+// replaced with large artificial ones and the problem is reported
+// unbounded if the optimal basis relies on an artificial bound.
+class DualSimplex : public LPBackend {
+ private:
+  enum VarStatus {
+    BASIC,
+    AT_LB,  // Nonbasic at the lower bound.
+    AT_UB,  // Nonbasic at the upper bound.
+    FREE    // Nonbasic free variable at zero.
+  };
+
+  struct Var {
+    double lb;
+    double ub;
+    double cost;
+    double value;
+    VarStatus status;
+  };
+
+  // Structural variables followed by one logical variable per row equal
+  // to the row activity.
+  std::vector<Var> vars_;
+  int num_structural_vars_;
+
+  // The tableau with one row per basic variable. Row i expresses the basic
+  // variable head_[i] in terms of nonbasic ones as
+  //   sum(tableau_[i][j] * x[j]) = 0,
+  // where tableau_[i][head_[i]] = 1.
+  std::vector< std::vector<double> > tableau_;
+  std::vector<int> head_;
+
+  // Reduced costs of the maximization problem.
+  std::vector<double> reduced_costs_;
+
+  int num_iterations_;
+
+  // Adds a variable with a zero tableau column and returns its index.
+  int AddVar(double lb, double ub, double cost);
+
+  // Makes a variable nonbasic at the bound that keeps the basis dual
+  // feasible.
+  void MakeNonbasic(int var_index);
+
+  // Computes values of basic variables from the values of nonbasic ones.
+  void ComputeBasicValues();
+
+  // Replaces the basic variable in row with var_index which is
+  // a pivot operation on the tableau.
+  void Pivot(int row, int var_index);
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(DualSimplex);
+
+ public:
+  DualSimplex() : num_structural_vars_(0), num_iterations_(0) {}
+
+  void Load(const Problem &p);
+
+  void AddRow(double lb, double ub, int num_terms,
+              const int *vars, const double *coefs);
+
+  int Optimize();
+
+  double value(int var_index) const {
+    MP_ASSERT(0 <= var_index && var_index < num_structural_vars_,
+              "invalid index");
+    return vars_[var_index].value;
+  }
+
+  // Returns the total number of simplex iterations.
+  int num_iterations() const { return num_iterations_; }
+};
+}  // namespace mp
+
+#endif  // MP_SOLVERS_LP_H_
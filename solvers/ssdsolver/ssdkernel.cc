@@ -0,0 +1,462 @@
+/*
+ Tail and cut kernel for the SSD cutting-plane method.
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include "ssdsolver/ssdkernel.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <limits>
+
+#include "mp/os.h"
+
+#ifdef MP_USE_THREAD
+# include <thread>
+#endif
+
+namespace {
+
+// The minimum number of coefficients processed by a thread.
+const double MIN_WORK_PER_THREAD = 1 << 16;
+
+// The maximum number of cuts aggregated from the previous one before
+// a cut is recomputed from scratch to avoid accumulation of rounding
+// errors.
+const int MAX_CUT_UPDATES = 16;
+
+struct ValueScenario {
+  double value;
+  int scenario;
+};
+
+struct ValueLess {
+  bool operator()(const ValueScenario &lhs, const ValueScenario &rhs) const {
+    return lhs.value < rhs.value;
+  }
+};
+
+// Returns the number of threads to process work coefficients.
+int GetNumThreads(int max_threads, double work) {
+  int num_threads = static_cast<int>(work / MIN_WORK_PER_THREAD);
+  return std::max(std::min(max_threads, num_threads), 1);
+}
+
+// Returns the start of a block when size items are split into num_blocks
+// contiguous blocks of nearly equal size.
+inline int BlockStart(int size, int num_blocks, int block) {
+  return static_cast<int>(static_cast<long long>(size) * block / num_blocks);
+}
+
+// Returns the dot product of vectors a and b of size n.
+inline double Dot(const double *a, const double *b, int n) {
+  // Use independent partial sums to allow vectorization of the loop.
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  int j = 0;
+  for (; j + 4 <= n; j += 4) {
+    s0 += a[j] * b[j];
+    s1 += a[j + 1] * b[j + 1];
+    s2 += a[j + 2] * b[j + 2];
+    s3 += a[j + 3] * b[j + 3];
+  }
+  for (; j < n; ++j)
+    s0 += a[j] * b[j];
+  return (s0 + s1) + (s2 + s3);
+}
+
+// Adds sign * row to sums where row and sums are vectors of size n.
+inline void AddRow(double *sums, const double *row, int n, double sign) {
+  if (sign > 0) {
+    for (int j = 0; j < n; ++j)
+      sums[j] += row[j];
+  } else {
+    for (int j = 0; j < n; ++j)
+      sums[j] -= row[j];
+  }
+}
+}  // namespace
+
+mp::SSDMatrix::Layout mp::SSDMatrix::ChooseLayout(
+    int num_rows, int num_cols, std::size_t num_nonzeros) {
+  // CSR takes less memory than a dense matrix if less than 2/3 of elements
+  // are nonzero, but its indirect access makes it slower to process unless
+  // the matrix is sparser than that.
+  double size = static_cast<double>(num_rows) * num_cols;
+  return num_nonzeros < size / 2 ? CSR : DENSE;
+}
+
+void mp::SSDMatrix::Assign(Layout layout, int num_cols,
+                           std::vector<std::size_t> &row_starts,
+                           std::vector<int> &col_indices,
+                           std::vector<double> &values) {
+  MP_ASSERT(!row_starts.empty() && row_starts.back() == values.size() &&
+            col_indices.size() == values.size(), "invalid matrix");
+  int num_rows = static_cast<int>(row_starts.size() - 1);
+  if (layout == AUTO)
+    layout = ChooseLayout(num_rows, num_cols, values.size());
+  layout_ = layout;
+  num_rows_ = num_rows;
+  num_cols_ = num_cols;
+  if (layout == CSR) {
+    row_starts_.swap(row_starts);
+    col_indices_.swap(col_indices);
+    values_.swap(values);
+    return;
+  }
+  std::vector<std::size_t>().swap(row_starts_);
+  std::vector<int>().swap(col_indices_);
+  values_.assign(static_cast<std::size_t>(num_rows) * num_cols, 0);
+  for (int i = 0; i < num_rows; ++i) {
+    for (std::size_t k = row_starts[i], end = row_starts[i + 1];
+         k != end; ++k) {
+      int col = col_indices[k];
+      MP_ASSERT(0 <= col && col < num_cols, "invalid index");
+      std::size_t index = 0;
+      if (layout == DENSE) {
+        index = static_cast<std::size_t>(i) * num_cols + col;
+      } else {
+        int block = col / BLOCK_SIZE;
+        index = static_cast<std::size_t>(num_rows) * block * BLOCK_SIZE +
+            static_cast<std::size_t>(i) * block_size(block) +
+            col % BLOCK_SIZE;
+      }
+      values_[index] = values[k];
+    }
+  }
+  // Release the memory occupied by the sparse matrix.
+  std::vector<std::size_t>().swap(row_starts);
+  std::vector<int>().swap(col_indices);
+  std::vector<double>().swap(values);
+}
+
+void mp::SSDMatrix::Assign(
+    Layout layout, int num_rows, int num_cols, const double *coefs) {
+  std::vector<std::size_t> row_starts(1);
+  std::vector<int> col_indices;
+  std::vector<double> values;
+  for (int i = 0; i < num_rows; ++i) {
+    const double *row = coefs + static_cast<std::size_t>(i) * num_cols;
+    for (int j = 0; j < num_cols; ++j) {
+      if (row[j] == 0) continue;
+      col_indices.push_back(j);
+      values.push_back(row[j]);
+    }
+    row_starts.push_back(values.size());
+  }
+  Assign(layout, num_cols, row_starts, col_indices, values);
+}
+
+mp::SSDKernel::SSDKernel(const SSDMatrix &matrix, int num_threads)
+  : matrix_(matrix), num_scenarios_(matrix.num_rows()),
+    num_vars_(matrix.num_cols()), num_threads_(num_threads),
+    values_(num_scenarios_), order_(num_scenarios_), tails_(num_scenarios_),
+    cut_(num_vars_), in_cut_(num_scenarios_), num_updates_(0) {
+#ifdef MP_USE_THREAD
+  if (num_threads_ <= 0)
+    num_threads_ = static_cast<int>(std::thread::hardware_concurrency());
+#else
+  num_threads_ = 1;
+#endif
+  num_threads_ = std::max(num_threads_, 1);
+  for (int i = 0; i < num_scenarios_; ++i)
+    order_[i] = i;
+}
+
+void mp::SSDKernel::ComputeValues(const double *x, int start, int end) {
+  const double *coefs = matrix_.values();
+  switch (matrix_.layout()) {
+  case SSDMatrix::CSR: {
+    const int *cols = matrix_.col_indices();
+    const std::size_t *row_starts = matrix_.row_starts();
+    for (int i = start; i < end; ++i) {
+      double s0 = 0, s1 = 0;
+      std::size_t k = row_starts[i], row_end = row_starts[i + 1];
+      for (; k + 2 <= row_end; k += 2) {
+        s0 += coefs[k] * x[cols[k]];
+        s1 += coefs[k + 1] * x[cols[k + 1]];
+      }
+      if (k != row_end)
+        s0 += coefs[k] * x[cols[k]];
+      values_[i] = s0 + s1;
+    }
+    break;
+  }
+  case SSDMatrix::COLUMN_BLOCKED:
+    std::fill(values_.begin() + start, values_.begin() + end, 0);
+    for (int b = 0, num_blocks = matrix_.num_blocks(); b < num_blocks; ++b) {
+      const double *block_x = x + b * SSDMatrix::BLOCK_SIZE;
+      int size = matrix_.block_size(b);
+      for (int i = start; i < end; ++i)
+        values_[i] += Dot(matrix_.block_row(b, i), block_x, size);
+    }
+    break;
+  default:
+    for (int i = start; i < end; ++i) {
+      values_[i] = Dot(coefs + static_cast<std::size_t>(i) * num_vars_,
+                       x, num_vars_);
+    }
+    break;
+  }
+}
+
+void mp::SSDKernel::AddRows(const int *scenarios, int num_scenarios,
+                            double sign, double *sums) const {
+  const double *coefs = matrix_.values();
+  switch (matrix_.layout()) {
+  case SSDMatrix::CSR: {
+    const int *cols = matrix_.col_indices();
+    const std::size_t *row_starts = matrix_.row_starts();
+    for (int i = 0; i < num_scenarios; ++i) {
+      int scenario = scenarios[i];
+      for (std::size_t k = row_starts[scenario],
+           end = row_starts[scenario + 1]; k != end; ++k) {
+        sums[cols[k]] += sign * coefs[k];
+      }
+    }
+    break;
+  }
+  case SSDMatrix::COLUMN_BLOCKED:
+    for (int b = 0, num_blocks = matrix_.num_blocks(); b < num_blocks; ++b) {
+      double *block_sums = sums + b * SSDMatrix::BLOCK_SIZE;
+      int size = matrix_.block_size(b);
+      for (int i = 0; i < num_scenarios; ++i)
+        AddRow(block_sums, matrix_.block_row(b, scenarios[i]), size, sign);
+    }
+    break;
+  default:
+    for (int i = 0; i < num_scenarios; ++i) {
+      const double *row =
+          coefs + static_cast<std::size_t>(scenarios[i]) * num_vars_;
+      AddRow(sums, row, num_vars_, sign);
+    }
+    break;
+  }
+}
+
+void mp::SSDKernel::ComputeBlockValues(
+    const double *x, int num_blocks, int block) {
+  ComputeValues(x, BlockStart(num_scenarios_, num_blocks, block),
+                BlockStart(num_scenarios_, num_blocks, block + 1));
+}
+
+void mp::SSDKernel::AddBlockRows(const std::vector<int> &scenarios,
+                                 double sign, int num_blocks, int block) {
+  int size = static_cast<int>(scenarios.size());
+  int start = BlockStart(size, num_blocks, block);
+  int end = BlockStart(size, num_blocks, block + 1);
+  double *sums = block == 0 ?
+        &cut_[0] : &partial_sums_[(block - 1) * cut_.size()];
+  AddRows(scenarios.data() + start, end - start, sign, sums);
+}
+
+void mp::SSDKernel::AddRowsParallel(
+    const std::vector<int> &scenarios, double sign) {
+  int size = static_cast<int>(scenarios.size());
+  if (size == 0)
+    return;
+  double work = num_scenarios_ != 0 ?
+        static_cast<double>(matrix_.num_elements()) * size / num_scenarios_ : 0;
+  int num_threads = GetNumThreads(num_threads_, work);
+  if (num_threads == 1) {
+    AddRows(&scenarios[0], size, sign, &cut_[0]);
+    return;
+  }
+  // Each thread sums a block of rows into its own buffer and the buffers
+  // are added to the cut when all threads are done. The current thread
+  // sums the first block directly into the cut.
+  std::size_t n = num_vars_;
+  partial_sums_.assign((num_threads - 1) * n, 0);
+  internal::RunInParallel(
+        num_threads, std::bind(&SSDKernel::AddBlockRows, this,
+                               std::cref(scenarios), sign, num_threads,
+                               std::placeholders::_1));
+  for (int i = 0; i < num_threads - 1; ++i) {
+    const double *sums = &partial_sums_[i * n];
+    for (std::size_t j = 0; j < n; ++j)
+      cut_[j] += sums[j];
+  }
+}
+
+void mp::SSDKernel::Sort() {
+  int n = num_scenarios_;
+  if (n == 0)
+    return;
+  // Insertion sort takes linear time if the order is almost the same as in
+  // the previous iteration which is common near convergence. Switch to
+  // a full sort as soon as it is clear that the order has changed a lot.
+  const double *values = &values_[0];
+  int *order = &order_[0];
+  long num_moves = 0, max_moves = 4L * n;
+  for (int i = 1; i < n; ++i) {
+    int scenario = order[i];
+    double value = values[scenario];
+    int j = i;
+    for (; j > 0 && values[order[j - 1]] > value; --j)
+      order[j] = order[j - 1];
+    order[j] = scenario;
+    num_moves += i - j;
+    if (num_moves <= max_moves)
+      continue;
+    std::vector<ValueScenario> sorted(n);
+    for (int k = 0; k < n; ++k) {
+      sorted[k].value = values[order[k]];
+      sorted[k].scenario = order[k];
+    }
+    std::sort(sorted.begin(), sorted.end(), ValueLess());
+    for (int k = 0; k < n; ++k)
+      order[k] = sorted[k].scenario;
+    return;
+  }
+}
+
+void mp::SSDKernel::ComputeTails(const double *x) {
+  // Split the rows into contiguous blocks, one per thread.
+  int num_threads = GetNumThreads(
+        num_threads_, static_cast<double>(matrix_.num_elements()));
+  internal::RunInParallel(
+        num_threads, std::bind(&SSDKernel::ComputeBlockValues, this, x,
+                               num_threads, std::placeholders::_1));
+  Sort();
+  double sum = 0;
+  for (int i = 0; i < num_scenarios_; ++i) {
+    sum += values_[order_[i]];
+    tails_[i] = sum;
+  }
+}
+
+const double *mp::SSDKernel::ComputeCut(int size) {
+  // Find scenarios entering and leaving the cut compared to the last one.
+  entering_.clear();
+  leaving_.clear();
+  for (int i = 0; i < size; ++i) {
+    int scenario = order_[i];
+    if (in_cut_[scenario])
+      in_cut_[scenario] = 2;
+    else
+      entering_.push_back(scenario);
+  }
+  for (std::size_t i = 0, n = cut_scenarios_.size(); i != n; ++i) {
+    int scenario = cut_scenarios_[i];
+    if (in_cut_[scenario] == 2) {
+      in_cut_[scenario] = 1;
+    } else {
+      leaving_.push_back(scenario);
+      in_cut_[scenario] = 0;
+    }
+  }
+  for (std::size_t i = 0, n = entering_.size(); i != n; ++i)
+    in_cut_[entering_[i]] = 1;
+  cut_scenarios_.assign(order_.begin(), order_.begin() + size);
+
+  if (entering_.size() + leaving_.size() < static_cast<std::size_t>(size) &&
+      num_updates_ < MAX_CUT_UPDATES) {
+    // Update the last cut if it is cheaper than computing from scratch.
+    AddRowsParallel(entering_, 1);
+    AddRowsParallel(leaving_, -1);
+    ++num_updates_;
+  } else {
+    std::fill(cut_.begin(), cut_.end(), 0);
+    AddRowsParallel(cut_scenarios_, 1);
+    num_updates_ = 0;
+  }
+  return num_vars_ != 0 ? &cut_[0] : 0;
+}
+
+void mp::SolveSSD(LPBackend &lp, const SSDMatrix &coefs,
+                  const std::vector<double> &rhs, const SSDOptions &options,
+                  SSDResult &result) {
+  int num_scenarios = static_cast<int>(rhs.size());
+  int num_vars = coefs.num_cols();
+  MP_ASSERT(coefs.num_rows() == num_scenarios, "invalid matrix size");
+  int dominance_var = num_vars;
+  MP_ASSERT(result.solution.size() == num_vars + 1u, "invalid solution size");
+
+  // Compute the tails of the reference distribution.
+  std::vector<double> ref_tails(rhs);
+  std::sort(ref_tails.begin(), ref_tails.end());
+  for (int i = 1; i < num_scenarios; ++i)
+    ref_tails[i] += ref_tails[i - 1];
+
+  double inf = std::numeric_limits<double>::infinity();
+  double dominance_lb = -inf;
+  double dominance_ub =  inf;
+  SSDKernel kernel(coefs);
+  std::vector<int> cut_vars(num_vars + 1);
+  for (int i = 0; i <= num_vars; ++i)
+    cut_vars[i] = i;
+  std::vector<double> cut_coefs(num_vars + 1);
+  result.status = sol::SOLVED;
+  int iteration = 1;
+  if (options.output)
+    fmt::print("\nItn          Gap\n");
+  for (; ; ++iteration) {
+    // Compute the tails of the distribution.
+    kernel.ComputeTails(&result.solution[0]);
+
+    // Compute violation and minimal tail difference.
+    double min_tail_diff = inf;
+    double max_rel_violation = 0;
+    int max_rel_violation_scen = -1;
+    for (int i = 0; i < num_scenarios; ++i) {
+      double scaling = options.scaled ? (i + 1.0) / num_scenarios : 1;
+      double scaled_dominance = dominance_ub * scaling;
+      double rel_violation =
+          (scaled_dominance + ref_tails[i] + i + 1) / (kernel.tail(i) + i + 1);
+      if (rel_violation > max_rel_violation) {
+        max_rel_violation = rel_violation;
+        max_rel_violation_scen = i;
+      }
+      double tail_diff = (kernel.tail(i) - ref_tails[i]) / scaling;
+      if (tail_diff < min_tail_diff)
+        min_tail_diff = tail_diff;
+    }
+
+    double scaling = options.scaled ?
+        (max_rel_violation_scen + 1.0) / num_scenarios : 1;
+
+    // Update the lower bound for the objective which by definition is a
+    // minimum of tail differences (possibly scaled). Don't update in the
+    // first iteration because the solution may not be feasible.
+    if (min_tail_diff > dominance_lb && iteration != 1)
+      dominance_lb = min_tail_diff;
+
+    if (options.output)
+      fmt::print("{:3} {:>12}\n", iteration, dominance_ub - dominance_lb);
+
+    if ((dominance_ub - dominance_lb) * scaling <= options.abs_tolerance) {
+      if (options.output)
+        fmt::print("Absolute tolerance reached.\n");
+      break;
+    }
+
+    // Add a cut and reoptimize the master problem.
+    const double *cut = kernel.ComputeCut(max_rel_violation_scen + 1);
+    std::copy(cut, cut + num_vars, cut_coefs.begin());
+    cut_coefs[dominance_var] = -scaling;
+    lp.AddRow(ref_tails[max_rel_violation_scen], inf, num_vars + 1,
+              &cut_vars[0], &cut_coefs[0]);
+    result.status = lp.Optimize();
+    if (result.status != sol::SOLVED) break;
+    for (int i = 0; i <= num_vars; ++i)
+      result.solution[i] = lp.value(i);
+    dominance_ub = result.solution[dominance_var];
+  }
+  result.dominance = dominance_ub;
+  result.num_iterations = iteration;
+}
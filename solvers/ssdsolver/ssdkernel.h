@@ -0,0 +1,258 @@
+/*
+ Tail and cut kernel for the SSD cutting-plane method.
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#ifndef MP_SOLVERS_SSDKERNEL_H_
+#define MP_SOLVERS_SSDKERNEL_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "mp/format.h"
+#include "ssdsolver/lp.h"
+
+namespace mp {
+
+// A matrix of coefficients in an SSD constraint with one row per scenario
+// and one column per variable.
+class SSDMatrix {
+ public:
+  enum Layout {
+    // Choose CSR or DENSE depending on the density.
+    AUTO,
+
+    // A dense row-major matrix.
+    DENSE,
+
+    // Compressed sparse rows.
+    CSR,
+
+    // Dense row-major blocks of BLOCK_SIZE columns (the last block can be
+    // narrower) stored one after another. Rows are processed one block at
+    // a time with the corresponding parts of a solution vector and a cut
+    // staying in cache which can help with very wide matrices.
+    COLUMN_BLOCKED
+  };
+
+  enum { BLOCK_SIZE = 512 };
+
+ private:
+  Layout layout_;
+  int num_rows_;
+  int num_cols_;
+
+  // Nonzero coefficients for CSR or all coefficients otherwise.
+  std::vector<double> values_;
+
+  // Column indices and starts of rows in values_ for CSR.
+  std::vector<int> col_indices_;
+  std::vector<std::size_t> row_starts_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(SSDMatrix);
+
+ public:
+  SSDMatrix() : layout_(DENSE), num_rows_(0), num_cols_(0) {}
+
+  // Returns the layout that AUTO resolves to for a matrix with
+  // num_nonzeros nonzero elements.
+  static Layout ChooseLayout(int num_rows, int num_cols,
+                             std::size_t num_nonzeros);
+
+  // Sets the matrix from compressed sparse rows: the elements of row i are
+  // in positions [row_starts[i], row_starts[i + 1]) of col_indices and
+  // values. Column indices in a row must be unique. The arguments are
+  // used as a temporary storage and their contents is unspecified on
+  // return.
+  void Assign(Layout layout, int num_cols,
+              std::vector<std::size_t> &row_starts,
+              std::vector<int> &col_indices, std::vector<double> &values);
+
+  // Sets the matrix from a dense row-major one.
+  void Assign(Layout layout, int num_rows, int num_cols, const double *coefs);
+
+  Layout layout() const { return layout_; }
+  int num_rows() const { return num_rows_; }
+  int num_cols() const { return num_cols_; }
+
+  // Returns the number of stored elements.
+  std::size_t num_elements() const { return values_.size(); }
+
+  const double *values() const { return values_.empty() ? 0 : &values_[0]; }
+
+  // Returns the column indices for CSR.
+  const int *col_indices() const {
+    return col_indices_.empty() ? 0 : &col_indices_[0];
+  }
+
+  // Returns the row starts for CSR.
+  const std::size_t *row_starts() const { return &row_starts_[0]; }
+
+  // Returns the number of column blocks for COLUMN_BLOCKED.
+  int num_blocks() const {
+    return (num_cols_ + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  }
+
+  // Returns the number of columns in a block for COLUMN_BLOCKED.
+  int block_size(int block) const {
+    return block + 1 < num_blocks() ?
+          static_cast<int>(BLOCK_SIZE) : num_cols_ - block * BLOCK_SIZE;
+  }
+
+  // Returns a pointer to the part of a row in a block for COLUMN_BLOCKED.
+  const double *block_row(int block, int row) const {
+    std::size_t start =
+        static_cast<std::size_t>(num_rows_) * block * BLOCK_SIZE;
+    return &values_[start + static_cast<std::size_t>(row) *
+                    block_size(block)];
+  }
+};
+
+// Computes tails of the distribution of scenario values and coefficients
+// of cuts in the SSD cutting-plane method.
+//
+// The scenario values are the products of a solution and the rows of
+// a matrix with one row per scenario in any of the SSDMatrix layouts.
+// The product is computed in blocks of rows on multiple threads with inner
+// loops that the compiler can vectorize. Scenarios are sorted by value
+// starting from the order of the previous iteration which changes little
+// between iterations, and a cut is aggregated from the previous one when
+// their scenario sets are similar.
+class SSDKernel {
+ private:
+  const SSDMatrix &matrix_;
+  int num_scenarios_;
+  int num_vars_;
+  int num_threads_;
+
+  // values_[i] is the value of scenario i.
+  std::vector<double> values_;
+
+  // Scenarios sorted by value.
+  std::vector<int> order_;
+
+  // tails_[i] is the sum of i + 1 smallest values.
+  std::vector<double> tails_;
+
+  // Coefficients of the last cut and its scenarios.
+  std::vector<double> cut_;
+  std::vector<int> cut_scenarios_;
+  // in_cut_[i] is nonzero if scenario i is in the last cut.
+  std::vector<char> in_cut_;
+  // Scenarios entering and leaving the cut.
+  std::vector<int> entering_, leaving_;
+  // The number of cuts aggregated from the previous one since the last
+  // cut computed from scratch.
+  int num_updates_;
+
+  // Per-thread partial sums of coefficient rows.
+  std::vector<double> partial_sums_;
+
+  // Computes values of scenarios in [start, end).
+  void ComputeValues(const double *x, int start, int end);
+
+  // Computes values of scenarios in a block of rows when the rows are
+  // split into num_blocks blocks.
+  void ComputeBlockValues(const double *x, int num_blocks, int block);
+
+  // Adds sign * (sum of coefficient rows of scenarios) to sums.
+  void AddRows(const int *scenarios, int num_scenarios, double sign,
+               double *sums) const;
+
+  // Adds sign * (sum of coefficient rows of a block of scenarios) to cut_
+  // for the first block and to partial_sums_ for the others.
+  void AddBlockRows(const std::vector<int> &scenarios, double sign,
+                    int num_blocks, int block);
+
+  // Adds sign * (sum of coefficient rows of scenarios) to cut_ splitting
+  // the rows among threads.
+  void AddRowsParallel(const std::vector<int> &scenarios, double sign);
+
+  // Sorts order_ by value reusing the existing order.
+  void Sort();
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(SSDKernel);
+
+ public:
+  // Constructs a kernel for a matrix of coefficients which must outlive
+  // the kernel. Uses the number of hardware threads if num_threads <= 0.
+  explicit SSDKernel(const SSDMatrix &matrix, int num_threads = 0);
+
+  int num_scenarios() const { return num_scenarios_; }
+  int num_vars() const { return num_vars_; }
+  int num_threads() const { return num_threads_; }
+
+  // Computes scenario values for the solution x and their tails.
+  void ComputeTails(const double *x);
+
+  // Returns the sum of index + 1 smallest scenario values.
+  double tail(int index) const { return tails_[index]; }
+
+  // Returns the scenario with the specified position in the order of
+  // increasing values.
+  int scenario(int index) const { return order_[index]; }
+
+  // Computes coefficients of the cut for the tail with size scenarios,
+  // i.e. the sums of coefficient rows over size scenarios with the
+  // smallest values, and returns a pointer to num_vars() coefficients.
+  const double *ComputeCut(int size);
+};
+
+// Options of the SSD cutting-plane method.
+struct SSDOptions {
+  // Whether to use a scaled model.
+  bool scaled;
+
+  // Absolute tolerance for the dominance gap.
+  double abs_tolerance;
+
+  // Whether to print the iteration log.
+  bool output;
+
+  SSDOptions() : scaled(false), abs_tolerance(1e-5), output(false) {}
+};
+
+// A result of the SSD cutting-plane method.
+struct SSDResult {
+  // The status of the last master problem solve, one of sol::Status values.
+  int status;
+
+  // The dominance, i.e. the upper bound on the dominance variable.
+  double dominance;
+
+  int num_iterations;
+
+  // Values of the variables followed by the value of the dominance variable.
+  std::vector<double> solution;
+
+  SSDResult() : status(sol::SOLVED), dominance(0), num_iterations(0) {}
+};
+
+// Solves a problem with an SSD constraint by the cutting-plane method.
+// lp should contain the master problem with coefs.num_cols() variables
+// followed by the dominance variable which is maximized. Each iteration
+// adds a cut to the master problem and reoptimizes it from the previous
+// basis. result.solution should contain the initial values of
+// coefs.num_cols() + 1 variables. coefs is a matrix of coefficients in
+// the SSD constraint with one row per element of rhs.
+void SolveSSD(LPBackend &lp, const SSDMatrix &coefs,
+              const std::vector<double> &rhs, const SSDOptions &options,
+              SSDResult &result);
+}  // namespace mp
+
+#endif  // MP_SOLVERS_SSDKERNEL_H_
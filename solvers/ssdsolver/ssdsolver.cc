@@ -22,36 +22,95 @@
  */
 
 #include "ssdsolver/ssdsolver.h"
+#include "ssdsolver/ssdkernel.h"
 #include "mp/problem.h"
 #include "ilogcp/ilogcp.h"
 
 namespace {
 
-struct ValueScenario {
-  double value;
-  int scenario;
-};
+// An LP backend that keeps the problem extracted to CPLEX between solves.
+// CPLEX tracks the rows added to the extracted model and reoptimizes
+// starting from the previous basis.
+class CPLEXBackend : public mp::LPBackend {
+ private:
+  IloEnv env_;
+  IloModel model_;
+  IloNumVarArray vars_;
+  IloCplex cplex_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(CPLEXBackend);
+
+ public:
+  CPLEXBackend() : cplex_(env_) {
+    cplex_.setOut(env_.getNullStream());
+    cplex_.setWarning(env_.getNullStream());
+    cplex_.setParam(IloCplex::RootAlg, IloCplex::Dual);
+  }
+
+  ~CPLEXBackend() { env_.end(); }
+
+  void Load(const mp::Problem &p) {
+    mp::MPToConcertConverter converter(env_, 0);
+    converter.Convert(p);
+    model_ = converter.model();
+    vars_ = converter.vars();
+    model_.add(vars_);
+    cplex_.extract(model_);
+  }
+
+  void AddRow(double lb, double ub, int num_terms,
+              const int *vars, const double *coefs) {
+    IloExpr expr(env_);
+    for (int i = 0; i < num_terms; ++i)
+      expr += coefs[i] * vars_[vars[i]];
+    model_.add(IloRange(env_, lb, expr, ub));
+    expr.end();
+  }
+
+  int Optimize() {
+    cplex_.solve();
+    switch (cplex_.getStatus()) {
+    case IloAlgorithm::Optimal:
+      return mp::sol::SOLVED;
+    case IloAlgorithm::Infeasible:
+      return mp::sol::INFEASIBLE;
+    case IloAlgorithm::Unbounded:
+      return mp::sol::UNBOUNDED;
+    default:
+      return mp::sol::FAILURE;
+    }
+  }
 
-struct ValueLess {
-  bool operator()(const ValueScenario &lhs, const ValueScenario &rhs) const {
-    return lhs.value < rhs.value;
+  double value(int var_index) const {
+    return cplex_.getValue(vars_[var_index]);
   }
 };
-}
+}  // namespace
 
 namespace mp {
 
 SSDSolver::SSDSolver()
 : SolverImpl<Problem>("ssdsolver", 0, SSDSOLVER_VERSION),
-  output_(false), scaled_(false), abs_tolerance_(1e-5), solver_name_("cplex") {
+  output_(false), scaled_(false), storage_(SSDMatrix::AUTO),
+  abs_tolerance_(1e-5), solver_name_("cplex") {
   set_version("SSD Solver");
   AddIntOption("outlev", "0 or 1 (default 0):  Whether to print solution log.",
       &SSDSolver::GetBoolOption, &SSDSolver::SetBoolOption, &output_);
   AddIntOption("scaled", "0 or 1 (default 0):  Whether to use a scaled model.",
       &SSDSolver::GetBoolOption, &SSDSolver::SetBoolOption, &scaled_);
+  AddIntOption("storage",
+      "Storage of the coefficients of the SSD constraint:\n"
+      "\n"
+      "| 0 (default) - choose depending on the density\n"
+      "| 1 - dense\n"
+      "| 2 - compressed sparse rows\n"
+      "| 3 - dense blocks of columns\n",
+      &SSDSolver::GetStorage, &SSDSolver::SetStorage);
   AddDblOption("abs_tolerance", "Absolute tolerance. Default = 1e-5.",
       &SSDSolver::GetAbsTolerance, &SSDSolver::SetAbsTolerance);
-  AddStrOption("solver", "Solver to use for subproblems. Default = cplex.",
+  AddStrOption("solver",
+      "Solver to use for master problems: cplex or simplex (a bundled "
+      "dual simplex for small problems). Default = cplex.",
       &SSDSolver::GetSolverName, &SSDSolver::SetSolverName);
 }
 
@@ -79,6 +138,7 @@ void SSDSolver::Solve(Problem &p, SolutionHandler &outer_sh) {
       throw UnsupportedError("unsupported function: {}", f.name());
     extractor.Extract(call);
   }
+  extractor.Finish(static_cast<SSDMatrix::Layout>(storage_));
 
   if (p.num_objs() != 0)
     throw Error("SSD solver doesn't support user-defined objectives");
@@ -113,113 +173,27 @@ void SSDSolver::Solve(Problem &p, SolutionHandler &outer_sh) {
       builder.AddTerm(i->var_index(), i->coef());
   }
 
-  // Compute the tails of the reference distribution.
-  std::vector<double> ref_tails(extractor.rhs());
-  std::sort(ref_tails.begin(), ref_tails.end());
-  for (int i = 1; i < num_scenarios; ++i)
-    ref_tails[i] += ref_tails[i - 1];
-
-  struct SSDSolutionHandler : BasicSolutionHandler {
-    int num_vars;
-    int status;
-    std::vector<double> solution;
-    explicit SSDSolutionHandler(int num_vars) : num_vars(num_vars), status(0) {}
-
-    void HandleSolution(int status, fmt::CStringRef,
-        const double *values, const double *, double) {
-      this->status = status;
-      solution.assign(values, values + num_vars + 1);
-    }
-  } sh(num_vars);
-
   // Get the initial solution.
-  sh.solution.reserve(num_vars);
+  SSDResult result;
+  result.solution.reserve(num_vars + 1);
   auto vars = converted.vars();
   for (auto i = vars.begin(), end = vars.end(); i != end; ++i)
-    sh.solution.push_back(i->value());
+    result.solution.push_back(i->value());
 
   // Solve the problem using a cutting-plane method.
-  IlogCPSolver solver;
-  solver.SetStrOption("optimizer", "cplex");
-
-  // Disable solver output.
-  solver.SetStrOption("outlev", "quiet");
-
-  double dominance_lb = -inf;
-  double dominance_ub =  inf;
-  const double *coefs = extractor.coefs();
-  std::vector<ValueScenario> tails(num_scenarios);
-  int iteration = 1;
-  printf("\nItn          Gap\n") ;
-  for (; ; ++iteration) {
-    // Compute the tails of the distribution.
-    for (int i = 0; i < num_scenarios; ++i) {
-      double value = 0;
-      const double *row = coefs + i * num_vars;
-      for (int j = 0; j < num_vars; ++j)
-        value += row[j] * sh.solution[j];
-      tails[i].value = value;
-      tails[i].scenario = i;
-    }
-    std::sort(tails.begin(), tails.end(), ValueLess());
-    for (int i = 1; i < num_scenarios; ++i)
-      tails[i].value += tails[i - 1].value;
-
-    // Compute violation and minimal tail difference.
-    double min_tail_diff = inf;
-    double max_rel_violation = 0;
-    int max_rel_violation_scen = -1;
-    for (int i = 0; i < num_scenarios; ++i) {
-      double scaling = scaled_ ? (i + 1.0) / num_scenarios : 1;
-      double scaled_dominance = dominance_ub * scaling;
-      double rel_violation =
-          (scaled_dominance + ref_tails[i] + i + 1) / (tails[i].value + i + 1);
-      if (rel_violation > max_rel_violation) {
-        max_rel_violation = rel_violation;
-        max_rel_violation_scen = i;
-      }
-      double tail_diff = (tails[i].value - ref_tails[i]) / scaling;
-      if (tail_diff < min_tail_diff)
-        min_tail_diff = tail_diff;
-    }
-
-    double scaling = scaled_ ?
-        (max_rel_violation_scen + 1.0) / num_scenarios : 1;
-
-    // Update the lower bound for the objective which by definition is a
-    // minimum of tail differences (possibly scaled). Don't update in the
-    // first iteration because the solution may not be feasible.
-    if (min_tail_diff > dominance_lb && iteration != 1)
-      dominance_lb = min_tail_diff;
-
-    fmt::print("{:3} {:>12}\n", iteration, dominance_ub - dominance_lb);
-
-    if ((dominance_ub - dominance_lb) * scaling <= abs_tolerance_) {
-      fmt::print("Absolute tolerance reached.\n");
-      break;
-    }
-
-    // Add a cut.
-    converted.AddCon(ref_tails[max_rel_violation_scen], inf);
-    Problem::LinearConBuilder cut =
-        converted.algebraic_con(converted.num_algebraic_cons() - 1).
-        set_linear_expr(num_vars + 1);
-    for (int i = 0; i < num_vars; ++i) {
-      double coef = 0;
-      for (int j = 0; j <= max_rel_violation_scen; ++j)
-        coef += coefs[tails[j].scenario * num_vars + i];
-      cut.AddTerm(i, coef);
-    }
-    cut.AddTerm(dominance_var, -scaling);
-
-    solver.Solve(converted, sh);
-    if (sh.status != sol::SOLVED) break;
-    dominance_ub = sh.solution[dominance_var];
-  }
+  LPBackendPtr lp(solver_name_ == "simplex" ?
+                    static_cast<LPBackend*>(new DualSimplex()) :
+                    new CPLEXBackend());
+  lp->Load(converted);
+  SSDOptions options;
+  options.scaled = scaled_;
+  options.abs_tolerance = abs_tolerance_;
+  options.output = output_;
+  SolveSSD(*lp, extractor.matrix(), extractor.rhs(), options, result);
 
   // Convert solution status.
   const char *message = 0;
-  switch (sh.status) {
+  switch (result.status) {
   case sol::SOLVED:
     message = "optimal solution";
     break;
@@ -236,10 +210,10 @@ void SSDSolver::Solve(Problem &p, SolutionHandler &outer_sh) {
 
   fmt::MemoryWriter w;
   w.write("{}: {}", long_name(), message);
-  if (sh.status == sol::SOLVED)
-    w.write("; dominance {}", dominance_ub);
-  w.write("\n{} iteration(s)", iteration);
-  outer_sh.HandleSolution(sh.status, w.c_str(), &sh.solution[0], 0, 0);
+  if (result.status == sol::SOLVED)
+    w.write("; dominance {}", result.dominance);
+  w.write("\n{} iteration(s)", result.num_iterations);
+  outer_sh.HandleSolution(result.status, w.c_str(), &result.solution[0], 0, 0);
 }
 
 SolverPtr create_ssdsolver(const char *) { return SolverPtr(new SSDSolver()); }
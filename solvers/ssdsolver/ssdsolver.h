@@ -28,6 +28,7 @@
 
 #include "mp/expr-visitor.h"
 #include "mp/solver.h"
+#include "ssdsolver/ssdkernel.h"
 
 #define SSDSOLVER_VERSION 20130226
 
@@ -36,10 +37,18 @@ namespace mp {
 // Expression visitor that extracts SSD constraints.
 class SSDExtractor : public ExprVisitor<SSDExtractor, void> {
  private:
-  // A matrix of variable coefficients in the SSD constraint with one
-  // row per scenario and one column per variable. The matrix is stored in
-  // a row-major order.
-  std::vector<double> coefs_;
+  // Variable coefficients in the SSD constraint with one row per scenario
+  // collected in compressed sparse rows while extracting and converted to
+  // the matrix of the requested layout by Finish.
+  std::vector<std::size_t> row_starts_;
+  std::vector<int> col_indices_;
+  std::vector<double> values_;
+
+  // positions_[j] is the position of variable j in values_ if it is
+  // in the current row.
+  std::vector<std::size_t> positions_;
+
+  SSDMatrix matrix_;
 
   unsigned num_vars_;
   unsigned con_index_;
@@ -51,7 +60,7 @@ class SSDExtractor : public ExprVisitor<SSDExtractor, void> {
 
  public:
   SSDExtractor(unsigned num_scenarios, unsigned num_vars)
-  : coefs_(num_scenarios * num_vars), num_vars_(num_vars),
+  : row_starts_(1), positions_(num_vars), num_vars_(num_vars),
     con_index_(0), sign_(0), rhs_(num_scenarios) {}
 
   void VisitMul(BinaryExpr e) {
@@ -59,7 +68,16 @@ class SSDExtractor : public ExprVisitor<SSDExtractor, void> {
     Reference var = Cast<Reference>(e.rhs());
     if (!coef || !var)
       throw MakeUnsupportedError("nonlinear *");
-    coefs_[con_index_ * num_vars_ + var.index()] = sign_ * coef.value();
+    int index = var.index();
+    std::size_t pos = positions_[index];
+    if (pos >= row_starts_.back() && pos < values_.size() &&
+        col_indices_[pos] == index) {
+      values_[pos] = sign_ * coef.value();
+      return;
+    }
+    positions_[index] = values_.size();
+    col_indices_.push_back(index);
+    values_.push_back(sign_ * coef.value());
   }
 
   void VisitSum(SumExpr e) {
@@ -77,10 +95,16 @@ class SSDExtractor : public ExprVisitor<SSDExtractor, void> {
     Visit(Cast<NumericExpr>(call.arg(0)));
     sign_ = -1;
     Visit(Cast<NumericExpr>(call.arg(1)));
+    row_starts_.push_back(values_.size());
     ++con_index_;
   }
 
-  const double *coefs() const { return &coefs_[0]; }
+  // Builds the matrix of coefficients after all constraints are extracted.
+  void Finish(SSDMatrix::Layout layout) {
+    matrix_.Assign(layout, num_vars_, row_starts_, col_indices_, values_);
+  }
+
+  const SSDMatrix &matrix() const { return matrix_; }
   const std::vector<double> &rhs() const { return rhs_; }
 };
 
@@ -88,6 +112,7 @@ class SSDSolver : public SolverImpl<Problem> {
  private:
   bool output_;
   bool scaled_;
+  int storage_;
   double abs_tolerance_;
   std::string solver_name_;
 
@@ -98,6 +123,13 @@ class SSDSolver : public SolverImpl<Problem> {
     *ptr = value != 0;
   }
 
+  int GetStorage(const SolverOption &) const { return storage_; }
+  void SetStorage(const SolverOption &opt, int value) {
+    if (value < SSDMatrix::AUTO || value > SSDMatrix::COLUMN_BLOCKED)
+      throw InvalidOptionValue(opt, value);
+    storage_ = value;
+  }
+
   double GetAbsTolerance(const SolverOption &) const { return abs_tolerance_; }
   void SetAbsTolerance(const SolverOption &opt, double value) {
     if (value < 0)
@@ -106,8 +138,11 @@ class SSDSolver : public SolverImpl<Problem> {
   }
 
   std::string GetSolverName(const SolverOption &) const { return solver_name_; }
-  void SetSolverName(const SolverOption &, fmt::StringRef value) {
-    solver_name_ = value.to_string();
+  void SetSolverName(const SolverOption &opt, fmt::StringRef value) {
+    std::string name = value.to_string();
+    if (name != "cplex" && name != "simplex")
+      throw InvalidOptionValue(opt, name);
+    solver_name_ = name;
   }
 
  public:
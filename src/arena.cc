@@ -0,0 +1,63 @@
+/*
+ Arena allocator
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include "mp/arena.h"
+
+#include <new>
+
+void *mp::Arena::AllocateChunk(std::size_t size) {
+  // Allocate a separate chunk for a large object to avoid wasting the free
+  // memory in the current chunk.
+  bool is_large = size > chunk_size_ / 4;
+  std::size_t data_size = is_large ? size : chunk_size_;
+  // Over-allocate to align the chunk to a cache line.
+  char *raw = static_cast<char*>(
+        ::operator new(CACHE_LINE_SIZE + data_size + CACHE_LINE_SIZE));
+  std::size_t misalignment =
+      reinterpret_cast<std::size_t>(raw) % CACHE_LINE_SIZE;
+  std::size_t offset = misalignment != 0 ? CACHE_LINE_SIZE - misalignment : 0;
+  Chunk *chunk = reinterpret_cast<Chunk*>(raw + offset);
+  chunk->offset = offset;
+  char *data = reinterpret_cast<char*>(chunk) + CACHE_LINE_SIZE;
+  ++num_chunks_;
+  if (is_large && chunks_) {
+    // Insert a large chunk after the current one to keep allocating from
+    // the latter.
+    chunk->next = chunks_->next;
+    chunks_->next = chunk;
+    return data;
+  }
+  chunk->next = chunks_;
+  chunks_ = chunk;
+  ptr_ = data + size;
+  end_ = data + data_size;
+  return data;
+}
+
+void mp::Arena::Release() {
+  for (Chunk *chunk = chunks_; chunk; ) {
+    Chunk *next = chunk->next;
+    ::operator delete(reinterpret_cast<char*>(chunk) - chunk->offset);
+    chunk = next;
+  }
+  chunks_ = 0;
+  ptr_ = end_ = 0;
+  num_chunks_ = 0;
+}
@@ -0,0 +1,974 @@
+/*
+ Reverse-mode automatic differentiation of expression tapes
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include "mp/expr-ad.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace {
+
+typedef mp::ExprTape::Instruction Instruction;
+
+// Appends arguments of an instruction that can have nonzero derivatives
+// to args.
+void GetDiffArgs(const mp::ExprTape &tape, const Instruction &instr,
+                 std::vector<int> &args) {
+  namespace expr = mp::expr;
+  switch (instr.opcode) {
+  case expr::FLOOR: case expr::CEIL:
+  case expr::TRUNC_DIV: case expr::PRECISION: case expr::ROUND:
+  case expr::TRUNC:
+    // Piecewise constant.
+    break;
+  case expr::ADD: case expr::SUB: case expr::LESS: case expr::MUL:
+  case expr::DIV: case expr::MOD: case expr::POW: case expr::POW_CONST_BASE:
+  case expr::POW_CONST_EXP: case expr::ATAN2:
+    args.push_back(instr.arg0);
+    args.push_back(instr.arg1);
+    break;
+  case expr::IF:
+    args.push_back(instr.arg1);
+    args.push_back(instr.arg2);
+    break;
+  case expr::PLTERM:
+    args.push_back(instr.arg0);
+    break;
+  case expr::MIN: case expr::MAX: case expr::SUM:
+    for (int i = 0; i < instr.arg2; ++i)
+      args.push_back(tape.arg(instr.arg1 + i));
+    break;
+  default:
+    if (instr.opcode >= expr::FIRST_UNARY && instr.opcode <= expr::LAST_UNARY)
+      args.push_back(instr.arg0);
+    // Other instructions are either leaves or logical and counting
+    // expressions which are piecewise constant.
+    break;
+  }
+}
+
+// Collects variables that instructions depend on. Variable sets of
+// shared instructions, i.e. instructions with more than one use, are
+// computed once and reused.
+class VarCollector {
+ private:
+  const mp::ExprTape &tape_;
+  const std::vector<int> &uses_;
+  std::vector< std::vector<int> > shared_vars_;
+  std::vector<int> instr_marks_;
+  std::vector<int> var_marks_;
+  int tag_;
+  std::vector<int> stack_;
+  std::vector<int> args_;
+
+  bool IsShared(int index) const {
+    return uses_[index] > 1 &&
+        tape_.instruction(index).opcode != mp::expr::VARIABLE;
+  }
+
+  void AddVar(int var, std::vector<int> &vars) {
+    if (var_marks_[var] != tag_) {
+      var_marks_[var] = tag_;
+      vars.push_back(var);
+    }
+  }
+
+ public:
+  VarCollector(const mp::ExprTape &tape, const std::vector<int> &uses)
+    : tape_(tape), uses_(uses), shared_vars_(tape.num_instructions()),
+      instr_marks_(tape.num_instructions()), var_marks_(tape.num_vars()),
+      tag_(0) {}
+
+  // Computes the variable set of an instruction if it is shared.
+  // Shared instructions should be added in increasing order.
+  void AddShared(int index) {
+    if (IsShared(index))
+      Collect(index, shared_vars_[index]);
+  }
+
+  // Collects variables that an instruction depends on in vars.
+  void Collect(int index, std::vector<int> &vars);
+};
+
+void VarCollector::Collect(int index, std::vector<int> &vars) {
+  if (IsShared(index) && !shared_vars_[index].empty()) {
+    vars = shared_vars_[index];
+    return;
+  }
+  ++tag_;
+  vars.clear();
+  stack_.assign(1, index);
+  instr_marks_[index] = tag_;
+  while (!stack_.empty()) {
+    int i = stack_.back();
+    stack_.pop_back();
+    const Instruction &instr = tape_.instruction(i);
+    if (i != index && IsShared(i)) {
+      const std::vector<int> &shared_vars = shared_vars_[i];
+      for (std::size_t j = 0, n = shared_vars.size(); j < n; ++j)
+        AddVar(shared_vars[j], vars);
+    } else if (instr.opcode == mp::expr::VARIABLE) {
+      AddVar(instr.arg0, vars);
+    } else if (instr.opcode == mp::ExprTape::LINEAR) {
+      for (int j = instr.arg1, end = instr.arg1 + instr.arg2; j < end; ++j)
+        AddVar(tape_.var_index(j), vars);
+    } else {
+      args_.clear();
+      GetDiffArgs(tape_, instr, args_);
+      for (std::size_t j = 0, n = args_.size(); j < n; ++j) {
+        int arg = args_[j];
+        if (instr_marks_[arg] != tag_) {
+          instr_marks_[arg] = tag_;
+          stack_.push_back(arg);
+        }
+      }
+    }
+  }
+}
+
+// Adds elements a[i] x b[j] of the upper triangle to elements as
+// (column, row) pairs.
+void AddElements(const std::vector<int> &a, const std::vector<int> &b,
+                 std::vector< std::pair<int, int> > &elements) {
+  for (std::size_t i = 0, m = a.size(); i < m; ++i) {
+    for (std::size_t j = 0, n = b.size(); j < n; ++j) {
+      int row = a[i], col = b[j];
+      if (row > col)
+        std::swap(row, col);
+      elements.push_back(std::make_pair(col, row));
+    }
+  }
+}
+}  // namespace
+
+mp::ReverseAD::ReverseAD(ExprTape &tape)
+  : tape_(tape), shared_(tape.num_instructions(), -1), stamp_(0),
+    adjoints_(tape.num_instructions()), grad_(tape.num_vars()) {
+  int num_instrs = tape.num_instructions();
+  int num_outputs = tape.num_outputs();
+  // Find shared instructions.
+  std::vector<int> uses(num_instrs);
+  std::vector<int> args;
+  for (int i = 0; i < num_instrs; ++i) {
+    args.clear();
+    GetDiffArgs(tape, tape.instruction(i), args);
+    for (std::size_t j = 0, n = args.size(); j < n; ++j)
+      ++uses[args[j]];
+  }
+  int num_segments = num_outputs;
+  for (int i = 0; i < num_instrs; ++i) {
+    int opcode = tape.instruction(i).opcode;
+    if (uses[i] > 1 && opcode != expr::VARIABLE && opcode != expr::NUMBER)
+      shared_[i] = num_segments++;
+  }
+  segments_.resize(num_segments + 1);
+  for (int i = 0; i < num_outputs; ++i)
+    segments_[i].root = tape.output(i);
+  for (int i = 0; i < num_instrs; ++i) {
+    if (shared_[i] >= 0)
+      segments_[shared_[i]].root = i;
+  }
+  std::vector<int> marks(num_instrs, -1);
+  for (int i = 0; i < num_segments; ++i)
+    BuildCone(i, marks);
+  Segment &end = segments_[num_segments];
+  end.root = -1;
+  end.cone_start = static_cast<int>(cone_.size());
+  end.ref_start = static_cast<int>(refs_.size());
+
+  // Shared segments only use shared segments with smaller roots, so
+  // their patterns are built in the increasing order of roots. They are
+  // stored after the rows of the Jacobian.
+  marks.assign(tape.num_vars(), -1);
+  std::vector<int> shared_pattern;
+  for (int i = num_outputs; i < num_segments; ++i) {
+    segments_[i].pattern_start = static_cast<int>(shared_pattern.size());
+    AddPattern(i, shared_pattern, marks);
+  }
+  int num_shared_nonzeros = static_cast<int>(shared_pattern.size());
+  end.pattern_start = num_shared_nonzeros;
+  pattern_.swap(shared_pattern);
+  for (int i = 0; i < num_outputs; ++i) {
+    segments_[i].pattern_start = static_cast<int>(shared_pattern.size());
+    AddPattern(i, shared_pattern, marks);
+  }
+  int num_jac_nonzeros = static_cast<int>(shared_pattern.size());
+  shared_pattern.insert(shared_pattern.end(),
+                        pattern_.begin(), pattern_.end());
+  pattern_.swap(shared_pattern);
+  for (int i = num_outputs; i <= num_segments; ++i)
+    segments_[i].pattern_start += num_jac_nonzeros;
+  jac_row_starts_.resize(num_outputs + 1);
+  for (int i = 0; i < num_outputs; ++i)
+    jac_row_starts_[i] = segments_[i].pattern_start;
+  jac_row_starts_[num_outputs] = num_jac_nonzeros;
+  shared_grads_.resize(pattern_.size());
+  shared_stamps_.resize(num_segments, stamp_);
+}
+
+void mp::ReverseAD::BuildCone(int segment, std::vector<int> &marks) {
+  Segment &seg = segments_[segment];
+  seg.cone_start = static_cast<int>(cone_.size());
+  seg.ref_start = static_cast<int>(refs_.size());
+  int root = seg.root;
+  if (shared_[root] >= 0 && shared_[root] != segment) {
+    // An output computed by a shared instruction.
+    refs_.push_back(shared_[root]);
+    return;
+  }
+  // Collect instructions reachable without passing through other
+  // shared instructions.
+  std::vector<int> stack(1, root), args;
+  marks[root] = segment;
+  while (!stack.empty()) {
+    int index = stack.back();
+    stack.pop_back();
+    cone_.push_back(index);
+    args.clear();
+    GetDiffArgs(tape_, tape_.instruction(index), args);
+    for (std::size_t i = 0, n = args.size(); i < n; ++i) {
+      int arg = args[i];
+      if (marks[arg] == segment)
+        continue;
+      marks[arg] = segment;
+      if (shared_[arg] >= 0)
+        refs_.push_back(shared_[arg]);
+      else
+        stack.push_back(arg);
+    }
+  }
+  std::sort(cone_.begin() + seg.cone_start, cone_.end(),
+            std::greater<int>());
+}
+
+void mp::ReverseAD::AddPattern(
+    int segment, std::vector<int> &pattern, std::vector<int> &marks) const {
+  const Segment &seg = segments_[segment];
+  // Variables of the linear part go first in their original order.
+  const ExprTape::Instruction &root = tape_.instruction(seg.root);
+  int linear = -1;
+  if (root.opcode == ExprTape::LINEAR)
+    linear = seg.root;
+  else if (root.opcode == expr::ADD &&
+           tape_.instruction(root.arg0).opcode == ExprTape::LINEAR)
+    linear = root.arg0;
+  if (linear >= 0 && shared_[linear] < 0) {
+    const ExprTape::Instruction &instr = tape_.instruction(linear);
+    for (int i = 0; i < instr.arg2; ++i) {
+      int var = tape_.var_index(instr.arg1 + i);
+      if (marks[var] != segment) {
+        marks[var] = segment;
+        pattern.push_back(var);
+      }
+    }
+  }
+  std::size_t sorted_start = pattern.size();
+  for (int i = seg.cone_start, n = segments_[segment + 1].cone_start;
+       i < n; ++i) {
+    const ExprTape::Instruction &instr = tape_.instruction(cone_[i]);
+    if (instr.opcode == expr::VARIABLE) {
+      if (marks[instr.arg0] != segment) {
+        marks[instr.arg0] = segment;
+        pattern.push_back(instr.arg0);
+      }
+    } else if (instr.opcode == ExprTape::LINEAR) {
+      for (int j = 0; j < instr.arg2; ++j) {
+        int var = tape_.var_index(instr.arg1 + j);
+        if (marks[var] != segment) {
+          marks[var] = segment;
+          pattern.push_back(var);
+        }
+      }
+    }
+  }
+  // Patterns of shared segments are in pattern_ at this point.
+  for (int i = seg.ref_start, n = segments_[segment + 1].ref_start;
+       i < n; ++i) {
+    int ref = refs_[i];
+    for (int j = segments_[ref].pattern_start,
+         end = segments_[ref + 1].pattern_start; j < end; ++j) {
+      int var = pattern_[j];
+      if (marks[var] != segment) {
+        marks[var] = segment;
+        pattern.push_back(var);
+      }
+    }
+  }
+  std::sort(pattern.begin() + sorted_start, pattern.end());
+}
+
+void mp::ReverseAD::ComputeSharedGrads(int segment) {
+  for (int i = segments_[segment].ref_start,
+       n = segments_[segment + 1].ref_start; i < n; ++i) {
+    int ref = refs_[i];
+    if (shared_stamps_[ref] == stamp_)
+      continue;
+    Differentiate(ref, &shared_grads_[segments_[ref].pattern_start]);
+    shared_stamps_[ref] = stamp_;
+  }
+}
+
+void mp::ReverseAD::Differentiate(int segment, double *grad) {
+  ComputeSharedGrads(segment);
+  const Segment &seg = segments_[segment], &next = segments_[segment + 1];
+  adjoints_[seg.root] = 1;
+  for (int i = seg.cone_start; i < next.cone_start; ++i) {
+    int index = cone_[i];
+    double adj = adjoints_[index];
+    if (adj == 0)
+      continue;
+    adjoints_[index] = 0;
+    const ExprTape::Instruction &instr = tape_.instruction(index);
+    if (instr.opcode == expr::VARIABLE) {
+      grad_[instr.arg0] += adj;
+    } else if (instr.opcode == ExprTape::LINEAR) {
+      for (int j = instr.arg1, end = instr.arg1 + instr.arg2; j < end; ++j)
+        grad_[tape_.var_index(j)] += adj * tape_.coef(j);
+    } else {
+      Propagate(instr, index, adj);
+    }
+  }
+  // Combine gradients of shared instructions weighted by their adjoints.
+  for (int i = seg.ref_start; i < next.ref_start; ++i) {
+    int ref = refs_[i];
+    const Segment &ref_seg = segments_[ref];
+    double adj = adjoints_[ref_seg.root];
+    if (adj == 0)
+      continue;
+    adjoints_[ref_seg.root] = 0;
+    for (int j = ref_seg.pattern_start,
+         end = segments_[ref + 1].pattern_start; j < end; ++j) {
+      grad_[pattern_[j]] += adj * shared_grads_[j];
+    }
+  }
+  for (int i = seg.pattern_start; i < next.pattern_start; ++i) {
+    double &g = grad_[pattern_[i]];
+    *grad++ = g;
+    g = 0;
+  }
+}
+
+void mp::ReverseAD::Propagate(const Instruction &instr, int index,
+                              double adj) {
+  double *adjoints = adjoints_.data();
+  double a = instr.arg0 >= 0 ? tape_.value(instr.arg0) : 0;
+  switch (instr.opcode) {
+  case expr::MINUS:
+    adjoints[instr.arg0] -= adj;
+    break;
+  case expr::ABS:
+    adjoints[instr.arg0] += a < 0 ? -adj : (a > 0 ? adj : 0);
+    break;
+  case expr::SQRT:
+    adjoints[instr.arg0] += adj * 0.5 / tape_.value(index);
+    break;
+  case expr::POW2:
+    adjoints[instr.arg0] += adj * 2 * a;
+    break;
+  case expr::EXP:
+    adjoints[instr.arg0] += adj * tape_.value(index);
+    break;
+  case expr::LOG:
+    adjoints[instr.arg0] += adj / a;
+    break;
+  case expr::LOG10:
+    adjoints[instr.arg0] += adj / (a * std::log(10.0));
+    break;
+  case expr::SIN:
+    adjoints[instr.arg0] += adj * std::cos(a);
+    break;
+  case expr::SINH:
+    adjoints[instr.arg0] += adj * std::cosh(a);
+    break;
+  case expr::COS:
+    adjoints[instr.arg0] -= adj * std::sin(a);
+    break;
+  case expr::COSH:
+    adjoints[instr.arg0] += adj * std::sinh(a);
+    break;
+  case expr::TAN: {
+    double r = tape_.value(index);
+    adjoints[instr.arg0] += adj * (1 + r * r);
+    break;
+  }
+  case expr::TANH: {
+    double r = tape_.value(index);
+    adjoints[instr.arg0] += adj * (1 - r * r);
+    break;
+  }
+  case expr::ASIN:
+    adjoints[instr.arg0] += adj / std::sqrt(1 - a * a);
+    break;
+  case expr::ASINH:
+    adjoints[instr.arg0] += adj / std::sqrt(1 + a * a);
+    break;
+  case expr::ACOS:
+    adjoints[instr.arg0] -= adj / std::sqrt(1 - a * a);
+    break;
+  case expr::ACOSH:
+    adjoints[instr.arg0] += adj / std::sqrt(a * a - 1);
+    break;
+  case expr::ATAN:
+    adjoints[instr.arg0] += adj / (1 + a * a);
+    break;
+  case expr::ATANH:
+    adjoints[instr.arg0] += adj / (1 - a * a);
+    break;
+  case expr::ADD:
+    adjoints[instr.arg0] += adj;
+    adjoints[instr.arg1] += adj;
+    break;
+  case expr::SUB:
+    adjoints[instr.arg0] += adj;
+    adjoints[instr.arg1] -= adj;
+    break;
+  case expr::LESS:
+    if (tape_.value(index) > 0) {
+      adjoints[instr.arg0] += adj;
+      adjoints[instr.arg1] -= adj;
+    }
+    break;
+  case expr::MUL:
+    adjoints[instr.arg0] += adj * tape_.value(instr.arg1);
+    adjoints[instr.arg1] += adj * a;
+    break;
+  case expr::DIV: {
+    double b = tape_.value(instr.arg1);
+    adjoints[instr.arg0] += adj / b;
+    adjoints[instr.arg1] -= adj * a / (b * b);
+    break;
+  }
+  case expr::MOD: {
+    // fmod(a, b) = a - trunc(a / b) * b
+    double q = a / tape_.value(instr.arg1);
+    adjoints[instr.arg0] += adj;
+    adjoints[instr.arg1] -= adj * (q >= 0 ? std::floor(q) : std::ceil(q));
+    break;
+  }
+  case expr::POW: case expr::POW_CONST_BASE: case expr::POW_CONST_EXP: {
+    double b = tape_.value(instr.arg1);
+    if (instr.opcode != expr::POW_CONST_BASE && b != 0)
+      adjoints[instr.arg0] += adj * b * std::pow(a, b - 1);
+    if (instr.opcode != expr::POW_CONST_EXP && a > 0)
+      adjoints[instr.arg1] += adj * tape_.value(index) * std::log(a);
+    break;
+  }
+  case expr::ATAN2: {
+    double b = tape_.value(instr.arg1);
+    double scale = adj / (a * a + b * b);
+    adjoints[instr.arg0] += b * scale;
+    adjoints[instr.arg1] -= a * scale;
+    break;
+  }
+  case expr::IF:
+    adjoints[a != 0 ? instr.arg1 : instr.arg2] += adj;
+    break;
+  case expr::PLTERM: {
+    // The slope of the segment containing a. At a breakpoint the slope
+    // on the right is used.
+    int i = 0;
+    while (i < instr.arg2 && a >= tape_.data(instr.arg1 + 2 * i + 1))
+      ++i;
+    adjoints[instr.arg0] += adj * tape_.data(instr.arg1 + 2 * i);
+    break;
+  }
+  case expr::MIN: case expr::MAX: {
+    // Propagate to the first argument attaining the extremum.
+    double r = tape_.value(index);
+    for (int i = instr.arg1, end = instr.arg1 + instr.arg2; i < end; ++i) {
+      int arg = tape_.arg(i);
+      if (tape_.value(arg) == r) {
+        adjoints[arg] += adj;
+        break;
+      }
+    }
+    break;
+  }
+  case expr::SUM:
+    for (int i = instr.arg1, end = instr.arg1 + instr.arg2; i < end; ++i)
+      adjoints[tape_.arg(i)] += adj;
+    break;
+  default:
+    // Piecewise constant or logical.
+    break;
+  }
+}
+
+void mp::ReverseAD::NextPoint(const double *x, double *results) {
+  int num_vars = tape_.num_vars();
+  if (stamp_ == 0 || !std::equal(x, x + num_vars, x_.begin())) {
+    x_.assign(x, x + num_vars);
+    results_.resize(tape_.num_outputs());
+    tape_.Evaluate(x, results_.data());
+    if (++stamp_ == 0) {
+      // Stamp overflow: invalidate all shared gradients.
+      std::fill(shared_stamps_.begin(), shared_stamps_.end(), 0);
+      stamp_ = 1;
+    }
+  }
+  if (results)
+    std::copy(results_.begin(), results_.end(), results);
+}
+
+void mp::ReverseAD::Jacobian(const double *x, double *jac, double *results) {
+  NextPoint(x, results);
+  int num_outputs = tape_.num_outputs();
+  // Shared segments are differentiated in the order of roots so that
+  // gradients of the shared segments they use are always known.
+  for (int i = num_outputs, n = static_cast<int>(segments_.size()) - 1;
+       i < n; ++i) {
+    if (shared_stamps_[i] == stamp_)
+      continue;
+    Differentiate(i, &shared_grads_[segments_[i].pattern_start]);
+    shared_stamps_[i] = stamp_;
+  }
+  for (int i = 0; i < num_outputs; ++i)
+    Differentiate(i, jac + jac_row_starts_[i]);
+}
+
+double mp::ReverseAD::Gradient(int output, const double *x, double *grad) {
+  MP_ASSERT(0 <= output && output < tape_.num_outputs(), "invalid index");
+  NextPoint(x, 0);
+  int start = jac_row_starts_[output], end = jac_row_starts_[output + 1];
+  row_.resize(end - start);
+  Differentiate(output, row_.data());
+  std::fill(grad, grad + tape_.num_vars(), 0.0);
+  for (int i = start; i < end; ++i)
+    grad[pattern_[i]] = row_[i - start];
+  return results_[output];
+}
+
+mp::LagrangianHessian::LagrangianHessian(ExprTape &tape)
+  : tape_(tape), partials_(tape.num_instructions()),
+    adjoints_(tape.num_instructions()), tangents_(tape.num_instructions()),
+    tangent_adjoints_(tape.num_instructions()), prepared_(false) {
+  int num_instrs = tape.num_instructions(), num_vars = tape.num_vars();
+  // Find instructions reachable from outputs through arguments with
+  // nonzero derivatives and count their uses.
+  std::vector<int> uses(num_instrs);
+  for (int i = 0, n = tape.num_outputs(); i < n; ++i)
+    ++uses[tape.output(i)];
+  std::vector<int> args;
+  for (int i = num_instrs - 1; i >= 0; --i) {
+    if (uses[i] == 0)
+      continue;
+    active_.push_back(i);
+    args.clear();
+    GetDiffArgs(tape, tape.instruction(i), args);
+    for (std::size_t j = 0, n = args.size(); j < n; ++j)
+      ++uses[args[j]];
+  }
+  std::reverse(active_.begin(), active_.end());
+
+  // Variable sets of shared instructions. They are computed in the
+  // increasing order of instructions so that sets of shared instructions
+  // used by another one are always known.
+  VarCollector collector(tape, uses);
+  for (std::size_t i = 0, n = active_.size(); i < n; ++i)
+    collector.AddShared(active_[i]);
+
+  // Collect elements of the upper triangle as (column, row) pairs.
+  std::vector< std::pair<int, int> > elements;
+  std::vector<int> lhs_vars, vars;
+  for (std::size_t i = 0, n = active_.size(); i < n; ++i) {
+    const ExprTape::Instruction &instr = tape.instruction(active_[i]);
+    switch (instr.opcode) {
+    case expr::SQRT: case expr::POW2: case expr::EXP: case expr::LOG:
+    case expr::LOG10: case expr::SIN: case expr::SINH: case expr::COS:
+    case expr::COSH: case expr::TAN: case expr::TANH: case expr::ASIN:
+    case expr::ASINH: case expr::ACOS: case expr::ACOSH: case expr::ATAN:
+    case expr::ATANH: case expr::POW_CONST_EXP:
+      collector.Collect(instr.arg0, vars);
+      AddElements(vars, vars, elements);
+      break;
+    case expr::POW_CONST_BASE:
+      collector.Collect(instr.arg1, vars);
+      AddElements(vars, vars, elements);
+      break;
+    case expr::MUL: case expr::DIV:
+      collector.Collect(instr.arg0, lhs_vars);
+      collector.Collect(instr.arg1, vars);
+      AddElements(lhs_vars, vars, elements);
+      if (instr.opcode == expr::DIV)
+        AddElements(vars, vars, elements);
+      break;
+    case expr::POW: case expr::ATAN2:
+      collector.Collect(instr.arg0, lhs_vars);
+      collector.Collect(instr.arg1, vars);
+      lhs_vars.insert(lhs_vars.end(), vars.begin(), vars.end());
+      AddElements(lhs_vars, lhs_vars, elements);
+      break;
+    }
+  }
+  std::sort(elements.begin(), elements.end());
+  elements.erase(std::unique(elements.begin(), elements.end()),
+                 elements.end());
+  col_starts_.assign(num_vars + 1, 0);
+  row_indices_.resize(elements.size());
+  for (std::size_t i = 0, n = elements.size(); i < n; ++i) {
+    ++col_starts_[elements[i].first + 1];
+    row_indices_[i] = elements[i].second;
+  }
+  for (int i = 0; i < num_vars; ++i)
+    col_starts_[i + 1] += col_starts_[i];
+
+  // Build the full adjacency structure without the diagonal and color
+  // columns greedily so that columns at distance at most 2 get
+  // different colors.
+  std::vector<int> adj_starts(num_vars + 1);
+  for (std::size_t i = 0, n = elements.size(); i < n; ++i) {
+    if (elements[i].first != elements[i].second) {
+      ++adj_starts[elements[i].first + 1];
+      ++adj_starts[elements[i].second + 1];
+    }
+  }
+  for (int i = 0; i < num_vars; ++i)
+    adj_starts[i + 1] += adj_starts[i];
+  std::vector<int> adj(adj_starts[num_vars]);
+  std::vector<int> pos(adj_starts.begin(), adj_starts.end() - 1);
+  for (std::size_t i = 0, n = elements.size(); i < n; ++i) {
+    int col = elements[i].first, row = elements[i].second;
+    if (col != row) {
+      adj[pos[col]++] = row;
+      adj[pos[row]++] = col;
+    }
+  }
+  std::vector<int> colors(num_vars, -1);
+  std::vector<int> forbidden(num_vars, -1);
+  int num_colors = 0;
+  for (int j = 0; j < num_vars; ++j) {
+    // Skip empty columns. A column with only a diagonal element has no
+    // neighbors but is not empty.
+    if (adj_starts[j] == adj_starts[j + 1] &&
+        col_starts_[j] == col_starts_[j + 1]) {
+      continue;
+    }
+    for (int k = adj_starts[j]; k < adj_starts[j + 1]; ++k) {
+      int neighbor = adj[k];
+      if (colors[neighbor] >= 0)
+        forbidden[colors[neighbor]] = j;
+      for (int l = adj_starts[neighbor]; l < adj_starts[neighbor + 1]; ++l) {
+        int c = colors[adj[l]];
+        if (c >= 0)
+          forbidden[c] = j;
+      }
+    }
+    int color = 0;
+    while (forbidden[color] == j)
+      ++color;
+    colors[j] = color;
+    num_colors = std::max(num_colors, color + 1);
+  }
+  color_starts_.assign(num_colors + 1, 0);
+  for (int j = 0; j < num_vars; ++j) {
+    if (colors[j] >= 0)
+      ++color_starts_[colors[j] + 1];
+  }
+  for (int i = 0; i < num_colors; ++i)
+    color_starts_[i + 1] += color_starts_[i];
+  color_cols_.resize(color_starts_[num_colors]);
+  pos.assign(color_starts_.begin(), color_starts_.end() - 1);
+  for (int j = 0; j < num_vars; ++j) {
+    if (colors[j] >= 0)
+      color_cols_[pos[colors[j]]++] = j;
+  }
+}
+
+void mp::LagrangianHessian::Prepare(const double *x, const double *w) {
+  int num_vars = tape_.num_vars(), num_outputs = tape_.num_outputs();
+  if (prepared_ && std::equal(x, x + num_vars, x_.begin()) &&
+      std::equal(w, w + num_outputs, w_.begin())) {
+    return;
+  }
+  x_.assign(x, x + num_vars);
+  w_.assign(w, w + num_outputs);
+  results_.resize(num_outputs);
+  tape_.Evaluate(x, results_.data());
+  // Compute partial derivatives.
+  for (std::size_t i = 0, n = active_.size(); i < n; ++i) {
+    int index = active_[i];
+    const ExprTape::Instruction &instr = tape_.instruction(index);
+    Partials &p = partials_[index];
+    p.d1 = p.d2 = p.d11 = p.d12 = p.d22 = 0;
+    p.selected = -1;
+    double a = 0, b = 0;
+    if (instr.opcode >= expr::FIRST_UNARY &&
+        instr.opcode <= expr::LAST_BINARY) {
+      a = tape_.value(instr.arg0);
+      if (instr.opcode >= expr::FIRST_BINARY)
+        b = tape_.value(instr.arg1);
+    }
+    double r = tape_.value(index);
+    switch (instr.opcode) {
+    case expr::MINUS:
+      p.d1 = -1;
+      break;
+    case expr::ABS:
+      p.d1 = a < 0 ? -1 : (a > 0 ? 1 : 0);
+      break;
+    case expr::SQRT:
+      p.d1 = 0.5 / r;
+      p.d11 = -0.25 / (a * r);
+      break;
+    case expr::POW2:
+      p.d1 = 2 * a;
+      p.d11 = 2;
+      break;
+    case expr::EXP:
+      p.d1 = p.d11 = r;
+      break;
+    case expr::LOG: case expr::LOG10: {
+      double scale = instr.opcode == expr::LOG ? 1 : 1 / std::log(10.0);
+      p.d1 = scale / a;
+      p.d11 = -p.d1 / a;
+      break;
+    }
+    case expr::SIN:
+      p.d1 = std::cos(a);
+      p.d11 = -r;
+      break;
+    case expr::COS:
+      p.d1 = -std::sin(a);
+      p.d11 = -r;
+      break;
+    case expr::SINH:
+      p.d1 = std::cosh(a);
+      p.d11 = r;
+      break;
+    case expr::COSH:
+      p.d1 = std::sinh(a);
+      p.d11 = r;
+      break;
+    case expr::TAN:
+      p.d1 = 1 + r * r;
+      p.d11 = 2 * r * p.d1;
+      break;
+    case expr::TANH:
+      p.d1 = 1 - r * r;
+      p.d11 = -2 * r * p.d1;
+      break;
+    case expr::ASIN: case expr::ACOS: {
+      double t = 1 - a * a;
+      double sign = instr.opcode == expr::ASIN ? 1 : -1;
+      p.d1 = sign / std::sqrt(t);
+      p.d11 = p.d1 * a / t;
+      break;
+    }
+    case expr::ASINH: case expr::ACOSH: {
+      double t = instr.opcode == expr::ASINH ? 1 + a * a : a * a - 1;
+      p.d1 = 1 / std::sqrt(t);
+      p.d11 = -p.d1 * a / t;
+      break;
+    }
+    case expr::ATAN:
+      p.d1 = 1 / (1 + a * a);
+      p.d11 = -2 * a * p.d1 * p.d1;
+      break;
+    case expr::ATANH:
+      p.d1 = 1 / (1 - a * a);
+      p.d11 = 2 * a * p.d1 * p.d1;
+      break;
+    case expr::ADD:
+      p.d1 = p.d2 = 1;
+      break;
+    case expr::SUB:
+      p.d1 = 1;
+      p.d2 = -1;
+      break;
+    case expr::LESS:
+      if (r > 0) {
+        p.d1 = 1;
+        p.d2 = -1;
+      }
+      break;
+    case expr::MUL:
+      p.d1 = b;
+      p.d2 = a;
+      p.d12 = 1;
+      break;
+    case expr::DIV:
+      p.d1 = 1 / b;
+      p.d2 = -a / (b * b);
+      p.d12 = -p.d1 * p.d1;
+      p.d22 = -2 * p.d2 / b;
+      break;
+    case expr::MOD: {
+      double q = a / b;
+      p.d1 = 1;
+      p.d2 = -(q >= 0 ? std::floor(q) : std::ceil(q));
+      break;
+    }
+    case expr::POW: case expr::POW_CONST_BASE: case expr::POW_CONST_EXP:
+      if (instr.opcode != expr::POW_CONST_BASE && b != 0) {
+        p.d1 = b * std::pow(a, b - 1);
+        p.d11 = b * (b - 1) * std::pow(a, b - 2);
+      }
+      if (instr.opcode != expr::POW_CONST_EXP && a > 0) {
+        double log_a = std::log(a);
+        p.d2 = r * log_a;
+        p.d22 = p.d2 * log_a;
+        if (instr.opcode == expr::POW)
+          p.d12 = std::pow(a, b - 1) * (1 + b * log_a);
+      }
+      break;
+    case expr::ATAN2: {
+      double s = a * a + b * b;
+      p.d1 = b / s;
+      p.d2 = -a / s;
+      p.d11 = -2 * a * b / (s * s);
+      p.d22 = -p.d11;
+      p.d12 = (a * a - b * b) / (s * s);
+      break;
+    }
+    case expr::IF:
+      p.selected = tape_.value(instr.arg0) != 0 ? instr.arg1 : instr.arg2;
+      break;
+    case expr::PLTERM: {
+      double arg = tape_.value(instr.arg0);
+      int k = 0;
+      while (k < instr.arg2 && arg >= tape_.data(instr.arg1 + 2 * k + 1))
+        ++k;
+      p.d1 = tape_.data(instr.arg1 + 2 * k);
+      break;
+    }
+    case expr::MIN: case expr::MAX:
+      for (int k = instr.arg1, end = instr.arg1 + instr.arg2; k < end; ++k) {
+        if (tape_.value(tape_.arg(k)) == r) {
+          p.selected = tape_.arg(k);
+          break;
+        }
+      }
+      break;
+    }
+  }
+  // Compute first-order adjoints of the Lagrangian.
+  double *adjoints = adjoints_.data();
+  for (std::size_t i = 0, n = active_.size(); i < n; ++i)
+    adjoints[active_[i]] = 0;
+  for (int i = 0; i < num_outputs; ++i)
+    adjoints[tape_.output(i)] += w[i];
+  for (std::size_t i = active_.size(); i-- > 0; ) {
+    int index = active_[i];
+    double adj = adjoints[index];
+    if (adj == 0)
+      continue;
+    const ExprTape::Instruction &instr = tape_.instruction(index);
+    const Partials &p = partials_[index];
+    if (p.selected >= 0) {
+      adjoints[p.selected] += adj;
+    } else if (instr.opcode == expr::SUM) {
+      for (int k = instr.arg1, end = instr.arg1 + instr.arg2; k < end; ++k)
+        adjoints[tape_.arg(k)] += adj;
+    } else if (instr.opcode >= expr::FIRST_UNARY &&
+               instr.opcode <= expr::LAST_BINARY) {
+      adjoints[instr.arg0] += adj * p.d1;
+      if (instr.opcode >= expr::FIRST_BINARY)
+        adjoints[instr.arg1] += adj * p.d2;
+    } else if (instr.opcode == expr::PLTERM) {
+      adjoints[instr.arg0] += adj * p.d1;
+    }
+  }
+  prepared_ = true;
+}
+
+void mp::LagrangianHessian::Multiply(const double *v, double *hv) {
+  double *t = tangents_.data(), *tadj = tangent_adjoints_.data();
+  const double *adjoints = adjoints_.data();
+  // Propagate the direction forward.
+  for (std::size_t i = 0, n = active_.size(); i < n; ++i) {
+    int index = active_[i];
+    const ExprTape::Instruction &instr = tape_.instruction(index);
+    const Partials &p = partials_[index];
+    double result = 0;
+    if (instr.opcode == expr::VARIABLE) {
+      result = v[instr.arg0];
+    } else if (instr.opcode == ExprTape::LINEAR) {
+      for (int k = instr.arg1, end = instr.arg1 + instr.arg2; k < end; ++k)
+        result += tape_.coef(k) * v[tape_.var_index(k)];
+    } else if (p.selected >= 0) {
+      result = t[p.selected];
+    } else if (instr.opcode == expr::SUM) {
+      for (int k = instr.arg1, end = instr.arg1 + instr.arg2; k < end; ++k)
+        result += t[tape_.arg(k)];
+    } else if (instr.opcode >= expr::FIRST_UNARY &&
+               instr.opcode <= expr::LAST_BINARY) {
+      result = p.d1 * t[instr.arg0];
+      if (instr.opcode >= expr::FIRST_BINARY)
+        result += p.d2 * t[instr.arg1];
+    } else if (instr.opcode == expr::PLTERM) {
+      result = p.d1 * t[instr.arg0];
+    }
+    t[index] = result;
+    tadj[index] = 0;
+  }
+  // Propagate directional derivatives of adjoints backward.
+  std::fill(hv, hv + tape_.num_vars(), 0.0);
+  for (std::size_t i = active_.size(); i-- > 0; ) {
+    int index = active_[i];
+    double ta = tadj[index], adj = adjoints[index];
+    if (ta == 0 && adj == 0)
+      continue;
+    const ExprTape::Instruction &instr = tape_.instruction(index);
+    const Partials &p = partials_[index];
+    if (instr.opcode == expr::VARIABLE) {
+      hv[instr.arg0] += ta;
+    } else if (instr.opcode == ExprTape::LINEAR) {
+      for (int k = instr.arg1, end = instr.arg1 + instr.arg2; k < end; ++k)
+        hv[tape_.var_index(k)] += ta * tape_.coef(k);
+    } else if (p.selected >= 0) {
+      tadj[p.selected] += ta;
+    } else if (instr.opcode == expr::SUM) {
+      for (int k = instr.arg1, end = instr.arg1 + instr.arg2; k < end; ++k)
+        tadj[tape_.arg(k)] += ta;
+    } else if (instr.opcode >= expr::FIRST_UNARY &&
+               instr.opcode <= expr::LAST_UNARY) {
+      tadj[instr.arg0] += ta * p.d1 + adj * p.d11 * t[instr.arg0];
+    } else if (instr.opcode >= expr::FIRST_BINARY &&
+               instr.opcode <= expr::LAST_BINARY) {
+      double t0 = t[instr.arg0], t1 = t[instr.arg1];
+      tadj[instr.arg0] += ta * p.d1 + adj * (p.d11 * t0 + p.d12 * t1);
+      tadj[instr.arg1] += ta * p.d2 + adj * (p.d12 * t0 + p.d22 * t1);
+    } else if (instr.opcode == expr::PLTERM) {
+      tadj[instr.arg0] += ta * p.d1;
+    }
+  }
+}
+
+void mp::LagrangianHessian::Compute(const double *x, const double *w,
+                                    double *hes) {
+  Prepare(x, w);
+  int num_vars = tape_.num_vars();
+  std::vector<double> v(num_vars), hv(num_vars);
+  for (int c = 0, n = num_colors(); c < n; ++c) {
+    int start = color_starts_[c], end = color_starts_[c + 1];
+    for (int i = start; i < end; ++i)
+      v[color_cols_[i]] = 1;
+    Multiply(v.data(), hv.data());
+    // Columns of the same color have no common rows, so the element
+    // (row, col) of the Hessian is hv[row].
+    for (int i = start; i < end; ++i) {
+      int col = color_cols_[i];
+      v[col] = 0;
+      for (int k = col_starts_[col]; k < col_starts_[col + 1]; ++k)
+        hes[k] = hv[row_indices_[k]];
+    }
+  }
+}
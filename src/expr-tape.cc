@@ -0,0 +1,300 @@
+/*
+ Expression tape
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include "mp/expr-tape.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Rounds x to n decimal places.
+inline double Round(double x, double n) {
+  double scale = std::pow(10.0, n);
+  return std::floor(x * scale + 0.5) / scale;
+}
+
+// Truncates x to n decimal places.
+inline double Trunc(double x, double n) {
+  double scale = std::pow(10.0, n);
+  double value = x * scale;
+  return (value >= 0 ? std::floor(value) : std::ceil(value)) / scale;
+}
+
+// Rounds x to n significant decimal digits.
+inline double Precision(double x, double n) {
+  if (x == 0)
+    return 0;
+  return Round(x, n - std::ceil(std::log10(std::fabs(x))));
+}
+
+// Computes the value of a piecewise-linear term with num_breakpoints
+// breakpoints at x. data contains slopes interleaved with breakpoints.
+// The term is zero at x = 0.
+inline double PLTermValue(const double *data, int num_breakpoints, double x) {
+  // Add contributions of all segments clipped to [0, x] or [x, 0].
+  double result = 0;
+  double lb = -HUGE_VAL;
+  for (int i = 0; i <= num_breakpoints; ++i) {
+    double ub = i < num_breakpoints ? data[2 * i + 1] : HUGE_VAL;
+    double start = std::min(std::max(0.0, lb), ub);
+    double end = std::min(std::max(x, lb), ub);
+    result += data[2 * i] * (end - start);
+    lb = ub;
+  }
+  return result;
+}
+}  // namespace
+
+#define MP_TAPE_ARG(arg) (values + (arg) * NUM_POINTS)
+
+#define MP_TAPE_UNARY(kind, expr) \
+  case kind: { \
+    const double *a = MP_TAPE_ARG(instr.arg0); \
+    for (int l = 0; l < NUM_POINTS; ++l) \
+      r[l] = expr; \
+    break; \
+  }
+
+#define MP_TAPE_BINARY(kind, expr) \
+  case kind: { \
+    const double *a = MP_TAPE_ARG(instr.arg0); \
+    const double *b = MP_TAPE_ARG(instr.arg1); \
+    for (int l = 0; l < NUM_POINTS; ++l) \
+      r[l] = expr; \
+    break; \
+  }
+
+template <int NUM_POINTS>
+void mp::ExprTape::Run(const double *const *points) {
+  values_.resize(code_.size() * NUM_POINTS);
+  num_points_ = NUM_POINTS;
+  double *values = values_.data();
+  for (std::size_t i = 0, n = code_.size(); i < n; ++i) {
+    const Instruction &instr = code_[i];
+    double *r = values + i * NUM_POINTS;
+    switch (instr.opcode) {
+    case expr::NUMBER: case expr::BOOL:
+      for (int l = 0; l < NUM_POINTS; ++l)
+        r[l] = instr.value;
+      break;
+    case expr::VARIABLE:
+      for (int l = 0; l < NUM_POINTS; ++l)
+        r[l] = points[l][instr.arg0];
+      break;
+    case LINEAR: {
+      for (int l = 0; l < NUM_POINTS; ++l)
+        r[l] = 0;
+      const int *indices = var_indices_.data() + instr.arg1;
+      const double *coefs = coefs_.data() + instr.arg1;
+      for (int k = 0; k < instr.arg2; ++k) {
+        int index = indices[k];
+        double coef = coefs[k];
+        for (int l = 0; l < NUM_POINTS; ++l)
+          r[l] += coef * points[l][index];
+      }
+      break;
+    }
+    MP_TAPE_UNARY(expr::MINUS, -a[l])
+    MP_TAPE_UNARY(expr::ABS, std::fabs(a[l]))
+    MP_TAPE_UNARY(expr::FLOOR, std::floor(a[l]))
+    MP_TAPE_UNARY(expr::CEIL, std::ceil(a[l]))
+    MP_TAPE_UNARY(expr::SQRT, std::sqrt(a[l]))
+    MP_TAPE_UNARY(expr::POW2, a[l] * a[l])
+    MP_TAPE_UNARY(expr::EXP, std::exp(a[l]))
+    MP_TAPE_UNARY(expr::LOG, std::log(a[l]))
+    MP_TAPE_UNARY(expr::LOG10, std::log10(a[l]))
+    MP_TAPE_UNARY(expr::SIN, std::sin(a[l]))
+    MP_TAPE_UNARY(expr::SINH, std::sinh(a[l]))
+    MP_TAPE_UNARY(expr::COS, std::cos(a[l]))
+    MP_TAPE_UNARY(expr::COSH, std::cosh(a[l]))
+    MP_TAPE_UNARY(expr::TAN, std::tan(a[l]))
+    MP_TAPE_UNARY(expr::TANH, std::tanh(a[l]))
+    MP_TAPE_UNARY(expr::ASIN, std::asin(a[l]))
+    MP_TAPE_UNARY(expr::ASINH, std::asinh(a[l]))
+    MP_TAPE_UNARY(expr::ACOS, std::acos(a[l]))
+    MP_TAPE_UNARY(expr::ACOSH, std::acosh(a[l]))
+    MP_TAPE_UNARY(expr::ATAN, std::atan(a[l]))
+    MP_TAPE_UNARY(expr::ATANH, std::atanh(a[l]))
+    MP_TAPE_UNARY(expr::NOT, a[l] == 0)
+    MP_TAPE_BINARY(expr::ADD, a[l] + b[l])
+    MP_TAPE_BINARY(expr::SUB, a[l] - b[l])
+    MP_TAPE_BINARY(expr::LESS, std::max(a[l] - b[l], 0.0))
+    MP_TAPE_BINARY(expr::MUL, a[l] * b[l])
+    MP_TAPE_BINARY(expr::DIV, a[l] / b[l])
+    MP_TAPE_BINARY(expr::TRUNC_DIV, Trunc(a[l] / b[l], 0))
+    MP_TAPE_BINARY(expr::MOD, std::fmod(a[l], b[l]))
+    MP_TAPE_BINARY(expr::POW, std::pow(a[l], b[l]))
+    MP_TAPE_BINARY(expr::POW_CONST_BASE, std::pow(a[l], b[l]))
+    MP_TAPE_BINARY(expr::POW_CONST_EXP, std::pow(a[l], b[l]))
+    MP_TAPE_BINARY(expr::ATAN2, std::atan2(a[l], b[l]))
+    MP_TAPE_BINARY(expr::PRECISION, Precision(a[l], b[l]))
+    MP_TAPE_BINARY(expr::ROUND, Round(a[l], b[l]))
+    MP_TAPE_BINARY(expr::TRUNC, Trunc(a[l], b[l]))
+    MP_TAPE_BINARY(expr::OR, a[l] != 0 || b[l] != 0)
+    MP_TAPE_BINARY(expr::AND, a[l] != 0 && b[l] != 0)
+    MP_TAPE_BINARY(expr::IFF, (a[l] != 0) == (b[l] != 0))
+    MP_TAPE_BINARY(expr::LT, a[l] < b[l])
+    MP_TAPE_BINARY(expr::LE, a[l] <= b[l])
+    MP_TAPE_BINARY(expr::EQ, a[l] == b[l])
+    MP_TAPE_BINARY(expr::GE, a[l] >= b[l])
+    MP_TAPE_BINARY(expr::GT, a[l] > b[l])
+    MP_TAPE_BINARY(expr::NE, a[l] != b[l])
+    MP_TAPE_BINARY(expr::ATLEAST, a[l] <= b[l])
+    MP_TAPE_BINARY(expr::ATMOST, a[l] >= b[l])
+    MP_TAPE_BINARY(expr::EXACTLY, a[l] == b[l])
+    MP_TAPE_BINARY(expr::NOT_ATLEAST, a[l] > b[l])
+    MP_TAPE_BINARY(expr::NOT_ATMOST, a[l] < b[l])
+    MP_TAPE_BINARY(expr::NOT_EXACTLY, a[l] != b[l])
+    case expr::IF: case expr::IMPLICATION: {
+      // Both branches are evaluated for all lanes so only select here.
+      const double *c = MP_TAPE_ARG(instr.arg0);
+      const double *a = MP_TAPE_ARG(instr.arg1);
+      const double *b = MP_TAPE_ARG(instr.arg2);
+      for (int l = 0; l < NUM_POINTS; ++l)
+        r[l] = c[l] != 0 ? a[l] : b[l];
+      break;
+    }
+    case expr::PLTERM: {
+      const double *a = MP_TAPE_ARG(instr.arg0);
+      const double *data = data_.data() + instr.arg1;
+      for (int l = 0; l < NUM_POINTS; ++l)
+        r[l] = PLTermValue(data, instr.arg2, a[l]);
+      break;
+    }
+    case expr::MIN: case expr::MAX: {
+      const int *args = args_.data() + instr.arg1;
+      const double *a = MP_TAPE_ARG(args[0]);
+      for (int l = 0; l < NUM_POINTS; ++l)
+        r[l] = a[l];
+      bool is_min = instr.opcode == expr::MIN;
+      for (int k = 1; k < instr.arg2; ++k) {
+        a = MP_TAPE_ARG(args[k]);
+        if (is_min) {
+          for (int l = 0; l < NUM_POINTS; ++l)
+            r[l] = std::min(r[l], a[l]);
+        } else {
+          for (int l = 0; l < NUM_POINTS; ++l)
+            r[l] = std::max(r[l], a[l]);
+        }
+      }
+      break;
+    }
+    case expr::SUM: case expr::COUNT: {
+      const int *args = args_.data() + instr.arg1;
+      bool is_count = instr.opcode == expr::COUNT;
+      for (int l = 0; l < NUM_POINTS; ++l)
+        r[l] = 0;
+      for (int k = 0; k < instr.arg2; ++k) {
+        const double *a = MP_TAPE_ARG(args[k]);
+        if (is_count) {
+          for (int l = 0; l < NUM_POINTS; ++l)
+            r[l] += a[l] != 0;
+        } else {
+          for (int l = 0; l < NUM_POINTS; ++l)
+            r[l] += a[l];
+        }
+      }
+      break;
+    }
+    case expr::NUMBEROF: {
+      const int *args = args_.data() + instr.arg1;
+      const double *value = MP_TAPE_ARG(args[0]);
+      for (int l = 0; l < NUM_POINTS; ++l)
+        r[l] = 0;
+      for (int k = 1; k < instr.arg2; ++k) {
+        const double *a = MP_TAPE_ARG(args[k]);
+        for (int l = 0; l < NUM_POINTS; ++l)
+          r[l] += a[l] == value[l];
+      }
+      break;
+    }
+    case expr::EXISTS: case expr::FORALL: {
+      const int *args = args_.data() + instr.arg1;
+      bool is_exists = instr.opcode == expr::EXISTS;
+      for (int l = 0; l < NUM_POINTS; ++l)
+        r[l] = !is_exists;
+      for (int k = 0; k < instr.arg2; ++k) {
+        const double *a = MP_TAPE_ARG(args[k]);
+        if (is_exists) {
+          for (int l = 0; l < NUM_POINTS; ++l)
+            r[l] = r[l] != 0 || a[l] != 0;
+        } else {
+          for (int l = 0; l < NUM_POINTS; ++l)
+            r[l] = r[l] != 0 && a[l] != 0;
+        }
+      }
+      break;
+    }
+    case expr::ALLDIFF: case expr::NOT_ALLDIFF: {
+      const int *args = args_.data() + instr.arg1;
+      for (int l = 0; l < NUM_POINTS; ++l)
+        r[l] = 1;
+      for (int j = 1; j < instr.arg2; ++j) {
+        const double *a = MP_TAPE_ARG(args[j]);
+        for (int k = 0; k < j; ++k) {
+          const double *b = MP_TAPE_ARG(args[k]);
+          for (int l = 0; l < NUM_POINTS; ++l)
+            r[l] = r[l] != 0 && a[l] != b[l];
+        }
+      }
+      if (instr.opcode == expr::NOT_ALLDIFF) {
+        for (int l = 0; l < NUM_POINTS; ++l)
+          r[l] = r[l] == 0;
+      }
+      break;
+    }
+    default:
+      throw MakeUnsupportedError("opcode {}", instr.opcode);
+    }
+  }
+}
+
+#undef MP_TAPE_ARG
+#undef MP_TAPE_UNARY
+#undef MP_TAPE_BINARY
+
+void mp::ExprTape::Evaluate(const double *x, double *results) {
+  Run<1>(&x);
+  for (std::size_t i = 0, n = outputs_.size(); i < n; ++i)
+    results[i] = values_[outputs_[i]];
+}
+
+void mp::ExprTape::EvaluateBatch(const double *points, int num_points,
+                                 int point_size, double *results) {
+  MP_ASSERT(num_points >= 0 && point_size >= num_vars_, "invalid size");
+  std::size_t num_outputs = outputs_.size();
+  const double *lanes[NUM_LANES];
+  for (int start = 0; start < num_points; start += NUM_LANES) {
+    // Repeat the last point in the unused lanes of the last batch.
+    int num_lanes = std::min(num_points - start, static_cast<int>(NUM_LANES));
+    for (int l = 0; l < NUM_LANES; ++l) {
+      lanes[l] = points +
+          static_cast<std::size_t>(start + std::min(l, num_lanes - 1)) *
+          point_size;
+    }
+    Run<NUM_LANES>(lanes);
+    for (int l = 0; l < num_lanes; ++l) {
+      double *result = results + (start + l) * num_outputs;
+      for (std::size_t i = 0; i < num_outputs; ++i)
+        result[i] = values_[outputs_[i] * NUM_LANES + l];
+    }
+  }
+}
@@ -24,6 +24,7 @@
 #include "mp/expr-visitor.h"
 #include "expr-writer.h"
 
+#include <algorithm>
 #include <cstring>
 
 using mp::Cast;
@@ -150,6 +151,149 @@ bool mp::Equal(Expr e1, Expr e2) {
   return ExprComparator(e1).Visit(e2);
 }
 
+// Shallow data of an expression.
+struct mp::internal::ExprTable::Fields {
+  expr::Kind kind;
+  // The value of a constant or the index of a reference.
+  double value;
+  const Impl *args[3];
+  int num_var_args;
+  const Impl *const *var_args;
+};
+
+#define MP_GET_ARGS(ExprType, ...) \
+  if (Is<ExprType>(kind)) { \
+    const ExprType::Impl *e = static_cast<const ExprType::Impl*>(impl); \
+    const Impl *args[] = {__VA_ARGS__}; \
+    std::copy(args, args + sizeof(args) / sizeof(*args), f.args); \
+    return; \
+  }
+
+#define MP_GET_VAR_ARGS(ExprType) \
+  if (Is<ExprType>(kind)) { \
+    const ExprType::Impl *e = static_cast<const ExprType::Impl*>(impl); \
+    f.num_var_args = e->num_args; \
+    f.var_args = e->args; \
+    return; \
+  }
+
+void mp::internal::ExprTable::GetFields(const Impl *impl, Fields &f) {
+  expr::Kind kind = impl->kind();
+  f.kind = kind;
+  f.value = 0;
+  f.args[0] = f.args[1] = f.args[2] = 0;
+  f.num_var_args = 0;
+  f.var_args = 0;
+  if (kind == expr::NUMBER) {
+    f.value = static_cast<const NumericConstant::Impl*>(impl)->value;
+    return;
+  }
+  if (kind == expr::BOOL) {
+    f.value = static_cast<const LogicalConstant::Impl*>(impl)->value;
+    return;
+  }
+  if (Is<Reference>(kind)) {
+    f.value = static_cast<const Reference::Impl*>(impl)->index;
+    return;
+  }
+  MP_GET_ARGS(UnaryExpr, e->arg)
+  MP_GET_ARGS(NotExpr, e->arg)
+  MP_GET_ARGS(BinaryExpr, e->lhs, e->rhs)
+  MP_GET_ARGS(BinaryLogicalExpr, e->lhs, e->rhs)
+  MP_GET_ARGS(RelationalExpr, e->lhs, e->rhs)
+  MP_GET_ARGS(LogicalCountExpr, e->lhs, e->rhs)
+  MP_GET_ARGS(IfExpr, e->condition, e->then_expr, e->else_expr)
+  MP_GET_ARGS(ImplicationExpr, e->condition, e->then_expr, e->else_expr)
+  MP_GET_ARGS(SymbolicIfExpr, e->condition, e->then_expr, e->else_expr)
+  MP_GET_VAR_ARGS(IteratedExpr)
+  MP_GET_VAR_ARGS(SymbolicNumberOfExpr)
+  MP_GET_VAR_ARGS(CountExpr)
+  MP_GET_VAR_ARGS(IteratedLogicalExpr)
+  MP_GET_VAR_ARGS(PairwiseExpr)
+  MP_ASSERT(false, "unsupported expression");
+}
+
+#undef MP_GET_ARGS
+#undef MP_GET_VAR_ARGS
+
+namespace {
+inline std::size_t Mix(std::size_t seed, std::size_t value) {
+  return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+inline std::size_t Mix(std::size_t seed, const void *ptr) {
+  return Mix(seed, reinterpret_cast<std::size_t>(ptr));
+}
+}  // namespace
+
+std::size_t mp::internal::ExprTable::Hash(const Fields &f) {
+  std::size_t hash = f.kind;
+  unsigned long long bits = 0;
+  std::memcpy(&bits, &f.value, sizeof(f.value));
+  hash = Mix(hash, static_cast<std::size_t>(bits ^ (bits >> 32)));
+  for (int i = 0; i < 3; ++i)
+    hash = Mix(hash, f.args[i]);
+  for (int i = 0; i < f.num_var_args; ++i)
+    hash = Mix(hash, f.var_args[i]);
+  return hash;
+}
+
+bool mp::internal::ExprTable::Equal(const Fields &lhs, const Fields &rhs) {
+  // Values are compared bitwise to distinguish 0 from -0 and to match NaNs.
+  return lhs.kind == rhs.kind &&
+      std::memcmp(&lhs.value, &rhs.value, sizeof(lhs.value)) == 0 &&
+      std::equal(lhs.args, lhs.args + 3, rhs.args) &&
+      lhs.num_var_args == rhs.num_var_args &&
+      std::equal(lhs.var_args, lhs.var_args + lhs.num_var_args,
+                 rhs.var_args);
+}
+
+const mp::Expr::Impl *mp::internal::ExprTable::Find(const Impl *impl) const {
+  if (slots_.empty() || !IsSupported(impl->kind()))
+    return 0;
+  Fields fields, other;
+  GetFields(impl, fields);
+  std::size_t mask = slots_.size() - 1;
+  for (std::size_t i = Hash(fields) & mask; slots_[i]; i = (i + 1) & mask) {
+    GetFields(slots_[i], other);
+    if (Equal(fields, other))
+      return slots_[i];
+  }
+  return 0;
+}
+
+void mp::internal::ExprTable::Insert(const Impl *impl) {
+  if (!IsSupported(impl->kind()))
+    return;
+  // Keep the load factor below 1/2.
+  if (2 * (size_ + 1) > slots_.size())
+    Grow();
+  Fields fields;
+  GetFields(impl, fields);
+  std::size_t mask = slots_.size() - 1;
+  std::size_t i = Hash(fields) & mask;
+  while (slots_[i])
+    i = (i + 1) & mask;
+  slots_[i] = impl;
+  ++size_;
+}
+
+void mp::internal::ExprTable::Grow() {
+  std::vector<const Impl*> slots(std::max<std::size_t>(64, 2 * slots_.size()));
+  std::size_t mask = slots.size() - 1;
+  Fields fields;
+  for (std::size_t i = 0, n = slots_.size(); i < n; ++i) {
+    if (!slots_[i])
+      continue;
+    GetFields(slots_[i], fields);
+    std::size_t j = Hash(fields) & mask;
+    while (slots[j])
+      j = (j + 1) & mask;
+    slots[j] = slots_[i];
+  }
+  slots_.swap(slots);
+}
+
 #ifdef MP_USE_HASH
 
 using std::size_t;
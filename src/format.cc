@@ -35,6 +35,7 @@
 #include <cmath>
 #include <cstdarg>
 #include <cstddef>  // for std::ptrdiff_t
+#include <cstring>
 
 #if defined(_WIN32) && defined(__MINGW32__)
 # include <cstring>
@@ -360,6 +361,236 @@ class CharConverter : public ArgVisitor<CharConverter, void> {
     arg_.int_value = static_cast<char>(value);
   }
 };
+
+// A floating-point number f * 2^e with a 64-bit significand used by the
+// Grisu2 algorithm from "Printing Floating-Point Numbers Quickly and
+// Accurately with Integers" by Florian Loitsch.
+struct DiyFp {
+  uint64_t f;
+  int e;
+
+  DiyFp(uint64_t f, int e) : f(f), e(e) {}
+
+  // Returns the product rounded to 64 bits of the significand.
+  DiyFp operator*(const DiyFp &rhs) const {
+    const uint64_t MASK32 = 0xffffffff;
+    uint64_t a = f >> 32, b = f & MASK32, c = rhs.f >> 32, d = rhs.f & MASK32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & MASK32) + (bc & MASK32);
+    tmp += 1u << 31;  // Round.
+    return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e + rhs.e + 64);
+  }
+};
+
+const int SIGNIFICAND_SIZE = 52;
+const uint64_t HIDDEN_BIT = static_cast<uint64_t>(1) << SIGNIFICAND_SIZE;
+
+DiyFp Normalize(DiyFp x) {
+  while ((x.f & (HIDDEN_BIT << 11)) == 0) {
+    x.f <<= 1;
+    --x.e;
+  }
+  return x;
+}
+
+// Normalized powers of 10 from 10^-348 to 10^340 with a step of 8.
+const struct {
+  uint64_t f;
+  int e;
+} CACHED_POWERS[] = {
+  {0xfa8fd5a0081c0288ULL, -1220},
+  {0xbaaee17fa23ebf76ULL, -1193},
+  {0x8b16fb203055ac76ULL, -1166},
+  {0xcf42894a5dce35eaULL, -1140},
+  {0x9a6bb0aa55653b2dULL, -1113},
+  {0xe61acf033d1a45dfULL, -1087},
+  {0xab70fe17c79ac6caULL, -1060},
+  {0xff77b1fcbebcdc4fULL, -1034},
+  {0xbe5691ef416bd60cULL, -1007},
+  {0x8dd01fad907ffc3cULL, -980},
+  {0xd3515c2831559a83ULL, -954},
+  {0x9d71ac8fada6c9b5ULL, -927},
+  {0xea9c227723ee8bcbULL, -901},
+  {0xaecc49914078536dULL, -874},
+  {0x823c12795db6ce57ULL, -847},
+  {0xc21094364dfb5637ULL, -821},
+  {0x9096ea6f3848984fULL, -794},
+  {0xd77485cb25823ac7ULL, -768},
+  {0xa086cfcd97bf97f4ULL, -741},
+  {0xef340a98172aace5ULL, -715},
+  {0xb23867fb2a35b28eULL, -688},
+  {0x84c8d4dfd2c63f3bULL, -661},
+  {0xc5dd44271ad3cdbaULL, -635},
+  {0x936b9fcebb25c996ULL, -608},
+  {0xdbac6c247d62a584ULL, -582},
+  {0xa3ab66580d5fdaf6ULL, -555},
+  {0xf3e2f893dec3f126ULL, -529},
+  {0xb5b5ada8aaff80b8ULL, -502},
+  {0x87625f056c7c4a8bULL, -475},
+  {0xc9bcff6034c13053ULL, -449},
+  {0x964e858c91ba2655ULL, -422},
+  {0xdff9772470297ebdULL, -396},
+  {0xa6dfbd9fb8e5b88fULL, -369},
+  {0xf8a95fcf88747d94ULL, -343},
+  {0xb94470938fa89bcfULL, -316},
+  {0x8a08f0f8bf0f156bULL, -289},
+  {0xcdb02555653131b6ULL, -263},
+  {0x993fe2c6d07b7facULL, -236},
+  {0xe45c10c42a2b3b06ULL, -210},
+  {0xaa242499697392d3ULL, -183},
+  {0xfd87b5f28300ca0eULL, -157},
+  {0xbce5086492111aebULL, -130},
+  {0x8cbccc096f5088ccULL, -103},
+  {0xd1b71758e219652cULL, -77},
+  {0x9c40000000000000ULL, -50},
+  {0xe8d4a51000000000ULL, -24},
+  {0xad78ebc5ac620000ULL, 3},
+  {0x813f3978f8940984ULL, 30},
+  {0xc097ce7bc90715b3ULL, 56},
+  {0x8f7e32ce7bea5c70ULL, 83},
+  {0xd5d238a4abe98068ULL, 109},
+  {0x9f4f2726179a2245ULL, 136},
+  {0xed63a231d4c4fb27ULL, 162},
+  {0xb0de65388cc8ada8ULL, 189},
+  {0x83c7088e1aab65dbULL, 216},
+  {0xc45d1df942711d9aULL, 242},
+  {0x924d692ca61be758ULL, 269},
+  {0xda01ee641a708deaULL, 295},
+  {0xa26da3999aef774aULL, 322},
+  {0xf209787bb47d6b85ULL, 348},
+  {0xb454e4a179dd1877ULL, 375},
+  {0x865b86925b9bc5c2ULL, 402},
+  {0xc83553c5c8965d3dULL, 428},
+  {0x952ab45cfa97a0b3ULL, 455},
+  {0xde469fbd99a05fe3ULL, 481},
+  {0xa59bc234db398c25ULL, 508},
+  {0xf6c69a72a3989f5cULL, 534},
+  {0xb7dcbf5354e9beceULL, 561},
+  {0x88fcf317f22241e2ULL, 588},
+  {0xcc20ce9bd35c78a5ULL, 614},
+  {0x98165af37b2153dfULL, 641},
+  {0xe2a0b5dc971f303aULL, 667},
+  {0xa8d9d1535ce3b396ULL, 694},
+  {0xfb9b7cd9a4a7443cULL, 720},
+  {0xbb764c4ca7a44410ULL, 747},
+  {0x8bab8eefb6409c1aULL, 774},
+  {0xd01fef10a657842cULL, 800},
+  {0x9b10a4e5e9913129ULL, 827},
+  {0xe7109bfba19c0c9dULL, 853},
+  {0xac2820d9623bf429ULL, 880},
+  {0x80444b5e7aa7cf85ULL, 907},
+  {0xbf21e44003acdd2dULL, 933},
+  {0x8e679c2f5e44ff8fULL, 960},
+  {0xd433179d9c8cb841ULL, 986},
+  {0x9e19db92b4e31ba9ULL, 1013},
+  {0xeb96bf6ebadf77d9ULL, 1039},
+  {0xaf87023b9bf0ee6bULL, 1066}
+};
+
+const unsigned POWERS_OF_10[] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+// Returns a cached power of 10 c such that the binary exponent of x * c
+// for a normalized x with exponent e is in the range [-60, -32] and stores
+// the negated decimal exponent of c in k.
+DiyFp GetCachedPower(int e, int &k) {
+  double dk = (-61 - e) * 0.30102999566398114 + 347;  // log10(2)
+  int ik = static_cast<int>(dk);
+  if (dk - ik > 0)
+    ++ik;
+  unsigned index = static_cast<unsigned>((ik >> 3) + 1);
+  k = -(-348 + static_cast<int>(index << 3));
+  return DiyFp(CACHED_POWERS[index].f, CACHED_POWERS[index].e);
+}
+
+void GrisuRound(char *buffer, int size, uint64_t delta, uint64_t rest,
+                uint64_t ten_kappa, uint64_t wp_w) {
+  while (rest < wp_w && delta - rest >= ten_kappa &&
+         (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+    --buffer[size - 1];
+    rest += ten_kappa;
+  }
+}
+
+// Generates the shortest digits of a number in the range (low, high)
+// closest to w where high = mp and low = mp - delta.
+int GenerateDigits(DiyFp w, DiyFp mp, uint64_t delta, char *buffer, int &k) {
+  const DiyFp one(static_cast<uint64_t>(1) << -mp.e, mp.e);
+  uint64_t wp_w = mp.f - w.f;
+  unsigned p1 = static_cast<unsigned>(mp.f >> -one.e);
+  uint64_t p2 = mp.f & (one.f - 1);
+  int kappa = 10;
+  while (kappa > 1 && p1 < POWERS_OF_10[kappa - 1])
+    --kappa;
+  int size = 0;
+  while (kappa > 0) {
+    unsigned divisor = POWERS_OF_10[kappa - 1];
+    unsigned digit = p1 / divisor;
+    p1 %= divisor;
+    if (digit != 0 || size != 0)
+      buffer[size++] = static_cast<char>('0' + digit);
+    --kappa;
+    uint64_t rest = (static_cast<uint64_t>(p1) << -one.e) + p2;
+    if (rest <= delta) {
+      k += kappa;
+      GrisuRound(buffer, size, delta, rest,
+                 static_cast<uint64_t>(POWERS_OF_10[kappa]) << -one.e, wp_w);
+      return size;
+    }
+  }
+  for (;;) {
+    p2 *= 10;
+    delta *= 10;
+    char digit = static_cast<char>(p2 >> -one.e);
+    if (digit != 0 || size != 0)
+      buffer[size++] = static_cast<char>('0' + digit);
+    p2 &= one.f - 1;
+    --kappa;
+    if (p2 < delta) {
+      k += kappa;
+      // Scale wp_w by 10^-kappa the same way delta was scaled.
+      for (int i = kappa; i < 0; ++i)
+        wp_w *= 10;
+      GrisuRound(buffer, size, delta, p2, one.f, wp_w);
+      return size;
+    }
+  }
+}
+
+// Writes decimal digits of a finite positive value to buffer
+// and returns their number. The value is equal to digits * 10^k.
+// Grisu2 always produces digits that read back as the same value and
+// these digits are the shortest for more than 99.9% of doubles.
+int Grisu2(double value, char *buffer, int &k) {
+  uint64_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(value));
+  int biased_exp = static_cast<int>(bits >> SIGNIFICAND_SIZE);
+  uint64_t significand = bits & (HIDDEN_BIT - 1);
+  const int EXP_BIAS = 0x3ff + SIGNIFICAND_SIZE;
+  DiyFp v = biased_exp != 0 ?
+        DiyFp(significand + HIDDEN_BIT, biased_exp - EXP_BIAS) :
+        DiyFp(significand, 1 - EXP_BIAS);
+  // Compute the boundaries m- and m+ of the rounding interval of v.
+  DiyFp mp = DiyFp((v.f << 1) + 1, v.e - 1);
+  while ((mp.f & (HIDDEN_BIT << 1)) == 0) {
+    mp.f <<= 1;
+    --mp.e;
+  }
+  mp.f <<= 64 - SIGNIFICAND_SIZE - 2;
+  mp.e -= 64 - SIGNIFICAND_SIZE - 2;
+  DiyFp mm = v.f == HIDDEN_BIT ?
+        DiyFp((v.f << 2) - 1, v.e - 2) : DiyFp((v.f << 1) - 1, v.e - 1);
+  mm.f <<= mm.e - mp.e;
+  mm.e = mp.e;
+  DiyFp c_mk = GetCachedPower(mp.e, k);
+  DiyFp w = Normalize(v) * c_mk;
+  mp = mp * c_mk;
+  mm = mm * c_mk;
+  ++mm.f;
+  --mp.f;
+  return GenerateDigits(w, mp, mp.f - mm.f, buffer, k);
+}
 }  // namespace
 
 namespace internal {
@@ -506,6 +737,55 @@ const uint64_t fmt::internal::BasicData<T>::POWERS_OF_10_64[] = {
   fmt::ULongLong(1000000000) * fmt::ULongLong(1000000000) * 10
 };
 
+FMT_FUNC std::size_t fmt::internal::format_shortest(
+    char *buffer, double value) {
+  if (value == 0) {
+    *buffer = '0';
+    return 1;
+  }
+  char digits[MAX_SHORTEST_SIZE];
+  int k = 0;
+  int num_digits = Grisu2(value, digits, k);
+  char *ptr = buffer;
+  // Use the notation of %g with the precision of 17 digits: fixed unless
+  // the decimal exponent is less than -4 or greater than 16.
+  int exp = num_digits + k - 1;
+  if (exp < -4 || exp > 16) {
+    *ptr++ = digits[0];
+    if (num_digits > 1) {
+      *ptr++ = '.';
+      std::memcpy(ptr, digits + 1, num_digits - 1);
+      ptr += num_digits - 1;
+    }
+    *ptr++ = 'e';
+    *ptr++ = exp < 0 ? '-' : '+';
+    unsigned abs_exp = exp < 0 ? -exp : exp;
+    if (abs_exp >= 100)
+      *ptr++ = static_cast<char>('0' + abs_exp / 100);
+    *ptr++ = static_cast<char>('0' + abs_exp / 10 % 10);
+    *ptr++ = static_cast<char>('0' + abs_exp % 10);
+  } else if (k >= 0) {
+    std::memcpy(ptr, digits, num_digits);
+    ptr += num_digits;
+    std::memset(ptr, '0', k);
+    ptr += k;
+  } else if (exp >= 0) {
+    std::memcpy(ptr, digits, exp + 1);
+    ptr += exp + 1;
+    *ptr++ = '.';
+    std::memcpy(ptr, digits + exp + 1, num_digits - exp - 1);
+    ptr += num_digits - exp - 1;
+  } else {
+    *ptr++ = '0';
+    *ptr++ = '.';
+    std::memset(ptr, '0', -exp - 1);
+    ptr += -exp - 1;
+    std::memcpy(ptr, digits, num_digits);
+    ptr += num_digits;
+  }
+  return ptr - buffer;
+}
+
 FMT_FUNC void fmt::internal::report_unknown_type(char code, const char *type) {
   (void)type;
   if (std::isprint(static_cast<unsigned char>(code))) {
@@ -0,0 +1,131 @@
+/*
+ Streaming NL handler pipeline
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include "mp/nl-pipeline.h"
+
+#include <cerrno>
+
+mp::NLStreamWriter::NLStreamWriter(std::FILE *file)
+  : file_(file), num_vars_(0), pending_type_(0), num_pending_(0),
+    num_linear_terms_(0) {
+  Node null_node = {0, 0, 0, 0};
+  nodes_.push_back(null_node);
+}
+
+void mp::NLStreamWriter::Flush() {
+  std::size_t size = out_.size();
+  if (size != 0 && std::fwrite(out_.data(), 1, size, file_) != size)
+    throw fmt::SystemError(errno, "cannot write .nl file");
+  out_.clear();
+}
+
+void mp::NLStreamWriter::FlushPending() {
+  Format(out_).WriteSegmentHeader(pending_type_, num_pending_);
+  out_ << fmt::StringRef(pending_.data(), pending_.size());
+  pending_.clear();
+  num_pending_ = 0;
+  FlushIfFull();
+}
+
+void mp::NLStreamWriter::AddPending(char type, int index, double value) {
+  if (num_pending_ != 0 && pending_type_ != type)
+    FlushPending();
+  pending_type_ = type;
+  Format(pending_).WriteIndexedValue(index, value);
+  ++num_pending_;
+}
+
+int mp::NLStreamWriter::MakeNode(int opcode, int num_args, const int *args) {
+  int node = BeginNode();
+  Format(text_).WriteOpCode(opcode);
+  EndHeader(node);
+  nodes_[node].num_args = num_args;
+  args_.insert(args_.end(), args, args + num_args);
+  return node;
+}
+
+void mp::NLStreamWriter::DoWriteExpr(int node) {
+  const Node &n = nodes_[node];
+  out_ << fmt::StringRef(text_.data() + n.text_start,
+                         n.text_end - n.text_start);
+  for (int i = 0; i < n.num_args; ++i)
+    DoWriteExpr(args_[n.arg_start + i]);
+}
+
+void mp::NLStreamWriter::WriteExpr(int expr) {
+  if (expr == 0)
+    Format(out_).WriteConstant(0);
+  else
+    DoWriteExpr(expr);
+  nodes_.resize(1);
+  args_.clear();
+  text_.clear();
+  FlushIfFull();
+}
+
+void mp::NLStreamWriter::OnHeader(const NLHeader &h) {
+  num_vars_ = h.num_vars;
+  NLHeader header = h;
+  header.format = NLHeader::TEXT;
+  out_ << header;
+}
+
+void mp::NLStreamWriter::EndCommonExpr(int index, int expr, int position) {
+  BeginSegment();
+  Format(out_).WriteCommonExprHeader(
+      num_vars_ + index, num_linear_terms_, position);
+  out_ << fmt::StringRef(linear_.data(), linear_.size());
+  WriteExpr(expr);
+}
+
+void mp::NLStreamWriter::OnComplementarity(
+    int con_index, int var_index, ComplInfo info) {
+  if (con_index == 0) {
+    BeginSegment();
+    Format(out_).WriteSegmentHeader('r');
+  }
+  double infinity = std::numeric_limits<double>::infinity();
+  int flags = 0;
+  if (info.con_lb() == -infinity)
+    flags |= ComplInfo::INF_LB;
+  if (info.con_ub() == infinity)
+    flags |= ComplInfo::INF_UB;
+  Format(out_).WriteComplementarity(flags, var_index);
+  FlushIfFull();
+}
+
+int mp::NLStreamWriter::EndIterated(ArgHandler handler) {
+  int node = handler.node_;
+  std::vector<int>::iterator start =
+      arg_stack_.begin() + handler.stack_start_;
+  nodes_[node].arg_start = static_cast<int>(args_.size());
+  nodes_[node].num_args = static_cast<int>(arg_stack_.end() - start);
+  args_.insert(args_.end(), start, arg_stack_.end());
+  arg_stack_.erase(start, arg_stack_.end());
+  return node;
+}
+
+void mp::NLStreamWriter::EndInput() {
+  if (num_pending_ != 0)
+    FlushPending();
+  Flush();
+  if (std::fflush(file_) != 0)
+    throw fmt::SystemError(errno, "cannot write .nl file");
+}
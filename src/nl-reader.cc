@@ -22,11 +22,750 @@
 
 #include "mp/nl-reader.h"
 
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <vector>
+
+#ifdef MP_USE_THREAD
+# include <condition_variable>
+# include <mutex>
+# include <thread>
+# ifndef _WIN32
+#  include "mp/posix.h"
+#  include <poll.h>
+#  include <unistd.h>
+# endif
+#endif
+
 namespace {
 enum {
   USE_VBTOL_OPTION = 1,
   READ_VBTOL       = 3
 };
+
+// A text reader that writes everything it reads to a buffer in the
+// binary format.
+class ConvertingReader : public mp::internal::TextReader<> {
+ private:
+  typedef mp::internal::TextReader<> Base;
+
+  std::vector<char> &buffer_;
+
+  template <typename T>
+  void Write(T value) {
+    const char *data = reinterpret_cast<const char*>(&value);
+    buffer_.insert(buffer_.end(), data, data + sizeof(T));
+  }
+
+  fmt::StringRef WriteString(fmt::StringRef s) {
+    Write(static_cast<int>(s.size()));
+    buffer_.insert(buffer_.end(), s.data(), s.data() + s.size());
+    return s;
+  }
+
+ public:
+  ConvertingReader(const Base &reader, std::vector<char> &buffer)
+    : Base(reader), buffer_(buffer) {}
+
+  char ReadChar() {
+    char c = Base::ReadChar();
+    buffer_.push_back(c);
+    return c;
+  }
+
+  template <typename Int>
+  Int ReadInt() {
+    Int value = Base::template ReadInt<Int>();
+    Write(value);
+    return value;
+  }
+
+  int ReadUInt() {
+    int value = Base::ReadUInt();
+    Write(value);
+    return value;
+  }
+
+  double ReadDouble() {
+    double value = Base::ReadDouble();
+    Write(value);
+    return value;
+  }
+
+  fmt::StringRef ReadString() {
+    return WriteString(Base::ReadString());
+  }
+
+  fmt::StringRef ReadName() { return WriteString(Base::ReadName()); }
+};
+
+bool IsSegmentType(char c) {
+  switch (c) {
+  case 'C': case 'L': case 'O': case 'V': case 'F': case 'G': case 'J':
+  case 'S': case 'b': case 'r': case 'K': case 'k': case 'x': case 'd':
+    return true;
+  }
+  return false;
+}
+}  // namespace
+
+class mp::internal::TextSegmentConverter::Impl {
+ private:
+  // A segment of the input starting with a segment type character.
+  struct Segment {
+    const char *start;
+    int line;
+  };
+
+  // A range of consecutive segments converted as a single unit of work.
+  struct Chunk {
+    std::size_t first_segment;
+    std::size_t end_segment;
+    std::vector<char> data;
+    std::exception_ptr error;
+    bool done;
+
+    explicit Chunk(std::size_t first)
+      : first_segment(first), end_segment(first), done(false) {}
+  };
+
+  TextReader<> reader_;
+  NLHeader header_;
+  const char *end_;
+  std::vector<Segment> segments_;
+  std::vector<Chunk> chunks_;
+  int bounds_chunk_;
+
+#ifdef MP_USE_THREAD
+  std::mutex mutex_;
+  std::condition_variable chunk_done_;
+  std::size_t next_chunk_;
+  bool stop_;
+  std::vector<std::thread> threads_;
+
+  // Converts chunks until there are no more chunks left.
+  void Run();
+
+  // Stops and joins the threads.
+  void Stop();
+#else
+  std::size_t next_chunk_;
+#endif
+
+  bool Split(const char *ptr, int line);
+  void Split(std::size_t chunk_size);
+
+  // Converts a chunk into the binary format.
+  void Convert(Chunk &chunk);
+
+ public:
+  Impl(NLStringRef data, const TextReader<> &reader, const NLHeader &header,
+       std::size_t chunk_size, int num_threads);
+  ~Impl();
+
+  bool split() const { return !chunks_.empty(); }
+  int num_chunks() const { return static_cast<int>(chunks_.size()); }
+  int bounds_chunk() const { return bounds_chunk_; }
+
+  NLStringRef GetChunk(int index);
+};
+
+mp::internal::TextSegmentConverter::Impl::Impl(
+    NLStringRef data, const TextReader<> &reader, const NLHeader &header,
+    std::size_t chunk_size, int num_threads)
+  : reader_(reader), header_(header), end_(data.c_str() + data.size()),
+    bounds_chunk_(-1), next_chunk_(0) {
+  if (!Split(reader.ptr(), reader.line()))
+    return;
+  Split(chunk_size);
+#ifdef MP_USE_THREAD
+  stop_ = false;
+  if (num_threads <= 0)
+    num_threads = std::max(
+          static_cast<int>(std::thread::hardware_concurrency()), 1);
+  num_threads = std::min(num_threads, num_chunks());
+  threads_.reserve(num_threads);
+  try {
+    for (int i = 0; i < num_threads; ++i)
+      threads_.push_back(std::thread(&Impl::Run, this));
+  } catch (...) {
+    // The destructor is not called if the constructor throws.
+    Stop();
+    throw;
+  }
+#else
+  internal::Unused(num_threads);
+#endif
+}
+
+mp::internal::TextSegmentConverter::Impl::~Impl() {
+#ifdef MP_USE_THREAD
+  Stop();
+#endif
+}
+
+#ifdef MP_USE_THREAD
+void mp::internal::TextSegmentConverter::Impl::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  for (std::size_t i = 0, n = threads_.size(); i != n; ++i)
+    threads_[i].join();
+  threads_.clear();
+}
+#endif
+
+// Finds segments in the input starting at ptr. Returns false if the input is
+// not well-formed enough to be split.
+bool mp::internal::TextSegmentConverter::Impl::Split(
+    const char *ptr, int line) {
+  int num_bound_segments = 0;
+  while (ptr != end_) {
+    char c = *ptr;
+    if (IsSegmentType(c)) {
+      Segment segment = {ptr, line};
+      segments_.push_back(segment);
+      if (c == 'b')
+        ++num_bound_segments;
+    } else if (segments_.empty()) {
+      return false;
+    } else if (c == 'h') {
+      // Skip the string which may contain newlines.
+      std::size_t length = 0;
+      const char *p = ptr + 1;
+      if (*p < '0' || *p > '9')
+        return false;
+      for (; *p >= '0' && *p <= '9'; ++p) {
+        length = length * 10 + (*p - '0');
+        if (length > static_cast<std::size_t>(end_ - ptr))
+          return false;
+      }
+      if (*p != ':' || length > static_cast<std::size_t>(end_ - ++p))
+        return false;
+      for (const char *str_end = p + length; p != str_end; ++p) {
+        if (*p == '\n')
+          ++line;
+      }
+      ptr = p;
+    }
+    const void *newline = std::memchr(ptr, '\n', end_ - ptr);
+    if (!newline)
+      break;
+    ptr = static_cast<const char*>(newline) + 1;
+    ++line;
+  }
+  // Let the sequential reader report a missing or duplicate 'b' segment.
+  return num_bound_segments == 1;
+}
+
+// Groups segments into chunks.
+void mp::internal::TextSegmentConverter::Impl::Split(
+    std::size_t chunk_size) {
+  const char *chunk_start = 0;
+  bool after_bounds = false;
+  for (std::size_t i = 0, n = segments_.size(); i != n; ++i) {
+    const char *start = segments_[i].start;
+    bool is_bound_segment = *start == 'b';
+    if (!chunk_start || is_bound_segment || after_bounds ||
+        static_cast<std::size_t>(start - chunk_start) >= chunk_size) {
+      chunks_.push_back(Chunk(i));
+      chunk_start = start;
+    }
+    ++chunks_.back().end_segment;
+    if (is_bound_segment)
+      bounds_chunk_ = num_chunks() - 1;
+    after_bounds = is_bound_segment;
+  }
+}
+
+void mp::internal::TextSegmentConverter::Impl::Convert(Chunk &chunk) {
+  ConvertingReader reader(reader_, chunk.data);
+  NullNLHandler<int> handler;
+  NLReader< ConvertingReader, NullNLHandler<int> >
+      nl_reader(reader, header_, handler, 0);
+  for (std::size_t i = chunk.first_segment; i != chunk.end_segment; ++i) {
+    const Segment &segment = segments_[i];
+    reader.SeekLine(segment.start, segment.line);
+    nl_reader.ReadSegment(reader.ReadChar());
+    const char *next =
+        i + 1 != segments_.size() ? segments_[i + 1].start : end_;
+    if (reader.ptr() != next) {
+      // Report the same error as the sequential reader would.
+      reader.ReadChar();
+      reader.ReportError("invalid segment type");
+    }
+  }
+  chunk.data.push_back('\0');
+}
+
+#ifdef MP_USE_THREAD
+void mp::internal::TextSegmentConverter::Impl::Run() {
+  for (;;) {
+    std::size_t index = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stop_ || next_chunk_ == chunks_.size())
+        return;
+      index = next_chunk_++;
+    }
+    Chunk &chunk = chunks_[index];
+    std::exception_ptr error;
+    try {
+      Convert(chunk);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    chunk.error = error;
+    chunk.done = true;
+    chunk_done_.notify_all();
+  }
+}
+
+mp::NLStringRef
+    mp::internal::TextSegmentConverter::Impl::GetChunk(int index) {
+  Chunk &chunk = chunks_[index];
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!chunk.done)
+    chunk_done_.wait(lock);
+  if (chunk.error)
+    std::rethrow_exception(chunk.error);
+  return NLStringRef(&chunk.data[0], chunk.data.size() - 1);
+}
+#else
+mp::NLStringRef
+    mp::internal::TextSegmentConverter::Impl::GetChunk(int index) {
+  Chunk &chunk = chunks_[index];
+  if (!chunk.done) {
+    chunk.done = true;
+    try {
+      Convert(chunk);
+    } catch (...) {
+      chunk.error = std::current_exception();
+    }
+  }
+  if (chunk.error)
+    std::rethrow_exception(chunk.error);
+  return NLStringRef(&chunk.data[0], chunk.data.size() - 1);
+}
+#endif
+
+mp::internal::TextSegmentConverter::TextSegmentConverter(
+    NLStringRef data, const TextReader<> &reader, const NLHeader &header,
+    std::size_t chunk_size, int num_threads)
+  : impl_(new Impl(data, reader, header, chunk_size, num_threads)) {}
+
+mp::internal::TextSegmentConverter::~TextSegmentConverter() {
+  delete impl_;
+}
+
+bool mp::internal::TextSegmentConverter::split() const {
+  return impl_->split();
+}
+
+int mp::internal::TextSegmentConverter::num_chunks() const {
+  return impl_->num_chunks();
+}
+
+int mp::internal::TextSegmentConverter::bounds_chunk() const {
+  return impl_->bounds_chunk();
+}
+
+mp::NLStringRef mp::internal::TextSegmentConverter::GetChunk(int index) {
+  return impl_->GetChunk(index);
+}
+
+namespace mp {
+namespace internal {
+// Reads input from a source in blocks. With MP_USE_THREAD the next block
+// is read on a background thread while the current one is processed.
+// If the source has a descriptor, the background thread waits for input
+// with poll so that the reader can be destroyed before the end of input
+// without blocking on a pipe that is never closed.
+class BlockReader {
+ private:
+  InputSource &source_;
+  std::size_t block_size_;
+  std::vector<char> blocks_[2];
+  std::size_t sizes_[2];
+  int current_;  // The index of the block returned by the last Read.
+  bool eof_;
+
+#ifdef MP_USE_THREAD
+  bool full_[2];
+  std::exception_ptr errors_[2];
+  bool stop_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+# ifndef _WIN32
+  // A pipe used to wake up the background thread waiting for input.
+  fmt::File wake_read_end_;
+  fmt::File wake_write_end_;
+# endif
+  std::thread thread_;
+
+  // Waits until the source has input. Returns false if the reader has
+  // been stopped.
+  bool WaitForInput();
+
+  // Fills blocks alternately until the end of input.
+  void Run();
+#endif
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(BlockReader);
+
+ public:
+  BlockReader(InputSource &source, std::size_t block_size);
+  ~BlockReader();
+
+  // Returns the next block of input which is valid until the next call
+  // or an empty string at the end of input.
+  fmt::StringRef Read();
+};
+
+#ifdef MP_USE_THREAD
+BlockReader::BlockReader(InputSource &source, std::size_t block_size)
+  : source_(source), block_size_(block_size), current_(-1), eof_(false),
+    stop_(false) {
+  for (int i = 0; i < 2; ++i) {
+    blocks_[i].resize(block_size);
+    sizes_[i] = 0;
+    full_[i] = false;
+  }
+# ifndef _WIN32
+  if (source.descriptor() >= 0)
+    fmt::File::pipe(wake_read_end_, wake_write_end_);
+# endif
+  thread_ = std::thread(&BlockReader::Run, this);
+}
+
+BlockReader::~BlockReader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    cond_.notify_all();
+  }
+# ifndef _WIN32
+  if (wake_write_end_.descriptor() >= 0) {
+    // The write can only fail if the pipe is full, which already wakes
+    // up the background thread.
+    char c = 0;
+    ssize_t count = 0;
+    FMT_RETRY(count, ::write(wake_write_end_.descriptor(), &c, 1));
+    internal::Unused(count);
+  }
+# endif
+  thread_.join();
+}
+
+bool BlockReader::WaitForInput() {
+# ifndef _WIN32
+  if (wake_read_end_.descriptor() < 0)
+    return true;
+  pollfd fds[2] = {};
+  fds[0].fd = source_.descriptor();
+  fds[0].events = POLLIN;
+  fds[1].fd = wake_read_end_.descriptor();
+  fds[1].events = POLLIN;
+  int result = 0;
+  FMT_RETRY(result, ::poll(fds, 2, -1));
+  if (result < 0)
+    throw fmt::SystemError(errno, "cannot poll input");
+  // Read from the source on POLLHUP or POLLERR too to get EOF or the error.
+  return fds[1].revents == 0;
+# else
+  return true;
+# endif
+}
+
+void BlockReader::Run() {
+  for (int index = 0; ; index ^= 1) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (full_[index] && !stop_)
+        cond_.wait(lock);
+      if (stop_)
+        return;
+    }
+    std::size_t size = 0;
+    std::exception_ptr error;
+    try {
+      if (!WaitForInput())
+        return;
+      size = source_.Read(&blocks_[index][0], block_size_);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    sizes_[index] = size;
+    errors_[index] = error;
+    full_[index] = true;
+    cond_.notify_all();
+    if (size == 0 || error)
+      return;
+  }
+}
+
+fmt::StringRef BlockReader::Read() {
+  if (eof_)
+    return fmt::StringRef(0, 0);
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (current_ >= 0) {
+    // Let the background thread refill the block returned last time.
+    full_[current_] = false;
+    cond_.notify_all();
+  }
+  current_ = current_ < 0 ? 0 : current_ ^ 1;
+  while (!full_[current_])
+    cond_.wait(lock);
+  std::size_t size = sizes_[current_];
+  if (errors_[current_] || size == 0) {
+    eof_ = true;
+    if (errors_[current_])
+      std::rethrow_exception(errors_[current_]);
+  }
+  return fmt::StringRef(&blocks_[current_][0], size);
+}
+#else
+BlockReader::BlockReader(InputSource &source, std::size_t block_size)
+  : source_(source), block_size_(block_size), current_(0), eof_(false) {
+  blocks_[0].resize(block_size);
+  sizes_[0] = sizes_[1] = 0;
+}
+
+BlockReader::~BlockReader() {}
+
+fmt::StringRef BlockReader::Read() {
+  if (eof_)
+    return fmt::StringRef(0, 0);
+  std::size_t size = source_.Read(&blocks_[0][0], block_size_);
+  if (size == 0)
+    eof_ = true;
+  return fmt::StringRef(&blocks_[0][0], size);
+}
+#endif
+}  // namespace internal
+}  // namespace mp
+
+class mp::internal::SegmentStream::Impl {
+ private:
+  BlockReader input_;
+  std::string name_;
+  std::size_t chunk_size_;
+  NLHeader header_;
+  bool swap_bytes_;  // Whether the binary input has different endianness.
+
+  // Buffered input. data_[size_] is always '\0'.
+  std::vector<char> data_;
+  std::size_t size_;
+  std::size_t discarded_;  // The number of bytes discarded before data_[0].
+  bool eof_;
+
+  std::size_t start_;  // The start of the next chunk.
+  int line_;           // The line number at start_.
+
+  // The position of the first segment or line that hasn't been scanned yet
+  // and its line number.
+  std::size_t scan_;
+  int scan_line_;
+
+  // The end of the last chunk and the character replaced with '\0' there.
+  std::size_t end_;
+  char saved_char_;
+
+  // Appends the next block of input to the buffer. Returns false at the end
+  // of input.
+  bool ReadBlock();
+
+  // Returns true if the current chunk should end at the segment starting
+  // at pos.
+  bool IsChunkEnd(std::size_t pos) const {
+    return data_[start_] == 'b' || data_[pos] == 'b' ||
+        pos - start_ >= chunk_size_;
+  }
+
+  // Finds the end of the current chunk scanning the input from scan_.
+  // Returns false if more input is needed.
+  bool FindTextChunkEnd(std::size_t &end);
+
+  template <typename InputConverter>
+  bool FindBinaryChunkEnd(std::size_t &end);
+
+ public:
+  Impl(InputSource &source, fmt::CStringRef name,
+       std::size_t chunk_size, std::size_t block_size)
+    : input_(source, block_size), name_(name.c_str()), chunk_size_(chunk_size),
+      swap_bytes_(false), data_(1), size_(0), discarded_(0), eof_(false),
+      start_(0), line_(1), scan_(0), scan_line_(1), end_(0), saved_char_(0) {
+  }
+
+  void ReadHeader(NLHeader &header);
+  Chunk ReadChunk();
+};
+
+bool mp::internal::SegmentStream::Impl::ReadBlock() {
+  if (eof_)
+    return false;
+  fmt::StringRef block = input_.Read();
+  if (block.size() == 0) {
+    eof_ = true;
+    return false;
+  }
+  data_.resize(size_ + block.size() + 1);
+  std::memcpy(&data_[size_], block.data(), block.size());
+  size_ += block.size();
+  data_[size_] = '\0';
+  return true;
+}
+
+bool mp::internal::SegmentStream::Impl::FindTextChunkEnd(std::size_t &end) {
+  while (scan_ < size_) {
+    std::size_t pos = scan_;
+    int line = scan_line_;
+    char c = data_[pos];
+    if (pos != start_ && IsSegmentType(c) && IsChunkEnd(pos)) {
+      end = pos;
+      return true;
+    }
+    if (c == 'h') {
+      // Skip the string which may contain newlines.
+      std::size_t length = 0, p = pos + 1;
+      for (; data_[p] >= '0' && data_[p] <= '9'; ++p)
+        length = length * 10 + (data_[p] - '0');
+      if (p == size_ || (data_[p] == ':' && size_ - p - 1 < length))
+        return false;
+      if (p != pos + 1 && data_[p] == ':') {
+        const char *str = &data_[p + 1];
+        line += static_cast<int>(std::count(str, str + length, '\n'));
+        pos = p + 1 + length;
+      }
+    }
+    const void *newline = std::memchr(&data_[pos], '\n', size_ - pos);
+    if (!newline)
+      return false;
+    scan_ = static_cast<const char*>(newline) - &data_[0] + 1;
+    scan_line_ = line + 1;
+  }
+  return false;
+}
+
+template <typename InputConverter>
+bool mp::internal::SegmentStream::Impl::FindBinaryChunkEnd(std::size_t &end) {
+  // Binary segments can only be delimited by parsing them, so parse them
+  // without a handler until the chunk end.
+  NullNLHandler<int> handler;
+  while (scan_ < size_) {
+    if (scan_ != start_ && IsChunkEnd(scan_)) {
+      end = scan_;
+      return true;
+    }
+    TextReader<> base(NLStringRef(&data_[scan_], size_ - scan_), name_);
+    BinaryReader<InputConverter> reader(base);
+    NLReader<BinaryReader<InputConverter>, NullNLHandler<int> >
+        nl_reader(reader, header_, handler, 0);
+    try {
+      nl_reader.ReadSegment(reader.ReadChar());
+    } catch (const BinaryReadError &e) {
+      if (e.offset() == size_ - scan_)
+        return false;  // The segment is incomplete.
+      // Let the parser report the error.
+      end = size_;
+      return true;
+    }
+    scan_ = reader.ptr() - &data_[0];
+  }
+  return false;
+}
+
+void mp::internal::SegmentStream::Impl::ReadHeader(NLHeader &header) {
+  // The header consists of 10 lines.
+  enum { NUM_HEADER_LINES = 10 };
+  int num_lines = 0;
+  for (std::size_t pos = 0; num_lines < NUM_HEADER_LINES; ) {
+    const void *newline = std::memchr(&data_[pos], '\n', size_ - pos);
+    if (newline) {
+      pos = static_cast<const char*>(newline) - &data_[0] + 1;
+      ++num_lines;
+    } else {
+      pos = size_;
+      if (!ReadBlock())
+        break;
+    }
+  }
+  TextReader<> reader(NLStringRef(&data_[0], size_), name_);
+  reader.ReadHeader(header);
+  header_ = header;
+  if (header.format == NLHeader::BINARY &&
+      header.arith_kind != arith::GetKind()) {
+    swap_bytes_ = true;
+  }
+  end_ = scan_ = reader.ptr() - &data_[0];
+  line_ = scan_line_ = reader.line();
+  saved_char_ = data_[end_];
+}
+
+mp::internal::SegmentStream::Chunk
+    mp::internal::SegmentStream::Impl::ReadChunk() {
+  // Restore the input after the previous chunk and discard the chunk.
+  data_[end_] = saved_char_;
+  if (end_ == scan_)
+    line_ = scan_line_;
+  else
+    line_ += static_cast<int>(std::count(&data_[start_], &data_[end_], '\n'));
+  start_ = end_;
+  if (start_ != 0) {
+    std::memmove(&data_[0], &data_[start_], size_ - start_ + 1);
+    discarded_ += start_;
+    size_ -= start_;
+    scan_ -= start_;
+    start_ = 0;
+  }
+  std::size_t end = 0;
+  for (;;) {
+    bool found = false;
+    if (header_.format == NLHeader::TEXT)
+      found = FindTextChunkEnd(end);
+    else if (swap_bytes_)
+      found = FindBinaryChunkEnd<EndiannessConverter>(end);
+    else
+      found = FindBinaryChunkEnd<IdentityConverter>(end);
+    if (found)
+      break;
+    if (eof_) {
+      // The rest of the input forms the last chunk.
+      end = size_;
+      break;
+    }
+    // Read at least as much input as there is unscanned to avoid scanning
+    // a large incomplete segment too many times.
+    std::size_t min_size = size_ + (size_ - scan_);
+    while (ReadBlock() && size_ < min_size)
+      continue;
+  }
+  end_ = end;
+  saved_char_ = data_[end];
+  data_[end] = '\0';
+  return Chunk(NLStringRef(&data_[0], end), line_, discarded_);
+}
+
+mp::internal::SegmentStream::SegmentStream(
+    InputSource &source, fmt::CStringRef name,
+    std::size_t chunk_size, std::size_t block_size)
+  : impl_(new Impl(source, name, chunk_size, block_size)) {}
+
+mp::internal::SegmentStream::~SegmentStream() {
+  delete impl_;
+}
+
+void mp::internal::SegmentStream::ReadHeader(NLHeader &header) {
+  impl_->ReadHeader(header);
+}
+
+mp::internal::SegmentStream::Chunk
+    mp::internal::SegmentStream::ReadChunk() {
+  return impl_->ReadChunk();
 }
 
 void mp::ReadError::init(fmt::CStringRef filename, int line, int column,
@@ -274,7 +1013,7 @@ void mp::internal::TextReader<Locale>::ReadHeader(NLHeader &header) {
 void mp::internal::BinaryReaderBase::ReportError(
     fmt::CStringRef format_str, const fmt::ArgList &args) {
   fmt::MemoryWriter w;
-  std::size_t offset = token_ - start_;
+  std::size_t offset = token_ - start_ + base_offset_;
   w.write("{}:offset {}: ", name_, offset);
   w.write(format_str, args);
   throw BinaryReadError(name_, offset, w.c_str());
@@ -0,0 +1,192 @@
+/*
+ .nl writer
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include "mp/nl-writer.h"
+
+#include <fcntl.h>
+#include <limits.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <functional>
+
+#include "mp/os.h"
+#include "mp/posix.h"
+
+#ifndef _WIN32
+# include <sys/uio.h>
+#endif
+
+#ifdef MP_USE_THREAD
+# include <mutex>
+# include <thread>
+#endif
+
+// Formats chunks into per-thread buffers.
+class mp::internal::NLWriterBase::Formatter {
+ private:
+  NLWriterBase &writer_;
+  std::vector<fmt::MemoryWriter> buffers_;
+
+#ifdef MP_USE_THREAD
+  std::mutex mutex_;
+  std::size_t next_chunk_;
+  bool failed_;
+
+  // Formats chunks into the buffer with the specified index until there
+  // are no more chunks left or an error occurs.
+  void Run(int buffer);
+#endif
+
+  void Format(Chunk &chunk, int buffer) {
+    fmt::MemoryWriter &w = buffers_[buffer];
+    chunk.buffer = buffer;
+    chunk.offset = w.size();
+    writer_.Format(chunk, w);
+    chunk.size = w.size() - chunk.offset;
+  }
+
+ public:
+  Formatter(NLWriterBase &w, int num_threads);
+
+  const fmt::MemoryWriter &buffer(int index) const { return buffers_[index]; }
+};
+
+#ifdef MP_USE_THREAD
+void mp::internal::NLWriterBase::Formatter::Run(int buffer) {
+  std::vector<Chunk> &chunks = writer_.chunks_;
+  try {
+    for (;;) {
+      std::size_t index = 0;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (failed_ || next_chunk_ == chunks.size())
+          return;
+        index = next_chunk_++;
+      }
+      Format(chunks[index], buffer);
+    }
+  } catch (...) {
+    // Stop the other threads; the error is rethrown by RunInParallel.
+    std::lock_guard<std::mutex> lock(mutex_);
+    failed_ = true;
+    throw;
+  }
+}
+
+mp::internal::NLWriterBase::Formatter::Formatter(
+    NLWriterBase &w, int num_threads)
+  : writer_(w), next_chunk_(0), failed_(false) {
+  if (num_threads <= 0)
+    num_threads = std::max(
+          static_cast<int>(std::thread::hardware_concurrency()), 1);
+  num_threads = std::min(num_threads, static_cast<int>(w.chunks_.size()));
+  num_threads = std::max(num_threads, 1);
+  buffers_.resize(num_threads);
+  RunInParallel(num_threads,
+                std::bind(&Formatter::Run, this, std::placeholders::_1));
+}
+#else
+mp::internal::NLWriterBase::Formatter::Formatter(
+    NLWriterBase &w, int num_threads) : writer_(w), buffers_(1) {
+  internal::Unused(num_threads);
+  for (std::size_t i = 0, n = w.chunks_.size(); i != n; ++i)
+    Format(w.chunks_[i], 0);
+}
+#endif
+
+void mp::internal::NLWriterBase::AddChunks(SegmentType type, int num_items) {
+  if (num_items == 0)
+    return;
+  int num_threads = num_threads_;
+#ifdef MP_USE_THREAD
+  if (num_threads <= 0)
+    num_threads = static_cast<int>(std::thread::hardware_concurrency());
+#endif
+  // Use a few chunks per thread to balance the load.
+  int max_chunks = std::max(num_threads, 1) * 4;
+  int num_chunks = std::min(
+        (num_items + MIN_CHUNK_SIZE - 1) / MIN_CHUNK_SIZE, max_chunks);
+  int chunk_size = num_items / num_chunks, remainder = num_items % num_chunks;
+  for (int i = 0, start = 0; i < num_chunks; ++i) {
+    int end = start + chunk_size + (i < remainder ? 1 : 0);
+    AddChunk(type, start, end);
+    start = end;
+  }
+}
+
+void mp::internal::NLWriterBase::Write(
+    fmt::CStringRef filename, const NLHeader &header) {
+  fmt::MemoryWriter header_writer;
+  header_writer << header;
+  Formatter formatter(*this, num_threads_);
+  fmt::File file(filename, fmt::File::WRONLY | O_CREAT | O_TRUNC);
+#ifdef _WIN32
+  file.write(header_writer.data(), header_writer.size());
+  for (std::size_t i = 0, n = chunks_.size(); i != n; ++i) {
+    const Chunk &chunk = chunks_[i];
+    const char *data = formatter.buffer(chunk.buffer).data() + chunk.offset;
+    for (std::size_t size = chunk.size; size != 0; ) {
+      std::size_t count = file.write(data, size);
+      data += count;
+      size -= count;
+    }
+  }
+#else
+  std::vector<iovec> iov;
+  iov.reserve(chunks_.size() + 1);
+  iovec header_iov = {
+    const_cast<char*>(header_writer.data()), header_writer.size()
+  };
+  iov.push_back(header_iov);
+  for (std::size_t i = 0, n = chunks_.size(); i != n; ++i) {
+    const Chunk &chunk = chunks_[i];
+    if (chunk.size == 0)
+      continue;
+    const char *data = formatter.buffer(chunk.buffer).data() + chunk.offset;
+    iovec chunk_iov = {const_cast<char*>(data), chunk.size};
+    iov.push_back(chunk_iov);
+  }
+# ifdef IOV_MAX
+  const std::size_t max_iov = IOV_MAX;
+# else
+  const std::size_t max_iov = 1024;
+# endif
+  // Normally a single call writes everything, but writev may write
+  // less than requested and accepts at most IOV_MAX buffers.
+  for (std::size_t start = 0, n = iov.size(); start != n; ) {
+    int count = static_cast<int>(std::min(n - start, max_iov));
+    ssize_t result = 0;
+    do {
+      result = writev(file.descriptor(), &iov[start], count);
+    } while (result == -1 && errno == EINTR);
+    if (result < 0)
+      throw fmt::SystemError(errno, "cannot write to file {}", filename);
+    std::size_t size = result;
+    for (; start != n && size >= iov[start].iov_len; ++start)
+      size -= iov[start].iov_len;
+    if (size != 0) {
+      iov[start].iov_base = static_cast<char*>(iov[start].iov_base) + size;
+      iov[start].iov_len -= size;
+    }
+  }
+#endif
+  file.close();
+}
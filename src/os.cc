@@ -21,6 +21,7 @@
  */
 
 #include "mp/os.h"
+#include "mp/clock.h"
 #include "mp/error.h"
 #include "mp/posix.h"
 
@@ -31,6 +32,7 @@
 
 #ifndef _WIN32
 # include <sys/mman.h>
+# include <sys/resource.h>
 # include <sys/types.h>
 # include <sys/stat.h>
 # include <fcntl.h>
@@ -46,12 +48,65 @@
 # include <unistd.h>
 #endif
 
+#ifdef MP_USE_THREAD
+# include <exception>
+# include <mutex>
+# include <thread>
+# include <vector>
+#endif
+
 #undef getenv
 
 using std::size_t;
 using fmt::SystemError;
 using mp::path;
 
+#ifdef MP_USE_THREAD
+namespace {
+void RunTask(const std::function<void (int)> &task, int index,
+             std::exception_ptr *error) {
+  try {
+    task(index);
+  } catch (...) {
+    *error = std::current_exception();
+  }
+}
+}  // namespace
+#endif
+
+void mp::internal::RunInParallel(
+    int num_tasks, const std::function<void (int)> &task) {
+#ifdef MP_USE_THREAD
+  if (num_tasks <= 1) {
+    if (num_tasks == 1)
+      task(0);
+    return;
+  }
+  std::vector<std::exception_ptr> errors(num_tasks);
+  std::vector<std::thread> threads;
+  threads.reserve(num_tasks - 1);
+  try {
+    for (int i = 1; i < num_tasks; ++i) {
+      threads.push_back(std::thread(
+                          RunTask, std::cref(task), i, &errors[i]));
+    }
+    task(0);
+  } catch (...) {
+    // Either task(0) or a thread creation has failed.
+    errors[0] = std::current_exception();
+  }
+  for (std::size_t i = 0, n = threads.size(); i != n; ++i)
+    threads[i].join();
+  for (int i = 0; i < num_tasks; ++i) {
+    if (errors[i])
+      std::rethrow_exception(errors[i]);
+  }
+#else
+  for (int i = 0; i < num_tasks; ++i)
+    task(i);
+#endif
+}
+
 // Workaround for a bug in MSVC.
 // http://connect.microsoft.com/VisualStudio/feedback/details/
 // 786583/in-class-static-const-member-initialization-and-lnk2005
@@ -122,22 +177,158 @@ path path::temp_directory_path() {
   return path(dir);
 }
 
-void mp::internal::MemoryMappedFileBase::map(int fd, std::size_t size) {
+namespace {
+// Gets the numbers of minor and major page faults in the process.
+void GetPageFaults(long &minor_faults, long &major_faults) {
+  rusage usage = rusage();
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    minor_faults = major_faults = 0;
+    return;
+  }
+  minor_faults = usage.ru_minflt;
+  major_faults = usage.ru_majflt;
+}
+
+// Touches every page in [start, start + size) reading it in if necessary.
+void TouchPages(const char *start, std::size_t size) {
+  std::size_t page_size = fmt::getpagesize();
+  volatile char sum = 0;
+  for (std::size_t offset = 0; offset < size; offset += page_size)
+    sum += start[offset];
+}
+
+void Advise(char *start, std::size_t size, int advice) {
+  // The advice is only a hint, so errors are ignored.
+  if (size != 0)
+    madvise(start, size, advice);
+}
+}  // namespace
+
+#ifdef MP_USE_THREAD
+// Faults in the pages of a mapped file on a background thread. While one
+// window is being touched the kernel is asked to start reading the next.
+class mp::internal::MemoryMappedFileBase::Prefetcher {
+ private:
+  char *start_;
+  std::size_t size_;
+  std::mutex mutex_;
+  bool stop_;
+  double time_;
+  std::thread thread_;
+
+  void Run();
+
+ public:
+  Prefetcher(char *start, std::size_t size)
+    : start_(start), size_(size), stop_(false), time_(0),
+      thread_(&Prefetcher::Run, this) {}
+
+  ~Prefetcher() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    thread_.join();
+  }
+
+  // Returns the time spent prefetching so far.
+  double time() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return time_;
+  }
+};
+
+void mp::internal::MemoryMappedFileBase::Prefetcher::Run() {
+  steady_clock::time_point time = steady_clock::now();
+  double elapsed = 0;
+  const std::size_t window_size = PREFETCH_WINDOW_SIZE;
+  for (std::size_t offset = 0; offset < size_; offset += window_size) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stop_)
+        break;
+      time_ = elapsed;
+    }
+    std::size_t end = std::min(offset + window_size, size_);
+# ifdef MADV_WILLNEED
+    Advise(start_ + end, std::min(window_size, size_ - end), MADV_WILLNEED);
+# endif
+    TouchPages(start_ + offset, end - offset);
+    elapsed += GetTimeAndReset(time);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  time_ = elapsed;
+}
+#endif
+
+void mp::internal::MemoryMappedFileBase::map(
+    int fd, std::size_t size, int hints) {
+  long minor_faults = 0, major_faults = 0;
+  GetPageFaults(minor_faults, major_faults);
+  steady_clock::time_point time = steady_clock::now();
+  int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+  if ((hints & map_hint::POPULATE) != 0)
+    flags |= MAP_POPULATE;
+#endif
   char *start = reinterpret_cast<char*>(
-      mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0));
+      mmap(0, size, PROT_READ, flags, fd, 0));
   if (start == MAP_FAILED)
     throw SystemError(errno, "cannot map file");
+#ifdef MADV_SEQUENTIAL
+  if ((hints & map_hint::SEQUENTIAL) != 0)
+    Advise(start, size, MADV_SEQUENTIAL);
+#endif
+#ifdef MADV_HUGEPAGE
+  if ((hints & map_hint::HUGE_PAGES) != 0)
+    Advise(start, size, MADV_HUGEPAGE);
+#endif
+#ifndef MAP_POPULATE
+  if ((hints & map_hint::POPULATE) != 0)
+    TouchPages(start, size);
+#endif
   start_ = start;
   size_ = size;
+  minor_faults_ = minor_faults;
+  major_faults_ = major_faults;
+  if ((hints & map_hint::PREFETCH) != 0 &&
+      (hints & map_hint::POPULATE) == 0) {
+#ifdef MP_USE_THREAD
+    prefetcher_ = new Prefetcher(start, size);
+#elif defined(MADV_WILLNEED)
+    Advise(start, size, MADV_WILLNEED);
+#endif
+  }
+  map_time_ = GetTimeAndReset(time);
 }
 
 void mp::internal::MemoryMappedFileBase::unmap() {
+#ifdef MP_USE_THREAD
+  // Stop prefetching before the pages go away.
+  delete prefetcher_;
+  prefetcher_ = 0;
+#endif
   char *start = start_;
   start_ = 0;
   if (munmap(start, size_) == -1)
     fmt::report_system_error(errno, "cannot unmap file");
 }
 
+mp::MappedFileStats mp::internal::MemoryMappedFileBase::stats() const {
+  MappedFileStats stats;
+  if (!start_)
+    return stats;
+  GetPageFaults(stats.num_minor_faults, stats.num_major_faults);
+  stats.num_minor_faults -= minor_faults_;
+  stats.num_major_faults -= major_faults_;
+  stats.map_time = map_time_;
+#ifdef MP_USE_THREAD
+  if (prefetcher_)
+    stats.prefetch_time = prefetcher_->time();
+#endif
+  return stats;
+}
+
 #else  // _WIN32
 
 // Windows implementation.
@@ -175,7 +366,9 @@ path mp::GetExecutablePath() {
   return path(s, s + utf8_str.size());
 }
 
-void mp::internal::MemoryMappedFileBase::map(int fd, std::size_t size) {
+// Access hints are not supported on Windows and are ignored.
+void mp::internal::MemoryMappedFileBase::map(int fd, std::size_t size, int) {
+  steady_clock::time_point time = steady_clock::now();
   class Handle {
     HANDLE handle_;
     Handle(const Handle &) {}
@@ -197,6 +390,7 @@ void mp::internal::MemoryMappedFileBase::map(int fd, std::size_t size) {
     throw WindowsError(GetLastError(), "cannot map file");
   start_ = start;
   size_ = size;
+  map_time_ = GetTimeAndReset(time);
 }
 
 void mp::internal::MemoryMappedFileBase::unmap() {
@@ -206,4 +400,11 @@ void mp::internal::MemoryMappedFileBase::unmap() {
     throw WindowsError(GetLastError(), "cannot unmap file");
 }
 
+mp::MappedFileStats mp::internal::MemoryMappedFileBase::stats() const {
+  MappedFileStats stats;
+  if (start_)
+    stats.map_time = map_time_;
+  return stats;
+}
+
 #endif  // _WIN32
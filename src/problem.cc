@@ -48,6 +48,128 @@ int BasicProblem<Alloc>::GetSuffixSize(suf::Kind kind) {
   return static_cast<int>(size);
 }
 
+template <typename Alloc>
+void BasicProblem<Alloc>::MoveLinearConToEnd(int con_index) {
+  int start = linear_con_starts_[con_index];
+  int size = linear_con_sizes_[con_index];
+  std::size_t num_terms = linear_con_indices_.size();
+  if (size == 0) {
+    linear_con_starts_[con_index] = static_cast<int>(num_terms);
+    return;
+  }
+  if (2 * (num_unused_linear_con_terms_ + size) <= num_terms) {
+    // The old terms are left in place and reclaimed by compaction.
+    int new_start = static_cast<int>(num_terms);
+    linear_con_starts_[con_index] = new_start;
+    linear_con_indices_.resize(new_start + size);
+    linear_con_coefs_.resize(new_start + size);
+    std::copy(linear_con_indices_.begin() + start,
+              linear_con_indices_.begin() + start + size,
+              linear_con_indices_.begin() + new_start);
+    std::copy(linear_con_coefs_.begin() + start,
+              linear_con_coefs_.begin() + start + size,
+              linear_con_coefs_.begin() + new_start);
+    num_unused_linear_con_terms_ += size;
+    return;
+  }
+  // Compact the block placing the constraint last.
+  std::size_t num_used_terms = num_terms - num_unused_linear_con_terms_;
+  std::vector<int> indices;
+  std::vector<double> coefs;
+  indices.reserve(num_used_terms + size);
+  coefs.reserve(num_used_terms + size);
+  int num_cons = num_algebraic_cons();
+  for (int i = 0; i <= num_cons; ++i) {
+    if (i == con_index)
+      continue;
+    int con = i != num_cons ? i : con_index;
+    int con_start = linear_con_starts_[con];
+    int con_size = linear_con_sizes_[con];
+    linear_con_starts_[con] = static_cast<int>(indices.size());
+    indices.insert(indices.end(), linear_con_indices_.begin() + con_start,
+                   linear_con_indices_.begin() + con_start + con_size);
+    coefs.insert(coefs.end(), linear_con_coefs_.begin() + con_start,
+                 linear_con_coefs_.begin() + con_start + con_size);
+  }
+  linear_con_indices_.swap(indices);
+  linear_con_coefs_.swap(coefs);
+  num_unused_linear_con_terms_ = 0;
+}
+
+template <typename Alloc>
+void BasicProblem<Alloc>::set_linear_con_storage(LinearConStorage storage) {
+  if (storage == linear_con_storage_)
+    return;
+  int num_cons = num_algebraic_cons();
+  if (storage == LINEAR_CON_CSR) {
+    std::size_t num_terms = 0;
+    for (int i = 0; i < num_cons; ++i)
+      num_terms += algebraic_cons_[i].linear_expr.num_terms();
+    linear_con_starts_.resize(num_cons);
+    linear_con_sizes_.resize(num_cons);
+    linear_con_indices_.resize(num_terms);
+    linear_con_coefs_.resize(num_terms);
+    int start = 0;
+    for (int i = 0; i < num_cons; ++i) {
+      LinearExpr &expr = algebraic_cons_[i].linear_expr;
+      int size = expr.num_terms();
+      linear_con_starts_[i] = start;
+      linear_con_sizes_[i] = size;
+      std::copy(expr.indices_, expr.indices_ + size,
+                linear_con_indices_.begin() + start);
+      std::copy(expr.coefs_, expr.coefs_ + size,
+                linear_con_coefs_.begin() + start);
+      start += size;
+      LinearExpr().swap(expr);
+    }
+  } else {
+    for (int i = 0; i < num_cons; ++i) {
+      // Copy from an lvalue to get an owning expression rather than a view.
+      LinearExpr view = GetLinearConExpr(i);
+      algebraic_cons_[i].linear_expr = view;
+    }
+    std::vector<int>().swap(linear_con_starts_);
+    std::vector<int>().swap(linear_con_sizes_);
+    std::vector<int>().swap(linear_con_indices_);
+    std::vector<double>().swap(linear_con_coefs_);
+  }
+  num_unused_linear_con_terms_ = 0;
+  linear_con_storage_ = storage;
+}
+
+template <typename Alloc>
+void BasicProblem<Alloc>::GetConMatrix(CSCMatrix &matrix) const {
+  // Count terms in each column and convert counts into column starts.
+  int num_cons = num_algebraic_cons();
+  std::vector<int> &col_starts = matrix.col_starts_;
+  col_starts.assign(num_vars() + 1, 0);
+  std::size_t num_terms = 0;
+  for (int i = 0; i < num_cons; ++i) {
+    LinearExpr expr = GetLinearConExpr(i);
+    for (int j = 0, n = expr.num_terms(); j < n; ++j)
+      ++col_starts[expr.indices_[j] + 1];
+    num_terms += expr.num_terms();
+  }
+  for (std::size_t i = 1, n = col_starts.size(); i < n; ++i)
+    col_starts[i] += col_starts[i - 1];
+  matrix.row_indices_.resize(num_terms);
+  matrix.values_.resize(num_terms);
+  // Fill the matrix advancing col_starts[j] past the terms of column j
+  // so that at the end it contains the start of column j + 1.
+  for (int i = 0; i < num_cons; ++i) {
+    LinearExpr expr = GetLinearConExpr(i);
+    for (int j = 0, n = expr.num_terms(); j < n; ++j) {
+      int index = col_starts[expr.indices_[j]]++;
+      matrix.row_indices_[index] = i;
+      matrix.values_[index] = expr.coefs_[j];
+    }
+  }
+  // Shift column starts back.
+  for (std::size_t i = col_starts.size() - 1; i > 0; --i)
+    col_starts[i] = col_starts[i - 1];
+  col_starts[0] = 0;
+}
+
 template <typename Alloc>
 typename BasicProblem<Alloc>::LinearObjBuilder BasicProblem<Alloc>::AddObj(
     obj::Type type, NumericExpr expr, int num_linear_terms) {
@@ -72,9 +194,9 @@ void BasicProblem<Alloc>::SetComplementarity(
     compl_vars_.resize(algebraic_cons_.size());
   }
   compl_vars_[con_index] = var_index + 1u;
-  AlgebraicConInfo &con = algebraic_cons_[con_index];
-  con.lb = info.con_lb();
-  con.ub = info.con_ub();
+  Bounds &bounds = con_bounds_.mut(con_index);
+  bounds.lb = info.con_lb();
+  bounds.ub = info.con_ub();
 }
 
 template <typename Alloc>
@@ -86,6 +208,13 @@ void BasicProblem<Alloc>::SetInfo(const ProblemInfo &info) {
   if (info.num_nl_objs != 0)
     nonlinear_objs_.reserve(info.num_objs);
   algebraic_cons_.reserve(info.num_algebraic_cons);
+  con_bounds_.reserve(info.num_algebraic_cons);
+  if (linear_con_storage_ == LINEAR_CON_CSR) {
+    linear_con_starts_.reserve(info.num_algebraic_cons);
+    linear_con_sizes_.reserve(info.num_algebraic_cons);
+    linear_con_indices_.reserve(info.num_con_nonzeros);
+    linear_con_coefs_.reserve(info.num_con_nonzeros);
+  }
   if (info.num_compl_conds != 0)
     compl_vars_.reserve(info.num_algebraic_cons);
   if (info.num_nl_cons != 0)
@@ -96,6 +225,51 @@ void BasicProblem<Alloc>::SetInfo(const ProblemInfo &info) {
   nonlinear_exprs_.reserve(num_common_exprs);
 }
 
+template <typename Alloc>
+void BasicProblem<Alloc>::ShareFrom(const BasicProblem &base) {
+  MP_ASSERT(vars_.empty() && linear_objs_.empty() && algebraic_cons_.empty() &&
+            logical_cons_.empty() && linear_exprs_.empty(),
+            "problem not empty");
+  ShareFunctions(base);
+  // Bounds refer to the base problem until modified.
+  vars_.Share(base.vars_);
+  is_var_int_ = base.is_var_int_;
+  is_obj_max_ = base.is_obj_max_;
+  // Linear parts are views of the base problem storage that become
+  // owning when modified.
+  std::size_t num_objs = base.linear_objs_.size();
+  linear_objs_.resize(num_objs);
+  for (std::size_t i = 0; i != num_objs; ++i) {
+    LinearExpr view = base.linear_objs_[i].view();
+    linear_objs_[i].swap(view);
+  }
+  nonlinear_objs_ = base.nonlinear_objs_;
+  // Constraints use separate expressions rather than CSR storage because
+  // views of shared terms can't be modified in place.
+  linear_con_storage_ = LINEAR_CON_EXPRS;
+  int num_cons = base.num_algebraic_cons();
+  algebraic_cons_.resize(num_cons);
+  for (int i = 0; i < num_cons; ++i) {
+    LinearExpr view = base.GetLinearConExpr(i);
+    algebraic_cons_[i].linear_expr.swap(view);
+  }
+  con_bounds_.Share(base.con_bounds_);
+  compl_vars_ = base.compl_vars_;
+  nonlinear_cons_ = base.nonlinear_cons_;
+  logical_cons_ = base.logical_cons_;
+  std::size_t num_exprs = base.linear_exprs_.size();
+  linear_exprs_.resize(num_exprs);
+  for (std::size_t i = 0; i != num_exprs; ++i) {
+    LinearExpr view = base.linear_exprs_[i].view();
+    linear_exprs_[i].swap(view);
+  }
+  nonlinear_exprs_ = base.nonlinear_exprs_;
+  initial_values_ = base.initial_values_;
+  initial_dual_values_ = base.initial_dual_values_;
+  // Suffixes are not shared because solvers write output suffixes
+  // into them.
+}
+
 template class BasicProblem< std::allocator<char> >;
 
 template void ReadNLFile(fmt::CStringRef filename, Problem &p, int flags);
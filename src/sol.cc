@@ -22,21 +22,99 @@
 
 #include "mp/sol.h"
 
-void mp::internal::WriteMessage(fmt::BufferedFile &file, const char *message) {
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+mp::internal::SolOutput::SolOutput(fmt::CStringRef filename)
+  : file_(filename, "wb"), buffer_(new char[BUFFER_SIZE]),
+    ptr_(buffer_), end_(buffer_ + BUFFER_SIZE) {}
+
+mp::internal::SolOutput::~SolOutput() {
+  delete [] buffer_;
+}
+
+void mp::internal::SolOutput::Flush() {
+  std::size_t size = ptr_ - buffer_;
+  if (size != 0 && std::fwrite(buffer_, 1, size, file_.get()) != size)
+    throw fmt::SystemError(errno, "cannot write to file");
+  ptr_ = buffer_;
+}
+
+void mp::internal::SolOutput::Write(fmt::StringRef s) {
+  const char *data = s.data();
+  std::size_t size = s.size();
+  if (size > static_cast<std::size_t>(end_ - ptr_)) {
+    Flush();
+    if (size > BUFFER_SIZE) {
+      if (std::fwrite(data, 1, size, file_.get()) != size)
+        throw fmt::SystemError(errno, "cannot write to file");
+      return;
+    }
+  }
+  std::memcpy(ptr_, data, size);
+  ptr_ += size;
+}
+
+void mp::internal::SolOutput::WriteMessage(
+    const char *message, sol::Format format) {
   for (const char *line_start = message;;) {
     const char *line_end = line_start;
     while (*line_end && *line_end != '\n')
       ++line_end;
     // Replace an empty line with a line containing a single space
     // because an empty line indicates the end of message.
-    if (line_end == line_start + 1)
-      std::fputc(' ', file.get());
-    else
-      std::fwrite(line_start, 1, line_end - line_start, file.get());
-    std::fputc('\n', file.get());
+    fmt::StringRef line(line_start, line_end - line_start);
+    if (line.size() == 0)
+      line = " ";
+    if (format == sol::BINARY) {
+      WriteRecord(line.data(), line.size());
+    } else {
+      Write(line);
+      Write('\n');
+    }
     if (!*line_end)
       break;
     line_start = line_end + 1;
   }
-  std::fputc('\n', file.get());
+  if (format == sol::BINARY)
+    WriteRecord("", 0);
+  else
+    Write('\n');
+}
+
+void mp::internal::SolOutput::Close() {
+  Flush();
+  file_.close();
+}
+
+char *mp::internal::SolOutput::FormatInt(
+    char *buffer, fmt::LongLong value) {
+  fmt::FormatInt f(value);
+  std::memcpy(buffer, f.data(), f.size());
+  return buffer + f.size();
+}
+
+char *mp::internal::SolOutput::FormatDouble(char *buffer, double value) {
+  // Write integers exactly, without going through the floating-point
+  // formatting. They are common in solutions of discrete problems.
+  const double MAX_EXACT_INT = 1e15;
+  if (value > -MAX_EXACT_INT && value < MAX_EXACT_INT &&
+      value == static_cast<fmt::LongLong>(value) &&
+      (value != 0 || 1 / value > 0)) {
+    return FormatInt(buffer, static_cast<fmt::LongLong>(value));
+  }
+  if (value != value) {
+    std::memcpy(buffer, "NaN", 3);
+    return buffer + 3;
+  }
+  if (value < 0 || (value == 0 && 1 / value < 0)) {
+    *buffer++ = '-';
+    value = -value;
+  }
+  if (value == std::numeric_limits<double>::infinity()) {
+    std::memcpy(buffer, "Infinity", 8);
+    return buffer + 8;
+  }
+  return buffer + fmt::internal::format_shortest(buffer, value);
 }
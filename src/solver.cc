@@ -24,17 +24,25 @@
 #include "mp/solver.h"
 
 #include <cctype>
+#include <cerrno>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
 #include <algorithm>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <stack>
 
 #ifndef _WIN32
 # include <strings.h>
+# include <signal.h>
 # include <unistd.h>
+# include <sys/socket.h>
+# include <sys/stat.h>
+# include <sys/un.h>
 # define MP_WRITE write
 #else
 # include <io.h>
@@ -46,8 +54,15 @@
 #endif
 
 #include "mp/clock.h"
+#include "mp/os.h"
 #include "mp/rstparser.h"
 
+#ifdef MP_USE_THREAD
+# include <condition_variable>
+# include <mutex>
+# include <thread>
+#endif
+
 namespace {
 
 const char *SkipSpaces(const char *s) {
@@ -261,7 +276,7 @@ std::string OptionHelper<std::string>::Parse(const char *&s) {
 }
 
 SolverAppOptionParser::SolverAppOptionParser(Solver &s)
-  : solver_(s), echo_solver_options_(true) {
+  : solver_(s), echo_solver_options_(true), server_mode_(false) {
   // Add standard command-line options.
   OptionList::Builder<SolverAppOptionParser> app_options(options_, *this);
   app_options.Add<&SolverAppOptionParser::ShowUsage>(
@@ -273,6 +288,9 @@ SolverAppOptionParser::SolverAppOptionParser(Solver &s)
         'e', "suppress echoing of assignments");
   app_options.Add<&SolverAppOptionParser::WantSol>(
         's', "write .sol file (without -AMPL)");
+  app_options.Add<&SolverAppOptionParser::EnableServerMode>(
+        'b', "run as a batch solve server reading jobs from stdin or "
+        "a Unix socket given with socket=<path>");
   OptionList::Builder<mp::Solver> options(options_, s);
   options.Add<&mp::Solver::ShowVersion>('v', "show version and exit");
   // TODO: if solver supports functions add options -ix and -u
@@ -314,6 +332,21 @@ const char *SolverAppOptionParser::Parse(char **&argv) {
   ++argv;
   char opt = ParseOptions(argv, options_);
   if (opt && opt != '-') return 0;
+  if (server_mode_) {
+    // All arguments are solver options except socket=<path>.
+    const char SOCKET_PREFIX[] = "socket=";
+    std::size_t prefix_size = sizeof(SOCKET_PREFIX) - 1;
+    for (char **arg = argv; *arg; ++arg) {
+      if (std::strncmp(*arg, SOCKET_PREFIX, prefix_size) != 0)
+        continue;
+      const char *socket_path = *arg + prefix_size;
+      // Remove the argument so that it is not passed to the solver.
+      for (; *arg; ++arg)
+        arg[0] = arg[1];
+      return socket_path;
+    }
+    return "";
+  }
   const char *stub = *argv;
   if (!stub) {
     ShowUsage();
@@ -330,10 +363,12 @@ const char *SolverAppOptionParser::Parse(char **&argv) {
 
 mp::internal::atomic<const char*> SignalHandler::signal_message_ptr_;
 mp::internal::atomic<unsigned> SignalHandler::signal_message_size_;
-mp::internal::atomic<InterruptHandler> SignalHandler::handler_;
-mp::internal::atomic<void*> SignalHandler::data_;
+SignalHandler::HandlerInfo SignalHandler::handlers_[2];
+mp::internal::atomic<const SignalHandler::HandlerInfo*>
+  SignalHandler::handler_;
 
 volatile std::sig_atomic_t SignalHandler::stop_ = 1;
+volatile std::sig_atomic_t SignalHandler::signal_count_ = 0;
 
 #ifdef _WIN32
 // Signal repeater for Windows.
@@ -413,8 +448,12 @@ SignalHandler::~SignalHandler() {
 }
 
 void SignalHandler::SetHandler(InterruptHandler handler, void *data) {
-  handler_ = handler;
-  data_ = data;
+  // Fill the slot that is not in use and publish it.
+  const HandlerInfo *current = handler_;
+  HandlerInfo *info = &handlers_[current == handlers_ ? 1 : 0];
+  info->handler = handler;
+  info->data = data;
+  handler_ = handler ? info : 0;
 }
 
 void SignalHandler::HandleSigInt(int sig) {
@@ -431,8 +470,9 @@ void SignalHandler::HandleSigInt(int sig) {
     _exit(1);
   }
   stop_ = 1;
-  if (InterruptHandler handler = handler_)
-    handler(data_);
+  ++signal_count_;
+  if (const HandlerInfo *info = handler_)
+    info->handler(info->data);
   // Restore the handler since it might have been reset before the handler
   // is called (this is implementation defined).
   std::signal(sig, HandleSigInt);
@@ -479,6 +519,229 @@ void PrintSolution(const double *values, int num_values, const char *name_col,
 }
 }  // namespace internal
 
+namespace {
+#ifdef MP_USE_THREAD
+// Returns the mutex that guards interrupt handlers and children of
+// cancellation tokens. It is never destroyed because the token watchdog
+// thread may wait on it during exit.
+std::mutex &token_mutex() {
+  static std::mutex *mutex = new std::mutex();
+  return *mutex;
+}
+#endif
+
+// Locks token_mutex if threads are enabled.
+class TokenLock {
+#ifdef MP_USE_THREAD
+ private:
+  std::unique_lock<std::mutex> lock_;
+
+ public:
+  TokenLock() : lock_(token_mutex()) {}
+
+  std::unique_lock<std::mutex> &get() { return lock_; }
+#endif
+};
+}  // namespace
+
+namespace internal {
+
+// Polls cancellation tokens that have interrupt handlers so that the
+// handlers are called when a deadline passes, a signal is received or
+// a parent is cancelled even if nobody calls Stop. All members are
+// guarded by token_mutex.
+class TokenWatchdog {
+#ifdef MP_USE_THREAD
+ private:
+  std::vector<CancellationToken*> tokens_;
+  std::condition_variable cv_;
+  bool started_;
+
+  enum { POLL_INTERVAL_MS = 10 };
+
+  void Run();
+#endif
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(TokenWatchdog);
+
+ public:
+#ifdef MP_USE_THREAD
+  TokenWatchdog() : started_(false) {}
+
+  void Watch(CancellationToken *token);
+  void Unwatch(CancellationToken *token);
+#else
+  TokenWatchdog() {}
+  void Watch(CancellationToken *) {}
+  void Unwatch(CancellationToken *) {}
+#endif
+
+  // Returns the watchdog which is never destroyed: its thread is detached
+  // so that exit doesn't wait for it. A child process created with fork
+  // while another thread holds token_mutex can't use tokens.
+  static TokenWatchdog &instance() {
+    static TokenWatchdog *watchdog = new TokenWatchdog();
+    return *watchdog;
+  }
+};
+
+#ifdef MP_USE_THREAD
+void TokenWatchdog::Run() {
+  TokenLock lock;
+  CancellationToken::HandlerList handlers;
+  for (;;) {
+    if (tokens_.empty()) {
+      cv_.wait(lock.get());
+      continue;
+    }
+    for (std::size_t i = 0; i < tokens_.size(); ) {
+      CancellationToken *token = tokens_[i];
+      if (!token->cancelled_ && token->IsStopRequested())
+        token->DoCancel(handlers);
+      if (token->cancelled_)
+        tokens_.erase(tokens_.begin() + i);
+      else
+        ++i;
+    }
+    if (!handlers.empty()) {
+      lock.get().unlock();
+      CancellationToken::CallHandlers(handlers);
+      handlers.clear();
+      lock.get().lock();
+    }
+    cv_.wait_for(lock.get(), std::chrono::milliseconds(POLL_INTERVAL_MS));
+  }
+}
+
+void TokenWatchdog::Watch(CancellationToken *token) {
+  if (std::find(tokens_.begin(), tokens_.end(), token) != tokens_.end())
+    return;
+  if (!started_) {
+    std::thread(&TokenWatchdog::Run, this).detach();
+    started_ = true;
+  }
+  tokens_.push_back(token);
+  cv_.notify_one();
+}
+
+void TokenWatchdog::Unwatch(CancellationToken *token) {
+  std::vector<CancellationToken*>::iterator
+      it = std::find(tokens_.begin(), tokens_.end(), token);
+  if (it != tokens_.end())
+    tokens_.erase(it);
+}
+#endif
+}  // namespace internal
+
+const steady_clock::rep CancellationToken::NO_DEADLINE =
+    std::numeric_limits<steady_clock::rep>::max();
+
+CancellationToken::CancellationToken(CancellationToken *parent)
+  : cancelled_(0), check_(parent != 0), parent_(parent),
+    deadline_(NO_DEADLINE), signal_count_(-1),
+    handler_(0), handler_data_(0) {
+  if (!parent)
+    return;
+  TokenLock lock;
+  parent->children_.push_back(this);
+}
+
+CancellationToken::~CancellationToken() {
+  TokenLock lock;
+  MP_ASSERT(children_.empty(), "token destroyed before its children");
+  internal::TokenWatchdog::instance().Unwatch(this);
+  if (!parent_)
+    return;
+  std::vector<CancellationToken*> &siblings = parent_->children_;
+  siblings.erase(std::find(siblings.begin(), siblings.end(), this));
+}
+
+bool CancellationToken::IsStopRequested() const {
+  long signal_count = signal_count_;
+  if (signal_count >= 0 &&
+      internal::SignalHandler::signal_count() != signal_count) {
+    return true;
+  }
+  steady_clock::rep deadline = deadline_;
+  if (deadline != NO_DEADLINE &&
+      steady_clock::now().time_since_epoch().count() >= deadline) {
+    return true;
+  }
+  return parent_ && parent_->Stop();
+}
+
+void CancellationToken::DoCancel(HandlerList &handlers) {
+  if (cancelled_)
+    return;
+  cancelled_ = 1;
+  if (handler_)
+    handlers.push_back(std::make_pair(handler_, handler_data_));
+  for (std::size_t i = 0, n = children_.size(); i != n; ++i)
+    children_[i]->DoCancel(handlers);
+}
+
+void CancellationToken::CallHandlers(const HandlerList &handlers) {
+  for (std::size_t i = 0, n = handlers.size(); i != n; ++i)
+    handlers[i].first(handlers[i].second);
+}
+
+void CancellationToken::UpdateWatch() {
+  if (handler_ && check_ && !cancelled_)
+    internal::TokenWatchdog::instance().Watch(this);
+  else
+    internal::TokenWatchdog::instance().Unwatch(this);
+}
+
+void CancellationToken::set_deadline(steady_clock::time_point deadline) {
+  TokenLock lock;
+  deadline_ = deadline.time_since_epoch().count();
+  check_ = 1;
+  UpdateWatch();
+}
+
+void CancellationToken::set_time_limit(double seconds) {
+  typedef steady_clock::period Period;
+  steady_clock::rep now = steady_clock::now().time_since_epoch().count();
+  steady_clock::rep deadline = NO_DEADLINE;
+  double ticks = std::max(seconds, 0.0) * Period::den / Period::num;
+  // Limits that overflow the clock mean no deadline.
+  if (ticks < static_cast<double>(NO_DEADLINE - now)) {
+    steady_clock::rep limit = static_cast<steady_clock::rep>(ticks);
+    if (limit < NO_DEADLINE - now)
+      deadline = now + limit;
+  }
+  set_deadline(steady_clock::time_point(steady_clock::duration(deadline)));
+}
+
+void CancellationToken::CancelOnSigInt() {
+  TokenLock lock;
+  signal_count_ = internal::SignalHandler::signal_count();
+  check_ = 1;
+  UpdateWatch();
+}
+
+void CancellationToken::Cancel() {
+  HandlerList handlers;
+  {
+    TokenLock lock;
+    DoCancel(handlers);
+  }
+  CallHandlers(handlers);
+}
+
+void CancellationToken::SetHandler(InterruptHandler handler, void *data) {
+  HandlerList handlers;
+  {
+    TokenLock lock;
+    handler_ = handler;
+    handler_data_ = data;
+    if (handler && Stop())
+      DoCancel(handlers);
+    UpdateWatch();
+  }
+  CallHandlers(handlers);
+}
+
 bool Solver::OptionNameLess::operator()(
     const SolverOption *lhs, const SolverOption *rhs) const {
   return strcasecmp(lhs->name(), rhs->name()) < 0;
@@ -490,7 +753,7 @@ Solver::Solver(
   long_name_((long_name.c_str() ? long_name : name).c_str()),
   date_(date), wantsol_(0), obj_precision_(-1), objno_(-1), bool_options_(0),
   count_solutions_(false), read_flags_(0), timing_(false), multiobj_(false),
-  has_errors_(false) {
+  flags_(flags), has_errors_(false) {
   version_ = long_name_;
   error_handler_ = this;
   output_handler_ = this;
@@ -711,4 +974,452 @@ Solver::DoubleFormatter Solver::FormatObjValue(double value) {
   DoubleFormatter formatter = {value, obj_precision_};
   return formatter;
 }
+
+void internal::OptionSnapshot::Save(Solver &s) {
+  values_.clear();
+  fmt::MemoryWriter w;
+  for (Solver::option_iterator
+       i = s.option_begin(), end = s.option_end(); i != end; ++i) {
+    // Flag options don't have values and parsing them has side effects.
+    if (i->is_flag())
+      continue;
+    SolverOption *opt = s.FindOption(i->name());
+    w.clear();
+    try {
+      opt->Write(w);
+    } catch (const OptionError &) {
+      continue;  // Write-only option.
+    }
+    Value value = {opt, w.str()};
+    values_.push_back(value);
+  }
+}
+
+void internal::OptionSnapshot::Restore() {
+  fmt::MemoryWriter w;
+  for (std::size_t i = 0, n = values_.size(); i != n; ++i) {
+    const Value &value = values_[i];
+    w.clear();
+    value.option->Write(w);
+    if (w.size() == value.value.size() &&
+        std::equal(w.data(), w.data() + w.size(), value.value.begin())) {
+      continue;
+    }
+    const char *s = value.value.c_str();
+    value.option->Parse(s);
+  }
+}
+
+namespace {
+// Reads lines from a file.
+class LineReader {
+ private:
+  fmt::File &file_;
+  char buffer_[BUFSIZ];
+  std::size_t pos_, size_;
+  bool eof_;
+
+ public:
+  explicit LineReader(fmt::File &f)
+    : file_(f), pos_(0), size_(0), eof_(false) {}
+
+  // Reads a line without the terminating newline. Returns false at the end
+  // of input.
+  bool Read(std::string &line) {
+    line.clear();
+    for (;;) {
+      if (pos_ == size_) {
+        if (eof_)
+          return !line.empty();
+        size_ = file_.read(buffer_, sizeof(buffer_));
+        pos_ = 0;
+        if (size_ == 0) {
+          eof_ = true;
+          return !line.empty();
+        }
+      }
+      const char *start = buffer_ + pos_, *end = buffer_ + size_;
+      const char *newline =
+          static_cast<const char*>(std::memchr(start, '\n', end - start));
+      if (!newline) {
+        line.append(start, end);
+        pos_ = size_;
+        continue;
+      }
+      line.append(start, newline);
+      pos_ += newline - start + 1;
+      if (!line.empty() && line[line.size() - 1] == '\r')
+        line.resize(line.size() - 1);
+      return true;
+    }
+  }
+};
+
+// Writes the whole buffer to a file.
+void WriteAll(fmt::File &f, const char *data, std::size_t size) {
+  while (size != 0) {
+    std::size_t count = f.write(data, size);
+    data += count;
+    size -= count;
+  }
+}
+}  // namespace
+
+// Distributes jobs among workers and writes job reports.
+class internal::SolverServerBase::Dispatcher {
+ private:
+  SolverServerBase &server_;
+  fmt::File &out_;
+
+  // The error that occurred when writing a report. Once it is set, no more
+  // jobs are run.
+  std::exception_ptr write_error_;
+
+#ifdef MP_USE_THREAD
+  std::deque<Job> jobs_;
+  bool done_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::mutex output_mutex_;  // Protects out_ and write_error_.
+  std::vector<std::thread> threads_;
+
+  // Runs jobs from the queue until it is empty and no more jobs are coming.
+  void Run(int worker);
+
+  // Waits for the workers to finish.
+  void Join();
+#endif
+
+  // Runs a job catching exceptions and writes a job report. Doesn't throw
+  // on errors other than memory allocation failures, so it can be called
+  // on worker threads.
+  void RunAndReport(int worker, const Job &job);
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(Dispatcher);
+
+ public:
+  Dispatcher(SolverServerBase &server, fmt::File &out);
+
+  // Waits for all jobs to complete.
+  ~Dispatcher();
+
+  // Returns true if writing a report has failed.
+  bool failed();
+
+  // Adds a job to the queue.
+  void Add(const Job &job);
+
+  // Waits for all jobs to complete and rethrows the error that occurred
+  // when writing a report, if any.
+  void Finish();
+};
+
+bool internal::SolverServerBase::Dispatcher::failed() {
+#ifdef MP_USE_THREAD
+  std::lock_guard<std::mutex> lock(output_mutex_);
+#endif
+  return write_error_ != std::exception_ptr();
+}
+
+void internal::SolverServerBase::Dispatcher::RunAndReport(
+    int worker, const Job &job) {
+  if (failed())
+    return;  // Nobody will see the report.
+  fmt::MemoryWriter output, report;
+  std::string error;
+  try {
+    server_.RunJob(worker, job, output);
+  } catch (const std::exception &e) {
+    error = e.what();
+  } catch (...) {
+    error = "unknown exception";
+  }
+  steady_clock::time_point start = job.start;
+  double latency = GetTimeAndReset(start);
+  // Prefix solver output with "# " to separate it from job reports.
+  const char *s = output.c_str(), *end = s + output.size();
+  while (s != end) {
+    const char *newline =
+        static_cast<const char*>(std::memchr(s, '\n', end - s));
+    const char *line_end = newline ? newline : end;
+    report << "# " << fmt::StringRef(s, line_end - s) << '\n';
+    s = newline ? newline + 1 : end;
+  }
+  report.write("{} {} {:.6f} {}", job.id, error.empty() ? "ok" : "error",
+               latency, job.stub);
+  if (!error.empty())
+    report << ": " << error;
+  report << '\n';
+#ifdef MP_USE_THREAD
+  std::lock_guard<std::mutex> lock(output_mutex_);
+#endif
+  if (write_error_ != std::exception_ptr())
+    return;
+  try {
+    WriteAll(out_, report.data(), report.size());
+  } catch (const fmt::SystemError &e) {
+    // Drop the report if the client has disconnected.
+    if (e.error_code() != EPIPE)
+      write_error_ = std::current_exception();
+  } catch (...) {
+    write_error_ = std::current_exception();
+  }
+}
+
+#ifdef MP_USE_THREAD
+internal::SolverServerBase::Dispatcher::Dispatcher(
+    SolverServerBase &server, fmt::File &out)
+  : server_(server), out_(out), done_(false) {
+  if (server.num_workers_ == 1)
+    return;  // Run jobs on the calling thread.
+  threads_.reserve(server.num_workers_);
+  for (int i = 0; i < server.num_workers_; ++i)
+    threads_.push_back(std::thread(&Dispatcher::Run, this, i));
+}
+
+internal::SolverServerBase::Dispatcher::~Dispatcher() {
+  Join();
+}
+
+void internal::SolverServerBase::Dispatcher::Join() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+    cond_.notify_all();
+  }
+  for (std::size_t i = 0, n = threads_.size(); i != n; ++i)
+    threads_[i].join();
+  threads_.clear();
+}
+
+void internal::SolverServerBase::Dispatcher::Run(int worker) {
+  for (;;) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (jobs_.empty() && !done_)
+        cond_.wait(lock);
+      if (jobs_.empty())
+        return;
+      job = jobs_.front();
+      jobs_.pop_front();
+    }
+    RunAndReport(worker, job);
+  }
+}
+
+void internal::SolverServerBase::Dispatcher::Add(const Job &job) {
+  if (threads_.empty()) {
+    RunAndReport(0, job);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  jobs_.push_back(job);
+  cond_.notify_one();
+}
+
+void internal::SolverServerBase::Dispatcher::Finish() {
+  Join();
+  if (write_error_ != std::exception_ptr())
+    std::rethrow_exception(write_error_);
+}
+#else
+internal::SolverServerBase::Dispatcher::Dispatcher(
+    SolverServerBase &server, fmt::File &out) : server_(server), out_(out) {}
+
+internal::SolverServerBase::Dispatcher::~Dispatcher() {}
+
+void internal::SolverServerBase::Dispatcher::Add(const Job &job) {
+  RunAndReport(0, job);
+}
+
+void internal::SolverServerBase::Dispatcher::Finish() {
+  if (write_error_ != std::exception_ptr())
+    std::rethrow_exception(write_error_);
+}
+#endif
+
+internal::SolverServerBase::SolverServerBase(int num_workers)
+  : num_workers_(num_workers), num_jobs_(0) {
+#ifdef MP_USE_THREAD
+  if (num_workers_ <= 0)
+    num_workers_ = static_cast<int>(std::thread::hardware_concurrency());
+#else
+  num_workers_ = 1;
+#endif
+  num_workers_ = std::max(num_workers_, 1);
+}
+
+bool internal::SolverServerBase::Serve(fmt::File &in, fmt::File &out) {
+  Dispatcher dispatcher(*this, out);
+  LineReader reader(in);
+  std::string line;
+  bool quit = false;
+  // Stop reading jobs if reports can't be written.
+  while (!dispatcher.failed() && reader.Read(line)) {
+    const char *s = SkipSpaces(line.c_str());
+    if (!*s || *s == '#')
+      continue;
+    const char *stub_end = SkipNonSpaces(s);
+    Job job;
+    job.stub.assign(s, stub_end);
+    if (job.stub == "quit") {
+      quit = true;
+      break;
+    }
+    job.id = ++num_jobs_;
+    job.options = SkipSpaces(stub_end);
+    job.start = steady_clock::now();
+    dispatcher.Add(job);
+  }
+  dispatcher.Finish();
+  return quit;
+}
+
+// Solves scenarios on multiple threads.
+class internal::ScenarioDriverBase::Runner {
+ private:
+  ScenarioDriverBase &driver_;
+  int num_scenarios_;
+
+#ifdef MP_USE_THREAD
+  std::mutex mutex_;
+  int next_scenario_;
+  bool failed_;
+
+  // Solves scenarios on the worker with the specified index until there
+  // are no more scenarios left or an error occurs.
+  void Run(int worker);
+#endif
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(Runner);
+
+ public:
+  Runner(ScenarioDriverBase &d, int num_scenarios);
+};
+
+#ifdef MP_USE_THREAD
+void internal::ScenarioDriverBase::Runner::Run(int worker) {
+  try {
+    for (;;) {
+      int scenario = 0;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (failed_ || next_scenario_ == num_scenarios_)
+          return;
+        scenario = next_scenario_++;
+      }
+      driver_.SolveScenario(worker, scenario);
+    }
+  } catch (...) {
+    // Stop the other workers; the error is rethrown by RunInParallel.
+    std::lock_guard<std::mutex> lock(mutex_);
+    failed_ = true;
+    throw;
+  }
+}
+
+internal::ScenarioDriverBase::Runner::Runner(
+    ScenarioDriverBase &d, int num_scenarios)
+  : driver_(d), num_scenarios_(num_scenarios), next_scenario_(0),
+    failed_(false) {
+  RunInParallel(std::min(d.num_workers_, num_scenarios),
+                std::bind(&Runner::Run, this, std::placeholders::_1));
+}
+#else
+internal::ScenarioDriverBase::Runner::Runner(
+    ScenarioDriverBase &d, int num_scenarios)
+  : driver_(d), num_scenarios_(num_scenarios) {
+  for (int i = 0; i < num_scenarios; ++i)
+    driver_.SolveScenario(0, i);
+}
+#endif
+
+internal::ScenarioDriverBase::ScenarioDriverBase(int num_workers)
+  : num_workers_(num_workers) {
+#ifdef MP_USE_THREAD
+  if (num_workers_ <= 0)
+    num_workers_ = static_cast<int>(std::thread::hardware_concurrency());
+#else
+  num_workers_ = 1;
+#endif
+  num_workers_ = std::max(num_workers_, 1);
+}
+
+void internal::ScenarioDriverBase::Run(int num_scenarios) {
+  Runner runner(*this, num_scenarios);
+}
+
+#ifndef _WIN32
+namespace {
+// Ignores SIGPIPE while in scope, so that writing to a connection closed
+// by the client fails with EPIPE instead of terminating the process.
+class SigPipeIgnorer {
+ private:
+  struct sigaction old_action_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(SigPipeIgnorer);
+
+ public:
+  SigPipeIgnorer() {
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = SIG_IGN;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPIPE, &action, &old_action_);
+  }
+
+  ~SigPipeIgnorer() { sigaction(SIGPIPE, &old_action_, 0); }
+};
+}  // namespace
+
+void internal::SolverServerBase::Listen(fmt::CStringRef socket_path) {
+  sockaddr_un addr = sockaddr_un();
+  addr.sun_family = AF_UNIX;
+  const char *path = socket_path.c_str();
+  std::size_t path_size = std::strlen(path);
+  if (path_size >= sizeof(addr.sun_path))
+    throw Error("socket path too long: {}", path);
+  std::memcpy(addr.sun_path, path, path_size);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1)
+    throw fmt::SystemError(errno, "cannot create socket");
+  // Let File manage the descriptor.
+  fmt::File sock = fmt::File::dup(fd);
+  ::close(fd);
+  // Remove a socket left by a previous server, but never another file.
+  struct stat file_stat;
+  if (lstat(path, &file_stat) == 0) {
+    if (!S_ISSOCK(file_stat.st_mode))
+      throw Error("{} exists and is not a socket", path);
+    unlink(path);
+  } else if (errno != ENOENT) {
+    throw fmt::SystemError(errno, "cannot access {}", path);
+  }
+  if (bind(sock.descriptor(), reinterpret_cast<sockaddr*>(&addr),
+           sizeof(addr)) != 0) {
+    throw fmt::SystemError(errno, "cannot bind socket to {}", path);
+  }
+  if (listen(sock.descriptor(), SOMAXCONN) != 0)
+    throw fmt::SystemError(errno, "cannot listen on socket {}", path);
+  SigPipeIgnorer sigpipe_ignorer;
+  bool quit = false;
+  while (!quit) {
+    fd = accept(sock.descriptor(), 0, 0);
+    if (fd == -1) {
+      if (errno == EINTR)
+        continue;
+      throw fmt::SystemError(errno, "cannot accept connection on {}", path);
+    }
+    fmt::File conn = fmt::File::dup(fd);
+    ::close(fd);
+    quit = Serve(conn, conn);
+  }
+  unlink(path);
+}
+#else
+void internal::SolverServerBase::Listen(fmt::CStringRef) {
+  throw MakeUnsupportedError("Unix domain sockets");
+}
+#endif
 }  // namespace mp
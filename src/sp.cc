@@ -21,13 +21,37 @@
  */
 
 #include "sp.h"
+#include "mp/os.h"
+#include "mp/safeint.h"
 
-#include <cstring>    // std::strcmp
-#include <algorithm>  // std::max
+#include <cstring>     // std::strcmp
+#include <algorithm>   // std::max
+#include <functional>  // std::bind
+
+#ifdef MP_USE_THREAD
+# include <thread>
+#endif
 
 namespace mp {
 namespace {
 
+// Disables change recording in a problem for the lifetime of the object
+// and restores the previous setting on destruction.
+class ChangeRecordingPause {
+ private:
+  ColProblem &problem_;
+  bool record_changes_;
+
+  FMT_DISALLOW_COPY_AND_ASSIGN(ChangeRecordingPause);
+
+ public:
+  explicit ChangeRecordingPause(ColProblem &p)
+    : problem_(p), record_changes_(p.record_changes()) {
+    p.set_record_changes(false);
+  }
+  ~ChangeRecordingPause() { problem_.set_record_changes(record_changes_); }
+};
+
 // Returns the name of a logical constraint.
 inline std::string lcon_name(int index) {
   return fmt::format("_slogcon[{}]", index + 1);
@@ -87,34 +111,147 @@ class NullSuffix {
  public:
   int value(int) const { return 0; }
 };
-}  // namespace
 
-namespace internal {
+// Transposes a sparse matrix possibly on multiple threads. Elements of the
+// original matrix are split into parts with similar numbers of elements,
+// one part per thread. Each thread counts the elements of its part in every
+// minor vector and then scatters them to the offsets computed from all
+// the counts, so threads write to disjoint locations without locking.
+template <typename T>
+class Transposer {
+ private:
+  int major_size_;
+  int minor_size_;
+  const int *starts_;
+  const int *indices_;
+  const T *values_;
+  int *t_starts_;
+  int *t_indices_;
+  T *t_values_;
+  int num_parts_;
+
+  // Major indices of the original matrix where parts start.
+  std::vector<int> part_starts_;
+
+  // Per-part element counts in minor vectors which are later converted to
+  // offsets in the transposed matrix, minor_size_ entries per part.
+  std::vector<int> offsets_;
+
+  // The minimum number of elements in a part.
+  enum { MIN_PART_SIZE = 1 << 14 };
+
+  int *offsets(int part) {
+    return offsets_.data() + static_cast<std::size_t>(part) * minor_size_;
+  }
 
-void Transpose(SparseMatrix<double> &m, SparseMatrix<double*> &transposed,
-               int major_size) {
-  transposed.resize_major(major_size);
-  transposed.resize_elements(m.num_elements());
-  int orig_major_size = m.major_size();
-  for (int i = 0; i < orig_major_size; ++i) {
-    for (int j = m.start(i), n = m.start(i + 1); j < n; ++j)
-      ++transposed.start(m.index(j) + 1);
+  void Count(int part) {
+    int *counts = offsets(part);
+    for (int i = starts_[part_starts_[part]],
+         n = starts_[part_starts_[part + 1]]; i < n; ++i) {
+      ++counts[indices_[i]];
+    }
   }
-  int start = 0;
-  for (int i = 1; i <= major_size; ++i) {
-    double next = start + transposed.start(i);
-    transposed.start(i) =  start;
-    start = next;
+
+  void Scatter(int part) {
+    int *offsets = this->offsets(part);
+    for (int i = part_starts_[part], n = part_starts_[part + 1]; i < n; ++i) {
+      for (int j = starts_[i], end = starts_[i + 1]; j < end; ++j) {
+        int index = offsets[indices_[j]]++;
+        t_indices_[index] = i;
+        t_values_[index] = values_[j];
+      }
+    }
+  }
+
+  // Runs a phase of the transposition on all parts.
+  void Run(void (Transposer::*phase)(int part)) {
+    internal::RunInParallel(
+          num_parts_, std::bind(phase, this, std::placeholders::_1));
+  }
+
+ public:
+  Transposer(int major_size, int minor_size,
+             const int *starts, const int *indices, const T *values,
+             int *t_starts, int *t_indices, T *t_values)
+    : major_size_(major_size), minor_size_(minor_size),
+      starts_(starts), indices_(indices), values_(values),
+      t_starts_(t_starts), t_indices_(t_indices), t_values_(t_values),
+      num_parts_(1) {}
+
+  void Transpose(int num_threads);
+};
+
+template <typename T>
+void Transposer<T>::Transpose(int num_threads) {
+  int num_elements = starts_[major_size_];
+#ifdef MP_USE_THREAD
+  if (num_threads <= 0)
+    num_threads = static_cast<int>(std::thread::hardware_concurrency());
+  // Each part needs minor_size_ counters, so limit the number of parts
+  // to keep the extra work proportional to the number of elements.
+  int max_num_parts =
+      num_elements / std::max<int>(minor_size_, MIN_PART_SIZE);
+  num_parts_ = std::min(num_threads, max_num_parts);
+  num_parts_ = std::max(num_parts_, 1);
+#else
+  internal::Unused(num_threads);
+#endif
+  part_starts_.resize(num_parts_ + 1);
+  for (int part = 1, i = 0; part < num_parts_; ++part) {
+    int part_start = num_elements / num_parts_ * part;
+    while (i < major_size_ && starts_[i] < part_start)
+      ++i;
+    part_starts_[part] = i;
   }
-  for (int i = 0; i < orig_major_size; ++i) {
-    for (int j = m.start(i), n = m.start(i + 1); j < n; ++j) {
-      int index = transposed.start(m.index(j) + 1)++;
-      transposed.index(index) = i;
-      transposed.value(index) = &m.value(j);
+  part_starts_[num_parts_] = major_size_;
+
+  offsets_.assign(static_cast<std::size_t>(num_parts_) * minor_size_, 0);
+  Run(&Transposer::Count);
+  // Convert counts to offsets so that elements of each transposed vector
+  // are ordered by part and therefore by the major index.
+  int start = 0;
+  for (int j = 0; j < minor_size_; ++j) {
+    t_starts_[j] = start;
+    for (int part = 0; part < num_parts_; ++part) {
+      int &offset = offsets(part)[j];
+      int count = offset;
+      offset = start;
+      start += count;
     }
   }
+  t_starts_[minor_size_] = start;
+  Run(&Transposer::Scatter);
+}
+}  // namespace
+
+namespace internal {
+
+template <typename T>
+void Transpose(int major_size, int minor_size,
+               const int *starts, const int *indices, const T *values,
+               int *t_starts, int *t_indices, T *t_values, int num_threads) {
+  Transposer<T>(major_size, minor_size, starts, indices, values,
+                t_starts, t_indices, t_values).Transpose(num_threads);
 }
 
+template void Transpose(int, int, const int *, const int *, const double *,
+                        int *, int *, double *, int);
+
+template <typename T>
+void Transpose(const SparseMatrix<T> &m, SparseMatrix<T> &transposed,
+               int major_size, int num_threads) {
+  transposed.resize_major(major_size);
+  transposed.resize_elements(m.num_elements());
+  Transpose(m.major_size(), major_size, m.starts(), m.indices(), m.values(),
+            transposed.starts(), transposed.indices(), transposed.values(),
+            num_threads);
+}
+
+template void Transpose(const SparseMatrix<double> &, SparseMatrix<double> &,
+                        int, int);
+template void Transpose(const SparseMatrix<int> &, SparseMatrix<int> &,
+                        int, int);
+
 // Extracts an affine expression from a nonlinear one.
 class AffineExprExtractor: public ExprVisitor<AffineExprExtractor, void> {
  private:
@@ -410,24 +547,28 @@ void SPAdapter::ExtractRandomTerms() {
   const double *coefs = problem_.values();
   collector.Collect();
 
-  // Convert vars_in_nonlinear_ to column-major form.
+  // Combine the first scenario with core coefficients. Second-stage
+  // constraints are visited in order, so the position of the current element
+  // in each column only moves forward and no transposition is necessary.
   int num_vars = this->num_vars();
-  SparseMatrix<double*> var2con;
-  internal::Transpose(vars_in_nonlinear_, var2con, num_vars);
-
-  // Combine the first scenario with core coefficients.
+  std::vector<int> col_positions(num_vars);
+  for (int core_var_index = 0; core_var_index < num_vars; ++core_var_index)
+    col_positions[core_var_index] =
+        problem_.col_start(var_core2orig_[core_var_index]);
   core_coefs_.assign(coefs, coefs + problem_.col_start(problem_.num_vars()));
-  for (int core_var_index = 0; core_var_index < num_vars; ++core_var_index) {
-    int var_index = var_core2orig_[core_var_index];
-    int elt_index = problem_.col_start(var_index);
-    for (int j = var2con.start(core_var_index),
-         n = var2con.start(core_var_index + 1); j < n; ++j) {
-      int con_index = con_core2orig_[var2con.index(j) + num_stage1_cons];
+  for (int stage2_con = 0; stage2_con < num_stage2_cons; ++stage2_con) {
+    int con_index = con_core2orig_[stage2_con + num_stage1_cons];
+    for (int j = vars_in_nonlinear_.start(stage2_con),
+         n = vars_in_nonlinear_.start(stage2_con + 1); j < n; ++j) {
+      int core_var_index = vars_in_nonlinear_.index(j);
+      int &elt_index = col_positions[core_var_index];
       while (problem_.row_index(elt_index) != con_index)
         ++elt_index;
-      assert(elt_index < problem_.col_start(var_index + 1));
-      double coef = core_coefs_[elt_index] + *var2con.value(j);
-      *var2con.value(j) = core_coefs_[elt_index];
+      assert(elt_index <
+             problem_.col_start(var_core2orig_[core_var_index] + 1));
+      double &value = vars_in_nonlinear_.value(j);
+      double coef = core_coefs_[elt_index] + value;
+      value = core_coefs_[elt_index];
       core_coefs_[elt_index] = coef;
     }
   }
@@ -472,4 +613,340 @@ SPAdapter::SPAdapter(const ColProblem &p): problem_(p), num_stages_(1) {
   if (num_stages_ > 1)
     ExtractRandomTerms();
 }
+
+const SPAdapter::RandomVector *SPAdapter::GetScenarioRV() const {
+  const RandomVector *result = 0;
+  for (auto i = rvs_.begin(), end = rvs_.end(); i != end; ++i) {
+    if (i->num_elements() == 0)
+      continue;
+    if (result)
+      throw MakeUnsupportedError("multiple random vectors");
+    result = &*i;
+  }
+  return result;
+}
+
+// Expands scenarios into the deterministic equivalent. A core column has
+// the same elements in every scenario, so the position of each element in
+// the deterministic equivalent is known in advance and threads fill
+// disjoint ranges of scenarios without locking.
+class SPAdapter::ScenarioExpander {
+ private:
+  const SPAdapter &sp_;
+  ColProblem &de_;
+  int num_scenarios_;
+  int num_stage1_vars_;
+  int num_stage2_vars_;
+  int num_stage1_cons_;
+  int num_stage2_cons_;
+  int num_elements_;
+
+  // block_starts_[j] is the index of the first element of core column j
+  // in second-stage constraints of the first scenario in the deterministic
+  // equivalent and block_strides_[j] is the distance between such elements
+  // of consecutive scenarios.
+  std::vector<int> block_starts_;
+  std::vector<int> block_strides_;
+
+  // Offsets of elements of sp_.vars_in_nonlinear_ in the blocks of their
+  // columns.
+  std::vector<int> nonlinear_offsets_;
+
+  // Indices of scenarios where parts start.
+  std::vector<int> part_starts_;
+
+  // Coefficients of the core constraint matrix combined with the first
+  // scenario.
+  const double *core_coefs_;
+
+  // The constraint matrix of the deterministic equivalent.
+  int *col_starts_;
+  int *row_indices_;
+  double *coefs_;
+
+  // The minimum number of elements in a part.
+  enum { MIN_PART_SIZE = 1 << 14 };
+
+  void AddVarsAndObj();
+  void ComputeOffsets();
+
+  // Expands scenarios of a part.
+  void ExpandPart(int part);
+
+  // Receives random terms and right-hand sides of a scenario.
+  class ScenarioHandler {
+   private:
+    ScenarioExpander &expander_;
+    int scenario_;
+    int element_index_;  // Index of the next element in vars_in_nonlinear_.
+
+   public:
+    ScenarioHandler(ScenarioExpander &e, int scenario)
+      : expander_(e), scenario_(scenario), element_index_(0) {}
+
+    void OnTerm(int con_index, int var_index, double coef);
+    void OnRHS(int con_index, double offset);
+  };
+
+ public:
+  // Adds variables, constraints and the objective of the deterministic
+  // equivalent to de and computes the layout of its constraint matrix.
+  ScenarioExpander(const SPAdapter &sp, ColProblem &de, int num_scenarios);
+
+  // Returns the number of elements in the constraint matrix of
+  // the deterministic equivalent.
+  int num_elements() const { return num_elements_; }
+
+  // Fills the preallocated constraint matrix of the deterministic
+  // equivalent.
+  void Expand(int *col_starts, int *row_indices, double *coefs,
+              int num_threads);
+};
+
+void SPAdapter::ScenarioExpander::ScenarioHandler::OnTerm(
+    int, int var_index, double coef) {
+  int element_index = element_index_++;
+  assert(expander_.sp_.vars_in_nonlinear_.index(element_index) == var_index);
+  expander_.coefs_[expander_.block_starts_[var_index] +
+      scenario_ * expander_.block_strides_[var_index] +
+      expander_.nonlinear_offsets_[element_index]] = coef;
+}
+
+void SPAdapter::ScenarioExpander::ScenarioHandler::OnRHS(
+    int con_index, double offset) {
+  auto con = expander_.de_.algebraic_con(
+        con_index + scenario_ * expander_.num_stage2_cons_);
+  con.set_lb(con.lb() + offset);
+  con.set_ub(con.ub() + offset);
+}
+
+SPAdapter::ScenarioExpander::ScenarioExpander(
+    const SPAdapter &sp, ColProblem &de, int num_scenarios)
+  : sp_(sp), de_(de), num_scenarios_(num_scenarios),
+    num_stage1_vars_(sp.num_stage_vars_[0]),
+    num_stage2_vars_(sp.num_vars() - num_stage1_vars_),
+    num_stage1_cons_(sp.num_stage_cons_[0]),
+    num_stage2_cons_(sp.num_cons() - num_stage1_cons_), num_elements_(0),
+    // Random terms are only extracted from multistage problems.
+    core_coefs_(sp.num_stages_ > 1 ?
+                  sp.core_coefs_.data() : sp.problem_.values()),
+    col_starts_(0), row_indices_(0), coefs_(0) {
+  AddVarsAndObj();
+  de.AddAlgebraicCons(val(num_stage1_cons_ +
+                          SafeInt<int>(num_stage2_cons_) * num_scenarios));
+  for (int i = 0; i < num_stage1_cons_; ++i) {
+    auto con = sp.con(i);
+    auto de_con = de.algebraic_con(i);
+    de_con.set_lb(con.lb());
+    de_con.set_ub(con.ub());
+  }
+  ComputeOffsets();
+}
+
+void SPAdapter::ScenarioExpander::AddVarsAndObj() {
+  int num_vars = sp_.num_vars();
+  for (int j = 0; j < num_stage1_vars_; ++j) {
+    auto var = sp_.var(j);
+    de_.AddVar(var.lb(), var.ub(), var.type());
+  }
+  for (int s = 0; s < num_scenarios_; ++s) {
+    for (int j = num_stage1_vars_; j < num_vars; ++j) {
+      auto var = sp_.var(j);
+      de_.AddVar(var.lb(), var.ub(), var.type());
+    }
+  }
+  const ColProblem &p = sp_.problem_;
+  if (p.num_objs() == 0)
+    return;
+  // Terms of the objective have been extracted into linear_obj_ and
+  // the nonlinear part is either null, a constant or the original affine
+  // expression which shouldn't be counted twice.
+  NumericExpr constant;
+  NumericExpr nonlinear = sp_.nonlinear_objs_[0];
+  if (nonlinear && nonlinear.kind() == expr::NUMBER)
+    constant = de_.MakeNumericConstant(
+          Cast<NumericConstant>(nonlinear).value());
+  const LinearExpr &linear = sp_.linear_obj_;
+  int num_stage2_terms = 0;
+  for (auto i = linear.begin(), end = linear.end(); i != end; ++i) {
+    if (i->var_index() >= num_stage1_vars_)
+      ++num_stage2_terms;
+  }
+  auto obj = de_.AddObj(p.obj(0).type(), constant,
+                        val(linear.num_terms() - num_stage2_terms +
+                            SafeInt<int>(num_stage2_terms) * num_scenarios_));
+  for (auto i = linear.begin(), end = linear.end(); i != end; ++i) {
+    if (i->var_index() < num_stage1_vars_)
+      obj.AddTerm(i->var_index(), i->coef());
+  }
+  const RandomVector *rv = sp_.GetScenarioRV();
+  for (int s = 0; s < num_scenarios_; ++s) {
+    double probability = rv ? rv->probability(s) : 1;
+    int var_offset = s * num_stage2_vars_;
+    for (auto i = linear.begin(), end = linear.end(); i != end; ++i) {
+      if (i->var_index() >= num_stage1_vars_)
+        obj.AddTerm(i->var_index() + var_offset, probability * i->coef());
+    }
+  }
+}
+
+void SPAdapter::ScenarioExpander::ComputeOffsets() {
+  const ColProblem &p = sp_.problem_;
+  int num_vars = sp_.num_vars();
+  // Count elements of core columns in first- and second-stage constraints
+  // temporarily storing them in block_starts_ and block_strides_.
+  block_starts_.resize(num_vars);
+  block_strides_.resize(num_vars);
+  for (int j = 0; j < num_vars; ++j) {
+    int orig_var_index = sp_.var_core2orig_[j];
+    for (int k = p.col_start(orig_var_index),
+         end = p.col_start(orig_var_index + 1); k != end; ++k) {
+      if (sp_.con_orig2core_[p.row_index(k)] < num_stage1_cons_)
+        ++block_starts_[j];
+      else
+        ++block_strides_[j];
+    }
+  }
+  // First-stage columns contain elements of all scenarios and are followed
+  // by second-stage columns of the first scenario, second scenario, etc.
+  SafeInt<int> start = 0;
+  for (int j = 0; j < num_stage1_vars_; ++j) {
+    start = start + block_starts_[j];
+    block_starts_[j] = val(start);
+    start = start + SafeInt<int>(block_strides_[j]) * num_scenarios_;
+  }
+  int num_stage2_elements = 0;
+  for (int j = num_stage1_vars_; j < num_vars; ++j) {
+    assert(block_starts_[j] == 0);
+    block_starts_[j] = val(start + num_stage2_elements);
+    num_stage2_elements += block_strides_[j];
+  }
+  for (int j = num_stage1_vars_; j < num_vars; ++j)
+    block_strides_[j] = num_stage2_elements;
+  num_elements_ =
+      val(start + SafeInt<int>(num_stage2_elements) * num_scenarios_);
+
+  // Find offsets of elements that are replaced in every scenario.
+  // Second-stage constraints are visited in order, so the position of
+  // the current element in each column only moves forward.
+  if (sp_.num_stages_ == 1)
+    return;
+  const SparseMatrix<double> &vars_in_nonlinear = sp_.vars_in_nonlinear_;
+  nonlinear_offsets_.resize(vars_in_nonlinear.num_elements());
+  std::vector<int> col_positions(num_vars), offsets(num_vars);
+  for (int j = 0; j < num_vars; ++j)
+    col_positions[j] = p.col_start(sp_.var_core2orig_[j]);
+  for (int stage2_con = 0; stage2_con < num_stage2_cons_; ++stage2_con) {
+    int con_index = sp_.con_core2orig_[stage2_con + num_stage1_cons_];
+    for (int i = vars_in_nonlinear.start(stage2_con),
+         n = vars_in_nonlinear.start(stage2_con + 1); i < n; ++i) {
+      int core_var_index = vars_in_nonlinear.index(i);
+      int &elt_index = col_positions[core_var_index];
+      int &offset = offsets[core_var_index];
+      for (; p.row_index(elt_index) != con_index; ++elt_index) {
+        if (sp_.con_orig2core_[p.row_index(elt_index)] >= num_stage1_cons_)
+          ++offset;
+      }
+      nonlinear_offsets_[i] = offset;
+    }
+  }
+}
+
+void SPAdapter::ScenarioExpander::ExpandPart(int part) {
+  const ColProblem &p = sp_.problem_;
+  int num_vars = sp_.num_vars();
+  for (int s = part_starts_[part], end = part_starts_[part + 1];
+       s < end; ++s) {
+    int var_offset = s * num_stage2_vars_;
+    for (int j = num_stage1_vars_; j < num_vars; ++j)
+      col_starts_[j + var_offset] = block_starts_[j] + s * block_strides_[j];
+    // Copy second-stage elements of core columns combined with the first
+    // scenario. Elements containing random variables are replaced below.
+    int con_offset = s * num_stage2_cons_;
+    for (int j = 0; j < num_vars; ++j) {
+      int orig_var_index = sp_.var_core2orig_[j];
+      int index = block_starts_[j] + s * block_strides_[j];
+      for (int k = p.col_start(orig_var_index),
+           n = p.col_start(orig_var_index + 1); k != n; ++k) {
+        int con_index = sp_.con_orig2core_[p.row_index(k)];
+        if (con_index < num_stage1_cons_)
+          continue;
+        row_indices_[index] = con_index + con_offset;
+        coefs_[index++] = core_coefs_[k];
+      }
+    }
+    for (int i = num_stage1_cons_, n = sp_.num_cons(); i < n; ++i) {
+      auto con = sp_.con(i);
+      auto de_con = de_.algebraic_con(i + con_offset);
+      de_con.set_lb(con.lb());
+      de_con.set_ub(con.ub());
+    }
+    if (sp_.num_stages_ > 1) {
+      ScenarioHandler handler(*this, s);
+      sp_.GetScenario(s, handler);
+    }
+  }
+}
+
+void SPAdapter::ScenarioExpander::Expand(
+    int *col_starts, int *row_indices, double *coefs, int num_threads) {
+  col_starts_ = col_starts;
+  row_indices_ = row_indices;
+  coefs_ = coefs;
+  const ColProblem &p = sp_.problem_;
+  // Copy first-stage columns in first-stage constraints.
+  for (int j = 0; j < num_stage1_vars_; ++j) {
+    int orig_var_index = sp_.var_core2orig_[j];
+    int start = p.col_start(orig_var_index);
+    int end = p.col_start(orig_var_index + 1);
+    int index = col_starts_[j] =
+        block_starts_[j] - (end - start - block_strides_[j]);
+    for (int k = start; k != end; ++k) {
+      int con_index = sp_.con_orig2core_[p.row_index(k)];
+      if (con_index >= num_stage1_cons_)
+        continue;
+      row_indices_[index] = con_index;
+      coefs_[index++] = core_coefs_[k];
+    }
+  }
+  col_starts_[num_stage1_vars_ + num_stage2_vars_ * num_scenarios_] =
+      num_elements_;
+
+  int num_parts = 1;
+#ifdef MP_USE_THREAD
+  if (num_threads <= 0)
+    num_threads = static_cast<int>(std::thread::hardware_concurrency());
+  num_parts = std::min(num_threads, num_elements_ / MIN_PART_SIZE);
+  num_parts = std::max(std::min(num_parts, num_scenarios_), 1);
+#else
+  internal::Unused(num_threads);
+#endif
+  part_starts_.resize(num_parts + 1);
+  for (int i = 0; i <= num_parts; ++i) {
+    part_starts_[i] = static_cast<int>(
+          static_cast<long long>(num_scenarios_) * i / num_parts);
+  }
+  internal::RunInParallel(
+        num_parts, std::bind(&ScenarioExpander::ExpandPart, this,
+                             std::placeholders::_1));
+}
+
+void SPAdapter::BuildDeterministicEquivalent(
+    ColProblem &de, int num_threads) const {
+  MP_ASSERT(de.num_vars() == 0 && de.num_algebraic_cons() == 0,
+            "problem is not empty");
+  if (num_stages_ > 2)
+    throw MakeUnsupportedError("more than two stages");
+  // Constraint bounds are set on multiple threads, which is only safe if
+  // they are not appended to the change journal.
+  ChangeRecordingPause pause(de);
+  const RandomVector *rv = GetScenarioRV();
+  int num_scenarios = rv ? rv->num_realizations() : 1;
+  ScenarioExpander expander(*this, de, num_scenarios);
+  de.col_starts_.resize(de.num_vars() + 1);
+  de.row_indices_.resize(expander.num_elements());
+  de.coefs_.resize(expander.num_elements());
+  expander.Expand(de.col_starts_.data(), de.row_indices_.data(),
+                  de.coefs_.data(), num_threads);
+}
 }  // namespace mp
@@ -64,14 +64,28 @@ class SparseMatrix {
 
   T value(int element_index) const { return values_[element_index]; }
   T &value(int element_index) { return values_[element_index]; }
+
+  const int *starts() const { return starts_.data(); }
+  int *starts() { return starts_.data(); }
+  const int *indices() const { return indices_.data(); }
+  int *indices() { return indices_.data(); }
+  const T *values() const { return values_.data(); }
+  T *values() { return values_.data(); }
 };
 
 namespace internal {
 
 class AffineExprExtractor;
 
-void Transpose(SparseMatrix<double> &m, SparseMatrix<double*> &transposed,
-               int major_size);
+// Transposes a sparse matrix *m* into *transposed*. *major_size* is the
+// major size of the transposed matrix, i.e. the minor size of *m*.
+// Elements of each transposed vector are ordered by their major index in *m*,
+// so the result doesn't depend on *num_threads*. If *num_threads* is zero
+// or negative, the number of hardware threads is used. This function is
+// instantiated for double and int values.
+template <typename T>
+void Transpose(const SparseMatrix<T> &m, SparseMatrix<T> &transposed,
+               int major_size, int num_threads = 0);
 }
 
 // Adapts ColProblem to stochastic programming problem API.
@@ -186,6 +200,13 @@ class SPAdapter {
 
   void ExtractRandomTerms();
 
+  // Returns the random vector whose realizations define scenarios or null
+  // if there are no random variables.
+  const RandomVector *GetScenarioRV() const;
+
+  // Expands scenarios into a deterministic equivalent.
+  class ScenarioExpander;
+
  public:
   SPAdapter(const ColProblem &p);
 
@@ -351,6 +372,17 @@ class SPAdapter {
   template <typename ScenarioHandler>
   void GetScenario(int scenario_index, ScenarioHandler &handler) const;
 
+  // Builds the extensive form of the deterministic equivalent of a two-stage
+  // problem in *de* which should be empty. First-stage variables and
+  // constraints are followed by a copy of second-stage variables and
+  // constraints per scenario and the expectation in the first objective is
+  // replaced with a sum of scenario objectives weighted by probabilities.
+  // The constraint matrix is allocated once and its scenario blocks are
+  // filled on *num_threads* threads. If *num_threads* is zero or negative,
+  // the number of hardware threads is used. Change recording is disabled
+  // in *de* while it is built, so the build is not in its change journal.
+  void BuildDeterministicEquivalent(ColProblem &de, int num_threads = 0) const;
+
   class RandomVar {
    private:
     const SPAdapter *sp_;
@@ -0,0 +1,105 @@
+/*
+ Arena tests.
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <gtest/gtest.h>
+#include "mp/arena.h"
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using mp::Arena;
+using mp::ArenaAllocator;
+
+namespace {
+
+bool IsAligned(const void *ptr, std::size_t alignment) {
+  return reinterpret_cast<std::size_t>(ptr) % alignment == 0;
+}
+
+TEST(ArenaTest, Allocate) {
+  Arena arena;
+  EXPECT_EQ(0u, arena.num_chunks());
+  char *p1 = static_cast<char*>(arena.Allocate(1));
+  char *p2 = static_cast<char*>(arena.Allocate(10));
+  char *p3 = static_cast<char*>(arena.Allocate(8));
+  EXPECT_EQ(1u, arena.num_chunks());
+  EXPECT_TRUE(IsAligned(p1, Arena::CACHE_LINE_SIZE));
+  EXPECT_EQ(p1 + Arena::ALIGNMENT, p2);
+  EXPECT_EQ(p2 + 2 * Arena::ALIGNMENT, p3);
+  std::memset(p1, 0, 1);
+  std::memset(p2, 0, 10);
+  std::memset(p3, 0, 8);
+}
+
+TEST(ArenaTest, AllocateChunks) {
+  Arena arena(64);
+  for (int i = 0; i < 8; ++i) {
+    void *p = arena.Allocate(Arena::ALIGNMENT);
+    EXPECT_TRUE(IsAligned(p, Arena::ALIGNMENT));
+  }
+  EXPECT_EQ(8 * Arena::ALIGNMENT / 64, arena.num_chunks());
+  arena.Release();
+  EXPECT_EQ(0u, arena.num_chunks());
+  arena.Allocate(1);
+  EXPECT_EQ(1u, arena.num_chunks());
+}
+
+TEST(ArenaTest, AllocateLarge) {
+  Arena arena(1024);
+  char *small = static_cast<char*>(arena.Allocate(8));
+  char *large = static_cast<char*>(arena.Allocate(4096));
+  std::memset(large, 0, 4096);
+  EXPECT_EQ(2u, arena.num_chunks());
+  EXPECT_TRUE(IsAligned(large, Arena::CACHE_LINE_SIZE));
+  // The free memory in the current chunk is still used after allocating
+  // a large object.
+  EXPECT_EQ(small + 8, arena.Allocate(8));
+  EXPECT_EQ(2u, arena.num_chunks());
+}
+
+TEST(ArenaAllocatorTest, Allocate) {
+  Arena arena;
+  ArenaAllocator<int> alloc(&arena);
+  EXPECT_EQ(&arena, alloc.arena());
+  int *p = alloc.allocate(3);
+  p[2] = 42;
+  alloc.deallocate(p, 3);
+  ArenaAllocator<double> other(alloc);
+  EXPECT_TRUE(other == alloc);
+  Arena arena2;
+  EXPECT_TRUE(ArenaAllocator<int>(&arena2) != alloc);
+}
+
+TEST(ArenaAllocatorTest, Vector) {
+  Arena arena;
+  std::vector< int, ArenaAllocator<int> > v((ArenaAllocator<int>(&arena)));
+  for (int i = 0; i < 1000; ++i)
+    v.push_back(i);
+  EXPECT_EQ(999, v.back());
+  EXPECT_GE(arena.num_chunks(), 1u);
+}
+
+TEST(ArenaAllocatorTest, HasBulkDeallocation) {
+  using mp::internal::HasBulkDeallocation;
+  EXPECT_FALSE(HasBulkDeallocation< std::allocator<char> >::value);
+  EXPECT_TRUE(HasBulkDeallocation< ArenaAllocator<> >::value);
+}
+}  // namespace
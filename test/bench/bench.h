@@ -0,0 +1,86 @@
+/*
+ Benchmark utilities
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+
+#ifndef MP_BENCH_H_
+#define MP_BENCH_H_
+
+#include <string>
+#include <vector>
+
+#include "mp/clock.h"
+#include "mp/format.h"
+#include "../util.h"
+
+#ifndef MP_TEST_DATA_DIR
+# define MP_TEST_DATA_DIR "../data"
+#endif
+
+namespace bench {
+
+// Minimum duration of a measurement in seconds.
+const double MIN_TIME = 0.2;
+
+// Calls f repeatedly for at least MIN_TIME seconds and returns the average
+// time of a call in seconds.
+template <typename F>
+double Measure(F f) {
+  typedef mp::steady_clock clock;
+  clock::time_point start = clock::now();
+  double time = 0;
+  int num_calls = 0;
+  do {
+    f();
+    ++num_calls;
+    time = mp::duration_cast< mp::duration<double> >(
+          clock::now() - start).count();
+  } while (time < MIN_TIME);
+  return time / num_calls;
+}
+
+// Prints the throughput of processing num_bytes in the specified time.
+inline void PrintThroughput(fmt::StringRef name, std::size_t num_bytes,
+                            double time) {
+  fmt::print("{:<40} {:10.2f} MB/s\n", name, num_bytes / time / 1e6);
+}
+
+// Prints the number of items processed per second in millions.
+inline void PrintRate(fmt::StringRef name, double num_items, double time,
+                      fmt::StringRef units) {
+  fmt::print("{:<40} {:10.2f} M{}/s\n", name, num_items / time / 1e6, units);
+}
+
+// Returns the names of files passed on the command line or the .nl files
+// in the test data directory if there are no command-line arguments.
+inline std::vector<std::string> GetNLFiles(int argc, char **argv) {
+  std::vector<std::string> files(argv + 1, argv + argc);
+  if (!files.empty())
+    return files;
+  const char *names[] = {
+    "element", "feasible", "infeasible", "noobj", "numberof", "simple",
+    "ssd", "suffix", "test", "unbounded"
+  };
+  for (std::size_t i = 0; i < sizeof(names) / sizeof(*names); ++i)
+    files.push_back(fmt::format("{}/{}.nl", MP_TEST_DATA_DIR, names[i]));
+  return files;
+}
+}  // namespace bench
+
+#endif  // MP_BENCH_H_
@@ -0,0 +1,145 @@
+/*
+ Reverse-mode automatic differentiation benchmark
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <cmath>
+
+#include "bench.h"
+#include "mp/expr-ad.h"
+#include "mp/problem.h"
+
+namespace {
+
+enum {
+  NUM_VARS = 1000,
+  NUM_COMMON_EXPRS = 100,
+  NUM_CONS = 500
+};
+
+namespace expr = mp::expr;
+
+// Builds a problem whose constraints are of the form
+//   sum(x[j] * sin(x[j + 1]) for j in J(i)) + exp(e[i % NUM_COMMON_EXPRS])
+// where e[k] = sum(x[k + j] ^ 2 for j = 0..9) is a common expression.
+void BuildProblem(mp::Problem &p) {
+  p.AddVars(NUM_VARS, mp::var::CONTINUOUS);
+  const int num_terms = 10;
+  for (int k = 0; k < NUM_COMMON_EXPRS; ++k) {
+    mp::Problem::IteratedExprBuilder sum = p.BeginSum(num_terms);
+    for (int j = 0; j < num_terms; ++j)
+      sum.AddArg(p.MakeUnary(expr::POW2, p.MakeVariable(k + j)));
+    p.AddCommonExpr(p.EndSum(sum));
+  }
+  for (int i = 0; i < NUM_CONS; ++i) {
+    mp::Problem::IteratedExprBuilder sum = p.BeginSum(num_terms + 1);
+    for (int j = 0; j < num_terms; ++j) {
+      int var = (i * num_terms + j) % (NUM_VARS - 1);
+      sum.AddArg(p.MakeBinary(
+            expr::MUL, p.MakeVariable(var),
+            p.MakeUnary(expr::SIN, p.MakeVariable(var + 1))));
+    }
+    sum.AddArg(p.MakeUnary(
+          expr::EXP, p.MakeCommonExpr(i % NUM_COMMON_EXPRS)));
+    p.AddCon(-1, 1).set_nonlinear_expr(p.EndSum(sum));
+  }
+}
+}  // namespace
+
+int main() {
+  mp::Problem p;
+  BuildProblem(p);
+  mp::ExprTape tape;
+  mp::CompileProblem(p, tape);
+  std::vector<double> x(NUM_VARS);
+  for (int i = 0; i < NUM_VARS; ++i)
+    x[i] = std::sin(i * 0.01);
+  std::vector<double> results(NUM_CONS);
+  double time = bench::Measure([&]() {
+    tape.Evaluate(x.data(), results.data());
+  });
+  bench::PrintRate("ExprTape::Evaluate", NUM_CONS, time, "cons");
+  mp::ReverseAD *ad = 0;
+  time = bench::Measure([&]() {
+    delete ad;
+    ad = new mp::ReverseAD(tape);
+  });
+  bench::PrintRate("ReverseAD::ReverseAD", tape.num_instructions(), time,
+                   "instrs");
+  std::vector<double> jac(ad->num_jac_nonzeros());
+  time = bench::Measure([&]() {
+    // Change the point to prevent reuse of the tape values.
+    x[0] += 1e-9;
+    ad->Jacobian(x.data(), jac.data(), results.data());
+  });
+  bench::PrintRate("ReverseAD::Jacobian", NUM_CONS, time, "cons");
+  bench::PrintRate("ReverseAD::Jacobian", jac.size(), time, "nonzeros");
+  double jac_time = time;
+  std::vector<double> grad(NUM_VARS);
+  time = bench::Measure([&]() {
+    for (int i = 0; i < NUM_CONS; ++i)
+      ad->Gradient(i, x.data(), grad.data());
+  });
+  bench::PrintRate("ReverseAD::Gradient", NUM_CONS, time, "cons");
+  delete ad;
+  // Baseline: dense Jacobian by forward differences.
+  std::vector<double> dense_jac(NUM_VARS * NUM_CONS);
+  time = bench::Measure([&]() {
+    const double h = 1e-7;
+    for (int j = 0; j < NUM_VARS; ++j) {
+      double saved = x[j];
+      x[j] += h;
+      tape.Evaluate(x.data(), &dense_jac[j * NUM_CONS]);
+      x[j] = saved;
+    }
+  });
+  bench::PrintRate("Forward differences", NUM_CONS, time, "cons");
+  fmt::print("{:<40} {:10.2f}x\n", "Jacobian speedup", time / jac_time);
+
+  mp::LagrangianHessian *hes = 0;
+  time = bench::Measure([&]() {
+    delete hes;
+    hes = new mp::LagrangianHessian(tape);
+  });
+  bench::PrintRate("LagrangianHessian::LagrangianHessian",
+                   tape.num_instructions(), time, "instrs");
+  fmt::print("{:<40} {:10}\n", "Hessian nonzeros", hes->num_hes_nonzeros());
+  fmt::print("{:<40} {:10}\n", "Colors", hes->num_colors());
+  std::vector<double> w(NUM_CONS, 1), hes_values(hes->num_hes_nonzeros());
+  time = bench::Measure([&]() {
+    w[0] += 1e-9;
+    hes->Compute(x.data(), w.data(), hes_values.data());
+  });
+  bench::PrintRate("LagrangianHessian::Compute", hes_values.size(), time,
+                   "nonzeros");
+  double hes_time = time;
+  // Baseline: dense Hessian by one Hessian-vector product per column.
+  std::vector<double> v(NUM_VARS), hv(NUM_VARS);
+  time = bench::Measure([&]() {
+    w[0] += 1e-9;
+    for (int j = 0; j < NUM_VARS; ++j) {
+      v[j] = 1;
+      hes->MultiplyVector(x.data(), w.data(), v.data(), hv.data());
+      v[j] = 0;
+    }
+  });
+  bench::PrintRate("Hessian by columns", hes_values.size(), time,
+                   "nonzeros");
+  fmt::print("{:<40} {:10.2f}x\n", "Hessian speedup", time / hes_time);
+  delete hes;
+}
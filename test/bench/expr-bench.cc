@@ -0,0 +1,60 @@
+/*
+ Expression factory benchmark
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include "bench.h"
+#include "mp/expr.h"
+
+namespace {
+
+enum {
+  NUM_VARS = 100,
+  NUM_TERMS = 100000
+};
+
+// Builds sum(x[i] * (x[i + 1] + c)) with NUM_TERMS terms and destroys it
+// together with the factory. Returns the number of expression nodes.
+template <typename Factory>
+int BuildSum(Factory &f) {
+  typename Factory::IteratedExprBuilder sum = f.BeginSum(NUM_TERMS);
+  for (int i = 0; i < NUM_TERMS; ++i) {
+    mp::NumericExpr x = f.MakeVariable(i % NUM_VARS);
+    mp::NumericExpr y = f.MakeVariable((i + 1) % NUM_VARS);
+    mp::NumericExpr c = f.MakeNumericConstant(i);
+    sum.AddArg(f.MakeBinary(mp::expr::MUL, x,
+                            f.MakeBinary(mp::expr::ADD, y, c)));
+  }
+  f.EndSum(sum);
+  return 5 * NUM_TERMS + 1;
+}
+}  // namespace
+
+int main() {
+  int num_nodes = 0;
+  double time = bench::Measure([&]() {
+    mp::ExprFactory f;
+    num_nodes = BuildSum(f);
+  });
+  bench::PrintRate("ExprFactory", num_nodes, time, "nodes");
+  time = bench::Measure([&]() {
+    mp::ArenaExprFactory f;
+    num_nodes = BuildSum(f);
+  });
+  bench::PrintRate("ArenaExprFactory", num_nodes, time, "nodes");
+}
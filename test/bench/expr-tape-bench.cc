@@ -0,0 +1,139 @@
+/*
+ Expression tape benchmark
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <cmath>
+
+#include "bench.h"
+#include "mp/expr-tape.h"
+#include "mp/problem.h"
+
+namespace {
+
+enum {
+  NUM_VARS = 1000,
+  NUM_COMMON_EXPRS = 100,
+  NUM_CONS = 500,
+  NUM_POINTS = 64
+};
+
+namespace expr = mp::expr;
+
+// Builds a problem whose constraints are of the form
+//   sum(x[j] * sin(x[j + 1]) for j in J(i)) + exp(e[i % NUM_COMMON_EXPRS])
+// where e[k] = x[k] ^ 2 + cos(x[k + 1]) is a common expression.
+void BuildProblem(mp::Problem &p) {
+  p.AddVars(NUM_VARS, mp::var::CONTINUOUS);
+  for (int k = 0; k < NUM_COMMON_EXPRS; ++k) {
+    p.AddCommonExpr(p.MakeBinary(
+          expr::ADD, p.MakeUnary(expr::POW2, p.MakeVariable(k)),
+          p.MakeUnary(expr::COS, p.MakeVariable(k + 1))));
+  }
+  const int num_terms = 10;
+  for (int i = 0; i < NUM_CONS; ++i) {
+    mp::Problem::IteratedExprBuilder sum = p.BeginSum(num_terms + 1);
+    for (int j = 0; j < num_terms; ++j) {
+      int var = (i * num_terms + j) % (NUM_VARS - 1);
+      sum.AddArg(p.MakeBinary(
+            expr::MUL, p.MakeVariable(var),
+            p.MakeUnary(expr::SIN, p.MakeVariable(var + 1))));
+    }
+    sum.AddArg(p.MakeUnary(
+          expr::EXP, p.MakeCommonExpr(i % NUM_COMMON_EXPRS)));
+    p.AddCon(-1, 1).set_nonlinear_expr(p.EndSum(sum));
+  }
+}
+
+// A straightforward recursive evaluator used as a baseline.
+class NaiveEvaluator : public mp::ExprVisitor<NaiveEvaluator, double> {
+ private:
+  const mp::Problem &problem_;
+  const double *x_;
+
+ public:
+  NaiveEvaluator(const mp::Problem &p, const double *x)
+    : problem_(p), x_(x) {}
+
+  double VisitNumericConstant(mp::NumericConstant c) { return c.value(); }
+  double VisitVariable(mp::Reference v) { return x_[v.index()]; }
+
+  double VisitCommonExpr(mp::Reference e) {
+    return Visit(problem_.common_expr(e.index()).nonlinear_expr());
+  }
+
+  double VisitAdd(mp::BinaryExpr e) {
+    return Visit(e.lhs()) + Visit(e.rhs());
+  }
+  double VisitMul(mp::BinaryExpr e) {
+    return Visit(e.lhs()) * Visit(e.rhs());
+  }
+
+  double VisitPow2(mp::UnaryExpr e) {
+    double arg = Visit(e.arg());
+    return arg * arg;
+  }
+  double VisitSin(mp::UnaryExpr e) { return std::sin(Visit(e.arg())); }
+  double VisitCos(mp::UnaryExpr e) { return std::cos(Visit(e.arg())); }
+  double VisitExp(mp::UnaryExpr e) { return std::exp(Visit(e.arg())); }
+
+  double VisitSum(mp::IteratedExpr e) {
+    double sum = 0;
+    for (mp::IteratedExpr::iterator i = e.begin(), end = e.end();
+         i != end; ++i) {
+      sum += Visit(*i);
+    }
+    return sum;
+  }
+};
+}  // namespace
+
+int main() {
+  mp::Problem p;
+  BuildProblem(p);
+  std::vector<double> points(NUM_VARS * NUM_POINTS);
+  for (std::size_t i = 0; i < points.size(); ++i)
+    points[i] = std::sin(i * 0.01);
+  std::vector<double> results(NUM_CONS * NUM_POINTS);
+  double time = bench::Measure([&]() {
+    for (int k = 0; k < NUM_POINTS; ++k) {
+      NaiveEvaluator eval(p, &points[k * NUM_VARS]);
+      for (int i = 0; i < NUM_CONS; ++i) {
+        results[k * NUM_CONS + i] =
+            eval.Visit(p.algebraic_con(i).nonlinear_expr());
+      }
+    }
+  });
+  bench::PrintRate("ExprVisitor", NUM_POINTS * NUM_CONS, time, "cons");
+  mp::ExprTape tape;
+  time = bench::Measure([&]() {
+    tape = mp::ExprTape();
+    mp::CompileProblem(p, tape);
+  });
+  bench::PrintRate("Compile", tape.num_instructions(), time, "instrs");
+  time = bench::Measure([&]() {
+    for (int k = 0; k < NUM_POINTS; ++k)
+      tape.Evaluate(&points[k * NUM_VARS], &results[k * NUM_CONS]);
+  });
+  bench::PrintRate("ExprTape::Evaluate", NUM_POINTS * NUM_CONS, time, "cons");
+  time = bench::Measure([&]() {
+    tape.EvaluateBatch(points.data(), NUM_POINTS, NUM_VARS, results.data());
+  });
+  bench::PrintRate("ExprTape::EvaluateBatch", NUM_POINTS * NUM_CONS, time,
+                   "cons");
+}
@@ -0,0 +1,56 @@
+/*
+ Floating-point formatting benchmark
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "bench.h"
+#include "mp/format.h"
+
+namespace {
+
+enum { NUM_VALUES = 1000000 };
+
+// Measures the time of formatting values and prints the throughput.
+double Measure(fmt::StringRef name, fmt::CStringRef format,
+               const std::vector<double> &values) {
+  fmt::MemoryWriter w;
+  double time = bench::Measure([&]() {
+    w.clear();
+    for (std::size_t i = 0, n = values.size(); i < n; ++i) {
+      w.write(format, values[i]);
+      w << '\n';
+    }
+  });
+  bench::PrintThroughput(name, w.size(), time);
+  return time;
+}
+}  // namespace
+
+int main() {
+  std::vector<double> values(NUM_VALUES);
+  for (int i = 0; i < NUM_VALUES; ++i)
+    values[i] = std::sin(i) * std::pow(10.0, i % 20 - 10);
+  double exact_time = Measure("{:.17g} (snprintf)", "{:.17g}", values);
+  Measure("{:g} (snprintf, 6 digits)", "{:g}", values);
+  double shortest_time = Measure("{} (shortest)", "{}", values);
+  fmt::print("{:<40} {:10.2f}x\n", "speedup over {:.17g}",
+             exact_time / shortest_time);
+}
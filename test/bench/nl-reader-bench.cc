@@ -0,0 +1,127 @@
+/*
+ .nl reader benchmark
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "mp/nl-reader.h"
+
+#ifndef _WIN32
+# include <fcntl.h>
+#endif
+
+namespace {
+
+// Extracts whitespace-separated tokens that are numbers from .nl input.
+std::string ExtractNumbers(const std::string &data) {
+  std::string numbers;
+  std::size_t pos = 0, size = data.size();
+  while (pos < size) {
+    std::size_t end = data.find_first_of(" \t\r\n", pos);
+    if (end == std::string::npos)
+      end = size;
+    std::string token = data.substr(pos, end - pos);
+    char *token_end = 0;
+    std::strtod(token.c_str(), &token_end);
+    if (!token.empty() && token_end == token.c_str() + token.size())
+      numbers.append(token).append(" ");
+    pos = end + 1;
+  }
+  return numbers;
+}
+
+// Parses space-separated numbers with strtod.
+double ParseWithStrtod(const std::string &numbers) {
+  double sum = 0;
+  mp::internal::Locale locale;
+  for (const char *ptr = numbers.c_str(); *ptr; ++ptr)
+    sum += locale.strtod(ptr);
+  return sum;
+}
+
+// Parses space-separated numbers with TextReader.
+double ParseWithTextReader(const std::string &numbers) {
+  double sum = 0;
+  mp::internal::TextReader<> reader(numbers, "(input)");
+  for (const char *end = numbers.c_str() + numbers.size();
+       reader.ptr() != end; reader.ReadChar()) {
+    sum += reader.ReadDouble();
+  }
+  return sum;
+}
+
+// Evicts the file from the page cache so that the next read is cold.
+void DropFromCache(const std::string &filename) {
+#if !defined(_WIN32) && defined(POSIX_FADV_DONTNEED)
+  fmt::File file(filename, fmt::File::RDONLY);
+  posix_fadvise(file.descriptor(), 0, 0, POSIX_FADV_DONTNEED);
+#else
+  mp::internal::Unused(&filename);
+#endif
+}
+
+// Reads a file with the specified map hints starting from a cold cache
+// and prints the time and page fault counts.
+void MeasureColdRead(const std::string &filename, int hints,
+                     fmt::StringRef name) {
+  DropFromCache(filename);
+  mp::NullNLHandler<int> handler;
+  mp::internal::NLFileReader<> reader;
+  reader.set_map_hints(hints);
+  mp::steady_clock::time_point start = mp::steady_clock::now();
+  reader.Read(filename, handler, 0);
+  double time = mp::GetTimeAndReset(start);
+  const mp::MappedFileStats &stats = reader.stats();
+  fmt::print("{:<40} {:10.3f} ms {:8} minor {:8} major faults\n",
+             name, time * 1e3, stats.num_minor_faults,
+             stats.num_major_faults);
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::vector<std::string> files = bench::GetNLFiles(argc, argv);
+  std::string numbers;
+  for (std::size_t i = 0, n = files.size(); i < n; ++i) {
+    std::string data = ReadFile(files[i]);
+    numbers += ExtractNumbers(data);
+    mp::NullNLHandler<int> handler;
+    double time = bench::Measure([&]() { mp::ReadNLString(data, handler); });
+    bench::PrintThroughput(files[i], data.size(), time);
+  }
+  for (std::size_t i = 0, n = files.size(); i < n; ++i) {
+    namespace hint = mp::map_hint;
+    const std::string &f = files[i];
+    MeasureColdRead(f, 0, fmt::format("{} (cold)", f));
+    MeasureColdRead(f, hint::SEQUENTIAL, fmt::format("{} (sequential)", f));
+    MeasureColdRead(f, hint::SEQUENTIAL | hint::PREFETCH,
+                    fmt::format("{} (prefetch)", f));
+    MeasureColdRead(f, hint::POPULATE, fmt::format("{} (populate)", f));
+  }
+  // Make the number of bytes large enough to amortize the loop overhead.
+  while (numbers.size() < 100000)
+    numbers += numbers;
+  volatile double sum = 0;
+  double time = bench::Measure([&]() { sum = ParseWithStrtod(numbers); });
+  bench::PrintThroughput("numbers (strtod)", numbers.size(), time);
+  time = bench::Measure([&]() { sum = ParseWithTextReader(numbers); });
+  bench::PrintThroughput("numbers (TextReader)", numbers.size(), time);
+}
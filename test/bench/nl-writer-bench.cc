@@ -0,0 +1,85 @@
+/*
+ .nl writer benchmark
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "mp/nl-writer.h"
+#include "mp/problem.h"
+
+namespace {
+
+enum {
+  NUM_VARS = 100000,
+  NUM_CONS = 100000,
+  NUM_TERMS = 10
+};
+
+namespace expr = mp::expr;
+
+// Builds a problem with sparse linear constraints half of which have
+// nonlinear parts of the form x[i] * sin(x[i + 1]).
+void BuildProblem(mp::Problem &p) {
+  p.AddVars(NUM_VARS, mp::var::CONTINUOUS);
+  for (int j = 0; j < NUM_VARS; ++j) {
+    p.var(j).set_lb(-j);
+    p.var(j).set_ub(std::sqrt(j + 1.0));
+  }
+  for (int i = 0; i < NUM_CONS; ++i) {
+    mp::Problem::MutAlgebraicCon con = p.AddCon(-1, 1.0 / (i + 1));
+    mp::Problem::LinearConBuilder linear = con.set_linear_expr(NUM_TERMS);
+    for (int j = 0; j < NUM_TERMS; ++j)
+      linear.AddTerm((i * NUM_TERMS + j) % NUM_VARS, std::sin(i + j));
+    if (i % 2 != 0)
+      continue;
+    int var = i % (NUM_VARS - 1);
+    con.set_nonlinear_expr(p.MakeBinary(
+          expr::MUL, p.MakeVariable(var),
+          p.MakeUnary(expr::SIN, p.MakeVariable(var + 1))));
+  }
+  p.AddObj(mp::obj::MIN, p.MakeUnary(expr::EXP, p.MakeVariable(0)), 1)
+      .AddTerm(1, 2);
+}
+
+// Measures the time of writing a problem and prints the throughput.
+void Measure(fmt::StringRef name, const mp::Problem &p,
+             mp::NLHeader::Format format, int num_threads) {
+  mp::NLWriter<mp::Problem> writer(p, num_threads);
+  double time = bench::Measure([&]() { writer.Write("bench.nl", format); });
+  bench::PrintThroughput(name, ReadFile("bench.nl").size(), time);
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::vector<std::string> files = bench::GetNLFiles(argc, argv);
+  for (std::size_t i = 0, n = files.size(); i < n; ++i) {
+    mp::Problem p;
+    mp::ReadNLFile(files[i], p);
+    Measure(files[i], p, mp::NLHeader::TEXT, 0);
+  }
+  mp::Problem p;
+  BuildProblem(p);
+  Measure("text (1 thread)", p, mp::NLHeader::TEXT, 1);
+  Measure("text", p, mp::NLHeader::TEXT, 0);
+  Measure("binary (1 thread)", p, mp::NLHeader::BINARY, 1);
+  Measure("binary", p, mp::NLHeader::BINARY, 0);
+}
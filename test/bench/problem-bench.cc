@@ -0,0 +1,157 @@
+/*
+ Incremental problem modification benchmark
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "bench.h"
+#include "mp/nl-writer.h"
+#include "mp/problem.h"
+
+namespace {
+
+enum {
+  NUM_VARS = 100000,
+  NUM_CONS = 100000,
+  NUM_TERMS = 10,
+  NUM_CHANGES = 100
+};
+
+// Builds a linear problem with sparse constraints.
+void BuildProblem(mp::Problem &p) {
+  p.AddVars(NUM_VARS, mp::var::CONTINUOUS);
+  for (int j = 0; j < NUM_VARS; ++j)
+    p.var(j).set_ub(j + 1);
+  for (int i = 0; i < NUM_CONS; ++i) {
+    mp::Problem::LinearConBuilder linear =
+        p.AddCon(-1, i + 1).set_linear_expr(NUM_TERMS);
+    for (int j = 0; j < NUM_TERMS; ++j)
+      linear.AddTerm((i * NUM_TERMS + j) % NUM_VARS, std::sin(i + j));
+  }
+  mp::Problem::LinearObjBuilder obj = p.AddObj(mp::obj::MIN, NUM_VARS);
+  for (int j = 0; j < NUM_VARS; ++j)
+    obj.AddTerm(j, 1);
+}
+
+// A warm solver model that holds the problem data in the form a typical
+// LP solver does: bounds, objective and the constraint matrix in CSC format.
+class SolverModel {
+ private:
+  std::vector<double> var_lb_, var_ub_, con_lb_, con_ub_, obj_;
+  mp::CSCMatrix matrix_;
+  std::vector<double> coefs_;
+
+ public:
+  // Converts the whole problem.
+  void Load(const mp::Problem &p) {
+    int num_vars = p.num_vars(), num_cons = p.num_algebraic_cons();
+    var_lb_.resize(num_vars);
+    var_ub_.resize(num_vars);
+    for (int j = 0; j < num_vars; ++j) {
+      var_lb_[j] = p.var(j).lb();
+      var_ub_[j] = p.var(j).ub();
+    }
+    con_lb_.resize(num_cons);
+    con_ub_.resize(num_cons);
+    for (int i = 0; i < num_cons; ++i) {
+      con_lb_[i] = p.algebraic_con(i).lb();
+      con_ub_[i] = p.algebraic_con(i).ub();
+    }
+    obj_.assign(num_vars, 0);
+    const mp::LinearExpr &obj = p.obj(0).linear_expr();
+    for (mp::LinearExpr::iterator
+         i = obj.begin(), end = obj.end(); i != end; ++i) {
+      obj_[i->var_index()] = i->coef();
+    }
+    p.GetConMatrix(matrix_);
+    coefs_.assign(matrix_.values(), matrix_.values() + matrix_.num_elements());
+  }
+
+  // Change handler methods used to replay the change journal.
+  void SetVarLB(int index, double lb) { var_lb_[index] = lb; }
+  void SetVarUB(int index, double ub) { var_ub_[index] = ub; }
+  void SetConLB(int index, double lb) { con_lb_[index] = lb; }
+  void SetConUB(int index, double ub) { con_ub_[index] = ub; }
+  void SetObjCoef(int, int var_index, double coef) { obj_[var_index] = coef; }
+  void SetConCoef(int con_index, int var_index, double coef) {
+    for (int k = matrix_.col_start(var_index),
+         end = matrix_.col_start(var_index + 1); k != end; ++k) {
+      if (matrix_.row_index(k) == con_index) {
+        coefs_[k] = coef;
+        return;
+      }
+    }
+  }
+};
+
+// Makes NUM_CHANGES changes to bounds and existing coefficients.
+void ModifyProblem(mp::Problem &p, int iteration) {
+  for (int k = 0; k < NUM_CHANGES; ++k) {
+    int index = (iteration * NUM_CHANGES + k) % NUM_CONS * 7919 % NUM_CONS;
+    switch (k % 4) {
+    case 0:
+      p.var(index).set_ub(iteration + k);
+      break;
+    case 1:
+      p.algebraic_con(index).set_ub(iteration + k + 1);
+      break;
+    case 2:
+      p.obj(0).set_coef(index, iteration);
+      break;
+    case 3:
+      p.algebraic_con(index).set_coef(
+            (index * NUM_TERMS) % NUM_VARS, iteration);
+      break;
+    }
+  }
+}
+}  // namespace
+
+int main() {
+  mp::Problem original;
+  original.set_linear_con_storage(mp::Problem::LINEAR_CON_CSR);
+  BuildProblem(original);
+  mp::NLWriter<mp::Problem>(original).Write("bench.nl", mp::NLHeader::BINARY);
+
+  // Full rebuild: read the modified model and convert it again.
+  SolverModel model;
+  int iteration = 0;
+  double rebuild_time = bench::Measure([&]() {
+    mp::Problem p;
+    mp::ReadNLFile("bench.nl", p);
+    ModifyProblem(p, iteration++);
+    model.Load(p);
+  });
+  fmt::print("{:<40} {:10.3f} ms\n", "full rebuild", rebuild_time * 1e3);
+
+  // Incremental update: modify the problem and replay the changes.
+  mp::Problem p;
+  mp::ReadNLFile("bench.nl", p);
+  model.Load(p);
+  p.set_record_changes(true);
+  iteration = 0;
+  double update_time = bench::Measure([&]() {
+    ModifyProblem(p, iteration++);
+    p.ReplayChanges(model);
+    p.ClearChanges();
+  });
+  fmt::print("{:<40} {:10.3f} ms\n", "incremental update", update_time * 1e3);
+  fmt::print("{:<40} {:10.0f}x\n", "speedup", rebuild_time / update_time);
+}
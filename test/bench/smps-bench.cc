@@ -0,0 +1,63 @@
+/*
+ SMPS writer benchmark
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <cstdio>
+#include <string>
+
+#include "bench.h"
+#include "../solvers/farmer.h"
+#include "smpswriter/smpswriter.h"
+
+namespace {
+
+// Returns the size of a file in bytes.
+long GetFileSize(const std::string &filename) {
+  std::FILE *f = std::fopen(filename.c_str(), "rb");
+  if (!f)
+    return 0;
+  std::fseek(f, 0, SEEK_END);
+  long size = std::ftell(f);
+  std::fclose(f);
+  return size;
+}
+}  // namespace
+
+int main() {
+  enum { NUM_CROPS = 10 };
+  int sizes[] = {1000, 10000, 100000};
+  for (std::size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+    int num_scenarios = sizes[i];
+    FarmerProblem p(NUM_CROPS, num_scenarios);
+    mp::SMPSWriter writer;
+    writer.set_basename("smps-bench.nl");
+    mp::BasicSolutionHandler sh;
+    double time = bench::Measure([&]() { writer.Solve(p, sh); });
+    const char *extensions[] = {".tim", ".cor", ".sto"};
+    std::size_t num_bytes = 0;
+    for (int j = 0; j < 3; ++j) {
+      std::string filename = std::string("smps-bench") + extensions[j];
+      num_bytes += GetFileSize(filename);
+      std::remove(filename.c_str());
+    }
+    fmt::print("{} crops, {} scenarios, {} MB\n",
+               NUM_CROPS, num_scenarios, num_bytes >> 20);
+    bench::PrintThroughput("SMPSWriter", num_bytes, time);
+  }
+}
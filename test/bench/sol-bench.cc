@@ -0,0 +1,125 @@
+/*
+ .sol writer benchmark
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "bench.h"
+#include "mp/sol.h"
+#include "mp/suffix.h"
+
+namespace {
+
+enum { NUM_VALUES = 1000000 };
+
+// A solution with fractional primal and dual values and integer and
+// double suffixes with a value for each variable.
+class Solution {
+ private:
+  mp::SuffixManager suffixes_;
+  std::vector<double> values_;
+  std::vector<double> dual_values_;
+
+ public:
+  Solution() : values_(NUM_VALUES), dual_values_(NUM_VALUES) {
+    mp::MutIntSuffix status = suffixes_.suffixes(mp::suf::VAR).Add<int>(
+          "sstatus", mp::suf::VAR | mp::suf::OUTPUT, NUM_VALUES);
+    mp::MutDoubleSuffix rc = suffixes_.suffixes(mp::suf::VAR).Add<double>(
+          "rc", mp::suf::VAR | mp::suf::OUTPUT, NUM_VALUES);
+    for (int i = 0; i < NUM_VALUES; ++i) {
+      values_[i] = i % 3 == 0 ? i % 7 : std::sin(i) * 1000;
+      dual_values_[i] = std::cos(i) / (i + 1);
+      status.set_value(i, i % 4 + 1);
+      rc.set_value(i, std::sqrt(i + 1.0));
+    }
+  }
+
+  int status() const { return 0; }
+  const char *message() const { return "optimal solution"; }
+
+  int num_options() const { return 0; }
+  int option(int) const { return 0; }
+
+  int num_values() const { return NUM_VALUES; }
+  double value(int index) const { return values_[index]; }
+
+  int num_dual_values() const { return NUM_VALUES; }
+  double dual_value(int index) const { return dual_values_[index]; }
+
+  const mp::SuffixSet *suffixes(mp::suf::Kind kind) const {
+    return &suffixes_.suffixes(kind);
+  }
+
+  const char *suffix_table(const char *) const { return 0; }
+};
+
+// Writes values one at a time with fmt::BufferedFile::print as WriteSolFile
+// did before switching to mp::internal::SolOutput.
+class PrintSuffixValue {
+ private:
+  fmt::BufferedFile &file_;
+
+ public:
+  explicit PrintSuffixValue(fmt::BufferedFile &file) : file_(file) {}
+
+  template <typename T>
+  void Visit(int index, T value) { file_.print("{} {}\n", index, value); }
+};
+
+void WriteSolFileWithPrint(fmt::CStringRef filename, const Solution &sol) {
+  fmt::BufferedFile file(filename, "w");
+  file.print("{}\n\nOptions\n", sol.message());
+  int num_values = sol.num_values(), num_dual_values = sol.num_dual_values();
+  file.print("{0}\n{0}\n{1}\n{1}\n", num_dual_values, num_values);
+  for (int i = 0; i < num_values; ++i)
+    file.print("{}\n", sol.value(i));
+  for (int i = 0, n = num_dual_values; i < n; ++i)
+    file.print("{}\n", sol.dual_value(i));
+  file.print("objno 0 {}\n", sol.status());
+  const mp::SuffixSet &suffixes = *sol.suffixes(mp::suf::VAR);
+  for (mp::SuffixSet::iterator
+       i = suffixes.begin(), e = suffixes.end(); i != e; ++i) {
+    mp::internal::SuffixValueCounter counter;
+    i->VisitValues(counter);
+    file.print("suffix {} {} {} {} {}\n{}\n", i->kind(), counter.num_values(),
+               std::strlen(i->name()) + 1, 0, 0, i->name());
+    PrintSuffixValue writer(file);
+    i->VisitValues(writer);
+  }
+}
+}  // namespace
+
+int main() {
+  Solution sol;
+  double print_time = bench::Measure([&]() {
+    WriteSolFileWithPrint("bench.sol", sol);
+  });
+  bench::PrintThroughput("print", ReadFile("bench.sol").size(), print_time);
+  double write_time = bench::Measure([&]() {
+    mp::WriteSolFile("bench.sol", sol);
+  });
+  bench::PrintThroughput("WriteSolFile", ReadFile("bench.sol").size(),
+                         write_time);
+  fmt::print("{:<40} {:10.2f} ms\n{:<40} {:10.2f} ms\n{:<40} {:10.2f}x\n",
+             "print", print_time * 1e3,
+             "WriteSolFile", write_time * 1e3,
+             "speedup", print_time / write_time);
+}
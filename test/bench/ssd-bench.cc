@@ -0,0 +1,179 @@
+/*
+ SSD tail and cut kernel benchmark
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "bench.h"
+#include "ssdsolver/ssdkernel.h"
+
+namespace {
+
+// The number of assets in ssd-portfolio-data.ampl.
+enum { NUM_VARS = 76 };
+
+struct ValueScenario {
+  double value;
+  int scenario;
+};
+
+struct ValueLess {
+  bool operator()(const ValueScenario &lhs, const ValueScenario &rhs) const {
+    return lhs.value < rhs.value;
+  }
+};
+
+// The tail and cut computation of the original SSD solver loop.
+class NaiveKernel {
+ private:
+  const double *coefs_;
+  int num_scenarios_;
+  std::vector<ValueScenario> tails_;
+  std::vector<double> cut_;
+
+ public:
+  NaiveKernel(const double *coefs, int num_scenarios)
+    : coefs_(coefs), num_scenarios_(num_scenarios),
+      tails_(num_scenarios), cut_(NUM_VARS) {}
+
+  void ComputeTails(const double *x) {
+    for (int i = 0; i < num_scenarios_; ++i) {
+      double value = 0;
+      const double *row = coefs_ + i * NUM_VARS;
+      for (int j = 0; j < NUM_VARS; ++j)
+        value += row[j] * x[j];
+      tails_[i].value = value;
+      tails_[i].scenario = i;
+    }
+    std::sort(tails_.begin(), tails_.end(), ValueLess());
+    for (int i = 1; i < num_scenarios_; ++i)
+      tails_[i].value += tails_[i - 1].value;
+  }
+
+  const double *ComputeCut(int size) {
+    for (int i = 0; i < NUM_VARS; ++i) {
+      double coef = 0;
+      for (int j = 0; j < size; ++j)
+        coef += coefs_[tails_[j].scenario * NUM_VARS + i];
+      cut_[i] = coef;
+    }
+    return &cut_[0];
+  }
+};
+
+// Prevents the computed cuts from being optimized away.
+volatile double checksum;
+
+// Runs cutting-plane iterations with solutions that change less and less
+// as the method converges and returns the average time of an iteration.
+template <typename Kernel>
+double Run(fmt::StringRef name, Kernel &kernel, int num_scenarios,
+           int num_vars = NUM_VARS) {
+  std::vector<double> x(num_vars);
+  int iteration = 0;
+  double time = bench::Measure([&]() {
+    double step = 1.0 / (iteration + 1);
+    for (int j = 0; j < num_vars; ++j)
+      x[j] = 1 + std::sin(j + 10 * step) / num_vars;
+    kernel.ComputeTails(&x[0]);
+    checksum += kernel.ComputeCut(num_scenarios / 10 + iteration % 3)[0];
+    ++iteration;
+  });
+  fmt::print("{:<40} {:10.3f} ms\n", name, time * 1e3);
+  return time;
+}
+
+// Runs the cutting-plane method with the bundled LP backend which adds
+// a cut to the master problem and reoptimizes it in each iteration.
+void RunCuttingPlane(const mp::SSDMatrix &matrix,
+                     const std::vector<double> &coefs, int num_scenarios) {
+  std::vector<double> rhs(num_scenarios);
+  for (int i = 0; i < num_scenarios; ++i) {
+    for (int j = 0; j < NUM_VARS; ++j)
+      rhs[i] += coefs[i * NUM_VARS + j] / NUM_VARS;
+  }
+  double inf = std::numeric_limits<double>::infinity();
+  mp::Problem p;
+  for (int j = 0; j < NUM_VARS; ++j)
+    p.AddVar(0, 1);
+  p.AddVar(-inf, inf);
+  p.AddObj(mp::obj::MAX, 1).AddTerm(NUM_VARS, 1);
+  mp::Problem::LinearConBuilder budget =
+      p.AddCon(1, 1).set_linear_expr(NUM_VARS);
+  for (int j = 0; j < NUM_VARS; ++j)
+    budget.AddTerm(j, 1);
+  mp::SSDResult result;
+  mp::steady_clock::time_point start = mp::steady_clock::now();
+  mp::DualSimplex lp;
+  lp.Load(p);
+  result.solution.resize(NUM_VARS + 1);
+  mp::SolveSSD(lp, matrix, rhs, mp::SSDOptions(), result);
+  double time = mp::duration_cast< mp::duration<double> >(
+        mp::steady_clock::now() - start).count();
+  fmt::print("{:<40} {:10} iterations, {:.3f} ms/iteration\n",
+             "cutting-plane method", result.num_iterations,
+             time / result.num_iterations * 1e3);
+}
+}  // namespace
+
+int main() {
+  int sizes[] = {1000, 10000, 100000};
+  for (std::size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+    int num_scenarios = sizes[i];
+    std::vector<double> coefs(num_scenarios * NUM_VARS);
+    for (std::size_t k = 0, n = coefs.size(); k != n; ++k)
+      coefs[k] = std::sin(k * 0.37) * 0.05;
+    fmt::print("{} scenarios\n", num_scenarios);
+    NaiveKernel naive(&coefs[0], num_scenarios);
+    double naive_time = Run("naive", naive, num_scenarios);
+    mp::SSDMatrix matrix;
+    matrix.Assign(mp::SSDMatrix::DENSE, num_scenarios, NUM_VARS, &coefs[0]);
+    mp::SSDKernel kernel(matrix);
+    double kernel_time = Run("SSDKernel", kernel, num_scenarios);
+    fmt::print("{:<40} {:10.1f}x\n", "speedup", naive_time / kernel_time);
+    RunCuttingPlane(matrix, coefs, num_scenarios);
+  }
+
+  // Compare matrix layouts on a wide matrix with different densities.
+  enum { NUM_SCENARIOS = 20000, NUM_WIDE_VARS = 2000 };
+  int steps[] = {1, 20};
+  for (std::size_t i = 0; i < sizeof(steps) / sizeof(*steps); ++i) {
+    std::vector<double> coefs(NUM_SCENARIOS * NUM_WIDE_VARS);
+    for (std::size_t k = 0, n = coefs.size(); k != n; k += steps[i])
+      coefs[k] = std::sin(k * 0.37) * 0.05;
+    fmt::print("{} scenarios, {} variables, {}% nonzeros\n", NUM_SCENARIOS,
+               NUM_WIDE_VARS, 100 / steps[i]);
+    const char *names[] = {"", "dense", "CSR", "column-blocked"};
+    for (int layout = mp::SSDMatrix::DENSE;
+         layout <= mp::SSDMatrix::COLUMN_BLOCKED; ++layout) {
+      mp::SSDMatrix matrix;
+      matrix.Assign(static_cast<mp::SSDMatrix::Layout>(layout),
+                    NUM_SCENARIOS, NUM_WIDE_VARS, &coefs[0]);
+      mp::SSDKernel kernel(matrix);
+      std::size_t element_size = sizeof(double) +
+          (layout == mp::SSDMatrix::CSR ? sizeof(int) : 0);
+      Run(fmt::format("{} ({} MB)", names[layout],
+                      matrix.num_elements() * element_size >> 20),
+          kernel, NUM_SCENARIOS, NUM_WIDE_VARS);
+    }
+  }
+}
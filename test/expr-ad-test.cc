@@ -0,0 +1,275 @@
+/*
+ Reverse-mode automatic differentiation tests
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <gtest/gtest.h>
+#include "mp/expr-ad.h"
+#include "mp/problem.h"
+
+#include <cmath>
+
+using mp::ExprTape;
+using mp::LagrangianHessian;
+using mp::NumericExpr;
+using mp::ReverseAD;
+namespace expr = mp::expr;
+
+namespace {
+
+class ReverseADTest : public ::testing::Test {
+ protected:
+  mp::Problem p;
+  NumericExpr x, y, z;
+
+  ReverseADTest() {
+    p.AddVars(3, mp::var::CONTINUOUS);
+    x = p.MakeVariable(0);
+    y = p.MakeVariable(1);
+    z = p.MakeVariable(2);
+  }
+
+  NumericExpr MakeConst(double value) {
+    return p.MakeNumericConstant(value);
+  }
+
+  // Checks the gradient of e at (xv, yv, zv) against central differences.
+  void CheckGradient(NumericExpr e, double xv, double yv, double zv) {
+    ExprTape tape;
+    mp::ExprCompiler<mp::Problem> compiler(p, tape);
+    tape.AddOutput(compiler.Visit(e));
+    ReverseAD ad(tape);
+    double point[] = {xv, yv, zv};
+    std::vector<double> grad(tape.num_vars());
+    double value = ad.Gradient(0, point, &grad[0]);
+    double result = 0;
+    tape.Evaluate(point, &result);
+    EXPECT_EQ(result, value);
+    const double h = 1e-6;
+    for (int i = 0; i < tape.num_vars(); ++i) {
+      double saved = point[i];
+      point[i] = saved + h;
+      double upper = 0, lower = 0;
+      tape.Evaluate(point, &upper);
+      point[i] = saved - h;
+      tape.Evaluate(point, &lower);
+      point[i] = saved;
+      EXPECT_NEAR((upper - lower) / (2 * h), grad[i], 1e-6)
+          << str(static_cast<expr::Kind>(e.kind())) << " var " << i;
+    }
+  }
+};
+
+TEST_F(ReverseADTest, UnaryExprs) {
+  const expr::Kind kinds[] = {
+    expr::MINUS, expr::ABS, expr::SQRT, expr::POW2, expr::EXP, expr::LOG,
+    expr::LOG10, expr::SIN, expr::SINH, expr::COS, expr::COSH, expr::TAN,
+    expr::TANH, expr::ASIN, expr::ASINH, expr::ACOS, expr::ACOSH,
+    expr::ATAN, expr::ATANH
+  };
+  for (std::size_t i = 0; i < sizeof(kinds) / sizeof(*kinds); ++i) {
+    double arg = kinds[i] == expr::ACOSH ? 1.7 : 0.3;
+    CheckGradient(p.MakeUnary(kinds[i], x), arg, 0, 0);
+  }
+  CheckGradient(p.MakeUnary(expr::ABS, x), -2, 0, 0);
+}
+
+TEST_F(ReverseADTest, BinaryExprs) {
+  const expr::Kind kinds[] = {
+    expr::ADD, expr::SUB, expr::LESS, expr::MUL, expr::DIV, expr::MOD,
+    expr::POW, expr::ATAN2
+  };
+  for (std::size_t i = 0; i < sizeof(kinds) / sizeof(*kinds); ++i)
+    CheckGradient(p.MakeBinary(kinds[i], x, y), 2.5, 0.7, 0);
+  CheckGradient(p.MakeBinary(expr::POW_CONST_BASE, MakeConst(3), y), 0, 2, 0);
+  CheckGradient(p.MakeBinary(expr::POW_CONST_EXP, x, MakeConst(3)), 2, 0, 0);
+}
+
+TEST_F(ReverseADTest, IfAndVarArgExprs) {
+  NumericExpr e = p.MakeIf(p.MakeRelational(expr::LT, x, z),
+                           p.MakeBinary(expr::MUL, x, y), y);
+  CheckGradient(e, 1, 2, 3);
+  CheckGradient(e, 4, 2, 3);
+  mp::Problem::IteratedExprBuilder min = p.BeginIterated(expr::MIN, 3);
+  min.AddArg(x);
+  min.AddArg(p.MakeUnary(expr::EXP, y));
+  min.AddArg(z);
+  CheckGradient(p.EndIterated(min), 3, 0.5, 5);
+}
+
+TEST_F(ReverseADTest, PLTerm) {
+  mp::Problem::PLTermBuilder b = p.BeginPLTerm(2);
+  b.AddSlope(-1);
+  b.AddBreakpoint(0);
+  b.AddSlope(2);
+  b.AddBreakpoint(1);
+  b.AddSlope(3);
+  NumericExpr e = p.EndPLTerm(b, p.MakeVariable(0));
+  CheckGradient(e, -0.5, 0, 0);
+  CheckGradient(e, 0.5, 0, 0);
+  CheckGradient(e, 1.5, 0, 0);
+}
+
+TEST_F(ReverseADTest, ConditionVarsNotInStructure) {
+  NumericExpr e = p.MakeIf(p.MakeRelational(expr::LT, z, MakeConst(0)),
+                           x, MakeConst(0));
+  ExprTape tape;
+  mp::ExprCompiler<mp::Problem> compiler(p, tape);
+  tape.AddOutput(compiler.Visit(e));
+  ReverseAD ad(tape);
+  ASSERT_EQ(1, ad.num_jac_nonzeros());
+  EXPECT_EQ(0, ad.jac_var_index(0));
+}
+
+// Checks that common expressions are differentiated once and that
+// Jacobian rows list variables of linear parts first.
+TEST_F(ReverseADTest, Jacobian) {
+  p.AddCommonExpr(p.MakeBinary(expr::MUL, x, y));
+  NumericExpr e = p.MakeCommonExpr(0);
+  // c0: 3 * z + 2 * y + sin(e) + e
+  mp::Problem::MutAlgebraicCon c0 = p.AddCon(0, 0);
+  mp::Problem::LinearConBuilder c0_linear = c0.set_linear_expr(2);
+  c0_linear.AddTerm(2, 3);
+  c0_linear.AddTerm(1, 2);
+  c0.set_nonlinear_expr(p.MakeBinary(
+      expr::ADD, p.MakeUnary(expr::SIN, e), e));
+  // c1: exp(e) * z
+  p.AddCon(0, 0).set_nonlinear_expr(
+      p.MakeBinary(expr::MUL, p.MakeUnary(expr::EXP, e), z));
+  // c2: x
+  p.AddCon(0, 0).set_linear_expr(1).AddTerm(0, 1);
+  ExprTape tape;
+  mp::CompileProblem(p, tape);
+  ReverseAD ad(tape);
+  ASSERT_EQ(7, ad.num_jac_nonzeros());
+  const int row_starts[] = {0, 3, 6, 7};
+  const int var_indices[] = {2, 1, 0, 0, 1, 2, 0};
+  for (int i = 0; i <= 3; ++i)
+    EXPECT_EQ(row_starts[i], ad.jac_row_start(i));
+  for (int i = 0; i < 7; ++i)
+    EXPECT_EQ(var_indices[i], ad.jac_var_index(i));
+  double point[] = {0.5, 2, 3};
+  std::vector<double> jac(ad.num_jac_nonzeros());
+  double results[3];
+  ad.Jacobian(point, jac.data(), results);
+  double ev = 1, dev = std::cos(ev) + 1;
+  EXPECT_DOUBLE_EQ(3, jac[0]);
+  EXPECT_DOUBLE_EQ(2 + 0.5 * dev, jac[1]);
+  EXPECT_DOUBLE_EQ(2 * dev, jac[2]);
+  EXPECT_DOUBLE_EQ(std::exp(ev) * 3 * 2, jac[3]);
+  EXPECT_DOUBLE_EQ(std::exp(ev) * 3 * 0.5, jac[4]);
+  EXPECT_DOUBLE_EQ(std::exp(ev), jac[5]);
+  EXPECT_DOUBLE_EQ(1, jac[6]);
+  EXPECT_DOUBLE_EQ(9 + 4 + std::sin(ev) + ev, results[0]);
+  // Gradient at a different point agrees with the Jacobian.
+  double point2[] = {1, 1, 1};
+  ad.Jacobian(point2, jac.data());
+  double grad[3];
+  ad.Gradient(1, point2, grad);
+  for (int i = ad.jac_row_start(1); i < ad.jac_row_start(2); ++i)
+    EXPECT_DOUBLE_EQ(jac[i], grad[ad.jac_var_index(i)]);
+}
+
+TEST_F(ReverseADTest, HessianStructure) {
+  // x * y + sin(z) + 2 * x
+  NumericExpr e = p.MakeBinary(
+      expr::ADD, p.MakeBinary(expr::MUL, x, y), p.MakeUnary(expr::SIN, z));
+  ExprTape tape;
+  mp::ExprCompiler<mp::Problem> compiler(p, tape);
+  tape.AddOutput(compiler.Visit(p.MakeBinary(
+      expr::ADD, e, p.MakeBinary(expr::MUL, MakeConst(2), x))));
+  LagrangianHessian h(tape);
+  ASSERT_EQ(2, h.num_hes_nonzeros());
+  EXPECT_EQ(0, h.hes_col_start(0));
+  EXPECT_EQ(0, h.hes_col_start(1));
+  EXPECT_EQ(1, h.hes_col_start(2));
+  EXPECT_EQ(2, h.hes_col_start(3));
+  EXPECT_EQ(0, h.hes_row_index(0));
+  EXPECT_EQ(2, h.hes_row_index(1));
+  EXPECT_EQ(2, h.num_colors());
+  double point[] = {1, 2, 3}, w = 2, hes[2];
+  h.Compute(point, &w, hes);
+  EXPECT_DOUBLE_EQ(2, hes[0]);
+  EXPECT_DOUBLE_EQ(-2 * std::sin(3.0), hes[1]);
+}
+
+// Checks the Hessian of the Lagrangian against differences of gradients.
+TEST_F(ReverseADTest, Hessian) {
+  p.AddCommonExpr(p.MakeBinary(
+      expr::DIV, x, p.MakeUnary(expr::EXP, y)));
+  NumericExpr e = p.MakeCommonExpr(0);
+  p.AddObj(mp::obj::MIN, p.MakeBinary(
+      expr::ADD, p.MakeUnary(expr::POW2, e), p.MakeUnary(expr::COS, z)));
+  p.AddCon(0, 0).set_nonlinear_expr(p.MakeBinary(
+      expr::POW, p.MakeUnary(expr::SQRT, z), e));
+  p.AddCon(0, 0).set_nonlinear_expr(p.MakeBinary(expr::ATAN2, e, x));
+  ExprTape tape;
+  mp::CompileProblem(p, tape);
+  LagrangianHessian h(tape);
+  mp::ReverseAD ad(tape);
+  const int n = 3;
+  double point[n] = {0.5, 0.2, 1.5}, w[] = {1, 0.3, -2};
+  std::vector<double> hes(h.num_hes_nonzeros());
+  h.Compute(point, w, hes.data());
+  // Compute the dense Hessian by central differences of the gradient.
+  double full[n][n] = {};
+  for (int k = 0; k < n; ++k) {
+    const double step = 1e-6;
+    double grads[2][n] = {};
+    for (int s = 0; s < 2; ++s) {
+      double x0[n] = {point[0], point[1], point[2]};
+      x0[k] += s == 0 ? step : -step;
+      for (int i = 0; i < tape.num_outputs(); ++i) {
+        double grad[n];
+        ad.Gradient(i, x0, grad);
+        for (int j = 0; j < n; ++j)
+          grads[s][j] += w[i] * grad[j];
+      }
+    }
+    for (int j = 0; j < n; ++j)
+      full[j][k] = (grads[0][j] - grads[1][j]) / (2 * step);
+  }
+  for (int col = 0; col < n; ++col) {
+    for (int pos = h.hes_col_start(col); pos < h.hes_col_start(col + 1);
+         ++pos) {
+      int row = h.hes_row_index(pos);
+      EXPECT_NEAR(full[row][col], hes[pos], 1e-6);
+      full[row][col] = full[col][row] = 0;
+    }
+  }
+  // Elements outside of the structure are zero.
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j)
+      EXPECT_NEAR(0, full[i][j], 1e-6);
+  }
+  // Check a Hessian-vector product.
+  double v[n] = {1, -1, 2}, hv[n], expected[n] = {};
+  h.MultiplyVector(point, w, v, hv);
+  for (int col = 0; col < n; ++col) {
+    for (int pos = h.hes_col_start(col); pos < h.hes_col_start(col + 1);
+         ++pos) {
+      int row = h.hes_row_index(pos);
+      expected[row] += hes[pos] * v[col];
+      if (row != col)
+        expected[col] += hes[pos] * v[row];
+    }
+  }
+  for (int i = 0; i < n; ++i)
+    EXPECT_NEAR(expected[i], hv[i], 1e-12);
+}
+}  // namespace
@@ -0,0 +1,294 @@
+/*
+ Expression tape tests
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <gtest/gtest.h>
+#include "mp/expr-tape.h"
+#include "mp/problem.h"
+
+#include <cmath>
+
+using mp::ExprTape;
+using mp::NumericExpr;
+using mp::LogicalExpr;
+namespace expr = mp::expr;
+
+namespace {
+
+class ExprTapeTest : public ::testing::Test {
+ protected:
+  mp::Problem p;
+  NumericExpr x, y, z;
+
+  ExprTapeTest() {
+    p.AddVars(3, mp::var::CONTINUOUS);
+    x = p.MakeVariable(0);
+    y = p.MakeVariable(1);
+    z = p.MakeVariable(2);
+  }
+
+  NumericExpr MakeConst(double value) {
+    return p.MakeNumericConstant(value);
+  }
+
+  // Evaluates an expression at (x, y, z) both on its own and in a batch
+  // of points and checks that the results agree.
+  template <typename Expr>
+  double Eval(Expr e, double xv = 0, double yv = 0, double zv = 0) {
+    ExprTape tape;
+    mp::ExprCompiler<mp::Problem> compiler(p, tape);
+    tape.AddOutput(compiler.Visit(e));
+    double point[] = {xv, yv, zv};
+    double result = 0;
+    tape.Evaluate(point, &result);
+    // Put the point last in a batch that doesn't fill all lanes.
+    const int num_points = ExprTape::NUM_LANES + 3;
+    std::vector<double> points(3 * num_points);
+    std::copy(point, point + 3, points.end() - 3);
+    std::vector<double> results(num_points);
+    tape.EvaluateBatch(points.data(), num_points, 3, results.data());
+    if (result == result) {
+      EXPECT_EQ(result, results.back());
+    }
+    return result;
+  }
+};
+
+TEST_F(ExprTapeTest, Constant) {
+  EXPECT_EQ(42, Eval(MakeConst(42)));
+}
+
+TEST_F(ExprTapeTest, Variable) {
+  EXPECT_EQ(2, Eval(y, 1, 2, 3));
+}
+
+TEST_F(ExprTapeTest, Unary) {
+  struct {
+    expr::Kind kind;
+    double arg;
+    double result;
+  } tests[] = {
+    {expr::MINUS, 2, -2},
+    {expr::ABS, -2, 2},
+    {expr::FLOOR, 1.5, 1},
+    {expr::CEIL, 1.5, 2},
+    {expr::SQRT, 4, 2},
+    {expr::POW2, 3, 9},
+    {expr::EXP, 1, std::exp(1.0)},
+    {expr::LOG, 2, std::log(2.0)},
+    {expr::LOG10, 100, 2},
+    {expr::SIN, 1, std::sin(1.0)},
+    {expr::SINH, 1, std::sinh(1.0)},
+    {expr::COS, 1, std::cos(1.0)},
+    {expr::COSH, 1, std::cosh(1.0)},
+    {expr::TAN, 1, std::tan(1.0)},
+    {expr::TANH, 1, std::tanh(1.0)},
+    {expr::ASIN, 0.5, std::asin(0.5)},
+    {expr::ASINH, 1, std::asinh(1.0)},
+    {expr::ACOS, 0.5, std::acos(0.5)},
+    {expr::ACOSH, 2, std::acosh(2.0)},
+    {expr::ATAN, 1, std::atan(1.0)},
+    {expr::ATANH, 0.5, std::atanh(0.5)}
+  };
+  for (std::size_t i = 0; i < sizeof(tests) / sizeof(*tests); ++i) {
+    EXPECT_DOUBLE_EQ(tests[i].result,
+                     Eval(p.MakeUnary(tests[i].kind, x), tests[i].arg))
+        << str(tests[i].kind);
+  }
+}
+
+TEST_F(ExprTapeTest, Binary) {
+  struct {
+    expr::Kind kind;
+    double lhs;
+    double rhs;
+    double result;
+  } tests[] = {
+    {expr::ADD, 3, 2, 5},
+    {expr::SUB, 3, 2, 1},
+    {expr::LESS, 3, 2, 1},
+    {expr::LESS, 2, 3, 0},
+    {expr::MUL, 3, 2, 6},
+    {expr::DIV, 3, 2, 1.5},
+    {expr::TRUNC_DIV, -7, 2, -3},
+    {expr::MOD, 7, 3, 1},
+    {expr::POW, 2, 3, 8},
+    {expr::POW_CONST_BASE, 2, 3, 8},
+    {expr::POW_CONST_EXP, 2, 3, 8},
+    {expr::ATAN2, 1, 2, std::atan2(1.0, 2.0)},
+    {expr::PRECISION, 123.456, 4, 123.5},
+    {expr::ROUND, 1.256, 2, 1.26},
+    {expr::TRUNC, 1.256, 2, 1.25}
+  };
+  for (std::size_t i = 0; i < sizeof(tests) / sizeof(*tests); ++i) {
+    EXPECT_DOUBLE_EQ(tests[i].result,
+                     Eval(p.MakeBinary(tests[i].kind, x, y),
+                          tests[i].lhs, tests[i].rhs))
+        << str(tests[i].kind);
+  }
+}
+
+TEST_F(ExprTapeTest, If) {
+  NumericExpr e = p.MakeIf(p.MakeRelational(expr::LT, x, y), x, y);
+  EXPECT_EQ(1, Eval(e, 1, 2));
+  EXPECT_EQ(2, Eval(e, 3, 2));
+}
+
+TEST_F(ExprTapeTest, PLTerm) {
+  // Slopes -1, 0, 2 with breakpoints 1 and 3.
+  mp::Problem::PLTermBuilder b = p.BeginPLTerm(2);
+  b.AddSlope(-1);
+  b.AddBreakpoint(1);
+  b.AddSlope(0);
+  b.AddBreakpoint(3);
+  b.AddSlope(2);
+  NumericExpr e = p.EndPLTerm(b, p.MakeVariable(0));
+  EXPECT_EQ(2, Eval(e, -2));
+  EXPECT_EQ(-0.5, Eval(e, 0.5));
+  EXPECT_EQ(-1, Eval(e, 2));
+  EXPECT_EQ(1, Eval(e, 4));
+}
+
+TEST_F(ExprTapeTest, Iterated) {
+  mp::Problem::IteratedExprBuilder b = p.BeginIterated(expr::MIN, 3);
+  b.AddArg(x);
+  b.AddArg(y);
+  b.AddArg(z);
+  EXPECT_EQ(-1, Eval(p.EndIterated(b), 2, -1, 3));
+  b = p.BeginIterated(expr::MAX, 3);
+  b.AddArg(x);
+  b.AddArg(y);
+  b.AddArg(z);
+  EXPECT_EQ(3, Eval(p.EndIterated(b), 2, -1, 3));
+  b = p.BeginSum(3);
+  b.AddArg(x);
+  b.AddArg(y);
+  b.AddArg(z);
+  EXPECT_EQ(4, Eval(p.EndSum(b), 2, -1, 3));
+  mp::Problem::NumberOfExprBuilder nb = p.BeginNumberOf(3, x);
+  nb.AddArg(y);
+  nb.AddArg(z);
+  EXPECT_EQ(2, Eval(p.EndNumberOf(nb), 1, 1, 1));
+  EXPECT_EQ(1, Eval(p.EndNumberOf(nb), 1, 1, 2));
+}
+
+TEST_F(ExprTapeTest, Count) {
+  mp::Problem::CountExprBuilder b = p.BeginCount(2);
+  b.AddArg(p.MakeRelational(expr::GT, x, y));
+  b.AddArg(p.MakeRelational(expr::GT, x, z));
+  mp::CountExpr count = p.EndCount(b);
+  EXPECT_EQ(1, Eval(count, 2, 1, 3));
+  EXPECT_EQ(1, Eval(p.MakeLogicalCount(expr::ATLEAST, MakeConst(1), count),
+                    2, 1, 3));
+  EXPECT_EQ(0, Eval(p.MakeLogicalCount(expr::ATLEAST, MakeConst(2), count),
+                    2, 1, 3));
+  EXPECT_EQ(1, Eval(p.MakeLogicalCount(expr::EXACTLY, MakeConst(2), count),
+                    4, 1, 3));
+  EXPECT_EQ(1, Eval(p.MakeLogicalCount(expr::NOT_ATMOST, MakeConst(1), count),
+                    4, 1, 3));
+}
+
+TEST_F(ExprTapeTest, Logical) {
+  LogicalExpr lt = p.MakeRelational(expr::LT, x, y);
+  LogicalExpr ne = p.MakeRelational(expr::NE, x, z);
+  EXPECT_EQ(1, Eval(p.MakeLogicalConstant(true)));
+  EXPECT_EQ(0, Eval(p.MakeNot(lt), 1, 2));
+  EXPECT_EQ(1, Eval(p.MakeBinaryLogical(expr::OR, lt, ne), 1, 2, 1));
+  EXPECT_EQ(0, Eval(p.MakeBinaryLogical(expr::AND, lt, ne), 1, 2, 1));
+  EXPECT_EQ(0, Eval(p.MakeBinaryLogical(expr::IFF, lt, ne), 1, 2, 1));
+  EXPECT_EQ(1, Eval(p.MakeImplication(lt, ne, p.MakeLogicalConstant(true)),
+                    1, 2, 3));
+  mp::Problem::IteratedLogicalExprBuilder b =
+      p.BeginIteratedLogical(expr::FORALL, 2);
+  b.AddArg(lt);
+  b.AddArg(ne);
+  EXPECT_EQ(0, Eval(p.EndIteratedLogical(b), 1, 2, 1));
+  b = p.BeginIteratedLogical(expr::EXISTS, 2);
+  b.AddArg(lt);
+  b.AddArg(ne);
+  EXPECT_EQ(1, Eval(p.EndIteratedLogical(b), 1, 2, 1));
+}
+
+TEST_F(ExprTapeTest, AllDiff) {
+  mp::Problem::PairwiseExprBuilder b = p.BeginPairwise(expr::ALLDIFF, 3);
+  b.AddArg(x);
+  b.AddArg(y);
+  b.AddArg(z);
+  mp::PairwiseExpr e = p.EndPairwise(b);
+  EXPECT_EQ(1, Eval(e, 1, 2, 3));
+  EXPECT_EQ(0, Eval(e, 1, 2, 1));
+  b = p.BeginPairwise(expr::NOT_ALLDIFF, 3);
+  b.AddArg(x);
+  b.AddArg(y);
+  b.AddArg(z);
+  EXPECT_EQ(1, Eval(p.EndPairwise(b), 1, 2, 1));
+}
+
+TEST_F(ExprTapeTest, UnsupportedExpr) {
+  mp::Function f = p.AddFunction("f", 1);
+  mp::Problem::CallExprBuilder b = p.BeginCall(f, 1);
+  b.AddArg(x);
+  mp::CallExpr call = p.EndCall(b);
+  ExprTape tape;
+  mp::ExprCompiler<mp::Problem> compiler(p, tape);
+  EXPECT_THROW(compiler.Visit(call), mp::UnsupportedError);
+}
+
+TEST_F(ExprTapeTest, CommonExpr) {
+  // e0 = 2 * x + sin(y), used twice.
+  mp::Problem::MutCommonExpr e0 = p.AddCommonExpr(p.MakeUnary(expr::SIN, y));
+  e0.set_linear_expr(1).AddTerm(0, 2);
+  NumericExpr ref = p.MakeCommonExpr(0);
+  NumericExpr e = p.MakeBinary(expr::MUL, ref, ref);
+  ExprTape tape;
+  mp::ExprCompiler<mp::Problem> compiler(p, tape);
+  tape.AddOutput(compiler.Visit(e));
+  // linear, y, sin, add, mul
+  EXPECT_EQ(5, tape.num_instructions());
+  double point[] = {1, 2, 0};
+  double result = 0;
+  tape.Evaluate(point, &result);
+  double value = 2 + std::sin(2.0);
+  EXPECT_DOUBLE_EQ(value * value, result);
+}
+
+TEST_F(ExprTapeTest, CompileProblem) {
+  p.AddObj(mp::obj::MIN, p.MakeUnary(expr::EXP, x), 1).AddTerm(1, 3);
+  p.AddCon(0, 1).set_linear_expr(2).AddTerm(0, 1);
+  p.AddCon(0, 1).set_nonlinear_expr(p.MakeBinary(expr::MUL, x, z));
+  p.AddCon(p.MakeRelational(expr::LE, x, y));
+  ExprTape tape;
+  mp::CompileProblem(p, tape);
+  EXPECT_EQ(4, tape.num_outputs());
+  const int num_points = 20;
+  std::vector<double> points(num_points * 3);
+  for (int i = 0; i < num_points * 3; ++i)
+    points[i] = i * 0.1;
+  std::vector<double> results(num_points * 4);
+  tape.EvaluateBatch(points.data(), num_points, 3, results.data());
+  for (int i = 0; i < num_points; ++i) {
+    const double *pt = &points[i * 3];
+    const double *r = &results[i * 4];
+    EXPECT_DOUBLE_EQ(std::exp(pt[0]) + 3 * pt[1], r[0]);
+    EXPECT_DOUBLE_EQ(pt[0], r[1]);
+    EXPECT_DOUBLE_EQ(pt[0] * pt[2], r[2]);
+    EXPECT_EQ(pt[0] <= pt[1], r[3]);
+  }
+}
+}  // namespace
@@ -931,6 +931,88 @@ TEST(ExprFactoryTest, FuncMemoryAllocation) {
   EXPECT_CALL(alloc, deallocate(buffer, _));
 }
 
+TEST(ExprFactoryTest, HashConsing) {
+  ExprFactory f;
+  EXPECT_FALSE(f.hash_consing());
+  f.MakeVariable(0);
+  f.MakeVariable(0);
+  EXPECT_EQ(0, f.num_unique_exprs());
+  f.set_hash_consing(true);
+  EXPECT_TRUE(f.hash_consing());
+  auto x = f.MakeVariable(0), y = f.MakeVariable(1);
+  EXPECT_EQ(2, f.num_unique_exprs());
+  f.MakeBinary(expr::MUL, x, y);
+  f.MakeBinary(expr::MUL, f.MakeVariable(0), f.MakeVariable(1));
+  EXPECT_EQ(3, f.num_unique_exprs());
+  f.MakeBinary(expr::MUL, y, x);
+  f.MakeBinary(expr::ADD, x, y);
+  EXPECT_EQ(5, f.num_unique_exprs());
+  // 0 and -0 are different constants.
+  f.MakeUnary(expr::SIN, f.MakeNumericConstant(0));
+  f.MakeUnary(expr::SIN, f.MakeNumericConstant(0));
+  f.MakeUnary(expr::SIN, f.MakeNumericConstant(-0.0));
+  EXPECT_EQ(9, f.num_unique_exprs());
+  for (int i = 0; i < 2; ++i) {
+    auto b = f.BeginSum(2);
+    b.AddArg(x);
+    b.AddArg(y);
+    f.EndSum(b);
+    f.MakeIf(f.MakeRelational(expr::LT, x, y), x, y);
+  }
+  EXPECT_EQ(12, f.num_unique_exprs());
+  // Piecewise-linear terms are not shared.
+  for (int i = 0; i < 2; ++i) {
+    auto b = f.BeginPLTerm(1);
+    b.AddSlope(1);
+    b.AddBreakpoint(0);
+    b.AddSlope(2);
+    f.EndPLTerm(b, f.MakeVariable(0));
+  }
+  EXPECT_EQ(12, f.num_unique_exprs());
+  f.set_hash_consing(false);
+  EXPECT_EQ(0, f.num_unique_exprs());
+}
+
+TEST(ExprFactoryTest, HashConsingFreesDuplicates) {
+  MockAllocator alloc;
+  mp::BasicExprFactory< AllocatorRef<> > f((AllocatorRef<>(&alloc)));
+  f.set_hash_consing(true);
+  double buffers[3][8];
+  EXPECT_CALL(alloc, allocate(_))
+      .WillOnce(Return(buffers[0]))
+      .WillOnce(Return(buffers[1]))
+      .WillOnce(Return(buffers[2]));
+  f.MakeVariable(0);
+  auto b = f.BeginSum(1);
+  b.AddArg(f.MakeVariable(0));
+  f.EndSum(b);
+  // The second sum is freed immediately because it is a duplicate.
+  EXPECT_CALL(alloc, deallocate(buffers[2], _));
+  b = f.BeginSum(1);
+  b.AddArg(f.MakeVariable(0));
+  f.EndSum(b);
+  ::testing::Mock::VerifyAndClearExpectations(&alloc);
+  EXPECT_CALL(alloc, deallocate(buffers[0], _));
+  EXPECT_CALL(alloc, deallocate(buffers[1], _));
+}
+
+TEST(ExprFactoryTest, ArenaExprFactory) {
+  mp::ArenaExprFactory f(1024);
+  EXPECT_EQ(0u, f.arena().num_chunks());
+  auto x = f.MakeVariable(0);
+  NumericExpr e = f.MakeBinary(expr::ADD, x, f.MakeNumericConstant(42));
+  for (int i = 0; i < 100; ++i)
+    e = f.MakeBinary(expr::MUL, e, x);
+  EXPECT_LT(1u, f.arena().num_chunks());
+  while (e.kind() == expr::MUL)
+    e = mp::Cast<mp::BinaryExpr>(e).lhs();
+  auto add = mp::Cast<mp::BinaryExpr>(e);
+  EXPECT_EQ(x, add.lhs());
+  EXPECT_EQ(42, mp::Cast<mp::NumericConstant>(add.rhs()).value());
+  f.AddFunction("foo", 1);
+  EXPECT_EQ("foo", std::string(f.function(0).name()));
+}
+
 TEST(ExprFactoryTest, IntOverflow) {
   ExprFactory f;
   int int_max = std::numeric_limits<int>::max();
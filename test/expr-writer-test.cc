@@ -224,6 +224,8 @@ TEST_F(ExprWriterTest, WriteNumericConstant) {
   CHECK_WRITE("0", MakeConst(0));
   CHECK_WRITE("42", MakeConst(42));
   CHECK_WRITE("12.34", MakeConst(12.34));
+  CHECK_WRITE("0.30000000000000004", MakeConst(0.1 + 0.2));
+  CHECK_WRITE("1.2345678901234567e-20", MakeConst(1.2345678901234567e-20));
 }
 
 TEST_F(ExprWriterTest, WriteVariable) {
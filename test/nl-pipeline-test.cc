@@ -0,0 +1,220 @@
+/*
+ Streaming NL handler pipeline tests
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <gtest/gtest.h>
+#include "mp/nl-pipeline.h"
+#include "mp/problem.h"
+#include "util.h"
+
+namespace expr = mp::expr;
+
+using mp::NLHeader;
+using mp::NLStats;
+
+namespace {
+
+typedef mp::NullNLHandler<int> NullHandler;
+
+// Returns a problem in the text .nl format in the form produced by
+// NLStreamWriter.
+std::string MakeTestInput() {
+  NLHeader h;
+  h.num_vars = 3;
+  h.num_algebraic_cons = 2;
+  h.num_objs = 1;
+  h.num_logical_cons = 1;
+  h.num_common_exprs_in_both = 1;
+  h.num_funcs = 1;
+  fmt::MemoryWriter w;
+  w << h;
+  w << "F0 1 -1 foo\n"
+       "S0 2 suf\n0 1\n2 3\n"
+       "S5 1 dsuf\n1 1.5\n";
+  int sum = nl_opcode(expr::SUM), lt = nl_opcode(expr::LT);
+  w.write("V3 1 0\n0 2\no{}\nv0\nv1\n", nl_opcode(expr::MUL));
+  w.write("C0\no{}\n3\nv3\no{}\nv2\no{}\n2\nn-1\nn0\nn1\nv0\n",
+          sum, nl_opcode(expr::SIN), nl_opcode(expr::PLTERM));
+  w << "C1\nn0\n";
+  w.write("L0\no{}\nv0\nn1\n", lt);
+  w.write("O0 1\no{}\no{}\nv0\nn1\nf0 2\nh3:abc\nv1\nn0\n",
+          nl_opcode(expr::IF), lt);
+  w << "x2\n0 1\n2 3.5\n"
+       "d1\n0 2\n"
+       "r\n0 1 2\n5 1 3\n"
+       "b\n0 0 1\n3\n4 1\n"
+       "k2\n1\n2\n"
+       "J0 2\n0 1\n2 -1\n"
+       "J1 1\n1 2\n"
+       "G0 1\n0 1\n";
+  return w.str();
+}
+
+// Rewrites a problem in the .nl format with NLStreamWriter.
+template <typename Reader>
+std::string Rewrite(Reader read, const std::string &filename) {
+  {
+    fmt::BufferedFile file(filename, "w");
+    mp::NLStreamWriter writer(file.get());
+    read(writer);
+  }
+  return ReadFile(filename);
+}
+
+struct StringReader {
+  std::string input;
+  explicit StringReader(const std::string &s) : input(s) {}
+
+  template <typename Handler>
+  void operator()(Handler &h) const { mp::ReadNLString(input, h); }
+};
+
+TEST(NLPipelineTest, WriteText) {
+  std::string input = MakeTestInput();
+  TempFile file("pipeline-write-text.nl");
+  EXPECT_EQ(input, Rewrite(StringReader(input), file.name()));
+}
+
+TEST(NLPipelineTest, WriteZeroExprs) {
+  NLHeader h;
+  h.num_vars = 1;
+  h.num_algebraic_cons = 1;
+  h.num_objs = 1;
+  fmt::MemoryWriter w;
+  w << h << "O0 0\nn0\nC0\nn0\nb\n3\n";
+  TempFile file("pipeline-zero-exprs.nl");
+  EXPECT_EQ(w.str(), Rewrite(StringReader(w.str()), file.name()));
+}
+
+TEST(NLPipelineTest, Forwarder) {
+  std::string input = MakeTestInput();
+  TempFile temp("pipeline-forwarder.nl");
+  {
+    fmt::BufferedFile file(temp.name(), "w");
+    mp::NLStreamWriter writer(file.get());
+    mp::NLForwarder<mp::NLStreamWriter> forwarder(writer);
+    EXPECT_EQ(&writer, &forwarder.handler());
+    mp::ReadNLString(input, forwarder);
+  }
+  EXPECT_EQ(input, ReadFile(temp.name()));
+}
+
+TEST(NLPipelineTest, FlushWithinSegment) {
+  TempFile temp("pipeline-flush.nl");
+  fmt::BufferedFile file(temp.name(), "w");
+  mp::NLStreamWriter writer(file.get());
+  NLHeader h;
+  h.num_vars = 100000;
+  writer.OnHeader(h);
+  for (int i = 0; i < h.num_vars; ++i)
+    writer.OnVarBounds(i, 0, 1);
+  // Most of the b segment has been written before the segment ends.
+  EXPECT_GT(std::ftell(file.get()), 500000);
+  writer.EndInput();
+}
+
+TEST(NLPipelineTest, Stats) {
+  NullHandler sink;
+  mp::NLStatsCollector<NullHandler> collector(sink);
+  mp::ReadNLString(MakeTestInput(), collector);
+  const NLStats &stats = collector.stats();
+  EXPECT_EQ(1, stats.num_objs);
+  EXPECT_EQ(1, stats.num_nl_objs);
+  EXPECT_EQ(2, stats.num_algebraic_cons);
+  EXPECT_EQ(1, stats.num_nl_cons);
+  EXPECT_EQ(1, stats.num_logical_cons);
+  EXPECT_EQ(1, stats.num_common_exprs);
+  EXPECT_EQ(1, stats.num_obj_nonzeros);
+  EXPECT_EQ(3, stats.num_con_nonzeros);
+  EXPECT_EQ(1, stats.num_fixed_vars);
+  EXPECT_EQ(1, stats.num_free_vars);
+  EXPECT_EQ(0, stats.num_eqns);
+  EXPECT_EQ(1, stats.num_compl_conds);
+  EXPECT_EQ(8, stats.max_expr_size);
+  EXPECT_EQ(7, stats.num_exprs[expr::VARIABLE]);
+  EXPECT_EQ(3, stats.num_exprs[expr::NUMBER]);
+  EXPECT_EQ(2, stats.num_exprs[expr::LT]);
+  EXPECT_EQ(1, stats.num_exprs[expr::COMMON_EXPR]);
+  EXPECT_EQ(1, stats.num_exprs[expr::MUL]);
+  EXPECT_EQ(1, stats.num_exprs[expr::SUM]);
+  EXPECT_EQ(1, stats.num_exprs[expr::SIN]);
+  EXPECT_EQ(1, stats.num_exprs[expr::PLTERM]);
+  EXPECT_EQ(1, stats.num_exprs[expr::IF]);
+  EXPECT_EQ(1, stats.num_exprs[expr::CALL]);
+  EXPECT_EQ(1, stats.num_exprs[expr::STRING]);
+  EXPECT_EQ(0, stats.num_exprs[expr::ADD]);
+}
+
+// A stage that fixes the first variable at its lower bound.
+template <typename Handler>
+class VarFixer : public mp::NLForwarder<Handler> {
+ public:
+  explicit VarFixer(Handler &h) : mp::NLForwarder<Handler>(h) {}
+
+  void OnVarBounds(int index, double lb, double ub) {
+    this->handler().OnVarBounds(index, lb, index == 0 ? lb : ub);
+  }
+};
+
+TEST(NLPipelineTest, TransformIntoProblem) {
+  mp::Problem problem;
+  mp::internal::NLProblemBuilder<mp::Problem> builder(problem);
+  typedef mp::internal::NLProblemBuilder<mp::Problem> Builder;
+  mp::NLStatsCollector<Builder> collector(builder);
+  VarFixer< mp::NLStatsCollector<Builder> > fixer(collector);
+  mp::ReadNLString(MakeTestInput(), fixer, "(input)", mp::READ_BOUNDS_FIRST);
+  EXPECT_EQ(3, problem.num_vars());
+  EXPECT_EQ(0, problem.var(0).ub());
+  EXPECT_EQ(1, problem.num_common_exprs());
+  EXPECT_EQ(1, problem.num_logical_cons());
+  EXPECT_EQ(1, collector.stats().num_nl_objs);
+}
+
+struct FileReader {
+  std::string filename;
+  int flags;
+  FileReader(const std::string &name, int f) : filename(name), flags(f) {}
+
+  template <typename Handler>
+  void operator()(Handler &h) const { mp::ReadNLFile(filename, h, flags); }
+};
+
+NLStats GetStats(const std::string &filename) {
+  NullHandler sink;
+  mp::NLStatsCollector<NullHandler> collector(sink);
+  mp::ReadNLFile(filename, collector);
+  return collector.stats();
+}
+
+TEST(NLPipelineTest, RoundTrip) {
+  const char *names[] = {
+    "element", "feasible", "infeasible", "noobj", "numberof", "simple",
+    "ssd", "suffix", "test", "unbounded"
+  };
+  TempFile file("pipeline-round-trip.nl"), file2("pipeline-round-trip2.nl");
+  for (std::size_t i = 0; i < sizeof(names) / sizeof(*names); ++i) {
+    std::string filename = fmt::format("{}/{}.nl", MP_TEST_DATA_DIR, names[i]);
+    SCOPED_TRACE(filename);
+    std::string output =
+        Rewrite(FileReader(filename, mp::READ_BOUNDS_FIRST), file.name());
+    CheckEqual(GetStats(filename), GetStats(file.name()));
+    EXPECT_EQ(output, Rewrite(FileReader(file.name(), 0), file2.name()));
+  }
+}
+}  // namespace
@@ -26,6 +26,7 @@
 #include "../src/nl-reader.cc"
 
 #include <climits>
+#include <cmath>
 #include <cstring>
 
 #include "gmock/gmock.h"
@@ -140,6 +141,19 @@ TEST(TextReaderTest, ReadUInt) {
                    "test:1:8: expected unsigned integer");
 }
 
+TEST(TextReaderTest, ReadIntLimits) {
+  TextReader reader(" 2147483647 -2147483648 18446744073709551615 "
+                    "2147483648 18446744073709551616", "test");
+  EXPECT_EQ(INT_MAX, reader.ReadUInt());
+  EXPECT_EQ(INT_MIN, reader.ReadInt<int>());
+  EXPECT_EQ(ULLONG_MAX, reader.ReadInt<unsigned long long>());
+  EXPECT_THROW_MSG(reader.ReadUInt(), mp::ReadError,
+                   "test:1:46: number is too big");
+  TextReader reader2("18446744073709551616", "test");
+  EXPECT_THROW_MSG(reader2.ReadInt<unsigned long long>(), mp::ReadError,
+                   "test:1:1: number is too big");
+}
+
 TEST(TextReaderTest, ReadDouble) {
   TextReader reader("  11   -2.2 ", "test");
   EXPECT_EQ(11, reader.ReadDouble());
@@ -148,13 +162,48 @@ TEST(TextReaderTest, ReadDouble) {
                    "test:1:13: expected double");
 }
 
+TEST(TextReaderTest, ParseDecimalDouble) {
+  const char *numbers[] = {
+    "0", "-0", "+0", "1", "-1", "42", "0.5", ".5", "5.", "-.25", "1e3",
+    "1E-3", "1e+22", "1e22", "1e-22", "9007199254740992", "0.000123456789",
+    "123456789012345678", "1.7976931348623157", "3.14159265358979",
+    "0.1", "0.3", "2.2250738585072014e-5", "00000000000000000000000001.5",
+    "1.00000000000000000000", "9007199254740993", "1e23", "1e-23", "1e400",
+    "1e", "1e+", "-", ".", "e5", "inf", "0x10", "1.5x", "12abc"
+  };
+  for (std::size_t i = 0; i < sizeof(numbers) / sizeof(*numbers); ++i) {
+    const char *str = numbers[i];
+    char *end = 0;
+    double expected = std::strtod(str, &end);
+    const char *ptr = str;
+    double value = 0;
+    if (mp::internal::ParseDecimalDouble(ptr, value)) {
+      EXPECT_EQ(end, ptr) << str;
+      EXPECT_EQ(expected, value) << str;
+      EXPECT_EQ(std::signbit(expected), std::signbit(value)) << str;
+    } else {
+      EXPECT_EQ(str, ptr) << str;
+    }
+    TextReader reader(str, "test");
+    if (end != str) {
+      EXPECT_EQ(expected, reader.ReadDouble()) << str;
+    }
+  }
+  const char *ptr = "1.5 ";
+  double value = 0;
+  EXPECT_TRUE(mp::internal::ParseDecimalDouble(ptr, value));
+  EXPECT_EQ(1.5, value);
+  EXPECT_EQ(' ', *ptr);
+}
+
 class MockLocale {
  public:
   MOCK_METHOD1(strtod, double (const char *&str));
 };
 
 TEST(TextReaderTest, ReadDoubleUsesCLocale) {
-  const char *str = "4.2";
+  // Use a number that is not handled by ParseDecimalDouble.
+  const char *str = "4.2e-300";
   mp::internal::TextReader<MockLocale> reader(str, "test.nl");
   EXPECT_CALL(reader.locale(), strtod(str))
     .WillOnce(testing::DoAll(testing::SetArgReferee<0>(str + 1), Return(1.23)));
@@ -448,6 +497,67 @@ TEST(BinaryReaderTest, ReadString) {
   TestReadString(&BinaryReader<EndiannessConverter>::ReadString, true);
 }
 
+// Appends a value in the binary format to data.
+template <typename T>
+void AppendBinary(std::string &data, T value) {
+  data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+TEST(BinaryReaderTest, ReadRecords) {
+  struct Record {
+    int index;
+    double value;
+  };
+  Record records[] = {{11, 1.5}, {-22, 2.5}};
+  const std::size_t RECORD_SIZE = sizeof(int) + sizeof(double);
+  std::string data;
+  for (std::size_t i = 0; i < 2; ++i) {
+    data.append(reinterpret_cast<char*>(&records[i].index), sizeof(int));
+    data.append(reinterpret_cast<char*>(&records[i].value), sizeof(double));
+  }
+  {
+    TestBinaryReader<> reader(data);
+    const char *ptr = reader.ReadRecords(2, RECORD_SIZE);
+    EXPECT_EQ(-22, reader.Decode<int>(ptr + RECORD_SIZE));
+    EXPECT_EQ(2.5, reader.Decode<double>(ptr + RECORD_SIZE + sizeof(int)));
+    EXPECT_THROW_MSG(reader.ReadRecords(1, RECORD_SIZE), mp::BinaryReadError,
+        fmt::format("test:offset {}: unexpected end of file", data.size()));
+  }
+  EXPECT_THROW_MSG(TestBinaryReader<>(data).ReadRecords(3, RECORD_SIZE),
+      mp::BinaryReadError,
+      fmt::format("test:offset {}: unexpected end of file", data.size()));
+  ChangeEndianness(records[0].index);
+  ChangeEndianness(records[0].value);
+  std::memcpy(&data[0], &records[0].index, sizeof(int));
+  std::memcpy(&data[sizeof(int)], &records[0].value, sizeof(double));
+  TestBinaryReader<EndiannessConverter> reader(data);
+  const char *ptr = reader.ReadRecords(2, RECORD_SIZE);
+  EXPECT_EQ(11, reader.Decode<int>(ptr));
+  EXPECT_EQ(1.5, reader.Decode<double>(ptr + sizeof(int)));
+  int indices[1] = {};
+  double values[1] = {};
+  reader.DecodeRecords(ptr, 1, indices, values);
+  EXPECT_EQ(11, indices[0]);
+  EXPECT_EQ(1.5, values[0]);
+}
+
+TEST(BinaryReaderTest, DecodeRecords) {
+  std::string data;
+  AppendBinary(data, 11);
+  AppendBinary(data, 1.5);
+  AppendBinary(data, -22);
+  AppendBinary(data, 2.5);
+  TestBinaryReader<> reader(data);
+  const char *ptr = reader.ReadRecords(2, sizeof(int) + sizeof(double));
+  int indices[2] = {};
+  double values[2] = {};
+  reader.DecodeRecords(ptr, 2, indices, values);
+  EXPECT_EQ(11, indices[0]);
+  EXPECT_EQ(-22, indices[1]);
+  EXPECT_EQ(1.5, values[0]);
+  EXPECT_EQ(2.5, values[1]);
+}
+
 TEST(NLReaderTest, ArithKind) {
   namespace arith = mp::arith;
   EXPECT_GE(arith::GetKind(), arith::UNKNOWN);
@@ -1548,6 +1658,329 @@ TEST(NLReaderTest, EndInput) {
   ReadNLString(FormatHeader(header, false) + "b\n0 1 2\n", handler, "");
 }
 
+// Returns a binary NL header with 3 variables and 1 constraint followed by
+// the variable bounds.
+std::string MakeBinaryPrefix() {
+  auto header = NLHeader();
+  header.format = NLHeader::BINARY;
+  header.num_vars = 3;
+  header.num_algebraic_cons = 1;
+  header.arith_kind = mp::arith::GetKind();
+  return FormatHeader(header, false) + "b333";
+}
+
+// An NL handler with a linear constraint handler that adds terms in bulk.
+class BulkNLHandler : public TestNLHandler {
+ public:
+  class LinearConHandler {
+   private:
+    fmt::Writer &log_;
+    std::vector<int> indices_;
+    std::vector<double> coefs_;
+
+   public:
+    explicit LinearConHandler(fmt::Writer &log) : log_(log) {}
+    ~LinearConHandler() {
+      for (std::size_t i = 0, n = indices_.size(); i != n; ++i) {
+        if (i != 0)
+          log_ << " + ";
+        log_.write("{} * v{}", coefs_[i], indices_[i]);
+      }
+      log_ << ';';
+    }
+
+    void AddTerm(int, double) { ADD_FAILURE() << "terms not added in bulk"; }
+
+    void AddTerms(int num_terms, int *&indices, double *&coefs) {
+      indices_.resize(num_terms);
+      coefs_.resize(num_terms);
+      indices = indices_.data();
+      coefs = coefs_.data();
+    }
+  };
+
+  LinearConHandler OnLinearConExpr(int index, int num_terms) {
+    if (log.size() != 0)
+      log << ' ';
+    log.write("c{} {}: ", index, num_terms);
+    return LinearConHandler(log);
+  }
+};
+
+TEST(NLReaderTest, HasAddTerms) {
+  EXPECT_FALSE(mp::internal::HasAddTerms<
+               TestNLHandler::LinearExprHandler>::value);
+  EXPECT_TRUE(mp::internal::HasAddTerms<
+              BulkNLHandler::LinearConHandler>::value);
+}
+
+template <typename Handler>
+std::string ReadBinaryLinearExpr(std::string body) {
+  Handler handler;
+  ReadNLString(MakeBinaryPrefix() + body, handler);
+  return handler.log.str();
+}
+
+template <typename Handler>
+void CheckReadBinaryLinearExpr() {
+  std::string body = "J";
+  AppendBinary(body, 0);
+  AppendBinary(body, 2);
+  AppendBinary(body, 2);
+  AppendBinary(body, 1.5);
+  AppendBinary(body, 0);
+  AppendBinary(body, -3.0);
+  EXPECT_EQ("v0; v1; v2; c0 2: 1.5 * v2 + -3 * v0;",
+            ReadBinaryLinearExpr<Handler>(body));
+  std::size_t size = MakeBinaryPrefix().size() + body.size();
+  EXPECT_THROW_MSG(
+      ReadBinaryLinearExpr<Handler>(body.substr(0, body.size() - 1)),
+      mp::BinaryReadError,
+      fmt::format("(input):offset {}: unexpected end of file", size - 1));
+  std::size_t offset = size - sizeof(double) - sizeof(int);
+  int index = 3;
+  std::memcpy(&body[body.size() - sizeof(double) - sizeof(int)],
+              &index, sizeof(int));
+  EXPECT_THROW_MSG(ReadBinaryLinearExpr<Handler>(body), mp::BinaryReadError,
+      fmt::format("(input):offset {}: integer 3 out of bounds", offset));
+  index = -1;
+  std::memcpy(&body[body.size() - sizeof(double) - sizeof(int)],
+              &index, sizeof(int));
+  EXPECT_THROW_MSG(ReadBinaryLinearExpr<Handler>(body), mp::BinaryReadError,
+      fmt::format("(input):offset {}: expected unsigned integer", offset));
+}
+
+TEST(NLReaderTest, ReadBinaryLinearExpr) {
+  CheckReadBinaryLinearExpr<TestNLHandler>();
+}
+
+TEST(NLReaderTest, ReadBinaryLinearExprInBulk) {
+  CheckReadBinaryLinearExpr<BulkNLHandler>();
+}
+
+// Reads input and returns the handler log or an error message.
+std::string ReadNLOrError(std::string input, int flags, bool parallel) {
+  TestNLHandler handler;
+  try {
+    if (!parallel) {
+      ReadNLString(input, handler, "(input)", flags);
+      return handler.log.str();
+    }
+    // Read in parallel with each segment in a separate chunk.
+    TextReader reader(input, "(input)");
+    NLHeader header = NLHeader();
+    reader.ReadHeader(header);
+    handler.OnHeader(header);
+    mp::internal::ReadTextInParallel(
+          input, "(input)", reader, header, handler, flags, 1);
+  } catch (const ReadError &e) {
+    return e.what();
+  }
+  return handler.log.str();
+}
+
+// Checks that reading input in parallel gives the same result as reading it
+// sequentially.
+void CheckParallelRead(std::string input) {
+  int flags[] = {0, mp::READ_BOUNDS_FIRST};
+  for (std::size_t i = 0; i < sizeof(flags) / sizeof(*flags); ++i) {
+    EXPECT_EQ(ReadNLOrError(input, flags[i], false),
+              ReadNLOrError(input, flags[i], true));
+  }
+}
+
+TEST(NLReaderTest, ReadInParallel) {
+  std::string header = FormatHeader(MakeHeader(), false);
+  const char *bodies[] = {
+    "b\n0 1.1 2.2\n1 3\n2 4\n3\n3\nO0 1\no2\nv0\nn3\nC1\nn4\n"
+    "J1 2\n0 1\n1 2\nx2\n0 1\n1 2\n",
+    "O0 1\nv0\nb\n0 1 2\n3\n3\n3\n3\nC0\nn1\nk4\n1\n2\n3\n4\n"
+    "G0 2\n0 1\n1 2\nS0 2 foo\n0 1\n1 2\nd1\n0 1.5\n",
+    "F0 1 -1 foo\nb\n3\n3\n3\n3\n3\nC0\nf0 1\nh5:a\nb\nc\nV5 0 0\nn1\n",
+    "", "O0 1\nn0\n", "b\n3\n3\n3\n3\n3\nb\n3\n3\n3\n3\n3\n",
+    "b\n3\n3\n3\n3\n3\nC0\nn1\nC0\nn1 2\n", "b\n3\n3\n3\n3\n3\nq\n",
+    "b\n3\n3\n3\n3\n3\nC9\nn1\n", "b\n3\n3\n3\n3\n3\nC0\nh9:a\n"
+  };
+  for (std::size_t i = 0; i < sizeof(bodies) / sizeof(*bodies); ++i)
+    CheckParallelRead(header + bodies[i]);
+  EXPECT_EQ(ReadNLOrError(header + bodies[0], 0, false),
+            ReadNLOrError(header + bodies[0], mp::READ_PARALLEL, false));
+}
+
+TEST(NLReaderTest, ReadFilesInParallel) {
+  const char *names[] = {
+    "element", "feasible", "infeasible", "noobj", "numberof", "simple",
+    "ssd", "suffix", "test", "unbounded"
+  };
+  for (std::size_t i = 0; i < sizeof(names) / sizeof(*names); ++i) {
+    CheckParallelRead(
+          ReadFile(fmt::format("{}/{}.nl", MP_TEST_DATA_DIR, names[i])));
+  }
+}
+
+TEST(NLReaderTest, SplitIntoSegments) {
+  std::string input = FormatHeader(MakeHeader(), false) +
+      "C0\nn1\nb\n3\n3\n3\n3\n3\nC1\nh3:a\nC\nC2\nn2\n";
+  TextReader reader(input, "(input)");
+  NLHeader header = NLHeader();
+  reader.ReadHeader(header);
+  mp::internal::TextSegmentConverter converter(input, reader, header, 1);
+  EXPECT_TRUE(converter.split());
+  EXPECT_EQ(4, converter.num_chunks());
+  EXPECT_EQ(1, converter.bounds_chunk());
+  mp::internal::TextSegmentConverter single_chunk(input, reader, header);
+  EXPECT_EQ(3, single_chunk.num_chunks());
+}
+
+// An input source that returns at most max_size bytes at a time.
+class StringSource : public mp::internal::InputSource {
+ private:
+  std::string data_;
+  std::size_t pos_;
+  std::size_t max_size_;
+
+ public:
+  StringSource(const std::string &data, std::size_t max_size)
+    : data_(data), pos_(0), max_size_(max_size) {}
+
+  std::size_t Read(char *buffer, std::size_t size) {
+    size = std::min(std::min(size, max_size_), data_.size() - pos_);
+    std::memcpy(buffer, data_.data() + pos_, size);
+    pos_ += size;
+    return size;
+  }
+};
+
+// Reads input as a stream and returns the handler log or an error message.
+std::string ReadStreamOrError(const std::string &input, int flags,
+                              std::size_t chunk_size, std::size_t block_size) {
+  TestNLHandler handler;
+  StringSource source(input, 5);
+  try {
+    mp::internal::ReadNLStream(
+          source, handler, "(input)", flags, chunk_size, block_size);
+  } catch (const ReadError &e) {
+    return e.what();
+  } catch (const mp::BinaryReadError &e) {
+    return e.what();
+  }
+  return handler.log.str();
+}
+
+// Reads input from a string and returns the handler log or an error message.
+std::string ReadStringOrError(const std::string &input, int flags) {
+  TestNLHandler handler;
+  try {
+    ReadNLString(input, handler, "(input)", flags);
+  } catch (const ReadError &e) {
+    return e.what();
+  } catch (const mp::BinaryReadError &e) {
+    return e.what();
+  }
+  return handler.log.str();
+}
+
+// Checks that reading input as a stream gives the same result as reading
+// it from a string.
+void CheckStreamRead(const std::string &input) {
+  int flags[] = {0, mp::READ_BOUNDS_FIRST};
+  std::size_t sizes[][2] = {
+    {1, 1}, {1, 7}, {16, 3}, {100, 64},
+    {mp::internal::SegmentStream::DEFAULT_CHUNK_SIZE,
+     mp::internal::SegmentStream::DEFAULT_BLOCK_SIZE}
+  };
+  for (std::size_t i = 0; i < sizeof(flags) / sizeof(*flags); ++i) {
+    std::string expected = ReadStringOrError(input, flags[i]);
+    for (std::size_t j = 0; j < sizeof(sizes) / sizeof(*sizes); ++j) {
+      EXPECT_EQ(expected,
+                ReadStreamOrError(input, flags[i], sizes[j][0], sizes[j][1]));
+    }
+  }
+}
+
+TEST(NLReaderTest, ReadStream) {
+  std::string header = FormatHeader(MakeHeader(), false);
+  std::string input = header +
+      "C0\nn1\nb\n0 1.1 2.2\n3\n3\n3\n3\nC1\nh3:a\nC\nC2\nn2\n"
+      "O0 1\no2\nv0\nn3\nJ1 2\n0 1\n1 2\nx2\n0 1\n1 2\n";
+  CheckStreamRead(input);
+  // Check all truncated inputs to make sure that incomplete segments are
+  // handled correctly and errors are the same.
+  for (std::size_t size = 0; size < input.size(); ++size)
+    CheckStreamRead(input.substr(0, size));
+  const char *bodies[] = {
+    "", "O0 1\nn0\n", "b\n3\n3\n3\n3\n3\nb\n3\n3\n3\n3\n3\n",
+    "b\n3\n3\n3\n3\n3\nq\n", "b\n3\n3\n3\n3\n3\nC0\nh9:a\n",
+    "F0 1 -1 foo\nb\n3\n3\n3\n3\n3\nC0\nf0 1\nh5:a\nb\nc\nV5 0 0\nn1\n"
+  };
+  for (std::size_t i = 0; i < sizeof(bodies) / sizeof(*bodies); ++i)
+    CheckStreamRead(header + bodies[i]);
+}
+
+TEST(NLReaderTest, ReadFilesAsStream) {
+  const char *names[] = {
+    "element", "feasible", "infeasible", "noobj", "numberof", "simple",
+    "ssd", "suffix", "test", "unbounded"
+  };
+  for (std::size_t i = 0; i < sizeof(names) / sizeof(*names); ++i) {
+    CheckStreamRead(
+          ReadFile(fmt::format("{}/{}.nl", MP_TEST_DATA_DIR, names[i])));
+  }
+}
+
+TEST(NLReaderTest, ReadBinaryStream) {
+  std::string body = "C";
+  AppendBinary(body, 0);
+  body += "n";
+  AppendBinary(body, 4.2);
+  body += "J";
+  AppendBinary(body, 0);
+  AppendBinary(body, 2);
+  AppendBinary(body, 2);
+  AppendBinary(body, 1.5);
+  AppendBinary(body, 0);
+  AppendBinary(body, -3.0);
+  body += "x";
+  AppendBinary(body, 1);
+  AppendBinary(body, 1);
+  AppendBinary(body, 0.5);
+  std::string input = MakeBinaryPrefix() + body;
+  EXPECT_EQ("v0; v1; v2; c0: 4.2; c0 2: 1.5 * v2 + -3 * v0; v1 := 0.5;",
+            ReadStreamOrError(input, 0, 1, 3));
+  for (std::size_t size = 0; size <= input.size(); ++size)
+    CheckStreamRead(input.substr(0, size));
+  // Check that an error in the middle of the input is reported at
+  // the correct offset.
+  input[input.size() - sizeof(double) - sizeof(int)] = 9;
+  CheckStreamRead(input);
+}
+
+TEST(NLReaderTest, ReadNLStreamFromPipe) {
+  std::string input = ReadFile(MP_TEST_DATA_DIR "/test.nl");
+  fmt::File read_end, write_end;
+  fmt::File::pipe(read_end, write_end);
+  // The input fits into the pipe buffer.
+  write_end.write(input.data(), input.size());
+  write_end.close();
+  TestNLHandler handler;
+  mp::ReadNLStream(read_end, handler, "(pipe)");
+  EXPECT_EQ(ReadStringOrError(input, 0), handler.log.str());
+}
+
+TEST(NLReaderTest, ReadNLStreamErrorBeforeEOF) {
+  fmt::File read_end, write_end;
+  fmt::File::pipe(read_end, write_end);
+  // Keep the write end open so that the reader doesn't get EOF and has to
+  // stop waiting for input when the error is reported.
+  std::string input =
+      FormatHeader(MakeHeader(), false) + "C99\nn0\nC0\nn0\n";
+  write_end.write(input.data(), input.size());
+  TestNLHandler handler;
+  mp::internal::FileSource<fmt::File> source(read_end);
+  EXPECT_THROW(mp::internal::ReadNLStream(source, handler, "(pipe)", 0, 1),
+               ReadError);
+}
+
 struct MockNameHandler {
   MOCK_METHOD1(OnName, void (fmt::StringRef name));
 };
@@ -0,0 +1,294 @@
+/*
+ .nl writer tests
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <limits>
+
+#include <gtest/gtest.h>
+#include "gtest-extra.h"
+#include "mp/nl-pipeline.h"
+#include "mp/nl-writer.h"
+#include "mp/problem.h"
+#include "util.h"
+
+namespace expr = mp::expr;
+
+using mp::NLHeader;
+using mp::Problem;
+
+namespace {
+
+const double INF = std::numeric_limits<double>::infinity();
+
+// Writes a problem to a file and returns the output.
+std::string Write(const Problem &p, const std::string &filename,
+                  NLHeader::Format format = NLHeader::TEXT,
+                  int num_threads = 0) {
+  mp::NLWriter<Problem>(p, num_threads).Write(filename, format);
+  return ReadFile(filename);
+}
+
+// An NL handler that stores the header.
+class HeaderReader : public mp::NullNLHandler<int> {
+ private:
+  NLHeader header_;
+
+ public:
+  const NLHeader &header() const { return header_; }
+
+  void OnHeader(const NLHeader &h) { header_ = h; }
+};
+
+NLHeader ReadHeader(const std::string &filename) {
+  HeaderReader reader;
+  mp::ReadNLFile(filename, reader);
+  return reader.header();
+}
+
+void BuildTestProblem(Problem &p) {
+  p.AddVar(0, 1);
+  p.AddVar(-INF, INF);
+  p.AddVar(2, 2, mp::var::INTEGER);
+  p.var(1).set_value(3.5);
+  p.AddCommonExpr(p.MakeBinary(
+        expr::MUL, p.MakeVariable(0), p.MakeVariable(1)))
+      .set_linear_expr(1).AddTerm(2, 2);
+  Problem::MutAlgebraicCon con = p.AddCon(-INF, 10);
+  Problem::LinearConBuilder linear = con.set_linear_expr(2);
+  linear.AddTerm(0, 1);
+  linear.AddTerm(1, -1);
+  con.set_nonlinear_expr(p.MakeUnary(expr::SIN, p.MakeCommonExpr(0)));
+  con.set_dual(2);
+  p.AddCon(1, 1).set_linear_expr(1).AddTerm(2, 3);
+  p.AddCon(p.MakeRelational(expr::LT, p.MakeVariable(0),
+                            p.MakeNumericConstant(1)));
+  p.AddObj(mp::obj::MAX, p.MakeVariable(0), 1).AddTerm(1, 1);
+  p.AddIntSuffix("suf", mp::suf::VAR, 0).SetValue(2, 3);
+}
+
+TEST(NLWriterTest, WriteText) {
+  Problem p;
+  BuildTestProblem(p);
+  NLHeader h;
+  h.num_vars = 3;
+  h.num_algebraic_cons = 2;
+  h.num_objs = 1;
+  h.num_eqns = 1;
+  h.num_logical_cons = 1;
+  h.num_nl_cons = 1;
+  h.num_nl_objs = 1;
+  // Variable 0 is nonlinear in both constraints and objectives, and
+  // variables 1 and 2 are nonlinear in the common expression used in C0.
+  h.num_nl_vars_in_cons = 3;
+  h.num_nl_vars_in_objs = 1;
+  h.num_nl_vars_in_both = 1;
+  h.num_nl_integer_vars_in_cons = 1;
+  h.num_con_nonzeros = 3;
+  h.num_obj_nonzeros = 1;
+  h.num_common_exprs_in_both = 1;
+  fmt::MemoryWriter w;
+  w << h;
+  w.write("S0 1 suf\n2 3\n"
+          "V3 1 0\n2 2\no{}\nv0\nv1\n"
+          "C0\no{}\nv3\n"
+          "C1\nn0\n"
+          "L0\no{}\nv0\nn1\n"
+          "O0 1\nv0\n"
+          "d1\n0 2\n"
+          "x1\n1 3.5\n"
+          "r\n1 10\n4 1\n"
+          "b\n0 0 1\n3\n4 2\n"
+          "k2\n1\n2\n"
+          "J0 2\n0 1\n1 -1\n"
+          "J1 1\n2 3\n"
+          "G0 1\n1 1\n",
+          expr::nl_opcode(expr::MUL), expr::nl_opcode(expr::SIN),
+          expr::nl_opcode(expr::LT));
+  TempFile file("writer-write-text.nl");
+  EXPECT_EQ(w.str(), Write(p, file.name()));
+}
+
+TEST(NLWriterTest, Header) {
+  Problem p;
+  BuildTestProblem(p);
+  mp::NLWriter<Problem> writer(p);
+  EXPECT_EQ(3, writer.header().num_vars);
+  EXPECT_EQ(1, writer.header().num_eqns);
+  EXPECT_EQ(0, writer.header().num_ranges);
+  EXPECT_EQ(3, writer.header().num_con_nonzeros);
+  TempFile file("writer-header.nl");
+  writer.Write(file.name(), NLHeader::BINARY);
+  EXPECT_EQ(NLHeader::BINARY, writer.header().format);
+  EXPECT_EQ(mp::arith::GetKind(), writer.header().arith_kind);
+}
+
+TEST(NLWriterTest, WriteBinary) {
+  Problem p;
+  BuildTestProblem(p);
+  TempFile file("writer-binary.nl");
+  std::string text = Write(p, file.name());
+  EXPECT_EQ('b', Write(p, file.name(), NLHeader::BINARY)[0]);
+  Problem p2;
+  mp::ReadNLFile(file.name(), p2);
+  Problem p3;
+  p3.set_linear_con_storage(Problem::LINEAR_CON_CSR);
+  mp::ReadNLFile(file.name(), p3);
+  EXPECT_EQ(text, Write(p2, file.name()));
+  EXPECT_EQ(text, Write(p3, file.name()));
+}
+
+TEST(NLWriterTest, UnsupportedComplementarity) {
+  Problem p;
+  p.AddVar(0, 1);
+  p.AddCon(0, 0);
+  p.SetComplementarity(0, 0, mp::ComplInfo(0));
+  EXPECT_THROW_MSG(mp::NLWriter<Problem> writer(p), mp::UnsupportedError,
+                   "unsupported: complementarity conditions");
+}
+
+TEST(NLWriterTest, IntegerVarOrder) {
+  Problem p;
+  p.AddVar(0, 1, mp::var::INTEGER);
+  p.AddVar(0, 1);
+  EXPECT_THROW_MSG(mp::NLWriter<Problem> writer(p), mp::Error,
+                   "integer variables must follow continuous variables");
+}
+
+TEST(NLWriterTest, NonlinearVarOrder) {
+  Problem p;
+  p.AddVar(0, 1);
+  p.AddVar(0, 1);
+  p.AddCon(0, 1).set_nonlinear_expr(
+        p.MakeUnary(expr::EXP, p.MakeVariable(1)));
+  EXPECT_THROW_MSG(mp::NLWriter<Problem> writer(p), mp::Error,
+                   "variable 1 is out of order: nonlinear variables must "
+                   "precede linear ones and be ordered by where they appear "
+                   "nonlinearly");
+}
+
+TEST(NLWriterTest, NonlinearVarCounts) {
+  Problem p;
+  p.AddVar(0, 1);
+  p.AddVar(0, 1, mp::var::INTEGER);
+  p.AddVar(0, 1);
+  p.AddVar(0, 1, mp::var::INTEGER);
+  p.AddVar(0, 1);
+  p.AddVar(0, 1, mp::var::INTEGER);
+  Problem::MutAlgebraicCon con = p.AddCon(0, 1);
+  con.set_nonlinear_expr(
+        p.MakeBinary(expr::MUL, p.MakeVariable(0), p.MakeVariable(1)));
+  Problem::LinearConBuilder linear = con.set_linear_expr(2);
+  linear.AddTerm(4, 1);
+  linear.AddTerm(5, 1);
+  p.AddObj(mp::obj::MIN, p.MakeBinary(
+        expr::MUL, p.MakeVariable(0),
+        p.MakeBinary(expr::MUL, p.MakeVariable(2), p.MakeVariable(3))));
+  mp::NLWriter<Problem> writer(p);
+  const NLHeader &h = writer.header();
+  EXPECT_EQ(2, h.num_nl_vars_in_cons);
+  // Variables nonlinear just in objectives follow all variables nonlinear
+  // in constraints, so they are counted after num_nl_vars_in_cons.
+  EXPECT_EQ(4, h.num_nl_vars_in_objs);
+  EXPECT_EQ(1, h.num_nl_vars_in_both);
+  EXPECT_EQ(0, h.num_nl_integer_vars_in_both);
+  EXPECT_EQ(1, h.num_nl_integer_vars_in_cons);
+  EXPECT_EQ(1, h.num_nl_integer_vars_in_objs);
+  EXPECT_EQ(0, h.num_linear_binary_vars);
+  EXPECT_EQ(1, h.num_linear_integer_vars);
+}
+
+TEST(NLWriterTest, ParallelWrite) {
+  // Use enough items to split segments into several chunks.
+  Problem p;
+  const int num_vars = 5000;
+  p.AddVars(num_vars, mp::var::CONTINUOUS);
+  for (int i = 0; i < num_vars; ++i) {
+    p.var(i).set_value(i);
+    Problem::MutAlgebraicCon con = p.AddCon(0, i);
+    con.set_linear_expr(1).AddTerm(i, i + 1);
+    con.set_nonlinear_expr(p.MakeUnary(expr::EXP, p.MakeVariable(i)));
+  }
+  TempFile file("writer-parallel.nl");
+  std::string output = Write(p, file.name(), NLHeader::TEXT, 1);
+  EXPECT_EQ(output, Write(p, file.name(), NLHeader::TEXT, 4));
+  std::string binary_output = Write(p, file.name(), NLHeader::BINARY, 1);
+  EXPECT_EQ(binary_output, Write(p, file.name(), NLHeader::BINARY, 4));
+  Problem p2;
+  mp::ReadNLFile(file.name(), p2);
+  EXPECT_EQ(output, Write(p2, file.name()));
+}
+
+using ::CheckEqual;
+
+// Compares headers of an .nl file and its rewritten version.
+void CheckEqual(const NLHeader &lhs, const NLHeader &rhs) {
+  EXPECT_EQ(lhs.num_vars, rhs.num_vars);
+  EXPECT_EQ(lhs.num_algebraic_cons, rhs.num_algebraic_cons);
+  EXPECT_EQ(lhs.num_objs, rhs.num_objs);
+  EXPECT_EQ(lhs.num_ranges, rhs.num_ranges);
+  EXPECT_EQ(lhs.num_eqns, rhs.num_eqns);
+  EXPECT_EQ(lhs.num_logical_cons, rhs.num_logical_cons);
+  EXPECT_EQ(lhs.num_nl_cons, rhs.num_nl_cons);
+  EXPECT_EQ(lhs.num_nl_objs, rhs.num_nl_objs);
+  EXPECT_EQ(lhs.num_nl_vars_in_cons, rhs.num_nl_vars_in_cons);
+  EXPECT_EQ(lhs.num_nl_vars_in_objs, rhs.num_nl_vars_in_objs);
+  EXPECT_EQ(lhs.num_nl_vars_in_both, rhs.num_nl_vars_in_both);
+  EXPECT_EQ(lhs.num_funcs, rhs.num_funcs);
+  // mp::Problem keeps integer variables after continuous ones, so only
+  // the total number of integer variables is preserved.
+  EXPECT_EQ(lhs.num_integer_vars(), rhs.num_integer_vars());
+  EXPECT_EQ(lhs.num_con_nonzeros, rhs.num_con_nonzeros);
+  // The number of objective nonzeros is compared in NLStats because
+  // the header of test.nl doesn't match its G segments.
+  EXPECT_EQ(lhs.num_common_exprs(), rhs.num_common_exprs());
+}
+
+mp::NLStats GetStats(const std::string &filename) {
+  mp::NullNLHandler<int> sink;
+  mp::NLStatsCollector< mp::NullNLHandler<int> > collector(sink);
+  mp::ReadNLFile(filename, collector);
+  return collector.stats();
+}
+
+TEST(NLWriterTest, RoundTrip) {
+  const char *names[] = {
+    "element", "feasible", "infeasible", "noobj", "numberof", "simple",
+    "ssd", "suffix", "test", "unbounded"
+  };
+  TempFile file("writer-round-trip.nl");
+  for (std::size_t i = 0; i < sizeof(names) / sizeof(*names); ++i) {
+    std::string filename = fmt::format("{}/{}.nl", MP_TEST_DATA_DIR, names[i]);
+    SCOPED_TRACE(filename);
+    Problem p;
+    mp::ReadNLFile(filename, p);
+    std::string text = Write(p, file.name());
+    CheckEqual(ReadHeader(filename), ReadHeader(file.name()));
+    CheckEqual(GetStats(filename), GetStats(file.name()));
+    Problem text_problem;
+    mp::ReadNLFile(file.name(), text_problem);
+    EXPECT_EQ(text, Write(text_problem, file.name()));
+    Write(p, file.name(), NLHeader::BINARY);
+    CheckEqual(ReadHeader(filename), ReadHeader(file.name()));
+    CheckEqual(GetStats(filename), GetStats(file.name()));
+    Problem binary_problem;
+    mp::ReadNLFile(file.name(), binary_problem);
+    EXPECT_EQ(text, Write(binary_problem, file.name()));
+  }
+}
+}  // namespace
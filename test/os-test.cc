@@ -30,6 +30,7 @@
 #include <cerrno>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -200,6 +201,37 @@ TEST(OSTest, ConvertFileToMmapSize) {
   }
 }
 
+void CountCall(std::vector<int> *calls, int index) {
+  ++(*calls)[index];
+}
+
+TEST(OSTest, RunInParallel) {
+  for (int num_tasks = 0; num_tasks <= 4; ++num_tasks) {
+    std::vector<int> calls(num_tasks);
+    mp::internal::RunInParallel(
+          num_tasks, std::bind(CountCall, &calls, std::placeholders::_1));
+    EXPECT_EQ(std::vector<int>(num_tasks, 1), calls);
+  }
+}
+
+void FailTask(std::vector<int> *calls, int index) {
+  ++(*calls)[index];
+  if (index != 0)
+    throw mp::Error("task {} failed", index);
+}
+
+TEST(OSTest, RunInParallelRethrowsFirstError) {
+  std::vector<int> calls(4);
+  EXPECT_THROW_MSG(
+        mp::internal::RunInParallel(
+          4, std::bind(FailTask, &calls, std::placeholders::_1)),
+        mp::Error, "task 1 failed");
+#ifdef MP_USE_THREAD
+  // All tasks run to completion before the error is rethrown.
+  EXPECT_EQ(std::vector<int>(4, 1), calls);
+#endif
+}
+
 TEST(MemoryMappedFileTest, DefaultCtor) {
   MemoryMappedFile<> f;
   EXPECT_EQ(0, f.start());
@@ -226,6 +258,63 @@ TEST(MemoryMappedFileTest, MapWithSize) {
   EXPECT_EQ(2u, f.size());
 }
 
+TEST(MemoryMappedFileTest, MapWithHints) {
+  std::string filename = GetExecutableDir() + "/test";
+  WriteFile(filename, "abc");
+  namespace hint = mp::map_hint;
+  int hints[] = {
+    hint::SEQUENTIAL, hint::POPULATE, hint::HUGE_PAGES, hint::PREFETCH,
+    hint::SEQUENTIAL | hint::PREFETCH | hint::HUGE_PAGES
+  };
+  for (std::size_t i = 0; i < sizeof(hints) / sizeof(*hints); ++i) {
+    MemoryMappedFile<> f;
+    File file(filename, File::RDONLY);
+    f.map(file, filename, hints[i]);
+    EXPECT_EQ("abc", std::string(f.start(), 3));
+    EXPECT_EQ(3u, f.size());
+  }
+}
+
+TEST(MemoryMappedFileTest, Prefetch) {
+  // Use a file spanning several prefetch windows.
+  std::size_t size = 2 * MemoryMappedFile<>::PREFETCH_WINDOW_SIZE + 42;
+  std::string content(size, 'x');
+  for (std::size_t i = 0; i < size; i += 1000)
+    content[i] = static_cast<char>('a' + i % 26);
+  std::string filename = GetExecutableDir() + "/test";
+  WriteFile(filename, content);
+  File file(filename, File::RDONLY);
+  {
+    MemoryMappedFile<> f(file, size, mp::map_hint::PREFETCH);
+    EXPECT_EQ(content, std::string(f.start(), f.size()));
+  }
+  // Unmap while prefetching may still be in progress.
+  MemoryMappedFile<> f(file, size, mp::map_hint::PREFETCH);
+  f.map(file, size);
+  EXPECT_EQ(content[size - 1], f.start()[size - 1]);
+}
+
+TEST(MemoryMappedFileTest, Stats) {
+  mp::MappedFileStats stats = MemoryMappedFile<>().stats();
+  EXPECT_EQ(0, stats.num_minor_faults);
+  EXPECT_EQ(0, stats.num_major_faults);
+  EXPECT_EQ(0, stats.map_time);
+  EXPECT_EQ(0, stats.prefetch_time);
+  std::string filename = GetExecutableDir() + "/test";
+  WriteFile(filename, "abc");
+  File file(filename, File::RDONLY);
+  MemoryMappedFile<> f(file, 3, mp::map_hint::PREFETCH);
+  EXPECT_EQ('c', f.start()[2]);
+  stats = f.stats();
+#ifndef _WIN32
+  // Accessing the mapped page causes at least one page fault either
+  // on this thread or on the prefetch thread.
+  EXPECT_GT(stats.num_minor_faults + stats.num_major_faults, 0);
+#endif
+  EXPECT_GE(stats.map_time, 0);
+  EXPECT_GE(stats.prefetch_time, 0);
+}
+
 TEST(MemoryMappedFileTest, NegativeFileSizeInMap) {
   MockFile file;
   MemoryMappedFile<MockFile> f;
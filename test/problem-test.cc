@@ -20,6 +20,8 @@
  Author: Victor Zverovich
  */
 
+#include <type_traits>
+
 #include "gtest/gtest.h"
 #include "test-assert.h"
 
@@ -69,6 +71,21 @@ TEST(ProblemTest, LinearExpr) {
   EXPECT_EQ(10, e.capacity());
 }
 
+TEST(ProblemTest, LinearExprAddTerms) {
+  mp::LinearExpr e;
+  e.AddTerm(11, 2.2);
+  int *indices = 0;
+  double *coefs = 0;
+  e.AddTerms(2, indices, coefs);
+  indices[0] = 33;
+  indices[1] = 55;
+  coefs[0] = 4.4;
+  coefs[1] = 6.6;
+  const int expected_indices[] = {11, 33, 55};
+  const double expected_coefs[] = {2.2, 4.4, 6.6};
+  EXPECT_LINEAR_EXPR(e, expected_indices, expected_coefs);
+}
+
 TEST(ProblemTest, LinearExprIterator) {
   mp::LinearExpr e;
   e.AddTerm(11, 2.2);
@@ -406,7 +423,7 @@ TEST(ProblemTest, MutAlgebraicCon) {
   auto expr = p.MakeNumericConstant(42);
   con.set_nonlinear_expr(expr);
   EXPECT_EQ(expr, con.nonlinear_expr());
-  con.linear_expr().AddTerm(11, 2.2);
+  con.set_linear_expr(1).AddTerm(11, 2.2);
   const int indices[] = {11};
   const double coefs[] = {2.2};
   con.set_lb(3.3);
@@ -420,6 +437,370 @@ TEST(ProblemTest, MutAlgebraicCon) {
   ccon = con;
 }
 
+TEST(ProblemTest, LinearExprCopy) {
+  mp::LinearExpr e;
+  e.AddTerm(11, 2.2);
+  e.AddTerm(33, 4.4);
+  mp::LinearExpr copy(e);
+  e.AddTerm(55, 6.6);
+  const int indices[] = {11, 33};
+  const double coefs[] = {2.2, 4.4};
+  EXPECT_LINEAR_EXPR(copy, indices, coefs);
+  copy = e;
+  EXPECT_EQ(3, copy.num_terms());
+}
+
+TEST(ProblemTest, CSRLinearCons) {
+  Problem p;
+  p.set_linear_con_storage(Problem::LINEAR_CON_CSR);
+  EXPECT_EQ(Problem::LINEAR_CON_CSR, p.linear_con_storage());
+  p.AddVars(4, mp::var::CONTINUOUS);
+  p.AddAlgebraicCons(3);
+  // Set linear parts out of order.
+  Problem::LinearConBuilder builder = p.algebraic_con(2).set_linear_expr(1);
+  builder.AddTerm(3, 3.3);
+  builder = p.algebraic_con(0).set_linear_expr(2);
+  builder.AddTerm(0, 1.1);
+  builder.AddTerm(2, 2.2);
+  p.AddCon(0, 1).set_linear_expr(1).AddTerm(1, 4.4);
+  EXPECT_EQ(0, p.algebraic_con(1).linear_expr().num_terms());
+  const int indices0[] = {0, 2}, indices2[] = {3}, indices3[] = {1};
+  const double coefs0[] = {1.1, 2.2}, coefs2[] = {3.3}, coefs3[] = {4.4};
+  EXPECT_LINEAR_EXPR(p.algebraic_con(0).linear_expr(), indices0, coefs0);
+  EXPECT_LINEAR_EXPR(p.algebraic_con(2).linear_expr(), indices2, coefs2);
+  EXPECT_LINEAR_EXPR(p.algebraic_con(3).linear_expr(), indices3, coefs3);
+  // Add a term to a constraint that is not at the end of the block.
+  p.algebraic_con(2).set_linear_expr(1).AddTerm(0, 5.5);
+  const int indices2a[] = {3, 0};
+  const double coefs2a[] = {3.3, 5.5};
+  EXPECT_LINEAR_EXPR(p.algebraic_con(2).linear_expr(), indices2a, coefs2a);
+  // Modifying a copy doesn't affect the problem.
+  mp::LinearExpr expr = p.algebraic_con(0).linear_expr();
+  expr.AddTerm(3, 6.6);
+  EXPECT_EQ(3, expr.num_terms());
+  EXPECT_EQ(2, p.algebraic_con(0).linear_expr().num_terms());
+  // A mutable constraint only gives read access to its linear part.
+  EXPECT_TRUE((std::is_same<const mp::LinearExpr,
+               decltype(p.algebraic_con(3).linear_expr())>::value));
+  p.set_linear_con_storage(Problem::LINEAR_CON_EXPRS);
+  p.algebraic_con(3).set_linear_expr(1).AddTerm(2, 7.7);
+  EXPECT_LINEAR_EXPR(p.algebraic_con(0).linear_expr(), indices0, coefs0);
+  EXPECT_LINEAR_EXPR(p.algebraic_con(2).linear_expr(), indices2a, coefs2a);
+  EXPECT_EQ(2, p.algebraic_con(3).linear_expr().num_terms());
+}
+
+TEST(ProblemTest, AddCSRLinearConTerms) {
+  // NLReader decodes binary linear terms straight into the problem.
+  EXPECT_TRUE(mp::internal::HasAddTerms<Problem::LinearConBuilder>::value);
+  EXPECT_TRUE(mp::internal::HasAddTerms<Problem::LinearObjBuilder>::value);
+  Problem p;
+  p.set_linear_con_storage(Problem::LINEAR_CON_CSR);
+  p.AddVars(4, mp::var::CONTINUOUS);
+  p.AddAlgebraicCons(2);
+  int *indices = 0;
+  double *coefs = 0;
+  p.algebraic_con(0).set_linear_expr(1).AddTerms(1, indices, coefs);
+  indices[0] = 1;
+  coefs[0] = 1.1;
+  p.algebraic_con(1).set_linear_expr(1).AddTerms(1, indices, coefs);
+  indices[0] = 2;
+  coefs[0] = 2.2;
+  // Add terms to a constraint that is not at the end of the block.
+  p.algebraic_con(0).set_linear_expr(2).AddTerms(2, indices, coefs);
+  indices[0] = 0;
+  indices[1] = 3;
+  coefs[0] = 3.3;
+  coefs[1] = 4.4;
+  const int indices0[] = {1, 0, 3}, indices1[] = {2};
+  const double coefs0[] = {1.1, 3.3, 4.4}, coefs1[] = {2.2};
+  EXPECT_LINEAR_EXPR(p.algebraic_con(0).linear_expr(), indices0, coefs0);
+  EXPECT_LINEAR_EXPR(p.algebraic_con(1).linear_expr(), indices1, coefs1);
+}
+
+TEST(ProblemTest, ConvertToCSRLinearCons) {
+  Problem p;
+  p.AddCon(0, 1).set_linear_expr(2).AddTerm(1, 1.1);
+  p.AddCon(0, 1);
+  Problem::LinearConBuilder builder = p.AddCon(0, 1).set_linear_expr(2);
+  builder.AddTerm(0, 2.2);
+  builder.AddTerm(1, 3.3);
+  p.set_linear_con_storage(Problem::LINEAR_CON_CSR);
+  const int indices0[] = {1}, indices2[] = {0, 1};
+  const double coefs0[] = {1.1}, coefs2[] = {2.2, 3.3};
+  EXPECT_LINEAR_EXPR(p.algebraic_con(0).linear_expr(), indices0, coefs0);
+  EXPECT_EQ(0, p.algebraic_con(1).linear_expr().num_terms());
+  EXPECT_LINEAR_EXPR(p.algebraic_con(2).linear_expr(), indices2, coefs2);
+}
+
+TEST(ProblemTest, CompactCSRLinearCons) {
+  Problem p;
+  p.set_linear_con_storage(Problem::LINEAR_CON_CSR);
+  const int num_vars = 50;
+  p.AddVars(num_vars, mp::var::CONTINUOUS);
+  p.AddCon(0, 1);
+  p.AddCon(0, 1);
+  p.AddCon(0, 1).set_linear_expr(1).AddTerm(0, 1);
+  // Adding terms to constraints in turn moves each of them to the end of
+  // the block which triggers compaction.
+  for (int i = 0; i < num_vars; ++i) {
+    p.algebraic_con(0).set_linear_expr(1).AddTerm(i, i);
+    p.algebraic_con(1).set_linear_expr(1).AddTerm(num_vars - i - 1, -i);
+  }
+  for (int i = 0; i < 2; ++i) {
+    mp::LinearExpr expr = p.algebraic_con(i).linear_expr();
+    ASSERT_EQ(num_vars, expr.num_terms());
+    int j = 0;
+    for (mp::LinearExpr::iterator t = expr.begin(); t != expr.end(); ++t, ++j) {
+      EXPECT_EQ(i == 0 ? j : num_vars - j - 1, t->var_index());
+      EXPECT_EQ(i == 0 ? j : -j, t->coef());
+    }
+  }
+  const int indices2[] = {0};
+  const double coefs2[] = {1};
+  EXPECT_LINEAR_EXPR(p.algebraic_con(2).linear_expr(), indices2, coefs2);
+}
+
+TEST(ProblemTest, GetConMatrix) {
+  Problem p;
+  p.AddVars(3, mp::var::CONTINUOUS);
+  Problem::LinearConBuilder builder = p.AddCon(0, 1).set_linear_expr(2);
+  builder.AddTerm(2, 1.1);
+  builder.AddTerm(0, 2.2);
+  builder = p.AddCon(0, 1).set_linear_expr(2);
+  builder.AddTerm(0, 3.3);
+  builder.AddTerm(2, 4.4);
+  for (int i = 0; i < 2; ++i) {
+    mp::CSCMatrix m;
+    p.GetConMatrix(m);
+    EXPECT_EQ(3, m.num_cols());
+    EXPECT_EQ(4, m.num_elements());
+    const int col_starts[] = {0, 2, 2, 4};
+    const int row_indices[] = {0, 1, 0, 1};
+    const double values[] = {2.2, 3.3, 1.1, 4.4};
+    for (int j = 0; j <= m.num_cols(); ++j)
+      EXPECT_EQ(col_starts[j], m.col_start(j));
+    for (int j = 0; j < m.num_elements(); ++j) {
+      EXPECT_EQ(row_indices[j], m.row_index(j));
+      EXPECT_EQ(values[j], m.value(j));
+    }
+    p.set_linear_con_storage(Problem::LINEAR_CON_CSR);
+  }
+}
+
+TEST(ProblemTest, LinearExprSetCoef) {
+  mp::LinearExpr e;
+  e.AddTerm(1, 1.1);
+  e.AddTerm(3, 2.2);
+  EXPECT_EQ(1, e.FindTerm(3));
+  EXPECT_EQ(-1, e.FindTerm(2));
+  e.SetCoef(3, 4.4);
+  e.SetCoef(0, 5.5);
+  const int indices[] = {1, 3, 0};
+  const double coefs[] = {1.1, 4.4, 5.5};
+  EXPECT_LINEAR_EXPR(e, indices, coefs);
+}
+
+TEST(ProblemTest, SetCoef) {
+  for (int storage = Problem::LINEAR_CON_EXPRS;
+       storage <= Problem::LINEAR_CON_CSR; ++storage) {
+    Problem p;
+    p.set_linear_con_storage(static_cast<Problem::LinearConStorage>(storage));
+    p.AddVars(3, mp::var::CONTINUOUS);
+    p.AddCon(0, 1).set_linear_expr(1).AddTerm(1, 1.1);
+    p.AddCon(0, 1).set_linear_expr(1).AddTerm(2, 2.2);
+    p.AddObj(mp::obj::MIN).AddTerm(0, 3.3);
+    p.algebraic_con(0).set_coef(1, 4.4);
+    p.algebraic_con(0).set_coef(2, 5.5);
+    p.obj(0).set_coef(0, 6.6);
+    p.obj(0).set_coef(1, 7.7);
+    EXPECT_EQ(storage, p.linear_con_storage());
+    const int indices0[] = {1, 2}, indices1[] = {2}, obj_indices[] = {0, 1};
+    const double coefs0[] = {4.4, 5.5}, coefs1[] = {2.2};
+    const double obj_coefs[] = {6.6, 7.7};
+    EXPECT_LINEAR_EXPR(p.algebraic_con(0).linear_expr(), indices0, coefs0);
+    EXPECT_LINEAR_EXPR(p.algebraic_con(1).linear_expr(), indices1, coefs1);
+    EXPECT_LINEAR_EXPR(p.obj(0).linear_expr(), obj_indices, obj_coefs);
+    EXPECT_ASSERT(p.algebraic_con(0).set_coef(3, 1), "invalid index");
+    EXPECT_ASSERT(p.obj(0).set_coef(-1, 1), "invalid index");
+  }
+}
+
+TEST(ProblemTest, SetCoefInCSRInPlace) {
+  Problem p;
+  p.set_linear_con_storage(Problem::LINEAR_CON_CSR);
+  p.AddVars(2, mp::var::CONTINUOUS);
+  p.AddCon(0, 1).set_linear_expr(1).AddTerm(0, 1.1);
+  p.AddCon(0, 1).set_linear_expr(1).AddTerm(1, 2.2);
+  mp::LinearExpr::iterator begin = p.algebraic_con(0).linear_expr().begin();
+  p.algebraic_con(0).set_coef(0, 3.3);
+  // The constraint is not moved to the end of the block.
+  EXPECT_EQ(begin, p.algebraic_con(0).linear_expr().begin());
+  EXPECT_EQ(3.3, p.algebraic_con(0).linear_expr().begin()->coef());
+}
+
+// A change handler that formats replayed changes.
+struct ChangeWriter {
+  fmt::MemoryWriter w;
+  void SetVarLB(int index, double lb) { w.write("x{}>={} ", index, lb); }
+  void SetVarUB(int index, double ub) { w.write("x{}<={} ", index, ub); }
+  void SetConLB(int index, double lb) { w.write("c{}>={} ", index, lb); }
+  void SetConUB(int index, double ub) { w.write("c{}<={} ", index, ub); }
+  void SetObjCoef(int obj_index, int var_index, double coef) {
+    w.write("o{}[{}]={} ", obj_index, var_index, coef);
+  }
+  void SetConCoef(int con_index, int var_index, double coef) {
+    w.write("c{}[{}]={} ", con_index, var_index, coef);
+  }
+};
+
+TEST(ProblemTest, ChangeJournal) {
+  Problem p;
+  p.AddVars(2, mp::var::CONTINUOUS);
+  p.AddCon(0, 1);
+  p.AddObj(mp::obj::MIN);
+  EXPECT_FALSE(p.record_changes());
+  p.var(0).set_lb(1);
+  p.algebraic_con(0).set_coef(0, 1);
+  EXPECT_EQ(0, p.num_changes());
+  p.set_record_changes(true);
+  EXPECT_TRUE(p.record_changes());
+  p.var(0).set_lb(-1);
+  p.var(1).set_ub(2);
+  p.algebraic_con(0).set_lb(3);
+  p.algebraic_con(0).set_ub(4);
+  p.obj(0).set_coef(1, 5);
+  p.algebraic_con(0).set_coef(1, 6);
+  // Changes that are not recorded.
+  p.var(0).set_value(7);
+  p.AddVar(0, 1);
+  ASSERT_EQ(6, p.num_changes());
+  const mp::ProblemChange &change = p.change(5);
+  EXPECT_EQ(mp::ProblemChange::CON_COEF, change.kind);
+  EXPECT_EQ(0, change.index);
+  EXPECT_EQ(1, change.var_index);
+  EXPECT_EQ(6, change.value);
+  EXPECT_EQ(-1, p.change(0).var_index);
+  const int con_indices[] = {0, 1};
+  const double con_coefs[] = {1, 6};
+  EXPECT_LINEAR_EXPR(p.algebraic_con(0).linear_expr(), con_indices, con_coefs);
+  ChangeWriter writer;
+  p.ReplayChanges(writer);
+  EXPECT_EQ("x0>=-1 x1<=2 c0>=3 c0<=4 o0[1]=5 c0[1]=6 ", writer.w.str());
+  ChangeWriter tail_writer;
+  p.ReplayChanges(tail_writer, 4);
+  EXPECT_EQ("o0[1]=5 c0[1]=6 ", tail_writer.w.str());
+  EXPECT_ASSERT(p.ReplayChanges(tail_writer, 7), "invalid index");
+  p.ClearChanges();
+  EXPECT_EQ(0, p.num_changes());
+  EXPECT_ASSERT(p.change(0), "invalid index");
+}
+
+TEST(ProblemTest, ProblemOverlay) {
+  mp::ProblemOverlay overlay;
+  EXPECT_EQ(0, overlay.num_changes());
+  overlay.SetVarLB(0, -1);
+  overlay.SetVarUB(1, 2);
+  overlay.SetConLB(0, 3);
+  overlay.SetConUB(0, 4);
+  overlay.SetObjCoef(0, 1, 5);
+  overlay.SetConCoef(0, 1, 6);
+  ASSERT_EQ(6, overlay.num_changes());
+  EXPECT_EQ(mp::ProblemChange::OBJ_COEF, overlay.change(4).kind);
+  EXPECT_EQ(1, overlay.change(4).var_index);
+  EXPECT_ASSERT(overlay.change(6), "invalid index");
+  EXPECT_ASSERT(overlay.SetVarLB(-1, 0), "invalid index");
+  Problem p;
+  p.AddVars(2, mp::var::CONTINUOUS);
+  p.AddCon(0, 1).set_linear_expr(1).AddTerm(0, 1);
+  p.AddObj(mp::obj::MIN);
+  p.set_record_changes(true);
+  overlay.Apply(p);
+  EXPECT_EQ(-1, p.var(0).lb());
+  EXPECT_EQ(2, p.var(1).ub());
+  EXPECT_EQ(3, p.algebraic_con(0).lb());
+  EXPECT_EQ(4, p.algebraic_con(0).ub());
+  const int con_indices[] = {0, 1};
+  const double con_coefs[] = {1, 6};
+  EXPECT_LINEAR_EXPR(p.algebraic_con(0).linear_expr(), con_indices, con_coefs);
+  // Collect journaled changes in another overlay.
+  mp::ProblemOverlay journal;
+  p.ReplayChanges(journal);
+  ASSERT_EQ(6, journal.num_changes());
+  EXPECT_EQ(6, journal.change(5).value);
+}
+
+void CheckShareFrom(Problem::LinearConStorage storage) {
+  Problem base;
+  base.set_linear_con_storage(storage);
+  base.AddVar(1, 2, mp::var::INTEGER);
+  base.AddVar(3, 4);
+  base.AddObj(mp::obj::MAX, base.MakeVariable(0), 1).AddTerm(1, 5);
+  Problem::MutAlgebraicCon con = base.AddCon(6, 7);
+  Problem::LinearConBuilder linear = con.set_linear_expr(2);
+  linear.AddTerm(0, 8);
+  linear.AddTerm(1, 9);
+  con.set_nonlinear_expr(base.MakeVariable(1));
+  base.AddCon(10, 11).set_linear_expr(1).AddTerm(1, 12);
+  base.AddCon(base.MakeLogicalConstant(true));
+  base.AddCommonExpr(base.MakeVariable(1)).set_linear_expr(1).AddTerm(0, 13);
+  base.var(1).set_value(14);
+  base.AddFunction("foo", 1);
+  Problem p;
+  p.ShareFrom(base);
+  // Access the base problem via a const reference to make sure that
+  // the checks don't modify it.
+  const Problem &cbase = base;
+  ASSERT_EQ(2, p.num_vars());
+  EXPECT_EQ(1, p.var(0).lb());
+  EXPECT_EQ(4, p.var(1).ub());
+  EXPECT_EQ(mp::var::INTEGER, p.var(0).type());
+  EXPECT_EQ(14, p.var(1).value());
+  ASSERT_EQ(1, p.num_objs());
+  EXPECT_EQ(mp::obj::MAX, p.obj(0).type());
+  EXPECT_EQ(cbase.obj(0).nonlinear_expr(), p.obj(0).nonlinear_expr());
+  EXPECT_EQ(cbase.obj(0).linear_expr().begin(), p.obj(0).linear_expr().begin());
+  ASSERT_EQ(2, p.num_algebraic_cons());
+  EXPECT_EQ(10, p.algebraic_con(1).lb());
+  EXPECT_EQ(cbase.algebraic_con(0).nonlinear_expr(),
+            p.algebraic_con(0).nonlinear_expr());
+  EXPECT_EQ(cbase.algebraic_con(0).linear_expr().begin(),
+            p.algebraic_con(0).linear_expr().begin());
+  EXPECT_EQ(1, p.num_logical_cons());
+  EXPECT_EQ(cbase.logical_con(0).expr(), p.logical_con(0).expr());
+  ASSERT_EQ(1, p.num_common_exprs());
+  EXPECT_EQ(cbase.common_expr(0).linear_expr().begin(),
+            p.common_expr(0).linear_expr().begin());
+  ASSERT_EQ(1, p.num_functions());
+  EXPECT_EQ(base.function(0), p.function(0));
+  // Modifications are copied on write and don't affect the base problem.
+  p.var(0).set_lb(-1);
+  p.algebraic_con(1).set_ub(17);
+  p.algebraic_con(0).set_coef(1, 15);
+  p.obj(0).set_coef(1, 16);
+  EXPECT_EQ(1, cbase.var(0).lb());
+  EXPECT_EQ(-1, p.var(0).lb());
+  EXPECT_EQ(3, p.var(1).lb());
+  EXPECT_EQ(11, cbase.algebraic_con(1).ub());
+  EXPECT_EQ(17, p.algebraic_con(1).ub());
+  EXPECT_EQ(6, p.algebraic_con(0).lb());
+  const int indices[] = {0, 1};
+  const double base_coefs[] = {8, 9}, coefs[] = {8, 15};
+  EXPECT_LINEAR_EXPR(cbase.algebraic_con(0).linear_expr(), indices, base_coefs);
+  EXPECT_LINEAR_EXPR(p.algebraic_con(0).linear_expr(), indices, coefs);
+  EXPECT_NE(cbase.algebraic_con(0).linear_expr().begin(),
+            p.algebraic_con(0).linear_expr().begin());
+  EXPECT_EQ(cbase.algebraic_con(1).linear_expr().begin(),
+            p.algebraic_con(1).linear_expr().begin());
+  EXPECT_EQ(5, cbase.obj(0).linear_expr().begin()->coef());
+  EXPECT_EQ(16, p.obj(0).linear_expr().begin()->coef());
+  EXPECT_ASSERT(base.ShareFrom(p), "problem not empty");
+}
+
+TEST(ProblemTest, ShareFrom) {
+  CheckShareFrom(Problem::LINEAR_CON_EXPRS);
+  CheckShareFrom(Problem::LINEAR_CON_CSR);
+}
+
 TEST(ProblemTest, AddLogicalCon) {
   Problem p;
   EXPECT_EQ(0, p.num_logical_cons());
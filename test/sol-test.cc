@@ -0,0 +1,246 @@
+/*
+ .sol writer tests
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "mp/sol.h"
+#include "mp/suffix.h"
+#include "util.h"
+
+using mp::internal::SolOutput;
+
+namespace {
+
+std::string FormatDouble(double value) {
+  char buffer[32];
+  return std::string(buffer, SolOutput::FormatDouble(buffer, value));
+}
+
+TEST(SolTest, FormatInt) {
+  char buffer[32];
+  EXPECT_EQ("0", std::string(buffer, SolOutput::FormatInt(buffer, 0)));
+  EXPECT_EQ("-42", std::string(buffer, SolOutput::FormatInt(buffer, -42)));
+}
+
+TEST(SolTest, FormatDouble) {
+  EXPECT_EQ("0", FormatDouble(0));
+  EXPECT_EQ("-0", FormatDouble(-0.0));
+  EXPECT_EQ("1", FormatDouble(1));
+  EXPECT_EQ("-42", FormatDouble(-42));
+  EXPECT_EQ("0.1", FormatDouble(0.1));
+  EXPECT_EQ("0.30000000000000004", FormatDouble(0.1 + 0.2));
+  EXPECT_EQ("0.3333333333333333", FormatDouble(1.0 / 3));
+  EXPECT_EQ("1.5e-10", FormatDouble(1.5e-10));
+  EXPECT_EQ("1e+300", FormatDouble(1e300));
+  EXPECT_EQ("123456789012345", FormatDouble(123456789012345.0));
+  EXPECT_EQ("10000000000000000", FormatDouble(1e16));
+  EXPECT_EQ("1e+17", FormatDouble(1e17));
+  EXPECT_EQ("Infinity", FormatDouble(std::numeric_limits<double>::infinity()));
+  EXPECT_EQ("-Infinity",
+            FormatDouble(-std::numeric_limits<double>::infinity()));
+  EXPECT_EQ("NaN", FormatDouble(std::numeric_limits<double>::quiet_NaN()));
+  EXPECT_EQ("-1.7976931348623157e+308",
+            FormatDouble(-std::numeric_limits<double>::max()));
+  EXPECT_EQ("5e-324", FormatDouble(std::numeric_limits<double>::denorm_min()));
+  EXPECT_EQ("1234.5", FormatDouble(1234.5));
+  EXPECT_EQ("0.0001", FormatDouble(1e-4));
+  EXPECT_EQ("1.5e-05", FormatDouble(1.5e-5));
+  EXPECT_EQ("1000000000000000", FormatDouble(1e15));
+  EXPECT_EQ("1.2345678901234568e+17", FormatDouble(123456789012345678.0));
+}
+
+TEST(SolTest, FormatDoubleRoundTrip) {
+  double value = 1;
+  for (int i = 0; i < 10000; ++i) {
+    value = std::sin(value + i) * std::pow(10.0, i % 40 - 20);
+    std::string s = FormatDouble(value);
+    EXPECT_EQ(value, std::strtod(s.c_str(), 0)) << s;
+  }
+  // Check random bit patterns including subnormal numbers.
+  fmt::ULongLong bits = 1;
+  for (int i = 0; i < 100000; ++i) {
+    bits = bits * 6364136223846793005ull + 1442695040888963407ull;
+    std::memcpy(&value, &bits, sizeof(value));
+    if (value != value)
+      continue;
+    std::string s = FormatDouble(value);
+    EXPECT_EQ(value, std::strtod(s.c_str(), 0)) << s;
+  }
+}
+
+// A solution with a suffix table.
+class TestSolution {
+ private:
+  mp::SuffixManager suffixes_;
+
+ public:
+  std::vector<int> options;
+  std::vector<double> values;
+  std::vector<double> dual_values;
+
+  mp::SuffixManager &suffix_manager() { return suffixes_; }
+
+  int status() const { return 100; }
+  const char *message() const { return "test\n\nmessage"; }
+
+  int num_options() const { return static_cast<int>(options.size()); }
+  int option(int index) const { return options[index]; }
+
+  int num_values() const { return static_cast<int>(values.size()); }
+  double value(int index) const { return values[index]; }
+
+  int num_dual_values() const { return static_cast<int>(dual_values.size()); }
+  double dual_value(int index) const { return dual_values[index]; }
+
+  const mp::SuffixSet *suffixes(mp::suf::Kind kind) const {
+    return &suffixes_.suffixes(kind);
+  }
+
+  const char *suffix_table(const char *name) const {
+    return std::strcmp(name, "status") == 0 ? "0\tbas\n1\tsup" : 0;
+  }
+};
+
+// Adds suffixes to a solution.
+void AddSuffixes(TestSolution &sol) {
+  mp::MutIntSuffix status = sol.suffix_manager().suffixes(mp::suf::VAR).
+      Add<int>("status", mp::suf::VAR | mp::suf::OUTPUT, 3);
+  status.set_value(2, 1);
+  mp::MutDoubleSuffix dual = sol.suffix_manager().suffixes(mp::suf::CON).
+      Add<double>("dual", mp::suf::CON | mp::suf::OUTPUT, 1);
+  dual.set_value(0, 0.25);
+  // Suffixes that are not written.
+  sol.suffix_manager().suffixes(mp::suf::VAR).
+      Add<int>("input", mp::suf::VAR, 3).set_value(0, 1);
+  sol.suffix_manager().suffixes(mp::suf::OBJ).
+      Add<int>("zero", mp::suf::OBJ | mp::suf::OUTPUT, 1);
+}
+
+void BuildTestSolution(TestSolution &sol) {
+  sol.options.push_back(3);
+  sol.options.push_back(1);
+  sol.values.push_back(1);
+  sol.values.push_back(0.1);
+  sol.values.push_back(-2.5);
+  sol.dual_values.push_back(1e-20);
+  AddSuffixes(sol);
+}
+
+TEST(SolTest, WriteSolFile) {
+  TestSolution sol;
+  BuildTestSolution(sol);
+  TempFile file("test-text.sol");
+  mp::WriteSolFile(file.name(), sol);
+  EXPECT_EQ(
+        "test\n \nmessage\n\n"
+        "Options\n2\n3\n1\n"
+        "1\n1\n3\n3\n"
+        "1e-20\n1\n0.1\n-2.5\n"
+        "objno 0 100\n"
+        "suffix 0 1 7 12 0\nstatus\n0\tbas\n1\tsup\n2 1\n"
+        "suffix 5 1 5 0 0\ndual\n0 0.25\n",
+        ReadFile(file.name()));
+}
+
+// Builds the expected output in the binary .sol format.
+class BinaryOutput {
+ private:
+  std::string data_;
+
+ public:
+  const std::string &str() const { return data_; }
+
+  template <typename T>
+  BinaryOutput &operator<<(T value) {
+    data_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    return *this;
+  }
+
+  // Adds a record containing a string.
+  void AddRecord(const std::string &s) {
+    int size = static_cast<int>(s.size());
+    *this << size;
+    data_ += s;
+    *this << size;
+  }
+};
+
+TEST(SolTest, WriteBinarySolFile) {
+  TestSolution sol;
+  BuildTestSolution(sol);
+  TempFile file("test-binary.sol");
+  mp::WriteSolFile(file.name(), sol, mp::sol::BINARY);
+  BinaryOutput out;
+  out.AddRecord("binary");
+  out.AddRecord("test");
+  out.AddRecord(" ");
+  out.AddRecord("message");
+  out.AddRecord("");
+  out.AddRecord("Options");
+  out << 28 << 2 << 3 << 1 << 1 << 1 << 3 << 3 << 28;
+  out << 8 << 1e-20 << 8;
+  out << 24 << 1.0 << 0.1 << -2.5 << 24;
+  out << 8 << 0 << 100 << 8;
+  out << 20 << 0 << 1 << 7 << 12 << 0 << 20;
+  out.AddRecord("status");
+  out.AddRecord("0\tbas\n1\tsup");
+  out << 8 << 2 << 1 << 8;
+  out << 20 << 5 << 1 << 5 << 0 << 0 << 20;
+  out.AddRecord("dual");
+  out << 12 << 0 << 0.25 << 12;
+  EXPECT_EQ(out.str(), ReadFile(file.name()));
+}
+
+TEST(SolTest, WriteBinarySolFileWithoutValues) {
+  TestSolution sol;
+  TempFile file("test-binary-empty.sol");
+  mp::WriteSolFile(file.name(), sol, mp::sol::BINARY);
+  BinaryOutput out;
+  out.AddRecord("binary");
+  out.AddRecord("test");
+  out.AddRecord(" ");
+  out.AddRecord("message");
+  out.AddRecord("");
+  out.AddRecord("Options");
+  out << 20 << 0 << 0 << 0 << 0 << 0 << 20;
+  out << 8 << 0 << 100 << 8;
+  EXPECT_EQ(out.str(), ReadFile(file.name()));
+}
+
+TEST(SolTest, WriteLargeSolFile) {
+  TestSolution sol;
+  const int NUM_VALUES = 100000;
+  std::string expected = "test\n \nmessage\n\nOptions\n0\n0\n0\n";
+  expected += fmt::format("{0}\n{0}\n", NUM_VALUES);
+  for (int i = 0; i < NUM_VALUES; ++i) {
+    sol.values.push_back(i + 0.5);
+    expected += fmt::format("{}.5\n", i);
+  }
+  expected += "objno 0 100\n";
+  TempFile file("test-large.sol");
+  mp::WriteSolFile(file.name(), sol);
+  EXPECT_EQ(expected, ReadFile(file.name()));
+}
+}  // namespace
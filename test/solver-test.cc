@@ -29,9 +29,20 @@
 #include "util.h"
 
 #include <cstdio>
+#include <cstring>
+#include <functional>
+
+#ifdef MP_USE_THREAD
+# include <chrono>
+# include <thread>
+#endif
 
 #ifdef _WIN32
 # define putenv _putenv
+#else
+# include <unistd.h>
+# include <sys/socket.h>
+# include <sys/un.h>
 #endif
 
 #ifndef MP_TEST_DATA_DIR
@@ -410,6 +421,173 @@ TEST(SolverTest, SignalHandlerExitOnTwoSIGINTs) {
       ReadFile("out"));
 }
 
+TEST(CancellationTokenTest, Cancel) {
+  mp::CancellationToken token;
+  EXPECT_FALSE(token.Stop());
+  token.Cancel();
+  EXPECT_TRUE(token.Stop());
+  token.Cancel();
+  EXPECT_TRUE(token.Stop());
+}
+
+bool CountInterrupts(void *data) {
+  ++*static_cast<int*>(data);
+  return true;
+}
+
+TEST(CancellationTokenTest, Parent) {
+  mp::CancellationToken parent;
+  mp::CancellationToken child1(&parent), child2(&parent);
+  mp::CancellationToken grandchild(&child1);
+  int count1 = 0, count2 = 0;
+  child1.SetHandler(CountInterrupts, &count1);
+  grandchild.SetHandler(CountInterrupts, &count2);
+  child2.Cancel();
+  EXPECT_FALSE(parent.Stop());
+  EXPECT_FALSE(child1.Stop());
+  EXPECT_TRUE(child2.Stop());
+  EXPECT_EQ(0, count1);
+  parent.Cancel();
+  EXPECT_TRUE(child1.Stop());
+  EXPECT_TRUE(grandchild.Stop());
+  EXPECT_EQ(1, count1);
+  EXPECT_EQ(1, count2);
+  parent.Cancel();
+  EXPECT_EQ(1, count1);
+}
+
+TEST(CancellationTokenTest, DestroyChild) {
+  mp::CancellationToken parent;
+  int count = 0;
+  {
+    mp::CancellationToken child(&parent);
+    child.SetHandler(CountInterrupts, &count);
+  }
+  mp::CancellationToken child(&parent);
+  parent.Cancel();
+  EXPECT_TRUE(child.Stop());
+  EXPECT_EQ(0, count);
+}
+
+TEST(CancellationTokenTest, SetHandlerAfterCancel) {
+  mp::CancellationToken parent;
+  parent.Cancel();
+  mp::CancellationToken child(&parent);
+  int count = 0;
+  child.SetHandler(CountInterrupts, &count);
+  EXPECT_EQ(1, count);
+}
+
+TEST(CancellationTokenTest, Deadline) {
+  mp::CancellationToken parent;
+  parent.set_time_limit(1000);
+  mp::CancellationToken child(&parent);
+  EXPECT_FALSE(child.Stop());
+  parent.set_deadline(mp::steady_clock::now());
+  EXPECT_TRUE(parent.Stop());
+  EXPECT_TRUE(child.Stop());
+  mp::CancellationToken token;
+  token.set_time_limit(0);
+  EXPECT_TRUE(token.Stop());
+}
+
+TEST(CancellationTokenTest, LargeTimeLimit) {
+  mp::CancellationToken token;
+  token.set_time_limit(1e300);
+  EXPECT_FALSE(token.Stop());
+  token.set_time_limit(std::numeric_limits<double>::infinity());
+  EXPECT_FALSE(token.Stop());
+}
+
+// Cancels the token passed as data.
+bool CancelToken(void *data) {
+  static_cast<mp::CancellationToken*>(data)->Cancel();
+  return true;
+}
+
+TEST(CancellationTokenTest, HandlerCancelsToken) {
+  mp::CancellationToken token, other;
+  token.SetHandler(CancelToken, &other);
+  int count = 0;
+  other.SetHandler(CountInterrupts, &count);
+  token.Cancel();
+  EXPECT_TRUE(other.Stop());
+  EXPECT_EQ(1, count);
+}
+
+#ifdef MP_USE_THREAD
+bool CountInterruptsAtomic(void *data) {
+  mp::internal::atomic<int> &count =
+      *static_cast<mp::internal::atomic<int>*>(data);
+  count = count + 1;
+  return true;
+}
+
+// Waits up to 10 seconds for count to become nonzero.
+int WaitForInterrupt(const mp::internal::atomic<int> &count) {
+  for (int i = 0; i < 1000 && count == 0; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  return count;
+}
+
+TEST(CancellationTokenTest, DeadlineCallsHandler) {
+  mp::CancellationToken token;
+  mp::internal::atomic<int> count(0);
+  token.SetHandler(CountInterruptsAtomic, &count);
+  token.set_time_limit(0.01);
+  EXPECT_EQ(1, WaitForInterrupt(count));
+  EXPECT_TRUE(token.Stop());
+}
+
+TEST(CancellationTokenTest, ParentDeadlineCallsChildHandler) {
+  mp::CancellationToken parent;
+  mp::CancellationToken child(&parent);
+  mp::internal::atomic<int> count(0);
+  child.SetHandler(CountInterruptsAtomic, &count);
+  parent.set_deadline(mp::steady_clock::now());
+  EXPECT_EQ(1, WaitForInterrupt(count));
+}
+
+TEST(CancellationTokenTest, DeadlineHandlerCancelsToken) {
+  mp::CancellationToken token, other;
+  token.SetHandler(CancelToken, &other);
+  mp::internal::atomic<int> count(0);
+  other.SetHandler(CountInterruptsAtomic, &count);
+  token.set_time_limit(0.01);
+  EXPECT_EQ(1, WaitForInterrupt(count));
+}
+
+TEST(CancellationTokenTest, RemoveHandler) {
+  mp::CancellationToken token;
+  mp::internal::atomic<int> count(0);
+  token.SetHandler(CountInterruptsAtomic, &count);
+  token.SetHandler(0, 0);
+  token.set_time_limit(0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(0, count);
+}
+#endif
+
+TEST(CancellationTokenTest, CancelOnSigInt) {
+  std::signal(SIGINT, SIG_DFL);
+  TestSolver s;
+  EXPECT_EXIT({
+    FILE *f = freopen("out", "w", stdout);
+    mp::internal::SignalHandler sh(s);
+    mp::CancellationToken token;
+    mp::CancellationToken other;
+    token.CancelOnSigInt();
+    fmt::print("{}", token.Stop());
+    std::fflush(stdout);
+    std::raise(SIGINT);
+    fmt::print("{}", token.Stop());
+    fmt::print(" {}", other.Stop());
+    fclose(f);
+    exit(0);
+  }, ::testing::ExitedWithCode(0), "");
+  EXPECT_EQ("false\n<BREAK> (testsolver)\ntrue false", ReadFile("out"));
+}
+
 #ifdef _WIN32
 TEST(SignalRepeaterTest, NullPipeInfo) {
   mp::internal::SignalRepeater repeater(0);
@@ -1212,6 +1390,32 @@ TEST_F(SolverAppOptionParserTest, SOption) {
   EXPECT_EQ(1, solver_.wantsol());
 }
 
+// Test -b option.
+TEST_F(SolverAppOptionParserTest, BOption) {
+  EXPECT_FALSE(parser_.server_mode());
+  Args args("unused", "-b");
+  char **argp = args, **argp_copy = argp;
+  EXPECT_STREQ("", parser_.Parse(argp_copy));
+  EXPECT_EQ(argp + 2, argp_copy);
+  EXPECT_TRUE(parser_.server_mode());
+  EXPECT_EQ("", handler_.output);
+  // Solver options are passed when reading jobs from stdin.
+  Args args2("unused", "-b", "wantsol=1", "objno=2");
+  argp = args2, argp_copy = argp;
+  EXPECT_STREQ("", parser_.Parse(argp_copy));
+  EXPECT_EQ(argp + 2, argp_copy);
+  EXPECT_STREQ("wantsol=1", argp_copy[0]);
+  EXPECT_STREQ("objno=2", argp_copy[1]);
+  EXPECT_EQ(0, argp_copy[2]);
+  Args args3("unused", "-b", "wantsol=1", "socket=path", "objno=2");
+  argp = args3, argp_copy = argp;
+  EXPECT_STREQ("path", parser_.Parse(argp_copy));
+  EXPECT_EQ(argp + 2, argp_copy);
+  EXPECT_STREQ("wantsol=1", argp_copy[0]);
+  EXPECT_STREQ("objno=2", argp_copy[1]);
+  EXPECT_EQ(0, argp_copy[2]);
+}
+
 // Test -AMPL option.
 TEST_F(SolverAppOptionParserTest, AMPLOption) {
   EXPECT_EQ(0, solver_.wantsol());
@@ -1477,7 +1681,7 @@ TEST_F(SolverAppTest, ParseOptions) {
 TEST_F(SolverAppTest, StandardOptions) {
   mp::OptionList &options = app_.options();
   options.Sort();
-  char std_options[] = {'-', '=', '?', 'e', 's', 'v'};
+  char std_options[] = {'-', '=', '?', 'b', 'e', 's', 'v'};
   for (std::size_t i = 0, n = sizeof(std_options); i < n; ++i) {
     char opt = std_options[i];
     EXPECT_TRUE(options.Find(opt) != 0) << "option -" << opt;
@@ -1689,3 +1893,349 @@ TEST(ObjNoTest, InvalidObjNo) {
   app.solver().SetIntOption("objno", 3);
   EXPECT_THROW(app.Run(Args("test", "testproblem")), mp::InvalidOptionValue);
 }
+
+// An NLReader that reads an empty problem.
+struct EmptyNLReader {
+  template <typename NLHandler>
+  void Read(fmt::StringRef, NLHandler &, int) {}
+};
+
+typedef mp::SolverServer<TestSolver, EmptyNLReader> TestServer;
+
+// Runs jobs on a server and returns job reports.
+std::string Serve(mp::internal::SolverServerBase &server,
+                  fmt::StringRef jobs) {
+  fmt::File in_read, in_write, out_read, out_write;
+  fmt::File::pipe(in_read, in_write);
+  fmt::File::pipe(out_read, out_write);
+  in_write.write(jobs.data(), jobs.size());
+  in_write.close();
+  server.Serve(in_read, out_write);
+  out_write.close();
+  std::string output;
+  char buffer[BUFSIZ];
+  while (std::size_t count = out_read.read(buffer, sizeof(buffer)))
+    output.append(buffer, count);
+  return output;
+}
+
+// Replaces latencies in job reports with "T".
+std::string StripLatency(const std::string &output) {
+  std::string result;
+  std::string::size_type pos = 0;
+  while (pos != output.size()) {
+    std::string::size_type end = output.find('\n', pos) + 1;
+    std::string line = output.substr(pos, end - pos);
+    if (line[0] != '#') {
+      std::string::size_type start = line.find(' ', line.find(' ') + 1) + 1;
+      line.replace(start, line.find(' ', start) - start, "T");
+    }
+    result += line;
+    pos = end;
+  }
+  return result;
+}
+
+TEST(SolverServerTest, Serve) {
+  TestServer server;
+  EXPECT_EQ(1, server.num_workers());
+  EXPECT_EQ("1 ok T a\n2 ok T b\n",
+            StripLatency(Serve(server, "a\n\n# comment\n  b  \n")));
+}
+
+TEST(SolverServerTest, QuitStopsServing) {
+  TestServer server;
+  EXPECT_EQ("1 ok T a\n", StripLatency(Serve(server, "a\nquit\nb\n")));
+}
+
+TEST(SolverServerTest, ReportError) {
+  TestServer server;
+  EXPECT_EQ("# Unknown option \"badopt\"\n"
+            "1 error T a: invalid solver options\n2 ok T b\n",
+            StripLatency(Serve(server, "a badopt=1\nb")));
+}
+
+// A server that throws an exception which is not derived from
+// std::exception for jobs with the stub "bad".
+class ThrowingServer : public mp::internal::SolverServerBase {
+ protected:
+  void RunJob(int, const Job &job, fmt::Writer &) {
+    if (job.stub == "bad")
+      throw 42;
+  }
+
+ public:
+  explicit ThrowingServer(int num_workers) : SolverServerBase(num_workers) {}
+};
+
+TEST(SolverServerTest, ReportUnknownException) {
+  ThrowingServer server(1);
+  EXPECT_EQ("1 error T bad: unknown exception\n2 ok T a\n",
+            StripLatency(Serve(server, "bad\na\n")));
+}
+
+// Runs jobs writing reports to a file open for reading only.
+void CheckWriteError(int num_workers) {
+  fmt::File in_read, in_write;
+  fmt::File::pipe(in_read, in_write);
+  const char jobs[] = "a\nb\nbad\nc\n";
+  in_write.write(jobs, sizeof(jobs) - 1);
+  in_write.close();
+  TempFile file("server-output");
+  WriteFile(file.name(), "");
+  fmt::File out(file.name(), fmt::File::RDONLY);
+  ThrowingServer server(num_workers);
+  EXPECT_THROW(server.Serve(in_read, out), fmt::SystemError);
+}
+
+TEST(SolverServerTest, WriteError) {
+  CheckWriteError(1);
+#ifdef MP_USE_THREAD
+  CheckWriteError(4);
+#endif
+}
+
+TEST(SolverServerTest, RestoreOptions) {
+  TestServer server;
+  Args args("objno=2");
+  EXPECT_TRUE(server.SetOptions(args, TestSolver::NO_OPTION_ECHO));
+  Serve(server, "a objno=0 timing=1\n");
+  EXPECT_EQ(0, server.solver().GetIntOption("objno"));
+  EXPECT_EQ(1, server.solver().GetIntOption("timing"));
+  Serve(server, "a\n");
+  EXPECT_EQ(2, server.solver().GetIntOption("objno"));
+  EXPECT_EQ(0, server.solver().GetIntOption("timing"));
+}
+
+TEST(SolverServerTest, SolverOutput) {
+  TestServer server;
+  std::string output = StripLatency(Serve(server, "a timing=1\n"));
+  EXPECT_THAT(output, StartsWith("# Input time = "));
+  EXPECT_THAT(output, testing::EndsWith("s\n1 ok T a\n"));
+}
+
+TEST(SolverServerTest, RunWithOptionsFromStdin) {
+  fmt::File in_read, in_write, out_read, out_write;
+  fmt::File::pipe(in_read, in_write);
+  fmt::File::pipe(out_read, out_write);
+  const char jobs[] = "a\n";
+  in_write.write(jobs, sizeof(jobs) - 1);
+  in_write.close();
+  fmt::File saved_stdin = fmt::File::dup(0);
+  fmt::File saved_stdout = fmt::File::dup(1);
+  std::fflush(stdout);
+  in_read.dup2(0);
+  out_write.dup2(1);
+  out_write.close();
+  mp::SolverApp<TestSolver, EmptyNLReader> app;
+  int result = app.Run(Args("test", "-b", "-e", "timing=1"));
+  saved_stdin.dup2(0);
+  saved_stdout.dup2(1);
+  EXPECT_EQ(0, result);
+  std::string output;
+  char buffer[BUFSIZ];
+  while (std::size_t count = out_read.read(buffer, sizeof(buffer)))
+    output.append(buffer, count);
+  output = StripLatency(output);
+  EXPECT_THAT(output, StartsWith("# Input time = "));
+  EXPECT_THAT(output, testing::EndsWith("s\n1 ok T a\n"));
+}
+
+#ifdef MP_USE_THREAD
+TEST(SolverServerTest, MultipleWorkers) {
+  TestServer server(4);
+  EXPECT_EQ(4, server.num_workers());
+  fmt::MemoryWriter jobs;
+  const int NUM_JOBS = 20;
+  for (int i = 0; i < NUM_JOBS; ++i)
+    jobs << "job" << i << " objno=" << i % 2 << '\n';
+  std::string output = "\n" + Serve(server, jobs.str());
+  for (int i = 0; i < NUM_JOBS; ++i) {
+    EXPECT_NE(std::string::npos, output.find(fmt::format("\n{} ok ", i + 1)));
+    EXPECT_NE(std::string::npos, output.find(fmt::format(" job{}\n", i)));
+  }
+  EXPECT_EQ(NUM_JOBS + 1, std::count(output.begin(), output.end(), '\n'));
+}
+#endif
+
+#ifndef _WIN32
+TEST(SolverServerTest, ListenKeepsOtherFiles) {
+  TempFile file("server-not-socket");
+  WriteFile(file.name(), "data");
+  TestServer server;
+  EXPECT_THROW_MSG(server.Listen(file.name()), mp::Error,
+                   "server-not-socket exists and is not a socket");
+  EXPECT_EQ("data", ReadFile(file.name()));
+}
+
+# ifdef MP_USE_THREAD
+// Connects to a server listening on a socket, sends jobs and returns
+// the output if read_output is true.
+std::string SendJobs(const char *path, fmt::StringRef jobs, bool read_output) {
+  sockaddr_un addr = sockaddr_un();
+  addr.sun_family = AF_UNIX;
+  std::strcpy(addr.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  fmt::File sock = fmt::File::dup(fd);
+  ::close(fd);
+  // Wait for the server to start listening.
+  while (connect(sock.descriptor(), reinterpret_cast<sockaddr*>(&addr),
+                 sizeof(addr)) != 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  sock.write(jobs.data(), jobs.size());
+  std::string output;
+  if (!read_output)
+    return output;
+  shutdown(sock.descriptor(), SHUT_WR);
+  char buffer[BUFSIZ];
+  while (std::size_t count = sock.read(buffer, sizeof(buffer)))
+    output.append(buffer, count);
+  return output;
+}
+
+struct Client {
+  const char *path;
+  std::string output;
+
+  void operator()() {
+    // The first client disconnects without reading its report.
+    SendJobs(path, "a\n", false);
+    output = SendJobs(path, "b\nquit\n", true);
+  }
+};
+
+TEST(SolverServerTest, ListenAfterClientDisconnects) {
+  const char *path = "server-socket";
+  TestServer server;
+  Client client = {path, ""};
+  std::thread thread(std::ref(client));
+  server.Listen(path);
+  thread.join();
+  EXPECT_EQ("2 ok T b\n", StripLatency(client.output));
+}
+# endif
+#endif
+
+// A solver that sets variables to their upper bounds.
+struct UBSolver : mp::SolverImpl<mp::Problem> {
+  UBSolver() : mp::SolverImpl<mp::Problem>("ubsolver", 0, 0, REENTRANT) {}
+
+  void Solve(mp::Problem &p, mp::SolutionHandler &sh) {
+    if (p.num_vars() == 0 || p.var(0).ub() < 0)
+      throw mp::Error("invalid bound");
+    std::vector<double> values(p.num_vars());
+    for (int i = 0, n = p.num_vars(); i < n; ++i)
+      values[i] = p.var(i).ub();
+    double obj_value = 0;
+    const mp::LinearExpr &obj = p.obj(0).linear_expr();
+    for (mp::LinearExpr::iterator i = obj.begin(); i != obj.end(); ++i)
+      obj_value += i->coef() * values[i->var_index()];
+    sh.HandleSolution(mp::sol::SOLVED, "solved", values.data(), 0, obj_value);
+  }
+};
+
+// A solver that runs until interrupted.
+struct InterruptibleSolver : mp::SolverImpl<mp::Problem> {
+  InterruptibleSolver()
+    : mp::SolverImpl<mp::Problem>("isolver", 0, 0, REENTRANT) {}
+
+  void Solve(mp::Problem &, mp::SolutionHandler &sh) {
+    while (!interrupter()->Stop())
+      ;
+    sh.HandleSolution(mp::sol::INTERRUPTED, "stopped", 0, 0, 0);
+  }
+};
+
+void CheckScenarioDriver(int num_workers) {
+  mp::Problem base;
+  base.AddVar(0, 1);
+  base.AddVar(0, 2);
+  mp::Problem::LinearObjBuilder obj = base.AddObj(mp::obj::MAX, 2);
+  obj.AddTerm(0, 1);
+  obj.AddTerm(1, 10);
+  mp::ScenarioDriver<UBSolver> driver(base, num_workers);
+  EXPECT_EQ(num_workers, driver.num_workers());
+  const int NUM_SCENARIOS = 10;
+  for (int i = 0; i < NUM_SCENARIOS; ++i) {
+    mp::ProblemOverlay overlay;
+    overlay.SetVarUB(0, i == 3 ? -1 : i);
+    overlay.SetObjCoef(0, 1, i);
+    driver.AddScenario(fmt::format("scenario{}", i), overlay);
+  }
+  EXPECT_EQ(NUM_SCENARIOS, driver.num_scenarios());
+  driver.Solve();
+  for (int i = 0; i < NUM_SCENARIOS; ++i) {
+    const mp::ScenarioDriver<UBSolver>::Result &result = driver.result(i);
+    std::string sol_filename = fmt::format("scenario{}.sol", i);
+    if (i == 3) {
+      EXPECT_EQ(mp::sol::FAILURE, result.status);
+      EXPECT_EQ("invalid bound", result.message);
+      EXPECT_NE(0, std::remove(sol_filename.c_str()));
+      continue;
+    }
+    EXPECT_EQ(mp::sol::SOLVED, result.status);
+    EXPECT_EQ("solved", result.message);
+    EXPECT_EQ(i + 2 * i, result.obj_value);
+    EXPECT_EQ(0, std::remove(sol_filename.c_str()));
+  }
+  // The base problem is not modified.
+  EXPECT_EQ(1, base.var(0).ub());
+  mp::LinearExpr::iterator term = base.obj(0).linear_expr().begin();
+  EXPECT_EQ(10, (++term)->coef());
+}
+
+TEST(ScenarioDriverTest, Solve) {
+  CheckScenarioDriver(1);
+}
+
+#ifdef MP_USE_THREAD
+TEST(ScenarioDriverTest, MultipleWorkers) {
+  CheckScenarioDriver(4);
+}
+#endif
+
+// A solver that is not reentrant.
+struct SerialSolver : mp::SolverImpl<mp::Problem> {
+  SerialSolver() : mp::SolverImpl<mp::Problem>("serial", 0, 0, 0) {}
+
+  void Solve(mp::Problem &, mp::SolutionHandler &) {}
+};
+
+TEST(ScenarioDriverTest, NonReentrantSolverUsesOneWorker) {
+  mp::Problem base;
+  EXPECT_EQ(1, mp::ScenarioDriver<SerialSolver>(base, 4).num_workers());
+  EXPECT_EQ(1, mp::ScenarioDriver<SerialSolver>(base, 0).num_workers());
+}
+
+TEST(ScenarioDriverTest, Cancel) {
+  mp::Problem base;
+  base.AddVar(0, 1);
+  base.AddObj(mp::obj::MAX, 1).AddTerm(0, 1);
+  mp::ScenarioDriver<UBSolver> driver(base);
+  driver.AddScenario("scenario0", mp::ProblemOverlay());
+  driver.AddScenario("scenario1", mp::ProblemOverlay());
+  driver.Cancel(1);
+  driver.Solve();
+  EXPECT_EQ(mp::sol::SOLVED, driver.result(0).status);
+  EXPECT_EQ(mp::sol::INTERRUPTED, driver.result(1).status);
+  EXPECT_EQ("interrupted", driver.result(1).message);
+  EXPECT_EQ(0, std::remove("scenario0.sol"));
+  EXPECT_NE(0, std::remove("scenario1.sol"));
+}
+
+TEST(ScenarioDriverTest, Deadline) {
+  mp::Problem base;
+  base.AddVar(0, 1);
+  base.AddObj(mp::obj::MAX, 1).AddTerm(0, 1);
+  mp::ScenarioDriver<InterruptibleSolver> driver(base, 2);
+  const int NUM_SCENARIOS = 3;
+  for (int i = 0; i < NUM_SCENARIOS; ++i)
+    driver.AddScenario(fmt::format("scenario{}", i), mp::ProblemOverlay());
+  driver.token().set_time_limit(0.01);
+  driver.Solve();
+  for (int i = 0; i < NUM_SCENARIOS; ++i) {
+    EXPECT_EQ(mp::sol::INTERRUPTED, driver.result(i).status);
+    std::remove(fmt::format("scenario{}.sol", i).c_str());
+  }
+}
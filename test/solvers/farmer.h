@@ -0,0 +1,140 @@
+/*
+ The farmer's problem for SMPS writer tests and benchmarks
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#ifndef TEST_SOLVERS_FARMER_H_
+#define TEST_SOLVERS_FARMER_H_
+
+#include <cmath>
+#include <limits>
+
+#include "mp/problem-builder.h"
+#include "mp/problem.h"
+
+// The farmer's problem from solvers/smpswriter/farmer.ampl scaled up to
+// num_crops crops and num_scenarios yield scenarios. The last crop plays
+// the role of sugar beets which have a quota and an excess selling price.
+class FarmerProblem : public mp::ColProblem {
+ private:
+  int num_crops_;
+
+  int area(int crop) const { return crop; }
+  int sell(int crop) const { return num_crops_ + crop; }
+  int sell_excess() const { return 2 * num_crops_; }
+  int buy(int crop) const { return 2 * num_crops_ + 1 + crop; }
+  int random_yield(int crop) const { return 3 * num_crops_ + 1 + crop; }
+
+  NumericExpr MakeTerm(double coef, int var_index) {
+    return MakeBinary(mp::expr::MUL, MakeNumericConstant(coef),
+                      MakeVariable(var_index));
+  }
+
+ public:
+  FarmerProblem(int num_crops, int num_scenarios);
+};
+
+inline FarmerProblem::FarmerProblem(int num_crops, int num_scenarios)
+  : num_crops_(num_crops) {
+  int beets = num_crops - 1;
+  mp::NLHeader header = mp::NLHeader();
+  header.num_vars = 4 * num_crops + 1;
+  header.num_con_nonzeros = 4 * num_crops + 4;
+  mp::ColProblemBuilder builder(*this);
+  builder.OnHeader(header);
+  double inf = std::numeric_limits<double>::infinity();
+  for (int i = 0; i < random_yield(0); ++i)
+    var(i).set_ub(inf);
+  auto stage = AddIntSuffix("stage", mp::suf::VAR, header.num_vars);
+  for (int i = sell(0); i < random_yield(0); ++i)
+    stage.SetValue(i, 2);
+
+  // maximize profit:
+  //   expectation(ExcessSellingPrice * sell_excess +
+  //     sum{c in Crops} (SellingPrice[c] * sell[c] -
+  //                      PurchasePrice[c] * buy[c])) -
+  //   sum{c in Crops} PlantingCost[c] * area[c];
+  NumericExpr profit = MakeTerm(10, sell_excess());
+  for (int c = 0; c < num_crops; ++c) {
+    double selling_price = c == beets ? 36 : 170 - c;
+    double purchase_price = c == beets ? 100 : 238 - c;
+    profit = MakeBinary(mp::expr::ADD, profit, MakeTerm(selling_price, sell(c)));
+    profit = MakeBinary(mp::expr::ADD, profit, MakeTerm(-purchase_price, buy(c)));
+  }
+  auto expectation = BeginCall(AddFunction("expectation", 0), 1);
+  expectation.AddArg(profit);
+  auto obj = AddObj(mp::obj::MAX, EndCall(expectation), num_crops);
+  for (int c = 0; c < num_crops; ++c)
+    obj.AddTerm(area(c), -(150 + 10 * c));
+
+  // yield: random({c in Crops} (RandomYield[c], {s in Scen} Yield[c, s]));
+  auto random = BeginCall(AddFunction("random", 0),
+                          num_crops * (num_scenarios + 1));
+  for (int c = 0; c < num_crops; ++c) {
+    random.AddArg(MakeVariable(random_yield(c)));
+    double mean_yield = c == beets ? 20 : 2.5 + 0.1 * c;
+    for (int s = 0; s < num_scenarios; ++s) {
+      double deviation = 0.2 * std::sin(s * 0.61 + c * 1.3);
+      random.AddArg(MakeNumericConstant(mean_yield * (1 + deviation)));
+    }
+  }
+  AddCon(MakeRelational(mp::expr::NE, EndCall(random), MakeNumericConstant(0)));
+
+  // s.t. totalArea: sum {c in Crops} area[c] <= TotalArea;
+  AddCon(-inf, 500.0 * num_crops / 3);
+  // s.t. requirement{c in Crops}:
+  //   RandomYield[c] * area[c] - sell[c] + buy[c] >= MinRequirement[c];
+  for (int c = 0; c < num_crops; ++c) {
+    AddCon(c == beets ? 0 : 200, inf).set_nonlinear_expr(MakeBinary(
+          mp::expr::MUL, MakeVariable(random_yield(c)), MakeVariable(area(c))));
+  }
+  // s.t. quota: sell['beets'] <= BeetsQuota;
+  AddCon(-inf, 6000);
+  // s.t. sellBeets:
+  //   sell['beets'] + sell_excess <= RandomYield['beets'] * area['beets'];
+  AddCon(0, inf).set_nonlinear_expr(
+        MakeBinary(mp::expr::MUL, MakeVariable(random_yield(beets)),
+                   MakeVariable(area(beets))));
+
+  auto col_sizes = builder.OnColumnSizes();
+  for (int c = 0; c < num_crops; ++c)
+    col_sizes.Add(c == beets ? 3 : 2);
+  for (int c = 0; c < num_crops; ++c)
+    col_sizes.Add(c == beets ? 3 : 1);
+  col_sizes.Add(1);
+  for (int c = 0; c < num_crops; ++c)
+    col_sizes.Add(1);
+  for (int c = 0; c < num_crops; ++c)
+    col_sizes.Add(0);
+  auto con = builder.OnLinearConExpr(0, num_crops);
+  for (int c = 0; c < num_crops; ++c)
+    con.AddTerm(area(c), 1);
+  for (int c = 0; c < num_crops; ++c) {
+    con = builder.OnLinearConExpr(c + 1, 3);
+    con.AddTerm(area(c), 0);
+    con.AddTerm(sell(c), -1);
+    con.AddTerm(buy(c), 1);
+  }
+  builder.OnLinearConExpr(num_crops + 1, 1).AddTerm(sell(beets), 1);
+  con = builder.OnLinearConExpr(num_crops + 2, 3);
+  con.AddTerm(area(beets), 0);
+  con.AddTerm(sell(beets), -1);
+  con.AddTerm(sell_excess(), -1);
+}
+
+#endif  // TEST_SOLVERS_FARMER_H_
@@ -0,0 +1,123 @@
+/*
+ LP backend tests
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <limits>
+
+#include "gtest/gtest.h"
+#include "ssdsolver/lp.h"
+
+namespace {
+
+const double INF = std::numeric_limits<double>::infinity();
+
+// Builds the problem
+//   maximize 3x + 2y
+//   subject to x + y <= 4, x + 3y <= 6, 0 <= x <= 3, y >= 0
+// with the optimal solution x = 3, y = 1.
+void BuildProblem(mp::Problem &p) {
+  p.AddVar(0, 3);
+  p.AddVar(0, INF);
+  mp::Problem::LinearObjBuilder obj = p.AddObj(mp::obj::MAX, 2);
+  obj.AddTerm(0, 3);
+  obj.AddTerm(1, 2);
+  mp::Problem::LinearConBuilder con = p.AddCon(-INF, 4).set_linear_expr(2);
+  con.AddTerm(0, 1);
+  con.AddTerm(1, 1);
+  con = p.AddCon(-INF, 6).set_linear_expr(2);
+  con.AddTerm(0, 1);
+  con.AddTerm(1, 3);
+}
+
+TEST(DualSimplexTest, Optimize) {
+  mp::Problem p;
+  BuildProblem(p);
+  mp::DualSimplex lp;
+  lp.Load(p);
+  EXPECT_EQ(mp::sol::SOLVED, lp.Optimize());
+  EXPECT_NEAR(3, lp.value(0), 1e-9);
+  EXPECT_NEAR(1, lp.value(1), 1e-9);
+}
+
+TEST(DualSimplexTest, Minimize) {
+  mp::Problem p;
+  p.AddVar(0, INF);
+  p.AddVar(-1, INF);
+  mp::Problem::LinearObjBuilder obj = p.AddObj(mp::obj::MIN, 2);
+  obj.AddTerm(0, 2);
+  obj.AddTerm(1, 1);
+  mp::Problem::LinearConBuilder con = p.AddCon(2, 2).set_linear_expr(2);
+  con.AddTerm(0, 1);
+  con.AddTerm(1, 1);
+  mp::DualSimplex lp;
+  lp.Load(p);
+  EXPECT_EQ(mp::sol::SOLVED, lp.Optimize());
+  EXPECT_NEAR(0, lp.value(0), 1e-9);
+  EXPECT_NEAR(2, lp.value(1), 1e-9);
+}
+
+TEST(DualSimplexTest, AddRow) {
+  mp::Problem p;
+  BuildProblem(p);
+  mp::DualSimplex lp;
+  lp.Load(p);
+  EXPECT_EQ(mp::sol::SOLVED, lp.Optimize());
+  int num_iterations = lp.num_iterations();
+  // Add y >= 1.5 and reoptimize from the previous basis.
+  int vars[] = {1};
+  double coefs[] = {1};
+  lp.AddRow(1.5, INF, 1, vars, coefs);
+  EXPECT_EQ(mp::sol::SOLVED, lp.Optimize());
+  EXPECT_NEAR(1.5, lp.value(0), 1e-9);
+  EXPECT_NEAR(1.5, lp.value(1), 1e-9);
+  EXPECT_EQ(num_iterations + 1, lp.num_iterations());
+}
+
+TEST(DualSimplexTest, Infeasible) {
+  mp::Problem p;
+  BuildProblem(p);
+  mp::DualSimplex lp;
+  lp.Load(p);
+  int vars[] = {0, 1};
+  double coefs[] = {1, 1};
+  lp.AddRow(5, INF, 2, vars, coefs);
+  EXPECT_EQ(mp::sol::INFEASIBLE, lp.Optimize());
+}
+
+TEST(DualSimplexTest, Unbounded) {
+  mp::Problem p;
+  p.AddVar(-INF, INF);
+  p.AddVar(0, INF);
+  p.AddObj(mp::obj::MAX, 1).AddTerm(0, 1);
+  mp::Problem::LinearConBuilder con = p.AddCon(-INF, 1).set_linear_expr(2);
+  con.AddTerm(0, 1);
+  con.AddTerm(1, -1);
+  mp::DualSimplex lp;
+  lp.Load(p);
+  EXPECT_EQ(mp::sol::UNBOUNDED, lp.Optimize());
+}
+
+TEST(DualSimplexTest, NonlinearNotSupported) {
+  mp::Problem p;
+  p.AddVar(0, 1);
+  p.AddObj(mp::obj::MAX, p.MakeVariable(0));
+  mp::DualSimplex lp;
+  EXPECT_THROW(lp.Load(p), mp::Error);
+}
+}  // namespace
@@ -0,0 +1,88 @@
+/*
+ SMPS writer tests
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "smpswriter/smpswriter.h"
+#include "farmer.h"
+#include "../util.h"
+
+namespace {
+
+const char *const EXTENSIONS[] = {".tim", ".cor", ".sto"};
+
+// SMPS files written for a problem with the specified basename.
+// The files are removed on destruction.
+class SMPSFiles {
+ private:
+  std::string basename_;
+  TempFile tim_, cor_, sto_;
+
+ public:
+  explicit SMPSFiles(const std::string &basename)
+    : basename_(basename), tim_(basename + EXTENSIONS[0]),
+      cor_(basename + EXTENSIONS[1]), sto_(basename + EXTENSIONS[2]) {}
+
+  // Returns the contents of the file with the extension EXTENSIONS[index].
+  std::string Read(int index) const {
+    return ReadFile(basename_ + EXTENSIONS[index]);
+  }
+};
+
+// Writes a problem in the SMPS format using num_threads threads.
+void Write(FarmerProblem &p, const std::string &basename, int num_threads) {
+  mp::SMPSWriter writer;
+  writer.set_basename(basename + ".nl");
+  writer.set_num_threads(num_threads);
+  mp::BasicSolutionHandler sh;
+  writer.Solve(p, sh);
+}
+
+TEST(SMPSWriterTest, GoldenFiles) {
+  FarmerProblem p(3, 5);
+  int thread_counts[] = {1, 4};
+  for (int i = 0; i < 2; ++i) {
+    SCOPED_TRACE(thread_counts[i]);
+    SMPSFiles files("smps-golden");
+    Write(p, "smps-golden", thread_counts[i]);
+    for (int j = 0; j < 3; ++j) {
+      std::string golden = fmt::format(
+            "{}/smps/farmer{}", MP_TEST_DATA_DIR, EXTENSIONS[j]);
+      EXPECT_EQ(ReadFile(golden), files.Read(j));
+    }
+  }
+}
+
+TEST(SMPSWriterTest, OutputDoesNotDependOnThreads) {
+  // Enough scenarios for several blocks and rounds of parallel writing.
+  FarmerProblem p(3, 2000);
+  SMPSFiles expected("smps-threads1"), actual("smps-threads");
+  Write(p, "smps-threads1", 1);
+  int thread_counts[] = {2, 3, 8, 0};
+  for (std::size_t i = 0; i < sizeof(thread_counts) / sizeof(*thread_counts);
+       ++i) {
+    SCOPED_TRACE(thread_counts[i]);
+    Write(p, "smps-threads", thread_counts[i]);
+    for (int j = 0; j < 3; ++j)
+      EXPECT_EQ(expected.Read(j), actual.Read(j));
+  }
+}
+}  // namespace
@@ -0,0 +1,216 @@
+/*
+ SSD kernel tests
+
+ Copyright (C) 2026 AMPL Optimization Inc
+
+ Permission to use, copy, modify, and distribute this software and its
+ documentation for any purpose and without fee is hereby granted,
+ provided that the above copyright notice appear in all copies and that
+ both that the copyright notice and this permission notice and warranty
+ disclaimer appear in supporting documentation.
+
+ The author and AMPL Optimization Inc disclaim all warranties with
+ regard to this software, including all implied warranties of
+ merchantability and fitness.  In no event shall the author be liable
+ for any special, indirect or consequential damages or any damages
+ whatsoever resulting from loss of use, data or profits, whether in an
+ action of contract, negligence or other tortious action, arising out
+ of or in connection with the use or performance of this software.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "ssdsolver/ssdkernel.h"
+
+namespace {
+
+// Coefficients of a row-major scenario matrix where only every step-th
+// element is nonzero.
+std::vector<double> MakeCoefs(int num_scenarios, int num_vars, int step = 1) {
+  std::vector<double> coefs(num_scenarios * num_vars);
+  for (std::size_t i = 0, n = coefs.size(); i != n; ++i)
+    coefs[i] = i % step == 0 ? std::sin(i * 0.37 + 1) : 0;
+  return coefs;
+}
+
+// Checks the tails and cuts computed by the kernel against a naive
+// implementation for a sequence of slowly changing solutions.
+void CheckKernel(int num_scenarios, int num_vars, int num_threads,
+                 mp::SSDMatrix::Layout layout = mp::SSDMatrix::DENSE,
+                 int step = 1) {
+  std::vector<double> coefs = MakeCoefs(num_scenarios, num_vars, step);
+  mp::SSDMatrix matrix;
+  matrix.Assign(layout, num_scenarios, num_vars, &coefs[0]);
+  EXPECT_EQ(layout, matrix.layout());
+  mp::SSDKernel kernel(matrix, num_threads);
+  EXPECT_EQ(num_scenarios, kernel.num_scenarios());
+  EXPECT_EQ(num_vars, kernel.num_vars());
+  std::vector<double> x(num_vars), values(num_scenarios);
+  for (int iteration = 0; iteration < 40; ++iteration) {
+    for (int j = 0; j < num_vars; ++j)
+      x[j] = std::cos(j + iteration * 0.01 * (iteration % 10 == 9 ? 50 : 1));
+    kernel.ComputeTails(&x[0]);
+    for (int i = 0; i < num_scenarios; ++i) {
+      double value = 0;
+      for (int j = 0; j < num_vars; ++j)
+        value += coefs[i * num_vars + j] * x[j];
+      values[i] = value;
+    }
+    std::vector<double> sorted(values);
+    std::sort(sorted.begin(), sorted.end());
+    double tail = 0;
+    for (int i = 0; i < num_scenarios; ++i) {
+      tail += sorted[i];
+      ASSERT_NEAR(tail, kernel.tail(i), 1e-9 * (i + 1));
+      ASSERT_NEAR(sorted[i], values[kernel.scenario(i)], 1e-10);
+    }
+    // Use cuts of similar sizes which are aggregated from the previous ones
+    // with occasional jumps.
+    int size = iteration % 8 == 7 ?
+          1 + iteration * 7919 % num_scenarios :
+          num_scenarios / 3 + iteration % 5;
+    const double *cut = kernel.ComputeCut(size);
+    for (int j = 0; j < num_vars; ++j) {
+      double coef = 0;
+      for (int i = 0; i < size; ++i)
+        coef += coefs[kernel.scenario(i) * num_vars + j];
+      ASSERT_NEAR(coef, cut[j], 1e-9 * size);
+    }
+  }
+}
+}  // namespace
+
+TEST(SSDMatrixTest, ChooseLayout) {
+  EXPECT_EQ(mp::SSDMatrix::DENSE, mp::SSDMatrix::ChooseLayout(10, 10, 100));
+  EXPECT_EQ(mp::SSDMatrix::DENSE, mp::SSDMatrix::ChooseLayout(10, 10, 50));
+  EXPECT_EQ(mp::SSDMatrix::CSR, mp::SSDMatrix::ChooseLayout(10, 10, 49));
+}
+
+TEST(SSDMatrixTest, Assign) {
+  double coefs[] = {
+    1, 0, 2,
+    0, 0, 0,
+    0, 3, 4
+  };
+  mp::SSDMatrix matrix;
+  matrix.Assign(mp::SSDMatrix::AUTO, 3, 3, coefs);
+  EXPECT_EQ(mp::SSDMatrix::CSR, matrix.layout());
+  EXPECT_EQ(3, matrix.num_rows());
+  EXPECT_EQ(3, matrix.num_cols());
+  ASSERT_EQ(4u, matrix.num_elements());
+  const std::size_t row_starts[] = {0, 2, 2, 4};
+  const int col_indices[] = {0, 2, 1, 2};
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(row_starts[i], matrix.row_starts()[i]);
+    EXPECT_EQ(col_indices[i], matrix.col_indices()[i]);
+    EXPECT_EQ(i + 1, matrix.values()[i]);
+  }
+  matrix.Assign(mp::SSDMatrix::DENSE, 3, 3, coefs);
+  EXPECT_EQ(mp::SSDMatrix::DENSE, matrix.layout());
+  ASSERT_EQ(9u, matrix.num_elements());
+  for (int i = 0; i < 9; ++i)
+    EXPECT_EQ(coefs[i], matrix.values()[i]);
+}
+
+TEST(SSDMatrixTest, AssignColumnBlocked) {
+  int num_cols = mp::SSDMatrix::BLOCK_SIZE + 2;
+  std::vector<double> coefs = MakeCoefs(2, num_cols);
+  mp::SSDMatrix matrix;
+  matrix.Assign(mp::SSDMatrix::COLUMN_BLOCKED, 2, num_cols, &coefs[0]);
+  ASSERT_EQ(2, matrix.num_blocks());
+  EXPECT_EQ(mp::SSDMatrix::BLOCK_SIZE, matrix.block_size(0));
+  EXPECT_EQ(2, matrix.block_size(1));
+  for (int i = 0; i < 2; ++i) {
+    for (int j = 0; j < num_cols; ++j) {
+      int block = j / mp::SSDMatrix::BLOCK_SIZE;
+      EXPECT_EQ(coefs[i * num_cols + j], matrix.block_row(block, i)[
+                j % mp::SSDMatrix::BLOCK_SIZE]);
+    }
+  }
+}
+
+TEST(SSDKernelTest, SingleThread) {
+  CheckKernel(100, 76, 1);
+}
+
+TEST(SSDKernelTest, MultipleThreads) {
+  CheckKernel(5000, 77, 4);
+}
+
+TEST(SSDKernelTest, CSR) {
+  CheckKernel(100, 76, 1, mp::SSDMatrix::CSR, 7);
+  CheckKernel(5000, 77, 4, mp::SSDMatrix::CSR, 3);
+}
+
+TEST(SSDKernelTest, ColumnBlocked) {
+  CheckKernel(100, 76, 1, mp::SSDMatrix::COLUMN_BLOCKED);
+  CheckKernel(300, 2 * mp::SSDMatrix::BLOCK_SIZE + 3, 4,
+              mp::SSDMatrix::COLUMN_BLOCKED, 5);
+}
+
+TEST(SSDKernelTest, EmptyCut) {
+  std::vector<double> coefs = MakeCoefs(3, 2);
+  mp::SSDMatrix matrix;
+  matrix.Assign(mp::SSDMatrix::DENSE, 3, 2, &coefs[0]);
+  mp::SSDKernel kernel(matrix, 1);
+  double x[] = {1, 2};
+  kernel.ComputeTails(x);
+  const double *cut = kernel.ComputeCut(0);
+  EXPECT_EQ(0, cut[0]);
+  EXPECT_EQ(0, cut[1]);
+}
+
+// Maximizes the dominance of a portfolio over the equally weighted one.
+TEST(SSDKernelTest, SolveSSD) {
+  enum {NUM_SCENARIOS = 50, NUM_VARS = 6};
+  std::vector<double> coefs = MakeCoefs(NUM_SCENARIOS, NUM_VARS);
+  std::vector<double> rhs(NUM_SCENARIOS);
+  for (int i = 0; i < NUM_SCENARIOS; ++i) {
+    for (int j = 0; j < NUM_VARS; ++j)
+      rhs[i] += coefs[i * NUM_VARS + j] / NUM_VARS;
+  }
+  double inf = std::numeric_limits<double>::infinity();
+  mp::Problem p;
+  for (int j = 0; j < NUM_VARS; ++j)
+    p.AddVar(0, 1);
+  p.AddVar(-inf, inf);
+  p.AddObj(mp::obj::MAX, 1).AddTerm(NUM_VARS, 1);
+  mp::Problem::LinearConBuilder budget =
+      p.AddCon(1, 1).set_linear_expr(NUM_VARS);
+  for (int j = 0; j < NUM_VARS; ++j)
+    budget.AddTerm(j, 1);
+  mp::DualSimplex lp;
+  lp.Load(p);
+  mp::SSDMatrix matrix;
+  matrix.Assign(mp::SSDMatrix::AUTO, NUM_SCENARIOS, NUM_VARS, &coefs[0]);
+  mp::SSDResult result;
+  result.solution.resize(NUM_VARS + 1);
+  mp::SolveSSD(lp, matrix, rhs, mp::SSDOptions(), result);
+  ASSERT_EQ(mp::sol::SOLVED, result.status);
+  EXPECT_GE(result.dominance, -1e-9);
+  EXPECT_GT(result.num_iterations, 1);
+
+  // Check that the solution satisfies the SSD constraint with the computed
+  // dominance.
+  double sum = 0;
+  for (int j = 0; j < NUM_VARS; ++j)
+    sum += result.solution[j];
+  EXPECT_NEAR(1, sum, 1e-9);
+  std::vector<double> values(NUM_SCENARIOS);
+  for (int i = 0; i < NUM_SCENARIOS; ++i) {
+    for (int j = 0; j < NUM_VARS; ++j)
+      values[i] += coefs[i * NUM_VARS + j] * result.solution[j];
+  }
+  std::sort(values.begin(), values.end());
+  std::sort(rhs.begin(), rhs.end());
+  double tail = 0, ref_tail = 0;
+  for (int i = 0; i < NUM_SCENARIOS; ++i) {
+    tail += values[i];
+    ref_tail += rhs[i];
+    EXPECT_GE(tail - ref_tail, result.dominance - 1e-4);
+  }
+}
@@ -24,6 +24,8 @@
 #include "gtest-extra.h"
 #include <gmock/gmock.h>
 
+#include <limits>
+
 namespace expr = mp::expr;
 
 // A test column-wise problem with specified number of variables.
@@ -105,20 +107,126 @@ TEST(SPTest, Transpose) {
       m.index(i) = indices[i];
       m.value(i) = values[i];
     }
+    m.start(3) = 3;
   }
-  mp::SparseMatrix<double*> t;
+  mp::SparseMatrix<double> t;
   mp::internal::Transpose(m, t, 3);
   int starts[] = {0, 1, 2, 3};
   for (int i = 0; i < 4; ++i)
     EXPECT_EQ(starts[i], t.start(i)) << i;
   int indices[] = {1, 0, 0};
-  double *values[] = {&m.value(2), &m.value(0), &m.value(1)};
+  double values[] = {7, 11, 13};
   for (int i = 0; i < 3; ++i) {
     EXPECT_EQ(indices[i], t.index(i));
     EXPECT_EQ(values[i], t.value(i));
   }
 }
 
+TEST(SPTest, ParallelTranspose) {
+  // Use enough elements to split the matrix into several parts.
+  const int num_rows = 100000, num_cols = 1000, num_elements = 300000;
+  mp::SparseMatrix<int> m;
+  m.resize_major(num_rows);
+  m.resize_elements(num_elements);
+  for (int i = 0; i < num_elements; ++i) {
+    m.index(i) = (i % num_cols) * 7919 % num_cols;
+    m.value(i) = i;
+  }
+  for (int i = 0; i <= num_rows; ++i)
+    m.start(i) = static_cast<int>(static_cast<long long>(i) * num_elements /
+                                  num_rows);
+  mp::SparseMatrix<int> t1, t4;
+  mp::internal::Transpose(m, t1, num_cols, 1);
+  mp::internal::Transpose(m, t4, num_cols, 4);
+  ASSERT_EQ(num_cols, t4.major_size());
+  ASSERT_EQ(num_elements, t4.num_elements());
+  for (int j = 0; j <= num_cols; ++j)
+    ASSERT_EQ(t1.start(j), t4.start(j));
+  for (int j = 0; j < num_cols; ++j) {
+    for (int k = t4.start(j), end = t4.start(j + 1); k < end; ++k) {
+      ASSERT_EQ(t1.index(k), t4.index(k));
+      ASSERT_EQ(t1.value(k), t4.value(k));
+      int elt_index = t4.value(k);
+      ASSERT_EQ(j, m.index(elt_index));
+      ASSERT_TRUE(elt_index >= m.start(t4.index(k)) &&
+                  elt_index < m.start(t4.index(k) + 1));
+      if (k != t4.start(j)) {
+        ASSERT_LT(t4.value(k - 1), elt_index);
+      }
+    }
+  }
+}
+
+// Builds the constraint matrix
+//   [1 0 2]
+//   [0 0 0]
+//   [0 3 4]
+// adding rows in the specified order.
+void BuildRows(mp::ColProblem &p, const int *rows) {
+  p.set_build_rows(true);
+  mp::ColProblemBuilder builder(p);
+  mp::NLHeader header = MakeHeader(3);
+  header.num_algebraic_cons = 3;
+  header.num_con_nonzeros = 4;
+  builder.OnHeader(header);
+  auto col_sizes = builder.OnColumnSizes();
+  col_sizes.Add(1);
+  col_sizes.Add(1);
+  for (int i = 0; i < 2; ++i) {
+    if (rows[i] == 0) {
+      auto con = builder.OnLinearConExpr(0, 2);
+      con.AddTerm(0, 1);
+      con.AddTerm(2, 2);
+    } else {
+      auto con = builder.OnLinearConExpr(2, 2);
+      con.AddTerm(1, 3);
+      con.AddTerm(2, 4);
+    }
+  }
+  builder.EndInput();
+}
+
+void CheckRows(const mp::ColProblem &p) {
+  ASSERT_TRUE(p.has_rows());
+  int row_starts[] = {0, 2, 2, 4};
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(row_starts[i], p.row_start(i));
+  int col_indices[] = {0, 2, 1, 2};
+  double values[] = {1, 2, 3, 4};
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(col_indices[i], p.col_index(i));
+    EXPECT_EQ(values[i], p.row_value(i));
+  }
+}
+
+TEST(SPTest, BuildRows) {
+  mp::ColProblem p;
+  int rows[] = {0, 2};
+  BuildRows(p, rows);
+  CheckRows(p);
+  int col_starts[] = {0, 1, 2, 4};
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(col_starts[i], p.col_start(i));
+  int row_indices[] = {0, 2, 0, 2};
+  double values[] = {1, 3, 2, 4};
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(row_indices[i], p.row_index(i));
+    EXPECT_EQ(values[i], p.value(i));
+  }
+}
+
+TEST(SPTest, BuildRowsOutOfOrder) {
+  mp::ColProblem p;
+  int rows[] = {2, 0};
+  BuildRows(p, rows);
+  CheckRows(p);
+}
+
+TEST(SPTest, NoRowsByDefault) {
+  TestBasicProblem p(1);
+  EXPECT_FALSE(p.has_rows());
+}
+
 TEST(SPTest, EmptyProblem) {
   TestBasicProblem p(0);
   mp::SPAdapter sp(p);
@@ -613,3 +721,169 @@ TEST(SPTest, RandomConMatrix) {
   EXPECT_EQ(0, it->con_index());
   EXPECT_EQ(col.end(), ++it);
 }
+
+// Builds a two-stage problem
+//   minimize expectation(x + 3 * y + 1)
+//   subject to x <= 10, x + y >= xi, 2 * x + xi * y <= 100,
+// where y is a second-stage variable and xi is a random variable with
+// the specified realizations. The first realization has probability
+// first_prob and the rest are equiprobable.
+void MakeTwoStageProblem(TestProblem &p, const std::vector<double> &xi,
+                         double first_prob) {
+  auto stage = p.AddIntSuffix("stage", mp::suf::VAR, 3);
+  stage.SetValue(2, 2);
+  int num_realizations = static_cast<int>(xi.size());
+  auto random = p.BeginRandom(2 * num_realizations + 1);
+  double prob = (1 - first_prob) / (num_realizations - 1);
+  for (int i = 0; i < num_realizations; ++i)
+    random.AddArg(p.MakeNumericConstant(i == 0 ? first_prob : prob));
+  auto rv = p.MakeVariable(0);
+  random.AddArg(rv);
+  for (int i = 0; i < num_realizations; ++i)
+    random.AddArg(p.MakeNumericConstant(xi[i]));
+  p.EndRandom(random);
+  auto x = p.MakeVariable(1), y = p.MakeVariable(2);
+  p.AddExpectationObj(p.MakeBinary(
+      expr::ADD, p.MakeBinary(expr::ADD, x, p.MakeBinary(
+                                expr::MUL, p.MakeNumericConstant(3), y)),
+      p.MakeNumericConstant(1)));
+  double inf = std::numeric_limits<double>::infinity();
+  p.AddCon(-inf, 10);
+  p.AddCon(0, inf);
+  p.AddCon(-inf, 100).set_nonlinear_expr(p.MakeBinary(expr::MUL, rv, y));
+  auto cols = p.OnColumnSizes();
+  cols.Add(1);
+  cols.Add(3);
+  cols.Add(2);
+  p.OnLinearConExpr(0).AddTerm(1, 1);
+  auto con = p.OnLinearConExpr(1);
+  con.AddTerm(0, -1);
+  con.AddTerm(1, 1);
+  con.AddTerm(2, 1);
+  con = p.OnLinearConExpr(2);
+  con.AddTerm(1, 2);
+  con.AddTerm(2, 0);
+}
+
+mp::NLHeader MakeTwoStageHeader() {
+  auto header = MakeHeader(3);
+  header.num_con_nonzeros = 6;
+  return header;
+}
+
+TEST(SPTest, DeterministicEquivalent) {
+  TestProblem p(MakeTwoStageHeader());
+  std::vector<double> xi;
+  xi.push_back(5);
+  xi.push_back(7);
+  MakeTwoStageProblem(p, xi, 0.25);
+  mp::SPAdapter sp(p);
+  mp::ColProblem de;
+  sp.BuildDeterministicEquivalent(de);
+  ASSERT_EQ(3, de.num_vars());
+  ASSERT_EQ(5, de.num_algebraic_cons());
+
+  // Check the objective x + 0.25 * 3 * y[0] + 0.75 * 3 * y[1] + 1.
+  ASSERT_EQ(1, de.num_objs());
+  auto obj = de.obj(0);
+  EXPECT_EQ(mp::obj::MIN, obj.type());
+  EXPECT_EQ(1, mp::Cast<mp::NumericConstant>(obj.nonlinear_expr()).value());
+  const auto &linear = obj.linear_expr();
+  ASSERT_EQ(3, linear.num_terms());
+  auto term = linear.begin();
+  double obj_coefs[] = {1, 0.75, 2.25};
+  for (int i = 0; i < 3; ++i, ++term) {
+    EXPECT_EQ(i, term->var_index());
+    EXPECT_EQ(obj_coefs[i], term->coef());
+  }
+
+  // Check constraint bounds.
+  double inf = std::numeric_limits<double>::infinity();
+  double lbs[] = {-inf, 5, -inf, 7, -inf};
+  double ubs[] = {10, inf, 100, inf, 100};
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(lbs[i], de.algebraic_con(i).lb());
+    EXPECT_EQ(ubs[i], de.algebraic_con(i).ub());
+  }
+
+  // Check the constraint matrix.
+  int col_starts[] = {0, 5, 7, 9};
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(col_starts[i], de.col_start(i));
+  int row_indices[] = {0, 1, 2, 3, 4, 1, 2, 3, 4};
+  double coefs[] = {1, 1, 2, 1, 2, 1, 5, 1, 7};
+  for (int i = 0; i < 9; ++i) {
+    EXPECT_EQ(row_indices[i], de.row_index(i));
+    EXPECT_EQ(coefs[i], de.value(i));
+  }
+}
+
+TEST(SPTest, DeterministicEquivalentOfSingleStageProblem) {
+  auto header = MakeHeader(2);
+  header.num_con_nonzeros = 2;
+  TestProblem p(header);
+  p.AddObj(mp::obj::MAX, 0);
+  p.AddCon(1, 2);
+  auto cols = p.OnColumnSizes();
+  cols.Add(1);
+  cols.Add(1);
+  auto con = p.OnLinearConExpr(0);
+  con.AddTerm(0, 3);
+  con.AddTerm(1, 4);
+  mp::SPAdapter sp(p);
+  mp::ColProblem de;
+  sp.BuildDeterministicEquivalent(de);
+  ASSERT_EQ(2, de.num_vars());
+  ASSERT_EQ(1, de.num_algebraic_cons());
+  EXPECT_EQ(mp::obj::MAX, de.obj(0).type());
+  EXPECT_EQ(1, de.algebraic_con(0).lb());
+  EXPECT_EQ(2, de.algebraic_con(0).ub());
+  EXPECT_EQ(2, de.col_start(2));
+  EXPECT_EQ(3, de.value(0));
+  EXPECT_EQ(4, de.value(1));
+}
+
+TEST(SPTest, ParallelDeterministicEquivalent) {
+  // Use enough scenarios to split them into several parts.
+  const int num_scenarios = 20000;
+  std::vector<double> xi(num_scenarios);
+  for (int i = 0; i < num_scenarios; ++i)
+    xi[i] = i % 100;
+  TestProblem p(MakeTwoStageHeader());
+  MakeTwoStageProblem(p, xi, 0.5);
+  mp::SPAdapter sp(p);
+  mp::ColProblem de1, de4;
+  de4.set_record_changes(true);
+  sp.BuildDeterministicEquivalent(de1, 1);
+  sp.BuildDeterministicEquivalent(de4, 4);
+  // Recording is paused while the bounds are set on multiple threads.
+  EXPECT_TRUE(de4.record_changes());
+  EXPECT_EQ(0, de4.num_changes());
+  int num_vars = num_scenarios + 1;
+  ASSERT_EQ(num_vars, de4.num_vars());
+  ASSERT_EQ(2 * num_scenarios + 1, de4.num_algebraic_cons());
+  for (int i = 0; i <= num_vars; ++i)
+    ASSERT_EQ(de1.col_start(i), de4.col_start(i));
+  for (int i = 0, n = de4.col_start(num_vars); i < n; ++i) {
+    ASSERT_EQ(de1.row_index(i), de4.row_index(i));
+    ASSERT_EQ(de1.value(i), de4.value(i));
+  }
+  for (int s = 0; s < num_scenarios; ++s) {
+    EXPECT_EQ(xi[s], de4.algebraic_con(2 * s + 1).lb());
+    EXPECT_EQ(xi[s], de4.value(de4.col_start(s + 1) + 1));
+  }
+}
+
+TEST(SPTest, DeterministicEquivalentWithMultipleRVs) {
+  TestBasicProblem p(2);
+  for (int i = 0; i < 2; ++i) {
+    auto random = i == 0 ? p.BeginRandom(2) : p.BeginCall(p.function(0), 2);
+    random.AddArg(p.MakeVariable(i));
+    random.AddArg(p.MakeNumericConstant(1));
+    p.EndRandom(random);
+  }
+  mp::SPAdapter sp(p);
+  mp::ColProblem de;
+  EXPECT_THROW_MSG(sp.BuildDeterministicEquivalent(de);, mp::UnsupportedError,
+                   "unsupported: multiple random vectors");
+}
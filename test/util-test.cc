@@ -79,4 +79,22 @@ TEST(UtilTest, ExecuteShellThrowsOnNonzeroExitCode) {
     ExecuteShellCommand(GetExecutableDir() + "/test-helper > out"),
     mp::Error, "process exited with code 42");
 }
+
+// The default format of a double round-trips exactly and is usually
+// the shortest representation.
+TEST(FormatTest, FormatShortestWithSpec) {
+  EXPECT_EQ("0.1", fmt::format("{}", 0.1));
+  EXPECT_EQ("-0", fmt::format("{}", -0.0));
+  EXPECT_EQ("+0.5", fmt::format("{:+}", 0.5));
+  EXPECT_EQ("    -1.5", fmt::format("{:8}", -1.5));
+  EXPECT_EQ("2.25    ", fmt::format("{:<8}", 2.25));
+  EXPECT_EQ(" -0.125  ", fmt::format("{:^9}", -0.125));
+  EXPECT_EQ("-00003.5", fmt::format("{:08}", -3.5));
+  EXPECT_EQ("0.3333333333333333", fmt::format("{}", 1.0 / 3));
+  EXPECT_EQ("0.30000000000000004", fmt::format("{}", 0.1 + 0.2));
+  EXPECT_EQ(L"0.1", fmt::format(L"{}", 0.1));
+  // An explicit type or precision gives the output of printf.
+  EXPECT_EQ("0.333333", fmt::format("{:g}", 1.0 / 3));
+  EXPECT_EQ("0.333", fmt::format("{:.3}", 1.0 / 3));
+}
 }
@@ -22,6 +22,7 @@
 
 #include "util.h"
 
+#include "gtest/gtest.h"
 #include "mp/error.h"
 #include "mp/os.h"
 
@@ -181,3 +182,21 @@ mp::NLHeader MakeTestHeader() {
 TempFile::~TempFile() {
   std::remove(name_.c_str());
 }
+
+void CheckEqual(const mp::NLStats &lhs, const mp::NLStats &rhs) {
+  EXPECT_EQ(lhs.num_objs, rhs.num_objs);
+  EXPECT_EQ(lhs.num_nl_objs, rhs.num_nl_objs);
+  EXPECT_EQ(lhs.num_algebraic_cons, rhs.num_algebraic_cons);
+  EXPECT_EQ(lhs.num_nl_cons, rhs.num_nl_cons);
+  EXPECT_EQ(lhs.num_logical_cons, rhs.num_logical_cons);
+  EXPECT_EQ(lhs.num_common_exprs, rhs.num_common_exprs);
+  EXPECT_EQ(lhs.num_obj_nonzeros, rhs.num_obj_nonzeros);
+  EXPECT_EQ(lhs.num_con_nonzeros, rhs.num_con_nonzeros);
+  EXPECT_EQ(lhs.num_fixed_vars, rhs.num_fixed_vars);
+  EXPECT_EQ(lhs.num_free_vars, rhs.num_free_vars);
+  EXPECT_EQ(lhs.num_eqns, rhs.num_eqns);
+  EXPECT_EQ(lhs.num_compl_conds, rhs.num_compl_conds);
+  EXPECT_EQ(lhs.max_expr_size, rhs.max_expr_size);
+  for (int i = 0; i <= mp::expr::LAST_EXPR; ++i)
+    EXPECT_EQ(lhs.num_exprs[i], rhs.num_exprs[i]);
+}
@@ -29,6 +29,7 @@
 #include <vector>
 
 #include "mp/format.h"
+#include "mp/nl-pipeline.h"
 #include "mp/nl-reader.h"
 #include "mp/os.h"
 
@@ -59,6 +60,9 @@ std::string ReplaceLine(std::string s, int line_index, fmt::StringRef new_line);
 
 mp::NLHeader MakeTestHeader();
 
+// Checks that statistics of two .nl files are equal.
+void CheckEqual(const mp::NLStats &lhs, const mp::NLStats &rhs);
+
 class TempFile {
  private:
   std::string name_;